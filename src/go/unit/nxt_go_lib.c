@@ -31,6 +31,71 @@ nxt_go_response_write(nxt_go_request_t r, uintptr_t buf, size_t len)
 }
 
 
+int
+nxt_go_response_write_status(nxt_go_request_t r, int status, int fields)
+{
+    nxt_int_t              rc;
+    nxt_go_run_ctx_t       *ctx;
+    nxt_app_resp_header_t  h;
+
+    if (nxt_slow_path(r == 0)) {
+        return 0;
+    }
+
+    nxt_go_debug("write status: %d, fields: %d", status, fields);
+
+    if (nxt_slow_path(status < 100 || status > 999 || fields > 0xffff)) {
+        nxt_go_warn("invalid response status %d or fields number %d",
+                    status, fields);
+        return -1;
+    }
+
+    ctx = (nxt_go_run_ctx_t *) r;
+
+    h.status = status;
+    h.fields = fields;
+
+    rc = nxt_go_ctx_write(ctx, &h, sizeof(nxt_app_resp_header_t));
+
+    return rc == NXT_OK ? 0 : -1;
+}
+
+
+int
+nxt_go_response_write_field(nxt_go_request_t r, uintptr_t buf,
+    size_t name_len, size_t value_len)
+{
+    nxt_int_t             rc;
+    nxt_go_run_ctx_t      *ctx;
+    nxt_app_resp_field_t  f;
+
+    if (nxt_slow_path(r == 0)) {
+        return 0;
+    }
+
+    if (nxt_slow_path(name_len == 0 || name_len > 0xff)) {
+        nxt_go_warn("invalid response field name length %d", (int) name_len);
+        return -1;
+    }
+
+    ctx = (nxt_go_run_ctx_t *) r;
+
+    f.value_length = value_len;
+    f.id = nxt_app_resp_field_id((u_char *) buf, name_len);
+    f.name_length = name_len;
+    f.reserved = 0;
+
+    rc = nxt_go_ctx_write(ctx, &f, sizeof(nxt_app_resp_field_t));
+
+    if (nxt_fast_path(rc == NXT_OK)) {
+        /* The name is followed by the value in the buffer. */
+        rc = nxt_go_ctx_write(ctx, (void *) buf, name_len + value_len);
+    }
+
+    return rc == NXT_OK ? 0 : -1;
+}
+
+
 int
 nxt_go_request_read(nxt_go_request_t r, uintptr_t dst, size_t dst_len)
 {
@@ -45,6 +110,20 @@ nxt_go_request_read(nxt_go_request_t r, uintptr_t dst, size_t dst_len)
 
     dst_len = nxt_min(dst_len, ctx->request.body.preread_size);
 
+    if (ctx->body_fd != -1) {
+        res = pread(ctx->body_fd, (void *) dst, dst_len, ctx->body_offset);
+
+        if (nxt_slow_path(res == (size_t) -1)) {
+            nxt_go_warn("pread(%d) failed %d", ctx->body_fd, errno);
+            return 0;
+        }
+
+        ctx->body_offset += res;
+        ctx->request.body.preread_size -= res;
+
+        return res;
+    }
+
     res = nxt_go_ctx_read_raw(ctx, (void *) dst, dst_len);
 
     ctx->request.body.preread_size -= res;
@@ -53,6 +132,55 @@ nxt_go_request_read(nxt_go_request_t r, uintptr_t dst, size_t dst_len)
 }
 
 
+int
+nxt_go_request_body_fetch(nxt_go_request_t r)
+{
+    nxt_port_msg_t    port_msg;
+    nxt_go_run_ctx_t  *ctx;
+
+    if (nxt_slow_path(r == 0)) {
+        return 0;
+    }
+
+    ctx = (nxt_go_run_ctx_t *) r;
+
+    if (!ctx->body_more || ctx->request.body.preread_size == 0) {
+        return 0;
+    }
+
+    port_msg.stream = ctx->msg.port_msg->stream;
+    port_msg.pid = getpid();
+    port_msg.reply_port = 0;
+    port_msg.type = _NXT_PORT_MSG_BODY;
+    port_msg.last = 0;
+    port_msg.mmap = 0;
+    port_msg.nf = 0;
+    port_msg.mf = 0;
+    port_msg.tracking = 0;
+    port_msg.ring = 0;
+
+    if (nxt_go_port_send(ctx->msg.port_msg->pid, ctx->msg.port_msg->reply_port,
+                         &port_msg, sizeof(port_msg), NULL, 0)
+        != sizeof(port_msg))
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+
+void
+nxt_go_request_body_add(nxt_go_request_t r, uintptr_t msg)
+{
+    nxt_go_run_ctx_t  *ctx;
+
+    ctx = (nxt_go_run_ctx_t *) r;
+
+    nxt_go_ctx_add_msg(ctx, (nxt_go_msg_t *) msg);
+}
+
+
 int
 nxt_go_request_close(nxt_go_request_t r)
 {
@@ -77,6 +205,10 @@ nxt_go_request_done(nxt_go_request_t r)
 
     nxt_go_ctx_release_msg(ctx, &ctx->msg);
 
+    if (ctx->body_fd != -1) {
+        close(ctx->body_fd);
+    }
+
     msg = ctx->msg.next;
     while (msg != NULL) {
         nxt_go_ctx_release_msg(ctx, msg);
@@ -107,6 +239,7 @@ nxt_go_ready(uint32_t stream)
     port_msg.nf = 0;
     port_msg.mf = 0;
     port_msg.tracking = 0;
+    port_msg.ring = 0;
 
     nxt_go_main_send(&port_msg, sizeof(port_msg), NULL, 0);
 }
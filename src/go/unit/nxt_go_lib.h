@@ -21,8 +21,17 @@ typedef uintptr_t nxt_go_request_t;
 
 int nxt_go_response_write(nxt_go_request_t r, uintptr_t buf, size_t len);
 
+int nxt_go_response_write_status(nxt_go_request_t r, int status, int fields);
+
+int nxt_go_response_write_field(nxt_go_request_t r, uintptr_t buf,
+    size_t name_len, size_t value_len);
+
 int nxt_go_request_read(nxt_go_request_t r, uintptr_t dst, size_t dst_len);
 
+int nxt_go_request_body_fetch(nxt_go_request_t r);
+
+void nxt_go_request_body_add(nxt_go_request_t r, uintptr_t msg);
+
 int nxt_go_request_close(nxt_go_request_t r);
 
 int nxt_go_request_done(nxt_go_request_t r);
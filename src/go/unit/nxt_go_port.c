@@ -17,7 +17,7 @@
 #define nxt_go_str(p) ((nxt_go_str_t *)(p))
 
 static nxt_go_request_t
-nxt_go_data_handler(nxt_port_msg_t *port_msg, size_t size)
+nxt_go_data_handler(nxt_port_msg_t *port_msg, size_t size, nxt_fd_t fd)
 {
     size_t                    s;
     nxt_str_t                 n, v;
@@ -25,6 +25,7 @@ nxt_go_data_handler(nxt_port_msg_t *port_msg, size_t size)
     nxt_uint_t                i;
     nxt_go_run_ctx_t          *ctx;
     nxt_go_request_t          r;
+    nxt_app_fields_t          fields;
     nxt_app_request_header_t  *h;
 
     ctx = malloc(sizeof(nxt_go_run_ctx_t) + size);
@@ -38,10 +39,17 @@ nxt_go_data_handler(nxt_port_msg_t *port_msg, size_t size)
 
     if (nxt_slow_path(ctx->cancelled)) {
         nxt_go_debug("request already cancelled by router");
+
+        if (fd != -1) {
+            close(fd);
+        }
+
         free(ctx);
         return 0;
     }
 
+    ctx->body_fd = fd;
+
     r = (nxt_go_request_t)(ctx);
     h = &ctx->request.header;
 
@@ -81,6 +89,8 @@ nxt_go_data_handler(nxt_port_msg_t *port_msg, size_t size)
                                        nxt_go_str(&ctx->request.remote));
     }
 
+    nxt_go_ctx_read_str(ctx, &ctx->request.local);
+
     nxt_go_ctx_read_str(ctx, &h->host);
     nxt_go_ctx_read_str(ctx, &h->cookie);
     nxt_go_ctx_read_str(ctx, &h->content_type);
@@ -93,17 +103,18 @@ nxt_go_data_handler(nxt_port_msg_t *port_msg, size_t size)
     nxt_go_ctx_read_size(ctx, &s);
     h->parsed_content_length = s;
 
-    do {
-        rc = nxt_go_ctx_read_str(ctx, &n);
+    rc = nxt_go_ctx_read_fields(ctx, &fields);
 
-        if (n.length == 0) {
-            break;
-        }
+    if (rc == NXT_OK) {
+        for (i = 0; i < fields.count; i++) {
+            if (nxt_app_fields_get(&fields, i, &n, &v) != NXT_OK) {
+                break;
+            }
 
-        rc = nxt_go_ctx_read_str(ctx, &v);
-        nxt_go_request_add_header(ctx->go_request, nxt_go_str(&n),
-                                  nxt_go_str(&v));
-    } while(1);
+            nxt_go_request_add_header(ctx->go_request, nxt_go_str(&n),
+                                      nxt_go_str(&v));
+        }
+    }
 
     nxt_go_ctx_read_size(ctx, &s);
     ctx->request.body.preread_size = s;
@@ -113,13 +124,38 @@ nxt_go_data_handler(nxt_port_msg_t *port_msg, size_t size)
                                           h->parsed_content_length);
     }
 
-    if (ctx->request.body.preread_size < h->parsed_content_length) {
+    if (port_msg->last == 0) {
+        /* The body is requested from router by parts. */
+        ctx->body_stream = 1;
+        ctx->body_more = 1;
+
+        nxt_go_request_body_stream(ctx->go_request);
+
+    } else if (ctx->request.body.preread_size < h->parsed_content_length) {
         nxt_go_warn("preread_size < content_length");
     }
 
     return ctx->go_request;
 }
 
+static void
+nxt_go_body_handler(nxt_port_msg_t *port_msg, size_t size)
+{
+    nxt_go_msg_t  *msg;
+
+    msg = nxt_go_msg_new(port_msg, size);
+    if (nxt_slow_path(msg == NULL)) {
+        nxt_go_warn("failed to allocate body message");
+        return;
+    }
+
+    if (nxt_go_request_body_msg(port_msg->stream, (uintptr_t) msg) == 0) {
+        nxt_go_warn("request #%d not found", (int) port_msg->stream);
+
+        nxt_go_msg_release(msg);
+    }
+}
+
 nxt_go_request_t
 nxt_go_port_on_read(void *buf, size_t buf_size, void *oob, size_t oob_size)
 {
@@ -192,7 +228,18 @@ nxt_go_port_on_read(void *buf, size_t buf_size, void *oob, size_t oob_size)
     case _NXT_PORT_MSG_DATA:
         nxt_go_debug("data");
 
-        return nxt_go_data_handler(port_msg, buf_size);
+        return nxt_go_data_handler(port_msg, buf_size, fd);
+
+    case _NXT_PORT_MSG_BODY:
+        nxt_go_debug("body");
+
+        nxt_go_body_handler(port_msg, buf_size);
+        break;
+
+    case _NXT_PORT_MSG_CREDIT:
+        /* Go applications do not limit responses, the credits are unused. */
+        nxt_go_debug("credit");
+        break;
 
     case _NXT_PORT_MSG_REMOVE_PID:
         nxt_go_debug("remove pid");
@@ -98,6 +98,10 @@ nxt_go_new_port_mmap(nxt_go_process_t *process, nxt_port_id_t id,
         goto remove_fail;
     }
 
+#if (NXT_HAVE_MADV_HUGEPAGE)
+    (void) madvise(mem, PORT_MMAP_SIZE, MADV_HUGEPAGE);
+#endif
+
     port_mmap->hdr = mem;
 
     /* Init segment header. */
@@ -129,6 +133,7 @@ nxt_go_new_port_mmap(nxt_go_process_t *process, nxt_port_id_t id,
     port_msg.nf = 0;
     port_msg.mf = 0;
     port_msg.tracking = 0;
+    port_msg.ring = 0;
 
     cmsg.cm.cmsg_len = CMSG_LEN(sizeof(int));
     cmsg.cm.cmsg_level = SOL_SOCKET;
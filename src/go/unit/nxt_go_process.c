@@ -133,6 +133,10 @@ nxt_go_new_incoming_mmap(nxt_pid_t pid, nxt_fd_t fd)
         goto fail;
     }
 
+#if (NXT_HAVE_MADV_HUGEPAGE)
+    (void) madvise(mem, mmap_stat.st_size, MADV_HUGEPAGE);
+#endif
+
     port_mmap->hdr = mem;
 
     if (nxt_slow_path(port_mmap->hdr->id != process->incoming.nelts - 1)) {
@@ -21,7 +21,6 @@ static nxt_int_t
 nxt_go_ctx_msg_rbuf(nxt_go_run_ctx_t *ctx, nxt_go_msg_t *msg, nxt_buf_t *buf,
     uint32_t n)
 {
-    size_t               nchunks;
     nxt_go_port_mmap_t   *port_mmap;
     nxt_port_mmap_msg_t  *mmap_msg;
 
@@ -58,19 +57,16 @@ nxt_go_ctx_msg_rbuf(nxt_go_run_ctx_t *ctx, nxt_go_msg_t *msg, nxt_buf_t *buf,
     nxt_go_mutex_lock(&ctx->process->incoming_mutex);
 
     port_mmap = nxt_go_array_at(&ctx->process->incoming, mmap_msg->mmap_id);
-    buf->mem.start = nxt_port_mmap_chunk_start(port_mmap->hdr,
-                                               mmap_msg->chunk_id);
+    buf->mem.start = nxt_port_mmap_msg_start(port_mmap->hdr,
+                                             mmap_msg->chunk_id);
     buf->mem.pos = buf->mem.start;
     buf->mem.free = buf->mem.start + mmap_msg->size;
 
-    nxt_go_mutex_unlock(&ctx->process->incoming_mutex);
-
-    nchunks = mmap_msg->size / PORT_MMAP_CHUNK_SIZE;
-    if ((mmap_msg->size % PORT_MMAP_CHUNK_SIZE) != 0) {
-        nchunks++;
-    }
+    buf->mem.end = (mmap_msg->size != 0)
+                   ? nxt_port_mmap_range_end(port_mmap->hdr, buf->mem.free)
+                   : buf->mem.free;
 
-    buf->mem.end = buf->mem.start + nchunks * PORT_MMAP_CHUNK_SIZE;
+    nxt_go_mutex_unlock(&ctx->process->incoming_mutex);
 
     return NXT_OK;
 }
@@ -78,7 +74,17 @@ nxt_go_ctx_msg_rbuf(nxt_go_run_ctx_t *ctx, nxt_go_msg_t *msg, nxt_buf_t *buf,
 static nxt_int_t
 nxt_go_ctx_init_rbuf(nxt_go_run_ctx_t *ctx)
 {
-    return nxt_go_ctx_msg_rbuf(ctx, &ctx->msg, &ctx->rbuf, ctx->nrbuf);
+    return nxt_go_ctx_msg_rbuf(ctx, ctx->rmsg, &ctx->rbuf, ctx->nrbuf);
+}
+
+static nxt_uint_t
+nxt_go_msg_nbufs(nxt_go_msg_t *msg)
+{
+    if (msg->mmap_msg == NULL) {
+        return 1;
+    }
+
+    return msg->end - msg->mmap_msg;
 }
 
 static void
@@ -118,11 +124,10 @@ nxt_go_ctx_init_msg(nxt_go_msg_t *msg, nxt_port_msg_t *port_msg,
     }
 }
 
-void
-nxt_go_ctx_release_msg(nxt_go_run_ctx_t *ctx, nxt_go_msg_t *msg)
+static void
+nxt_go_process_release_msg(nxt_go_process_t *process, nxt_go_msg_t *msg)
 {
-    u_char               *b, *e;
-    nxt_chunk_id_t       c;
+    u_char               *b;
     nxt_go_port_mmap_t   *port_mmap;
     nxt_port_mmap_msg_t  *mmap_msg, *end;
 
@@ -133,24 +138,75 @@ nxt_go_ctx_release_msg(nxt_go_run_ctx_t *ctx, nxt_go_msg_t *msg)
     mmap_msg = msg->mmap_msg;
     end = msg->end;
 
-    nxt_go_mutex_lock(&ctx->process->incoming_mutex);
+    nxt_go_mutex_lock(&process->incoming_mutex);
 
     for (; mmap_msg < end; mmap_msg++ ) {
-        port_mmap = nxt_go_array_at(&ctx->process->incoming, mmap_msg->mmap_id);
+        port_mmap = nxt_go_array_at(&process->incoming, mmap_msg->mmap_id);
 
-        c = mmap_msg->chunk_id;
-        b = nxt_port_mmap_chunk_start(port_mmap->hdr, c);
-        e = b + mmap_msg->size;
+        b = nxt_port_mmap_msg_start(port_mmap->hdr, mmap_msg->chunk_id);
 
-        while (b < e) {
-            nxt_port_mmap_set_chunk_free(port_mmap->hdr->free_map, c);
+        nxt_port_mmap_free_range(port_mmap->hdr, b, b + mmap_msg->size);
 
-            b += PORT_MMAP_CHUNK_SIZE;
-            c++;
-        }
+        (void) nxt_port_mmap_reclaim(port_mmap->hdr);
     }
 
-    nxt_go_mutex_unlock(&ctx->process->incoming_mutex);
+    nxt_go_mutex_unlock(&process->incoming_mutex);
+}
+
+void
+nxt_go_ctx_release_msg(nxt_go_run_ctx_t *ctx, nxt_go_msg_t *msg)
+{
+    nxt_go_process_release_msg(ctx->process, msg);
+}
+
+
+/*
+ * A separate message carries a part of the request body
+ * streamed by router, it is copied with the port message.
+ */
+
+nxt_go_msg_t *
+nxt_go_msg_new(nxt_port_msg_t *port_msg, size_t size)
+{
+    nxt_go_msg_t  *msg;
+
+    msg = malloc(sizeof(nxt_go_msg_t) + size);
+    if (nxt_slow_path(msg == NULL)) {
+        return NULL;
+    }
+
+    port_msg = memcpy(msg + 1, port_msg, size);
+
+    nxt_go_ctx_init_msg(msg, port_msg, size - sizeof(nxt_port_msg_t));
+
+    return msg;
+}
+
+
+void
+nxt_go_msg_release(nxt_go_msg_t *msg)
+{
+    nxt_go_process_t  *process;
+
+    process = nxt_go_get_process(msg->port_msg->pid);
+
+    if (nxt_fast_path(process != NULL)) {
+        nxt_go_process_release_msg(process, msg);
+    }
+
+    free(msg);
+}
+
+
+void
+nxt_go_ctx_add_msg(nxt_go_run_ctx_t *ctx, nxt_go_msg_t *msg)
+{
+    ctx->msg_last->next = msg;
+    ctx->msg_last = msg;
+
+    if (msg->port_msg->last) {
+        ctx->body_more = 0;
+    }
 }
 
 
@@ -202,6 +258,7 @@ nxt_go_ctx_init(nxt_go_run_ctx_t *ctx, nxt_port_msg_t *port_msg,
         }
     }
 
+    ctx->rmsg = &ctx->msg;
     ctx->msg_last = &ctx->msg;
 
     ctx->wport_msg.stream = port_msg->stream;
@@ -515,13 +572,49 @@ nxt_go_ctx_read_str(nxt_go_run_ctx_t *ctx, nxt_str_t *str)
 }
 
 
-size_t
-nxt_go_ctx_read_raw(nxt_go_run_ctx_t *ctx, void *dst, size_t size)
+nxt_int_t
+nxt_go_ctx_read_fields(nxt_go_run_ctx_t *ctx, nxt_app_fields_t *fields)
 {
-    size_t     res, read_size;
+    size_t     size;
     nxt_int_t  rc;
     nxt_buf_t  *buf;
 
+    rc = nxt_go_ctx_read_size_(ctx, &size);
+    if (nxt_slow_path(rc != NXT_OK)) {
+        nxt_go_warn("read fields: read size failed");
+        return rc;
+    }
+
+    buf = &ctx->rbuf;
+
+    if (nxt_slow_path(nxt_buf_mem_used_size(&buf->mem) < (intptr_t) size)) {
+        nxt_go_warn("read fields: used size too small %d < %d",
+                    (int) nxt_buf_mem_used_size(&buf->mem), (int) size);
+        return NXT_ERROR;
+    }
+
+    rc = nxt_app_fields_init(fields, buf->mem.pos, size);
+    if (nxt_slow_path(rc != NXT_OK)) {
+        nxt_go_warn("read fields: invalid fields block");
+        return rc;
+    }
+
+    buf->mem.pos += size;
+
+    nxt_go_debug("read_fields: %d", (int) fields->count);
+
+    return NXT_OK;
+}
+
+
+size_t
+nxt_go_ctx_read_raw(nxt_go_run_ctx_t *ctx, void *dst, size_t size)
+{
+    size_t        res, read_size;
+    nxt_int_t     rc;
+    nxt_buf_t     *buf;
+    nxt_go_msg_t  *msg;
+
     res = 0;
 
     while (size > 0) {
@@ -529,6 +622,30 @@ nxt_go_ctx_read_raw(nxt_go_run_ctx_t *ctx, void *dst, size_t size)
 
         if (nxt_slow_path(nxt_buf_mem_used_size(&buf->mem) == 0)) {
             ctx->nrbuf++;
+
+            if (ctx->body_stream
+                && ctx->nrbuf >= nxt_go_msg_nbufs(ctx->rmsg))
+            {
+                msg = ctx->rmsg;
+
+                if (msg->next == NULL) {
+                    /* The rest of the body has to be fetched. */
+                    ctx->nrbuf--;
+                    break;
+                }
+
+                ctx->rmsg = msg->next;
+                ctx->nrbuf = 0;
+
+                if (msg != &ctx->msg) {
+                    /* Free shared memory as soon as possible. */
+                    ctx->msg.next = msg->next;
+
+                    nxt_go_ctx_release_msg(ctx, msg);
+                    free(msg);
+                }
+            }
+
             rc = nxt_go_ctx_init_rbuf(ctx);
             if (nxt_slow_path(rc != NXT_OK)) {
                 nxt_go_warn("read raw: init rbuf failed");
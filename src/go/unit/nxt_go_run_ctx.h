@@ -37,10 +37,17 @@ struct nxt_go_msg_s {
 
 typedef struct {
     nxt_go_msg_t         msg;
+    nxt_go_msg_t         *rmsg;
 
     nxt_go_process_t     *process;
     nxt_port_mmap_msg_t  *wmmap_msg;
     nxt_bool_t           cancelled;
+    nxt_bool_t           body_stream;
+    nxt_bool_t           body_more;
+
+    /* A request body passed in a temporary file. */
+    nxt_fd_t             body_fd;
+    nxt_off_t            body_offset;
 
     uint32_t             nrbuf;
     nxt_buf_t            rbuf;
@@ -59,8 +66,14 @@ typedef struct {
 } nxt_go_run_ctx_t;
 
 
+nxt_go_msg_t *nxt_go_msg_new(nxt_port_msg_t *port_msg, size_t size);
+
+void nxt_go_msg_release(nxt_go_msg_t *msg);
+
 void nxt_go_ctx_release_msg(nxt_go_run_ctx_t *ctx, nxt_go_msg_t *msg);
 
+void nxt_go_ctx_add_msg(nxt_go_run_ctx_t *ctx, nxt_go_msg_t *msg);
+
 nxt_int_t nxt_go_ctx_init(nxt_go_run_ctx_t *ctx, nxt_port_msg_t *port_msg,
     size_t payload_size);
 
@@ -72,6 +85,9 @@ nxt_int_t nxt_go_ctx_read_size(nxt_go_run_ctx_t *ctx, size_t *size);
 
 nxt_int_t nxt_go_ctx_read_str(nxt_go_run_ctx_t *ctx, nxt_str_t *str);
 
+nxt_int_t nxt_go_ctx_read_fields(nxt_go_run_ctx_t *ctx,
+    nxt_app_fields_t *fields);
+
 size_t nxt_go_ctx_read_raw(nxt_go_run_ctx_t *ctx, void *dst, size_t size);
 
 
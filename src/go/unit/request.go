@@ -11,8 +11,10 @@ package unit
 import "C"
 
 import (
+	"io"
 	"net/http"
 	"net/url"
+	"sync"
 	"unsafe"
 )
 
@@ -21,15 +23,33 @@ type request struct {
 	resp  *response
 	c_req C.nxt_go_request_t
 	id    C.uint32_t
+	body  chan C.uintptr_t
 }
 
+type body_registry struct {
+	sync.Mutex
+	m map[C.uint32_t]*request
+}
+
+var body_registry_ body_registry
+
 func (r *request) Read(p []byte) (n int, err error) {
 	c := C.size_t(cap(p))
 	b := C.uintptr_t(uintptr(unsafe.Pointer(&p[0])))
 
-	res := C.nxt_go_request_read(r.c_req, b, c)
+	for {
+		res := C.nxt_go_request_read(r.c_req, b, c)
 
-	return int(res), nil
+		if res > 0 || r.body == nil {
+			return int(res), nil
+		}
+
+		if C.nxt_go_request_body_fetch(r.c_req) == 0 {
+			return 0, io.EOF
+		}
+
+		C.nxt_go_request_body_add(r.c_req, <-r.body)
+	}
 }
 
 func (r *request) Close() error {
@@ -46,6 +66,18 @@ func (r *request) response() *response {
 }
 
 func (r *request) done() {
+	if r.body != nil {
+		body_registry_.Lock()
+		delete(body_registry_.m, r.id)
+		body_registry_.Unlock()
+
+		select {
+		case msg := <-r.body:
+			C.nxt_go_request_body_add(r.c_req, msg)
+		default:
+		}
+	}
+
 	C.nxt_go_request_done(r.c_req)
 }
 
@@ -81,6 +113,35 @@ func nxt_go_new_request(c_req C.nxt_go_request_t, id C.uint32_t,
 	return uintptr(unsafe.Pointer(r))
 }
 
+//export nxt_go_request_body_stream
+func nxt_go_request_body_stream(go_req C.nxt_go_request_t) {
+	r := get_request(go_req)
+	r.body = make(chan C.uintptr_t, 1)
+
+	body_registry_.Lock()
+	if body_registry_.m == nil {
+		body_registry_.m = make(map[C.uint32_t]*request)
+	}
+
+	body_registry_.m[r.id] = r
+	body_registry_.Unlock()
+}
+
+//export nxt_go_request_body_msg
+func nxt_go_request_body_msg(id C.uint32_t, msg C.uintptr_t) C.int {
+	body_registry_.Lock()
+	r := body_registry_.m[id]
+	body_registry_.Unlock()
+
+	if r == nil {
+		return 0
+	}
+
+	r.body <- msg
+
+	return 1
+}
+
 //export nxt_go_request_set_proto
 func nxt_go_request_set_proto(go_req C.nxt_go_request_t, proto *C.nxt_go_str_t,
 	maj C.int, min C.int) {
@@ -11,8 +11,8 @@ package unit
 import "C"
 
 import (
-	"fmt"
 	"net/http"
+	"strings"
 )
 
 type response struct {
@@ -54,14 +54,31 @@ func (r *response) WriteHeader(code int) {
 		return
 	}
 	r.headerSent = true
-	fmt.Fprintf(r, "Status: %d\r\n", code)
 
 	// Set a default Content-Type
 	if _, hasType := r.header["Content-Type"]; !hasType {
 		r.header.Add("Content-Type", "text/html; charset=utf-8")
 	}
 
-	r.header.Write(r)
+	fields := 0
+	for _, vv := range r.header {
+		fields += len(vv)
+	}
+
+	C.nxt_go_response_write_status(r.c_req, C.int(code), C.int(fields))
+
+	var buf []byte
+
+	for k, vv := range r.header {
+		for _, v := range vv {
+			v = headerNewlineToSpace.Replace(v)
 
-	r.Write([]byte("\r\n"))
+			buf = append(append(buf[:0], k...), v...)
+
+			C.nxt_go_response_write_field(r.c_req, buf_ref(buf),
+				C.size_t(len(k)), C.size_t(len(v)))
+		}
+	}
 }
+
+var headerNewlineToSpace = strings.NewReplacer("\n", " ", "\r", " ")
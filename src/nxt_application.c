@@ -29,6 +29,21 @@ static nxt_int_t nxt_discovery_module(nxt_task_t *task, nxt_mp_t *mp,
 static nxt_app_module_t *nxt_app_module_load(nxt_task_t *task,
     const char *name);
 
+static void nxt_app_quit(nxt_task_t *task, void *obj, void *data);
+static void nxt_app_request_process(nxt_task_t *task,
+    nxt_port_recv_msg_t *msg);
+static void nxt_app_data_defer(nxt_task_t *task, nxt_port_recv_msg_t *msg);
+static void nxt_app_data_deferred(nxt_task_t *task, void *obj, void *data);
+static nxt_buf_t *nxt_app_msg_buf_take(nxt_task_t *task,
+    nxt_port_recv_msg_t *msg);
+static void nxt_app_buf_chain_complete(nxt_task_t *task, nxt_buf_t *b);
+static nxt_int_t nxt_app_msg_body_wait(nxt_task_t *task, nxt_app_rmsg_t *msg);
+static nxt_int_t nxt_app_msg_window_wait(nxt_task_t *task,
+    nxt_app_wmsg_t *msg);
+static nxt_int_t nxt_app_port_poll(nxt_task_t *task, nxt_port_t *port,
+    nxt_port_t *read_port);
+static nxt_int_t nxt_app_msg_write_raw_(nxt_task_t *task, nxt_app_wmsg_t *msg,
+    const u_char *c, size_t size);
 static void nxt_app_http_release(nxt_task_t *task, void *obj, void *data);
 
 
@@ -42,6 +57,12 @@ static nxt_thread_cond_t         nxt_app_cond;
 
 static nxt_application_module_t  *nxt_app;
 
+/* A request being processed, the body of which may be streamed. */
+static nxt_app_rmsg_t            *nxt_app_rmsg;
+
+/* Its response, the body of which is flow controlled by router. */
+static nxt_app_wmsg_t            *nxt_app_wmsg;
+
 
 nxt_int_t
 nxt_discovery_start(nxt_task_t *task, void *data)
@@ -304,6 +325,19 @@ nxt_app_start(nxt_task_t *task, void *data)
         nxt_app = nxt_app_module_load(task, lang->file);
     }
 
+#if (NXT_HAVE_CPU_AFFINITY)
+
+    if (app_conf->affinity.length != 0) {
+        ret = nxt_cpu_affinity_process(task, app_conf->affinity_index,
+                                       nxt_str_eq(&app_conf->affinity,
+                                                  "node", 4));
+        if (nxt_slow_path(ret == NXT_ERROR)) {
+            return NXT_ERROR;
+        }
+    }
+
+#endif
+
     if (app_conf->working_directory != NULL
         && app_conf->working_directory[0] != 0)
     {
@@ -358,22 +392,49 @@ nxt_app_module_load(nxt_task_t *task, const char *name)
 
 void
 nxt_app_quit_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg)
+{
+    if (nxt_slow_path(nxt_app_rmsg != NULL)) {
+        /* The quit is postponed until the current request is processed. */
+        nxt_work_queue_add(&task->thread->engine->fast_work_queue,
+                           nxt_app_quit, task, NULL, NULL);
+        return;
+    }
+
+    nxt_app_quit(task, NULL, NULL);
+}
+
+
+static void
+nxt_app_quit(nxt_task_t *task, void *obj, void *data)
 {
     if (nxt_app->atexit != NULL) {
         nxt_app->atexit(task);
     }
 
-    nxt_worker_process_quit_handler(task, msg);
+    nxt_worker_process_quit_handler(task, NULL);
 }
 
 
+/*
+ * A request is processed out of the port read handler, because application
+ * module waits for body parts and response credits which are read from the
+ * same port.  Requests received meanwhile are queued.
+ */
+
 void
 nxt_app_data_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg)
+{
+    nxt_app_data_defer(task, msg);
+}
+
+
+static void
+nxt_app_request_process(nxt_task_t *task, nxt_port_recv_msg_t *msg)
 {
     size_t          dump_size;
     nxt_buf_t       *b;
     nxt_port_t      *port;
-    nxt_app_rmsg_t  rmsg = { msg->buf };
+    nxt_app_rmsg_t  rmsg;
     nxt_app_wmsg_t  wmsg;
 
     b = msg->buf;
@@ -390,6 +451,11 @@ nxt_app_data_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg)
     if (nxt_slow_path(port == NULL)) {
         nxt_debug(task, "stream #%uD: reply port %d not found",
                   msg->port_msg.stream, msg->port_msg.reply_port);
+
+        if (msg->fd != -1) {
+            nxt_fd_close(msg->fd);
+        }
+
         return;
     }
 
@@ -397,8 +463,226 @@ nxt_app_data_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg)
     wmsg.write = NULL;
     wmsg.buf = &wmsg.write;
     wmsg.stream = msg->port_msg.stream;
+    wmsg.window = NXT_APP_RESPONSE_WINDOW;
+    wmsg.read_port = msg->port;
+    wmsg.window_wait = 0;
+    wmsg.cancelled = 0;
+
+    /*
+     * A request message without the "last" flag is followed
+     * by body parts which are sent by router on demand.
+     */
+    rmsg.buf = b;
+    rmsg.body = NULL;
+    rmsg.port = port;
+    rmsg.read_port = msg->port;
+    rmsg.stream = msg->port_msg.stream;
+    rmsg.body_stream = (msg->port_msg.last == 0);
+    rmsg.body_more = rmsg.body_stream;
+    rmsg.body_wait = 0;
+
+    rmsg.body_fd = msg->fd;
+    rmsg.body_offset = 0;
+
+    nxt_app_rmsg = &rmsg;
+    nxt_app_wmsg = &wmsg;
 
     nxt_app->run(task, &rmsg, &wmsg);
+
+    nxt_app_rmsg = NULL;
+    nxt_app_wmsg = NULL;
+
+    nxt_app_buf_chain_complete(task, rmsg.body);
+
+    if (rmsg.body_fd != -1) {
+        nxt_fd_close(rmsg.body_fd);
+    }
+}
+
+
+static void
+nxt_app_data_defer(nxt_task_t *task, nxt_port_recv_msg_t *msg)
+{
+    nxt_port_recv_msg_t  *dmsg;
+
+    nxt_debug(task, "stream #%uD: request deferred", msg->port_msg.stream);
+
+    dmsg = nxt_mp_alloc(msg->port->mem_pool, sizeof(nxt_port_recv_msg_t));
+    if (nxt_slow_path(dmsg == NULL)) {
+        return;
+    }
+
+    *dmsg = *msg;
+
+    dmsg->buf = nxt_app_msg_buf_take(task, msg);
+    if (nxt_slow_path(dmsg->buf == NULL)) {
+        nxt_mp_free(msg->port->mem_pool, dmsg);
+        return;
+    }
+
+    nxt_work_queue_add(&task->thread->engine->fast_work_queue,
+                       nxt_app_data_deferred, task, dmsg, NULL);
+}
+
+
+static void
+nxt_app_data_deferred(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_buf_t            *b;
+    nxt_port_recv_msg_t  *msg;
+
+    msg = obj;
+    b = msg->buf;
+
+    nxt_app_request_process(task, msg);
+
+    if (msg->buf == b) {
+        nxt_app_buf_chain_complete(task, b);
+    }
+
+    nxt_mp_free(msg->port->mem_pool, msg);
+}
+
+
+void
+nxt_app_body_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg)
+{
+    nxt_buf_t       *b;
+    nxt_app_rmsg_t  *rmsg;
+
+    rmsg = nxt_app_rmsg;
+
+    if (nxt_slow_path(rmsg == NULL
+                      || !rmsg->body_wait
+                      || rmsg->stream != msg->port_msg.stream))
+    {
+        nxt_debug(task, "stream #%uD: unexpected body part",
+                  msg->port_msg.stream);
+        return;
+    }
+
+    nxt_debug(task, "stream #%uD: %sbody part received",
+              msg->port_msg.stream, msg->port_msg.last ? "last " : "");
+
+    rmsg->body_wait = 0;
+
+    if (msg->port_msg.last) {
+        rmsg->body_more = 0;
+    }
+
+    if (msg->size == 0) {
+        return;
+    }
+
+    b = nxt_app_msg_buf_take(task, msg);
+
+    if (nxt_slow_path(b == NULL)) {
+        rmsg->body_more = 0;
+        return;
+    }
+
+    nxt_buf_chain_add(&rmsg->body, b);
+}
+
+
+void
+nxt_app_credit_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg)
+{
+    uint32_t        credit;
+    nxt_buf_t       *b;
+    nxt_app_wmsg_t  *wmsg;
+
+    wmsg = nxt_app_wmsg;
+
+    if (wmsg == NULL || wmsg->stream != msg->port_msg.stream) {
+        /* The response has been already sent. */
+        return;
+    }
+
+    if (msg->port_msg.last) {
+        nxt_debug(task, "stream #%uD: response cancelled",
+                  msg->port_msg.stream);
+
+        wmsg->cancelled = 1;
+        wmsg->window_wait = 0;
+
+        return;
+    }
+
+    b = msg->buf;
+
+    if (nxt_slow_path(b == NULL || msg->size < sizeof(uint32_t))) {
+        nxt_debug(task, "stream #%uD: invalid credit", msg->port_msg.stream);
+        return;
+    }
+
+    nxt_memcpy(&credit, b->mem.pos, sizeof(uint32_t));
+
+    nxt_debug(task, "stream #%uD: credit %uD, window %uz",
+              msg->port_msg.stream, credit, wmsg->window);
+
+    wmsg->window += credit;
+    wmsg->window_wait = 0;
+}
+
+
+/*
+ * Takes ownership of the message buffers to use them after the handler
+ * return.  Shared memory buffers are taken as is, a plain message is copied
+ * because the port reuses its buffers.
+ */
+
+static nxt_buf_t *
+nxt_app_msg_buf_take(nxt_task_t *task, nxt_port_recv_msg_t *msg)
+{
+    u_char     *p;
+    size_t     size;
+    nxt_buf_t  *b, *nb;
+
+    if (msg->port_msg.mmap) {
+        b = msg->buf;
+
+        /* Disable instant buffer completion by port. */
+        msg->buf = NULL;
+
+        return b;
+    }
+
+    size = 0;
+
+    for (b = msg->buf; b != NULL; b = b->next) {
+        size += nxt_buf_mem_used_size(&b->mem);
+    }
+
+    nb = nxt_buf_mem_alloc(msg->port->mem_pool, size, 0);
+    if (nxt_slow_path(nb == NULL)) {
+        return NULL;
+    }
+
+    p = nb->mem.free;
+
+    for (b = msg->buf; b != NULL; b = b->next) {
+        p = nxt_cpymem(p, b->mem.pos, nxt_buf_mem_used_size(&b->mem));
+    }
+
+    nb->mem.free = p;
+
+    return nb;
+}
+
+
+static void
+nxt_app_buf_chain_complete(nxt_task_t *task, nxt_buf_t *b)
+{
+    nxt_buf_t  *next;
+
+    while (b != NULL) {
+        next = b->next;
+
+        b->completion_handler(task, b, b->parent);
+
+        b = next;
+    }
 }
 
 
@@ -495,49 +779,6 @@ nxt_app_msg_write(nxt_task_t *task, nxt_app_wmsg_t *msg, u_char *c, size_t size)
 }
 
 
-nxt_int_t
-nxt_app_msg_write_prefixed_upcase(nxt_task_t *task, nxt_app_wmsg_t *msg,
-    const nxt_str_t *prefix, u_char *c, size_t size)
-{
-    u_char  *dst, *src;
-    size_t  i, length, dst_length;
-
-    length = prefix->length + size;
-
-    dst_length = length + (length < 128 ? 1 : 4) + 1;
-
-    dst = nxt_app_msg_write_get_buf(task, msg, dst_length);
-    if (nxt_slow_path(dst == NULL)) {
-        return NXT_ERROR;
-    }
-
-    dst = nxt_app_msg_write_length(dst, length + 1); /* +1 for trailing 0 */
-
-    nxt_memcpy(dst, prefix->start, prefix->length);
-    dst += prefix->length;
-
-    src = c;
-    for (i = 0; i < size; i++, dst++, src++) {
-
-        if (*src >= 'a' && *src <= 'z') {
-            *dst = *src & ~0x20;
-            continue;
-        }
-
-        if (*src == '-') {
-            *dst = '_';
-            continue;
-        }
-
-        *dst = *src;
-    }
-
-    *dst = 0;
-
-    return NXT_OK;
-}
-
-
 nxt_inline nxt_int_t
 nxt_app_msg_read_size_(nxt_task_t *task, nxt_app_rmsg_t *msg, size_t *size)
 {
@@ -648,6 +889,213 @@ nxt_app_msg_read_raw(nxt_task_t *task, nxt_app_rmsg_t *msg, void *dst,
 }
 
 
+size_t
+nxt_app_msg_read_body(nxt_task_t *task, nxt_app_rmsg_t *msg, void *dst,
+    size_t size)
+{
+    size_t     res, read_size;
+    ssize_t    n;
+    nxt_buf_t  *buf;
+
+    if (msg->body_fd != -1) {
+        res = 0;
+
+        while (size > 0) {
+            n = pread(msg->body_fd, dst, size, msg->body_offset);
+
+            if (n <= 0) {
+                if (n == -1 && nxt_errno == NXT_EINTR) {
+                    continue;
+                }
+
+                if (n == -1) {
+                    nxt_log(task, NXT_LOG_CRIT, "pread(%FD) failed %E",
+                            msg->body_fd, nxt_errno);
+                }
+
+                break;
+            }
+
+            dst = (u_char *) dst + n;
+            size -= n;
+            msg->body_offset += n;
+            res += n;
+        }
+
+        nxt_debug(task, "nxt_read_body: %uz from file", res);
+
+        return res;
+    }
+
+    if (!msg->body_stream) {
+        return nxt_app_msg_read_raw(task, msg, dst, size);
+    }
+
+    res = 0;
+
+    while (size > 0) {
+        buf = msg->body;
+
+        if (buf == NULL) {
+            if (!msg->body_more
+                || nxt_app_msg_body_wait(task, msg) != NXT_OK)
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        read_size = nxt_buf_mem_used_size(&buf->mem);
+
+        if (read_size == 0) {
+            /* Free shared memory as soon as possible. */
+            msg->body = buf->next;
+            buf->completion_handler(task, buf, buf->parent);
+            continue;
+        }
+
+        read_size = nxt_min(read_size, size);
+
+        dst = nxt_cpymem(dst, buf->mem.pos, read_size);
+
+        size -= read_size;
+        buf->mem.pos += read_size;
+        res += read_size;
+    }
+
+    nxt_debug(task, "nxt_read_body: %uz", res);
+
+    return res;
+}
+
+
+/*
+ * Requests the next body part from router and waits for it.  The port
+ * messages are processed synchronously because an application module
+ * reads the body within the request handler.  Other requests received
+ * meanwhile are deferred.
+ */
+
+static nxt_int_t
+nxt_app_msg_body_wait(nxt_task_t *task, nxt_app_rmsg_t *msg)
+{
+    nxt_int_t   ret;
+    nxt_port_t  *port, *read_port;
+
+    port = msg->port;
+    read_port = msg->read_port;
+
+    ret = nxt_port_socket_write(task, port, NXT_PORT_MSG_BODY, -1,
+                                msg->stream, read_port->id, NULL);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return NXT_ERROR;
+    }
+
+    msg->body_wait = 1;
+
+    for ( ;; ) {
+        /* Messages may be passed via shared memory ring. */
+        read_port->socket.read_ready = 1;
+        read_port->socket.read_handler(task, &read_port->socket, NULL);
+
+        if (!msg->body_wait) {
+            return NXT_OK;
+        }
+
+        ret = nxt_app_port_poll(task, port, read_port);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return NXT_ERROR;
+        }
+    }
+}
+
+
+/*
+ * Sends the response part written so far and waits until router
+ * returns credits as the response is sent to a client, or until
+ * the response is cancelled.
+ */
+
+static nxt_int_t
+nxt_app_msg_window_wait(nxt_task_t *task, nxt_app_wmsg_t *msg)
+{
+    nxt_int_t   ret;
+    nxt_port_t  *read_port;
+
+    nxt_debug(task, "stream #%uD: response window is exhausted", msg->stream);
+
+    ret = nxt_app_msg_flush(task, msg, 0);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return NXT_ERROR;
+    }
+
+    read_port = msg->read_port;
+
+    msg->window_wait = 1;
+
+    for ( ;; ) {
+        read_port->socket.read_ready = 1;
+        read_port->socket.read_handler(task, &read_port->socket, NULL);
+
+        if (!msg->window_wait) {
+            return NXT_OK;
+        }
+
+        ret = nxt_app_port_poll(task, msg->port, read_port);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return NXT_ERROR;
+        }
+    }
+}
+
+
+static nxt_int_t
+nxt_app_port_poll(nxt_task_t *task, nxt_port_t *port, nxt_port_t *read_port)
+{
+    int            n;
+    nxt_err_t      err;
+    struct pollfd  pfd[2];
+
+    pfd[0].fd = read_port->socket.fd;
+    pfd[0].events = POLLIN;
+    pfd[0].revents = 0;
+
+    /* The port write queue is not empty if the socket was full. */
+    pfd[1].fd = port->socket.fd;
+    pfd[1].events = nxt_queue_is_empty(&port->messages) ? 0 : POLLOUT;
+    pfd[1].revents = 0;
+
+    n = poll(pfd, 2, -1);
+
+    if (nxt_slow_path(n == -1)) {
+        err = nxt_errno;
+
+        if (err == NXT_EINTR) {
+            return NXT_OK;
+        }
+
+        nxt_log(task, NXT_LOG_CRIT, "poll() failed %E", err);
+        return NXT_ERROR;
+    }
+
+    if (pfd[1].revents & POLLOUT) {
+        port->socket.write_ready = 1;
+        port->socket.write_handler(task, &port->socket, NULL);
+    }
+
+    if (!(pfd[0].revents & POLLIN)
+        && (pfd[0].revents & (POLLERR | POLLHUP | POLLNVAL)))
+    {
+        nxt_log(task, NXT_LOG_CRIT, "port %d: poll() error",
+                read_port->socket.fd);
+        return NXT_ERROR;
+    }
+
+    return NXT_OK;
+}
+
+
 nxt_int_t
 nxt_app_msg_read_nvp(nxt_task_t *task, nxt_app_rmsg_t *rmsg, nxt_str_t *n,
     nxt_str_t *v)
@@ -681,6 +1129,39 @@ nxt_app_msg_read_size(nxt_task_t *task, nxt_app_rmsg_t *msg, size_t *size)
 }
 
 
+nxt_int_t
+nxt_app_msg_read_fields(nxt_task_t *task, nxt_app_rmsg_t *msg,
+    nxt_app_fields_t *fields)
+{
+    size_t     size;
+    nxt_int_t  ret;
+    nxt_buf_t  *buf;
+
+    ret = nxt_app_msg_read_size_(task, msg, &size);
+    if (ret != NXT_OK) {
+        return ret;
+    }
+
+    buf = msg->buf;
+
+    if (nxt_slow_path(nxt_buf_mem_used_size(&buf->mem) < (intptr_t) size)) {
+        return NXT_ERROR;
+    }
+
+    ret = nxt_app_fields_init(fields, buf->mem.pos, size);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return ret;
+    }
+
+    buf->mem.pos += size;
+
+    nxt_debug(task, "nxt_read_fields: %uD fields, %uz bytes",
+              fields->count, size);
+
+    return NXT_OK;
+}
+
+
 nxt_int_t
 nxt_app_http_req_done(nxt_task_t *task, nxt_app_parse_ctx_t *ar)
 {
@@ -744,6 +1225,49 @@ nxt_app_msg_flush(nxt_task_t *task, nxt_app_wmsg_t *msg, nxt_bool_t last)
 nxt_int_t
 nxt_app_msg_write_raw(nxt_task_t *task, nxt_app_wmsg_t *msg, const u_char *c,
     size_t size)
+{
+    size_t     n;
+    nxt_int_t  ret;
+
+    if (msg->read_port == NULL) {
+        return nxt_app_msg_write_raw_(task, msg, c, size);
+    }
+
+    while (size > 0) {
+
+        if (nxt_slow_path(msg->cancelled)) {
+            /* The client has gone, the rest of response is discarded. */
+            return NXT_OK;
+        }
+
+        if (msg->window == 0) {
+            ret = nxt_app_msg_window_wait(task, msg);
+            if (nxt_slow_path(ret != NXT_OK)) {
+                return ret;
+            }
+
+            continue;
+        }
+
+        n = nxt_min(size, msg->window);
+
+        ret = nxt_app_msg_write_raw_(task, msg, c, n);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+
+        msg->window -= n;
+        size -= n;
+        c += n;
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_app_msg_write_raw_(nxt_task_t *task, nxt_app_wmsg_t *msg, const u_char *c,
+    size_t size)
 {
     size_t      free_size, copy_size;
     nxt_buf_t   *b;
@@ -786,6 +1310,136 @@ nxt_app_msg_write_raw(nxt_task_t *task, nxt_app_wmsg_t *msg, const u_char *c,
 }
 
 
+nxt_int_t
+nxt_app_msg_write_status(nxt_task_t *task, nxt_app_wmsg_t *msg,
+    nxt_uint_t status, nxt_uint_t fields)
+{
+    u_char                 *dst;
+    nxt_app_resp_header_t  h;
+
+    if (nxt_slow_path(status < 100 || status > 999 || fields > 0xffff)) {
+        nxt_log(task, NXT_LOG_ERR, "invalid response status %ui or "
+                "fields number %ui", status, fields);
+        return NXT_ERROR;
+    }
+
+    dst = nxt_app_msg_write_get_buf(task, msg, sizeof(nxt_app_resp_header_t));
+    if (nxt_slow_path(dst == NULL)) {
+        return NXT_ERROR;
+    }
+
+    h.status = status;
+    h.fields = fields;
+
+    nxt_memcpy(dst, &h, sizeof(nxt_app_resp_header_t));
+
+    nxt_debug(task, "nxt_app_msg_write_status: %ui, fields: %ui",
+              status, fields);
+
+    return NXT_OK;
+}
+
+
+nxt_int_t
+nxt_app_msg_write_field(nxt_task_t *task, nxt_app_wmsg_t *msg,
+    const u_char *name, size_t name_length, const u_char *value,
+    size_t value_length)
+{
+    u_char                *dst;
+    nxt_app_resp_field_t  f;
+
+    if (nxt_slow_path(name_length == 0 || name_length > 0xff)) {
+        nxt_log(task, NXT_LOG_ERR, "invalid response field \"%*s\"",
+                name_length, name);
+        return NXT_ERROR;
+    }
+
+    /* The whole field is placed in one buffer to be used by router as is. */
+
+    dst = nxt_app_msg_write_get_buf(task, msg, sizeof(nxt_app_resp_field_t)
+                                               + name_length + value_length);
+    if (nxt_slow_path(dst == NULL)) {
+        return NXT_ERROR;
+    }
+
+    f.value_length = value_length;
+    f.id = nxt_app_resp_field_id(name, name_length);
+    f.name_length = name_length;
+    f.reserved = 0;
+
+    dst = nxt_cpymem(dst, &f, sizeof(nxt_app_resp_field_t));
+    dst = nxt_cpymem(dst, name, name_length);
+    nxt_memcpy(dst, value, value_length);
+
+    nxt_debug(task, "nxt_app_msg_write_field: %ui \"%*s: %*s\"", f.id,
+              name_length, name, value_length, value);
+
+    return NXT_OK;
+}
+
+
+nxt_int_t
+nxt_app_msg_write_fields(nxt_task_t *task, nxt_app_wmsg_t *msg,
+    nxt_list_t *fields)
+{
+    u_char               *dst, *p;
+    size_t               size, offset;
+    uint32_t             count;
+    nxt_http_field_t     *field;
+    nxt_app_req_field_t  f;
+
+    count = 0;
+    size = sizeof(uint32_t);
+
+    nxt_list_each(field, fields) {
+        count++;
+        size += sizeof(nxt_app_req_field_t)
+                + field->name_length + field->value_length;
+    } nxt_list_loop;
+
+    /*
+     * The block is placed in one buffer to be used by application as is.
+     * Each field is copied once, as the fields may reside in several
+     * request header buffers.
+     */
+
+    dst = nxt_app_msg_write_get_buf(task, msg,
+                                    size + (size < 128 ? 1 : 4));
+    if (nxt_slow_path(dst == NULL)) {
+        return NXT_ERROR;
+    }
+
+    dst = nxt_app_msg_write_length(dst, size);
+
+    p = nxt_cpymem(dst, &count, sizeof(uint32_t));
+
+    offset = sizeof(uint32_t) + count * sizeof(nxt_app_req_field_t);
+
+    f.reserved[0] = 0;
+    f.reserved[1] = 0;
+    f.reserved[2] = 0;
+
+    nxt_list_each(field, fields) {
+        f.name = offset;
+        f.name_length = field->name_length;
+        f.value = offset + field->name_length;
+        f.value_length = field->value_length;
+
+        p = nxt_cpymem(p, &f, sizeof(nxt_app_req_field_t));
+
+        nxt_memcpy(dst + f.name, field->name, field->name_length);
+        nxt_memcpy(dst + f.value, field->value, field->value_length);
+
+        offset = f.value + f.value_length;
+    } nxt_list_loop;
+
+    nxt_debug(task, "nxt_app_msg_write_fields: %uD fields, %uz bytes",
+              count, size);
+
+    return NXT_OK;
+}
+
+
 nxt_app_lang_module_t *
 nxt_app_lang_module(nxt_runtime_t *rt, nxt_str_t *name)
 {
@@ -66,6 +66,9 @@ struct nxt_common_app_conf_s {
 
     char       *working_directory;
 
+    nxt_str_t       affinity;
+    nxt_uint_t      affinity_index;
+
     union {
         nxt_python_app_conf_t  python;
         nxt_php_app_conf_t     php;
@@ -108,6 +111,9 @@ typedef struct {
     nxt_bool_t                 done;
 
     nxt_buf_t                  *buf;
+
+    /* A temporary file with the whole body or -1. */
+    nxt_fd_t                   fd;
 } nxt_app_request_body_t;
 
 
@@ -127,14 +133,40 @@ struct nxt_app_parse_ctx_s {
     nxt_http_request_t        *request;
     nxt_timer_t               timer;
     nxt_http_request_parse_t  parser;
-    nxt_http_request_parse_t  resp_parser;
     nxt_mp_t                  *mem_pool;
+
+    nxt_port_t                *body_port;
+    nxt_buf_t                 *body_buf;
+    uint32_t                  body_stream;
+
+    /* Response flow control. */
+    nxt_port_t                *credit_port;
+    uint32_t                  credit_stream;
+    size_t                    credit_queued;   /* not marked yet */
+    size_t                    credit_marked;   /* being sent to client */
+    size_t                    credit_drained;  /* not returned yet */
+    size_t                    credit_used;     /* received minus returned */
+
+    /* Response body saved to temporary file. */
+    nxt_file_t                *response_file;
+    nxt_buf_t                 *response_spool; /* waiting to be written */
+    nxt_off_t                 response_size;   /* kept in memory */
+    nxt_off_t                 response_file_size;
+    uint8_t                   response_file_error;  /* 1 bit */
+    uint8_t                   response_spooling;    /* 1 bit */
 };
 
 
 nxt_int_t nxt_app_http_req_done(nxt_task_t *task, nxt_app_parse_ctx_t *ctx);
 
 
+/*
+ * The response body size which an application may pass to router
+ * before credits are returned as the body is sent to a client.
+ */
+#define NXT_APP_RESPONSE_WINDOW  (1024 * 1024)
+
+
 typedef struct nxt_app_wmsg_s  nxt_app_wmsg_t;
 typedef struct nxt_app_rmsg_s  nxt_app_rmsg_t;
 
@@ -143,13 +175,101 @@ struct nxt_app_wmsg_s {
     nxt_buf_t                  *write;
     nxt_buf_t                  **buf;
     uint32_t                   stream;
+
+    /*
+     * Response flow control: the body size which may be sent until
+     * router returns credits.  The window is not limited if read_port
+     * is NULL.
+     */
+    size_t                     window;
+    nxt_port_t                 *read_port;  /* where credits are received */
+
+    uint8_t                    window_wait;  /* 1 bit */
+    uint8_t                    cancelled;    /* 1 bit */
 };
 
 struct nxt_app_rmsg_s {
     nxt_buf_t                 *buf;   /* current buffer to read */
+
+    /* A request body streamed by router. */
+    nxt_buf_t                 *body;
+    nxt_port_t                *port;  /* where body requests are sent */
+    nxt_port_t                *read_port;
+    uint32_t                  stream;
+
+    /* A request body passed in a temporary file. */
+    nxt_fd_t                  body_fd;
+    nxt_off_t                 body_offset;
+
+    uint8_t                   body_stream;  /* 1 bit */
+    uint8_t                   body_more;    /* 1 bit */
+    uint8_t                   body_wait;    /* 1 bit */
 };
 
 
+/*
+ * A response starts with a binary header block: nxt_app_resp_header_t
+ * followed by "fields" entries, each is nxt_app_resp_field_t followed by
+ * the field name and value.  The fields known to router are identified
+ * by application to spare router the name lookup.
+ */
+
+typedef enum {
+    NXT_APP_RESP_FIELD_OTHER = 0,
+    NXT_APP_RESP_FIELD_STATUS,
+    NXT_APP_RESP_FIELD_SERVER,
+    NXT_APP_RESP_FIELD_DATE,
+    NXT_APP_RESP_FIELD_CONNECTION,
+    NXT_APP_RESP_FIELD_CONTENT_TYPE,
+    NXT_APP_RESP_FIELD_CONTENT_LENGTH,
+
+    NXT_APP_RESP_FIELD_MAX,
+} nxt_app_resp_field_id_t;
+
+
+typedef struct {
+    uint16_t                   status;
+    uint16_t                   fields;
+} nxt_app_resp_header_t;
+
+
+typedef struct {
+    uint32_t                   value_length;
+    uint8_t                    id;
+    uint8_t                    name_length;
+    uint16_t                   reserved;
+} nxt_app_resp_field_t;
+
+
+/*
+ * Request header fields are passed as a single block: a 32-bit number of
+ * fields, an index table of nxt_app_req_field_t entries, and the field
+ * bytes as they were received.  The offsets in the index are relative
+ * to the block start.  Names are neither prefixed nor upcased by router,
+ * an application normalizes only the names it actually uses.  The block
+ * is not aligned, so entries are accessed with nxt_app_fields_get().
+ */
+
+typedef struct {
+    uint32_t                   name;
+    uint32_t                   value;
+    uint32_t                   value_length;
+    uint8_t                    name_length;
+    uint8_t                    reserved[3];
+} nxt_app_req_field_t;
+
+
+typedef struct {
+    u_char                     *start;
+    size_t                     size;
+    uint32_t                   count;
+} nxt_app_fields_t;
+
+
+/* "HTTP_" prefix, the longest field name and trailing zero. */
+#define NXT_APP_FIELD_ENV_NAME_SIZE  (5 + 255 + 1)
+
+
 nxt_inline u_char *
 nxt_app_msg_write_length(u_char *dst, size_t length);
 
@@ -160,9 +280,6 @@ NXT_EXPORT u_char *nxt_app_msg_write_get_buf(nxt_task_t *task,
 NXT_EXPORT nxt_int_t nxt_app_msg_write(nxt_task_t *task, nxt_app_wmsg_t *msg,
     u_char *c, size_t size);
 
-NXT_EXPORT nxt_int_t nxt_app_msg_write_prefixed_upcase(nxt_task_t *task,
-    nxt_app_wmsg_t *msg, const nxt_str_t *prefix, u_char *c, size_t size);
-
 nxt_inline nxt_int_t
 nxt_app_msg_write_nvp_(nxt_task_t *task, nxt_app_wmsg_t *msg,
     u_char *n, size_t nsize, u_char *v, size_t vsize);
@@ -190,18 +307,45 @@ NXT_EXPORT nxt_int_t nxt_app_msg_flush(nxt_task_t *task, nxt_app_wmsg_t *msg,
 NXT_EXPORT nxt_int_t nxt_app_msg_write_raw(nxt_task_t *task,
     nxt_app_wmsg_t *msg, const u_char *c, size_t size);
 
+NXT_EXPORT nxt_int_t nxt_app_msg_write_status(nxt_task_t *task,
+    nxt_app_wmsg_t *msg, nxt_uint_t status, nxt_uint_t fields);
+
+NXT_EXPORT nxt_int_t nxt_app_msg_write_field(nxt_task_t *task,
+    nxt_app_wmsg_t *msg, const u_char *name, size_t name_length,
+    const u_char *value, size_t value_length);
+
+nxt_inline nxt_uint_t nxt_app_resp_field_id(const u_char *name,
+    size_t length);
+
+NXT_EXPORT nxt_int_t nxt_app_msg_write_fields(nxt_task_t *task,
+    nxt_app_wmsg_t *msg, nxt_list_t *fields);
+
+nxt_inline nxt_int_t nxt_app_fields_init(nxt_app_fields_t *fields,
+    u_char *start, size_t size);
+
+nxt_inline nxt_int_t nxt_app_fields_get(nxt_app_fields_t *fields,
+    nxt_uint_t i, nxt_str_t *name, nxt_str_t *value);
+
+nxt_inline size_t nxt_app_field_env_name(u_char *dst, const nxt_str_t *name);
+
 NXT_EXPORT nxt_int_t nxt_app_msg_read_str(nxt_task_t *task, nxt_app_rmsg_t *msg,
     nxt_str_t *str);
 
 NXT_EXPORT size_t nxt_app_msg_read_raw(nxt_task_t *task,
     nxt_app_rmsg_t *msg, void *buf, size_t size);
 
+NXT_EXPORT size_t nxt_app_msg_read_body(nxt_task_t *task,
+    nxt_app_rmsg_t *msg, void *buf, size_t size);
+
 NXT_EXPORT nxt_int_t nxt_app_msg_read_nvp(nxt_task_t *task,
     nxt_app_rmsg_t *rmsg, nxt_str_t *n, nxt_str_t *v);
 
 NXT_EXPORT nxt_int_t nxt_app_msg_read_size(nxt_task_t *task,
     nxt_app_rmsg_t *rmsg, size_t *size);
 
+NXT_EXPORT nxt_int_t nxt_app_msg_read_fields(nxt_task_t *task,
+    nxt_app_rmsg_t *rmsg, nxt_app_fields_t *fields);
+
 
 struct nxt_app_module_s {
     size_t                     compat_length;
@@ -295,6 +439,148 @@ nxt_app_msg_read_length(u_char *src, size_t *length)
 }
 
 
+nxt_inline nxt_uint_t
+nxt_app_resp_field_id(const u_char *name, size_t length)
+{
+    size_t        i;
+    nxt_uint_t    id;
+    const u_char  *known;
+
+    static const char  *names[] = {
+        NULL,
+        "status",
+        "server",
+        "date",
+        "connection",
+        "content-type",
+        "content-length",
+    };
+
+    switch (length) {
+
+    case 4:
+        id = NXT_APP_RESP_FIELD_DATE;
+        break;
+
+    case 6:
+        id = (nxt_lowcase(name[1]) == 't') ? NXT_APP_RESP_FIELD_STATUS
+                                           : NXT_APP_RESP_FIELD_SERVER;
+        break;
+
+    case 10:
+        id = NXT_APP_RESP_FIELD_CONNECTION;
+        break;
+
+    case 12:
+        id = NXT_APP_RESP_FIELD_CONTENT_TYPE;
+        break;
+
+    case 14:
+        id = NXT_APP_RESP_FIELD_CONTENT_LENGTH;
+        break;
+
+    default:
+        return NXT_APP_RESP_FIELD_OTHER;
+    }
+
+    known = (const u_char *) names[id];
+
+    for (i = 0; i < length; i++) {
+        if (nxt_lowcase(name[i]) != known[i]) {
+            return NXT_APP_RESP_FIELD_OTHER;
+        }
+    }
+
+    return id;
+}
+
+
+nxt_inline nxt_int_t
+nxt_app_fields_init(nxt_app_fields_t *fields, u_char *start, size_t size)
+{
+    uint32_t  count;
+
+    if (nxt_slow_path(size < sizeof(uint32_t))) {
+        return NXT_ERROR;
+    }
+
+    nxt_memcpy(&count, start, sizeof(uint32_t));
+
+    if (nxt_slow_path(count > (size - sizeof(uint32_t))
+                              / sizeof(nxt_app_req_field_t)))
+    {
+        return NXT_ERROR;
+    }
+
+    fields->start = start;
+    fields->size = size;
+    fields->count = count;
+
+    return NXT_OK;
+}
+
+
+nxt_inline nxt_int_t
+nxt_app_fields_get(nxt_app_fields_t *fields, nxt_uint_t i, nxt_str_t *name,
+    nxt_str_t *value)
+{
+    nxt_app_req_field_t  f;
+
+    nxt_memcpy(&f, fields->start + sizeof(uint32_t)
+                   + i * sizeof(nxt_app_req_field_t),
+               sizeof(nxt_app_req_field_t));
+
+    if (nxt_slow_path(f.name > fields->size
+                      || f.name_length > fields->size - f.name
+                      || f.value > fields->size
+                      || f.value_length > fields->size - f.value))
+    {
+        return NXT_ERROR;
+    }
+
+    name->start = fields->start + f.name;
+    name->length = f.name_length;
+
+    value->start = fields->start + f.value;
+    value->length = f.value_length;
+
+    return NXT_OK;
+}
+
+
+/*
+ * Converts a field name to the CGI form: "HTTP_" prefix, upcased letters,
+ * and underscores instead of dashes.  The "dst" buffer should have at least
+ * NXT_APP_FIELD_ENV_NAME_SIZE bytes, the result is zero-terminated.
+ */
+
+nxt_inline size_t
+nxt_app_field_env_name(u_char *dst, const nxt_str_t *name)
+{
+    u_char  c, *p;
+    size_t  i;
+
+    p = nxt_cpymem(dst, "HTTP_", 5);
+
+    for (i = 0; i < name->length; i++) {
+        c = name->start[i];
+
+        if (c >= 'a' && c <= 'z') {
+            c &= ~0x20;
+
+        } else if (c == '-') {
+            c = '_';
+        }
+
+        *p++ = c;
+    }
+
+    *p = '\0';
+
+    return p - dst;
+}
+
+
 nxt_app_lang_module_t *nxt_app_lang_module(nxt_runtime_t *rt, nxt_str_t *name);
 nxt_app_type_t nxt_app_parse_type(u_char *p, size_t length);
 
@@ -50,12 +50,24 @@ static nxt_int_t nxt_conf_vldt_listener(nxt_conf_validation_t *vldt,
     nxt_str_t *name, nxt_conf_value_t *value);
 static nxt_int_t nxt_conf_vldt_app_name(nxt_conf_validation_t *vldt,
     nxt_conf_value_t *value, void *data);
+#if (NXT_SSLTLS)
+static nxt_int_t nxt_conf_vldt_tls(nxt_conf_validation_t *vldt,
+    nxt_conf_value_t *value, void *data);
+static nxt_int_t nxt_conf_vldt_certificate(nxt_conf_validation_t *vldt,
+    nxt_conf_value_t *value, void *data);
+#endif
 static nxt_int_t nxt_conf_vldt_app(nxt_conf_validation_t *vldt,
     nxt_str_t *name, nxt_conf_value_t *value);
 static nxt_int_t nxt_conf_vldt_object(nxt_conf_validation_t *vldt,
     nxt_conf_value_t *value, void *data);
 static nxt_int_t nxt_conf_vldt_processes(nxt_conf_validation_t *vldt,
     nxt_conf_value_t *value, void *data);
+static nxt_int_t nxt_conf_vldt_balance(nxt_conf_validation_t *vldt,
+    nxt_conf_value_t *value, void *data);
+#if (NXT_HAVE_CPU_AFFINITY)
+static nxt_int_t nxt_conf_vldt_affinity(nxt_conf_validation_t *vldt,
+    nxt_conf_value_t *value, void *data);
+#endif
 static nxt_int_t nxt_conf_vldt_object_iterator(nxt_conf_validation_t *vldt,
     nxt_conf_value_t *value, void *data);
 static nxt_int_t nxt_conf_vldt_system(nxt_conf_validation_t *vldt,
@@ -64,6 +76,76 @@ static nxt_int_t nxt_conf_vldt_user(nxt_conf_validation_t *vldt, char *name);
 static nxt_int_t nxt_conf_vldt_group(nxt_conf_validation_t *vldt, char *name);
 
 
+static nxt_conf_vldt_object_t  nxt_conf_vldt_http_members[] = {
+    { nxt_string("header_buffer_size"),
+      NXT_CONF_VLDT_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("large_header_buffer_size"),
+      NXT_CONF_VLDT_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("large_header_buffers"),
+      NXT_CONF_VLDT_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("body_buffer_size"),
+      NXT_CONF_VLDT_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("max_body_size"),
+      NXT_CONF_VLDT_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("body_temp_threshold"),
+      NXT_CONF_VLDT_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("body_stream_threshold"),
+      NXT_CONF_VLDT_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("response_temp_threshold"),
+      NXT_CONF_VLDT_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("temp_path"),
+      NXT_CONF_VLDT_STRING,
+      NULL,
+      NULL },
+
+    { nxt_string("idle_timeout"),
+      NXT_CONF_VLDT_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("header_read_timeout"),
+      NXT_CONF_VLDT_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("body_read_timeout"),
+      NXT_CONF_VLDT_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("send_timeout"),
+      NXT_CONF_VLDT_INTEGER,
+      NULL,
+      NULL },
+
+    NXT_CONF_VLDT_END
+};
+
+
 static nxt_conf_vldt_object_t  nxt_conf_vldt_root_members[] = {
     { nxt_string("listeners"),
       NXT_CONF_VLDT_OBJECT,
@@ -75,9 +157,45 @@ static nxt_conf_vldt_object_t  nxt_conf_vldt_root_members[] = {
       &nxt_conf_vldt_object_iterator,
       (void *) &nxt_conf_vldt_app },
 
+    { nxt_string("http"),
+      NXT_CONF_VLDT_OBJECT,
+      &nxt_conf_vldt_object,
+      (void *) &nxt_conf_vldt_http_members },
+
+#if (NXT_HAVE_CPU_AFFINITY)
+    { nxt_string("listeners_affinity"),
+      NXT_CONF_VLDT_BOOLEAN,
+      NULL,
+      NULL },
+#endif
+
+    NXT_CONF_VLDT_END
+};
+
+
+#if (NXT_SSLTLS)
+
+static nxt_conf_vldt_object_t  nxt_conf_vldt_tls_members[] = {
+    { nxt_string("certificate"),
+      NXT_CONF_VLDT_STRING,
+      &nxt_conf_vldt_certificate,
+      NULL },
+
+    { nxt_string("session_cache"),
+      NXT_CONF_VLDT_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("session_timeout"),
+      NXT_CONF_VLDT_INTEGER,
+      NULL,
+      NULL },
+
     NXT_CONF_VLDT_END
 };
 
+#endif
+
 
 static nxt_conf_vldt_object_t  nxt_conf_vldt_listener_members[] = {
     { nxt_string("application"),
@@ -85,6 +203,32 @@ static nxt_conf_vldt_object_t  nxt_conf_vldt_listener_members[] = {
       &nxt_conf_vldt_app_name,
       NULL },
 
+    { nxt_string("share"),
+      NXT_CONF_VLDT_STRING,
+      NULL,
+      NULL },
+
+#if (NXT_SSLTLS)
+    { nxt_string("tls"),
+      NXT_CONF_VLDT_OBJECT,
+      &nxt_conf_vldt_tls,
+      (void *) &nxt_conf_vldt_tls_members },
+#endif
+
+#if (NXT_HAVE_REUSEPORT)
+    { nxt_string("reuseport"),
+      NXT_CONF_VLDT_BOOLEAN,
+      NULL,
+      NULL },
+#endif
+
+#if (NXT_HAVE_REUSEPORT_CBPF)
+    { nxt_string("reuseport_cpu"),
+      NXT_CONF_VLDT_BOOLEAN,
+      NULL,
+      NULL },
+#endif
+
     NXT_CONF_VLDT_END
 };
 
@@ -125,6 +269,36 @@ static nxt_conf_vldt_object_t  nxt_conf_vldt_app_processes_members[] = {
       NULL,
       NULL },
 
+    { nxt_string("balance"),
+      NXT_CONF_VLDT_STRING,
+      &nxt_conf_vldt_balance,
+      NULL },
+
+    NXT_CONF_VLDT_END
+};
+
+
+static nxt_conf_vldt_object_t  nxt_conf_vldt_app_cache_members[] = {
+    { nxt_string("size"),
+      NXT_CONF_VLDT_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("valid"),
+      NXT_CONF_VLDT_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("stale"),
+      NXT_CONF_VLDT_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("lock_timeout"),
+      NXT_CONF_VLDT_INTEGER,
+      NULL,
+      NULL },
+
     NXT_CONF_VLDT_END
 };
 
@@ -145,6 +319,11 @@ static nxt_conf_vldt_object_t  nxt_conf_vldt_common_members[] = {
       &nxt_conf_vldt_processes,
       (void *) &nxt_conf_vldt_app_processes_members },
 
+    { nxt_string("cache"),
+      NXT_CONF_VLDT_OBJECT,
+      &nxt_conf_vldt_object,
+      (void *) &nxt_conf_vldt_app_cache_members },
+
     { nxt_string("user"),
       NXT_CONF_VLDT_STRING,
       nxt_conf_vldt_system,
@@ -160,6 +339,13 @@ static nxt_conf_vldt_object_t  nxt_conf_vldt_common_members[] = {
       NULL,
       NULL },
 
+#if (NXT_HAVE_CPU_AFFINITY)
+    { nxt_string("affinity"),
+      NXT_CONF_VLDT_STRING,
+      &nxt_conf_vldt_affinity,
+      NULL },
+#endif
+
     NXT_CONF_VLDT_END
 };
 
@@ -363,6 +549,53 @@ nxt_conf_vldt_listener(nxt_conf_validation_t *vldt, nxt_str_t *name,
 }
 
 
+#if (NXT_SSLTLS)
+
+static nxt_int_t
+nxt_conf_vldt_tls(nxt_conf_validation_t *vldt, nxt_conf_value_t *value,
+    void *data)
+{
+    nxt_int_t  ret;
+
+    static nxt_str_t  certificate_str = nxt_string("certificate");
+
+    ret = nxt_conf_vldt_object(vldt, value, data);
+    if (ret != NXT_OK) {
+        return ret;
+    }
+
+    if (nxt_conf_get_object_member(value, &certificate_str, NULL) == NULL) {
+        return nxt_conf_vldt_error(vldt, "The \"tls\" object must contain "
+                                   "the \"certificate\" parameter.");
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_conf_vldt_certificate(nxt_conf_validation_t *vldt,
+    nxt_conf_value_t *value, void *data)
+{
+    nxt_str_t  name;
+
+    nxt_conf_get_string(value, &name);
+
+    if (name.length == 0
+        || nxt_memchr(name.start, '/', name.length) != NULL
+        || nxt_str_eq(&name, ".", 1)
+        || nxt_str_eq(&name, "..", 2))
+    {
+        return nxt_conf_vldt_error(vldt, "The certificate name \"%V\" is "
+                                   "invalid.", &name);
+    }
+
+    return NXT_OK;
+}
+
+#endif
+
+
 static nxt_int_t
 nxt_conf_vldt_app_name(nxt_conf_validation_t *vldt, nxt_conf_value_t *value,
     void *data)
@@ -616,6 +849,47 @@ nxt_conf_vldt_processes(nxt_conf_validation_t *vldt, nxt_conf_value_t *value,
 }
 
 
+static nxt_int_t
+nxt_conf_vldt_balance(nxt_conf_validation_t *vldt, nxt_conf_value_t *value,
+    void *data)
+{
+    nxt_str_t  name;
+
+    nxt_conf_get_string(value, &name);
+
+    if (name.length == 0
+        || nxt_router_app_parse_balance(&name) == NXT_APP_BALANCE_UNKNOWN)
+    {
+        return nxt_conf_vldt_error(vldt, "The \"balance\" value must be "
+                                   "\"round_robin\", \"least_outstanding\", "
+                                   "or \"p2c\".");
+    }
+
+    return NXT_OK;
+}
+
+
+#if (NXT_HAVE_CPU_AFFINITY)
+
+static nxt_int_t
+nxt_conf_vldt_affinity(nxt_conf_validation_t *vldt, nxt_conf_value_t *value,
+    void *data)
+{
+    nxt_str_t  name;
+
+    nxt_conf_get_string(value, &name);
+
+    if (!nxt_str_eq(&name, "cpu", 3) && !nxt_str_eq(&name, "node", 4)) {
+        return nxt_conf_vldt_error(vldt, "The \"affinity\" value must be "
+                                   "\"cpu\" or \"node\".");
+    }
+
+    return NXT_OK;
+}
+
+#endif
+
+
 static nxt_int_t
 nxt_conf_vldt_object_iterator(nxt_conf_validation_t *vldt,
     nxt_conf_value_t *value, void *data)
@@ -9,6 +9,7 @@
 
 static void nxt_conn_write_timer_handler(nxt_task_t *task, void *obj,
     void *data);
+static ssize_t nxt_conn_io_sendfile(nxt_task_t *task, nxt_sendbuf_t *sb);
 
 
 void
@@ -153,14 +154,129 @@ nxt_conn_io_sendbuf(nxt_task_t *task, nxt_sendbuf_t *sb)
 
     niov = nxt_sendbuf_mem_coalesce0(task, sb, iov, NXT_IOBUF_MAX);
 
-    if (niov == 0 && sb->sync) {
-        return 0;
+    if (niov == 0) {
+
+        /* The memory buffers stop at a file buffer. */
+        if (sb->buf != NULL && nxt_buf_is_file(sb->buf)) {
+            return nxt_conn_io_sendfile(task, sb);
+        }
+
+        if (sb->sync) {
+            return 0;
+        }
     }
 
     return nxt_conn_io_writev(task, sb, iov, niov);
 }
 
 
+/*
+ * Sends adjacent parts of the same file at once.  Without sendfile()
+ * the file part is read to a buffer on stack, the unsent rest is read
+ * again on the next call.
+ */
+
+static ssize_t
+nxt_conn_io_sendfile(nxt_task_t *task, nxt_sendbuf_t *sb)
+{
+    size_t     size;
+    ssize_t    n;
+    nxt_fd_t   fd;
+    nxt_buf_t  *b;
+    nxt_off_t  pos, end;
+
+#if (NXT_HAVE_LINUX_SENDFILE)
+    nxt_err_t  err;
+    nxt_off_t  offset;
+#else
+    u_char     buf[16384];
+#endif
+
+    b = sb->buf;
+    fd = b->file->fd;
+    pos = b->file_pos;
+    end = b->file_end;
+
+    for (b = b->next; b != NULL; b = b->next) {
+
+        if (!nxt_buf_is_file(b) || b->file->fd != fd || b->file_pos != end) {
+            break;
+        }
+
+        end = b->file_end;
+    }
+
+    size = sb->limit - sb->size;
+
+    if (end - pos < (nxt_off_t) size) {
+        size = end - pos;
+    }
+
+#if !(NXT_HAVE_LINUX_SENDFILE)
+
+    if (size > sizeof(buf)) {
+        size = sizeof(buf);
+    }
+
+    n = nxt_file_read(sb->buf->file, buf, size, pos);
+
+    if (nxt_slow_path(n <= 0)) {
+        sb->error = (n == 0) ? NXT_EINVAL : nxt_errno;
+        return NXT_ERROR;
+    }
+
+    return nxt_conn_io_send(task, sb, buf, n);
+
+#else
+
+    for ( ;; ) {
+        offset = pos;
+
+        n = sendfile(sb->socket, fd, &offset, size);
+
+        err = (n == -1) ? nxt_errno : 0;
+
+        nxt_debug(task, "sendfile(%d, %FD, @%O, %uz): %z",
+                  sb->socket, fd, pos, size, n);
+
+        if (n > 0) {
+            return n;
+        }
+
+        if (n == 0) {
+            nxt_log(task, NXT_LOG_ERR, "file %FD was truncated", fd);
+
+            sb->error = NXT_EINVAL;
+            return NXT_ERROR;
+        }
+
+        /* n == -1 */
+
+        switch (err) {
+
+        case NXT_EAGAIN:
+            sb->ready = 0;
+            nxt_debug(task, "sendfile() %E", err);
+
+            return NXT_AGAIN;
+
+        case NXT_EINTR:
+            nxt_debug(task, "sendfile() %E", err);
+            continue;
+
+        default:
+            sb->error = err;
+            nxt_log(task, nxt_socket_error_level(err),
+                    "sendfile(%d, %FD) failed %E", sb->socket, fd, err);
+
+            return NXT_ERROR;
+        }
+    }
+
+#endif
+}
+
+
 ssize_t
 nxt_conn_io_writev(nxt_task_t *task, nxt_sendbuf_t *sb, struct iovec *iov,
     nxt_uint_t niov)
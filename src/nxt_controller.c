@@ -73,6 +73,12 @@ static void nxt_controller_conf_handler(nxt_task_t *task,
     nxt_port_recv_msg_t *msg, void *data);
 static void nxt_controller_conf_store(nxt_task_t *task,
     nxt_conf_value_t *conf);
+#if (NXT_SSLTLS)
+static void nxt_controller_process_cert(nxt_task_t *task,
+    nxt_controller_request_t *req, nxt_str_t *name);
+static void nxt_controller_cert_handler(nxt_task_t *task,
+    nxt_port_recv_msg_t *msg, void *data);
+#endif
 static void nxt_controller_response(nxt_task_t *task,
     nxt_controller_request_t *req, nxt_controller_response_t *resp);
 static u_char *nxt_controller_date(u_char *buf, nxt_realtime_t *now,
@@ -84,7 +90,7 @@ static nxt_http_field_proc_t  nxt_controller_request_fields[] = {
       &nxt_controller_request_content_length, 0 },
 };
 
-static nxt_lvlhsh_t            nxt_controller_fields_hash;
+static nxt_http_fields_hash_t  nxt_controller_fields_hash;
 
 static nxt_uint_t              nxt_controller_listening;
 static nxt_controller_conf_t   nxt_controller_conf;
@@ -203,9 +209,10 @@ static void
 nxt_controller_process_new_port_handler(nxt_task_t *task,
     nxt_port_recv_msg_t *msg)
 {
-    nxt_int_t         rc;
-    nxt_runtime_t     *rt;
-    nxt_conf_value_t  *conf;
+    nxt_int_t            rc;
+    nxt_runtime_t        *rt;
+    nxt_conf_value_t     *conf;
+    nxt_listen_socket_t  *ls;
 
     nxt_port_new_port_handler(task, msg);
 
@@ -236,7 +243,9 @@ nxt_controller_process_new_port_handler(nxt_task_t *task,
 
     rt = task->thread->runtime;
 
-    if (nxt_slow_path(nxt_listen_event(task, rt->controller_socket) == NULL)) {
+    ls = rt->controller_socket;
+
+    if (nxt_slow_path(nxt_listen_event(task, ls, ls->socket) == NULL)) {
         nxt_abort();
     }
 
@@ -276,7 +285,8 @@ static void
 nxt_controller_conf_init_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg,
     void *data)
 {
-    nxt_runtime_t  *rt;
+    nxt_runtime_t        *rt;
+    nxt_listen_socket_t  *ls;
 
     if (msg->port_msg.type != NXT_PORT_MSG_RPC_READY) {
         nxt_log(task, NXT_LOG_ALERT, "failed to apply previous configuration");
@@ -291,9 +301,9 @@ nxt_controller_conf_init_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg,
     if (nxt_controller_listening == 0) {
         rt = task->thread->runtime;
 
-        if (nxt_slow_path(nxt_listen_event(task, rt->controller_socket)
-                          == NULL))
-        {
+        ls = rt->controller_socket;
+
+        if (nxt_slow_path(nxt_listen_event(task, ls, ls->socket) == NULL)) {
             nxt_abort();
         }
 
@@ -776,6 +786,18 @@ nxt_controller_process_request(nxt_task_t *task, nxt_controller_request_t *req)
 
     nxt_memzero(&resp, sizeof(nxt_controller_response_t));
 
+#if (NXT_SSLTLS)
+
+    if (nxt_str_start(&path, "/certificates/", 14)) {
+        path.length -= 14;
+        path.start += 14;
+
+        nxt_controller_process_cert(task, req, &path);
+        return;
+    }
+
+#endif
+
     if (nxt_str_eq(&req->parser.method, "GET", 3)) {
 
         value = nxt_conf_get_path(nxt_controller_conf.root, &path);
@@ -1069,6 +1091,150 @@ nxt_controller_conf_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg,
 }
 
 
+#if (NXT_SSLTLS)
+
+/*
+ * Certificate chains are not a part of the configuration: they are
+ * uploaded as PEM bundles and stored by the main process in the state
+ * directory, and listeners refer to them by name.
+ */
+
+static void
+nxt_controller_process_cert(nxt_task_t *task, nxt_controller_request_t *req,
+    nxt_str_t *name)
+{
+    size_t                     size;
+    uint32_t                   stream;
+    nxt_int_t                  rc;
+    nxt_buf_t                  *b;
+    nxt_port_t                 *main_port, *controller_port;
+    nxt_runtime_t              *rt;
+    nxt_buf_mem_t              *mbuf;
+    nxt_controller_response_t  resp;
+
+    nxt_memzero(&resp, sizeof(nxt_controller_response_t));
+
+    resp.offset = -1;
+
+    if (name->length == 0
+        || nxt_memchr(name->start, '/', name->length) != NULL
+        || nxt_str_eq(name, ".", 1)
+        || nxt_str_eq(name, "..", 2))
+    {
+        resp.status = 400;
+        resp.title = (u_char *) "Invalid certificate name.";
+
+        nxt_controller_response(task, req, &resp);
+        return;
+    }
+
+    mbuf = &req->conn->read->mem;
+
+    if (nxt_str_eq(&req->parser.method, "PUT", 3)) {
+        size = nxt_buf_mem_used_size(mbuf);
+
+        if (nxt_ssltls_lib == NULL) {
+            resp.status = 500;
+            resp.title = (u_char *) "No SSL/TLS library is available.";
+
+            nxt_controller_response(task, req, &resp);
+            return;
+        }
+
+        rc = nxt_ssltls_lib->chain_check(task, mbuf->pos, size);
+
+        if (rc != NXT_OK) {
+            resp.status = (rc == NXT_DECLINED) ? 400 : 500;
+            resp.title = (u_char *) "Invalid certificate chain.";
+
+            nxt_controller_response(task, req, &resp);
+            return;
+        }
+
+    } else if (nxt_str_eq(&req->parser.method, "DELETE", 6)) {
+        /* An empty bundle deletes the certificate. */
+        size = 0;
+
+    } else {
+        resp.status = 405;
+        resp.title = (u_char *) "Invalid method.";
+
+        nxt_controller_response(task, req, &resp);
+        return;
+    }
+
+    rt = task->thread->runtime;
+
+    main_port = rt->port_by_type[NXT_PROCESS_MAIN];
+    controller_port = rt->port_by_type[NXT_PROCESS_CONTROLLER];
+
+    b = nxt_buf_mem_ts_alloc(task, task->thread->engine->mem_pool,
+                             name->length + 1 + size);
+    if (nxt_slow_path(b == NULL)) {
+        goto alloc_fail;
+    }
+
+    b->mem.free = nxt_cpymem(b->mem.free, name->start, name->length);
+    *b->mem.free++ = '\0';
+    b->mem.free = nxt_cpymem(b->mem.free, mbuf->pos, size);
+
+    stream = nxt_port_rpc_register_handler(task, controller_port,
+                                           nxt_controller_cert_handler,
+                                           nxt_controller_cert_handler,
+                                           main_port->pid, req);
+    if (nxt_slow_path(stream == 0)) {
+        goto alloc_fail;
+    }
+
+    rc = nxt_port_socket_write(task, main_port, NXT_PORT_MSG_CERT_STORE, -1,
+                               stream, controller_port->id, b);
+
+    if (nxt_slow_path(rc != NXT_OK)) {
+        nxt_port_rpc_cancel(task, controller_port, stream);
+        goto alloc_fail;
+    }
+
+    return;
+
+alloc_fail:
+
+    resp.status = 500;
+    resp.title = (u_char *) "Memory allocation failed.";
+
+    nxt_controller_response(task, req, &resp);
+}
+
+
+static void
+nxt_controller_cert_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg,
+    void *data)
+{
+    nxt_controller_request_t   *req;
+    nxt_controller_response_t  resp;
+
+    req = data;
+
+    nxt_memzero(&resp, sizeof(nxt_controller_response_t));
+
+    resp.offset = -1;
+
+    if (msg->port_msg.type == NXT_PORT_MSG_RPC_READY) {
+        resp.status = 200;
+        resp.title = nxt_str_eq(&req->parser.method, "PUT", 3)
+                     ? (u_char *) "Certificate chain uploaded."
+                     : (u_char *) "Certificate deleted.";
+
+    } else {
+        resp.status = 500;
+        resp.title = (u_char *) "Failed to store certificate chain.";
+    }
+
+    nxt_controller_response(task, req, &resp);
+}
+
+#endif
+
+
 static void
 nxt_controller_conf_store(nxt_task_t *task, nxt_conf_value_t *conf)
 {
@@ -0,0 +1,285 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_main.h>
+
+
+/*
+ * The CPUs allowed at start in ascending order.  The n-th router engine
+ * thread or application process is placed on the n-th CPU modulo their
+ * number, so the placement follows the CPU steering of reuseport listen
+ * sockets.  Shared memory segments are allocated by the first touch, so
+ * port memory written by a placed thread stays on its NUMA node.
+ */
+
+typedef struct {
+    uint16_t    cpu;
+    uint16_t    node;
+} nxt_cpu_t;
+
+
+static nxt_int_t nxt_cpu_affinity_list(nxt_task_t *task, const char *name,
+    cpu_set_t *set);
+static nxt_int_t nxt_cpu_affinity_nodes(nxt_task_t *task);
+
+
+static nxt_cpu_t   *nxt_cpus;
+static nxt_uint_t  nxt_cpus_n;
+
+/* The distinct NUMA nodes of the allowed CPUs in their order. */
+static uint16_t    *nxt_cpu_nodes;
+static nxt_uint_t  nxt_cpu_nodes_n;
+
+static cpu_set_t   nxt_cpu_allowed;
+
+
+void
+nxt_cpu_affinity_init(nxt_task_t *task)
+{
+    nxt_uint_t  i, n, cpu;
+
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &nxt_cpu_allowed) != 0) {
+        nxt_log(task, NXT_LOG_ALERT, "sched_getaffinity() failed %E",
+                nxt_errno);
+        return;
+    }
+
+    n = CPU_COUNT(&nxt_cpu_allowed);
+
+    nxt_cpus = nxt_malloc(n * (sizeof(nxt_cpu_t) + sizeof(uint16_t)));
+    if (nxt_slow_path(nxt_cpus == NULL)) {
+        return;
+    }
+
+    nxt_cpu_nodes = (uint16_t *) &nxt_cpus[n];
+
+    i = 0;
+
+    for (cpu = 0; i < n && cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &nxt_cpu_allowed)) {
+            nxt_cpus[i].cpu = cpu;
+            nxt_cpus[i].node = 0;
+            i++;
+        }
+    }
+
+    nxt_cpus_n = i;
+
+    if (nxt_cpu_affinity_nodes(task) != NXT_OK) {
+        nxt_cpu_nodes[0] = 0;
+        nxt_cpu_nodes_n = 1;
+
+        for (i = 0; i < nxt_cpus_n; i++) {
+            nxt_cpus[i].node = 0;
+        }
+    }
+
+    nxt_debug(task, "cpu affinity: %ui cpus, %ui nodes",
+              nxt_cpus_n, nxt_cpu_nodes_n);
+}
+
+
+static nxt_int_t
+nxt_cpu_affinity_nodes(nxt_task_t *task)
+{
+    char        name[64];
+    nxt_uint_t  i, j, node;
+    cpu_set_t   nodes, cpus;
+
+    if (nxt_cpu_affinity_list(task, "/sys/devices/system/node/online",
+                              &nodes)
+        != NXT_OK)
+    {
+        return NXT_DECLINED;
+    }
+
+    for (node = 0; node < CPU_SETSIZE; node++) {
+
+        if (!CPU_ISSET(node, &nodes)) {
+            continue;
+        }
+
+        nxt_sprintf((u_char *) name, (u_char *) name + sizeof(name),
+                    "/sys/devices/system/node/node%ui/cpulist%Z", node);
+
+        if (nxt_cpu_affinity_list(task, name, &cpus) != NXT_OK) {
+            return NXT_DECLINED;
+        }
+
+        for (i = 0; i < nxt_cpus_n; i++) {
+            if (CPU_ISSET(nxt_cpus[i].cpu, &cpus)) {
+                nxt_cpus[i].node = node;
+            }
+        }
+    }
+
+    nxt_cpu_nodes_n = 0;
+
+    for (i = 0; i < nxt_cpus_n; i++) {
+
+        for (j = 0; j < nxt_cpu_nodes_n; j++) {
+            if (nxt_cpu_nodes[j] == nxt_cpus[i].node) {
+                break;
+            }
+        }
+
+        if (j == nxt_cpu_nodes_n) {
+            nxt_cpu_nodes[nxt_cpu_nodes_n++] = nxt_cpus[i].node;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+/* Reads a sysfs list such as "0-3,8-11". */
+
+static nxt_int_t
+nxt_cpu_affinity_list(nxt_task_t *task, const char *name, cpu_set_t *set)
+{
+    u_char      *p, *end, buf[1024];
+    ssize_t     n;
+    nxt_uint_t  first, last;
+    nxt_file_t  file;
+
+    nxt_memzero(&file, sizeof(nxt_file_t));
+
+    file.name = (nxt_file_name_t *) name;
+
+    if (nxt_file_open(task, &file, NXT_FILE_RDONLY, NXT_FILE_OPEN, 0)
+        != NXT_OK)
+    {
+        return NXT_ERROR;
+    }
+
+    n = nxt_file_read(&file, buf, sizeof(buf), 0);
+
+    nxt_file_close(task, &file);
+
+    if (n <= 0) {
+        return NXT_ERROR;
+    }
+
+    CPU_ZERO(set);
+
+    p = buf;
+    end = buf + n;
+
+    while (p < end && nxt_isdigit(*p)) {
+        first = 0;
+
+        while (p < end && nxt_isdigit(*p)) {
+            first = first * 10 + (*p++ - '0');
+        }
+
+        last = first;
+
+        if (p < end && *p == '-') {
+            p++;
+            last = 0;
+
+            while (p < end && nxt_isdigit(*p)) {
+                last = last * 10 + (*p++ - '0');
+            }
+        }
+
+        if (last >= CPU_SETSIZE || first > last) {
+            return NXT_ERROR;
+        }
+
+        while (first <= last) {
+            CPU_SET(first, set);
+            first++;
+        }
+
+        if (p < end && *p == ',') {
+            p++;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+nxt_int_t
+nxt_cpu_affinity_thread(nxt_task_t *task, nxt_int_t n)
+{
+    nxt_err_t  err;
+    cpu_set_t  set;
+    nxt_cpu_t  *cpu;
+
+    if (nxt_cpus_n == 0) {
+        return NXT_DECLINED;
+    }
+
+    if (n < 0) {
+        /* Restores the CPUs allowed at start. */
+        set = nxt_cpu_allowed;
+
+        nxt_debug(task, "thread affinity: all cpus");
+
+    } else {
+        cpu = &nxt_cpus[n % nxt_cpus_n];
+
+        CPU_ZERO(&set);
+        CPU_SET(cpu->cpu, &set);
+
+        nxt_debug(task, "thread affinity: cpu %uD node %uD",
+                  (uint32_t) cpu->cpu, (uint32_t) cpu->node);
+    }
+
+    err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+
+    if (nxt_slow_path(err != 0)) {
+        nxt_log(task, NXT_LOG_ALERT, "pthread_setaffinity_np() failed %E",
+                err);
+        return NXT_ERROR;
+    }
+
+    return NXT_OK;
+}
+
+
+nxt_int_t
+nxt_cpu_affinity_process(nxt_task_t *task, nxt_uint_t n, nxt_bool_t node)
+{
+    uint16_t    id;
+    cpu_set_t   set;
+    nxt_uint_t  i;
+
+    if (nxt_cpus_n == 0) {
+        return NXT_DECLINED;
+    }
+
+    CPU_ZERO(&set);
+
+    if (node) {
+        id = nxt_cpu_nodes[n % nxt_cpu_nodes_n];
+
+        for (i = 0; i < nxt_cpus_n; i++) {
+            if (nxt_cpus[i].node == id) {
+                CPU_SET(nxt_cpus[i].cpu, &set);
+            }
+        }
+
+        nxt_debug(task, "process affinity: node %uD", (uint32_t) id);
+
+    } else {
+        i = n % nxt_cpus_n;
+
+        CPU_SET(nxt_cpus[i].cpu, &set);
+
+        nxt_debug(task, "process affinity: cpu %uD",
+                  (uint32_t) nxt_cpus[i].cpu);
+    }
+
+    if (nxt_slow_path(sched_setaffinity(0, sizeof(cpu_set_t), &set) != 0)) {
+        nxt_log(task, NXT_LOG_ALERT, "sched_setaffinity() failed %E",
+                nxt_errno);
+        return NXT_ERROR;
+    }
+
+    return NXT_OK;
+}
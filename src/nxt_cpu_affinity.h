@@ -0,0 +1,20 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#ifndef _NXT_CPU_AFFINITY_H_INCLUDED_
+#define _NXT_CPU_AFFINITY_H_INCLUDED_
+
+
+#if (NXT_HAVE_CPU_AFFINITY)
+
+NXT_EXPORT void nxt_cpu_affinity_init(nxt_task_t *task);
+NXT_EXPORT nxt_int_t nxt_cpu_affinity_thread(nxt_task_t *task, nxt_int_t n);
+NXT_EXPORT nxt_int_t nxt_cpu_affinity_process(nxt_task_t *task, nxt_uint_t n,
+    nxt_bool_t node);
+
+#endif
+
+
+#endif /* _NXT_CPU_AFFINITY_H_INCLUDED_ */
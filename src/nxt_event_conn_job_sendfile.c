@@ -140,7 +140,7 @@ nxt_event_conn_job_sendfile_handler(nxt_task_t *task, void *obj, void *data)
 
     } while (c->socket.write_ready);
 
-    if (first && task->thread->thread_pool->work_queue.head != NULL) {
+    if (first && nxt_thread_pool_pending(task->thread->thread_pool)) {
         goto fast;
     }
 
@@ -125,18 +125,22 @@ nxt_event_engine_create(nxt_task_t *task,
         goto post_fail;
     }
 
-    if (nxt_timers_init(&engine->timers, 4 * events) != NXT_OK) {
-        goto timers_fail;
-    }
-
     thread = task->thread;
 
     nxt_thread_time_update(thread);
     engine->timers.now = nxt_thread_monotonic_time(thread) / 1000000;
 
+    if (nxt_timers_init(&engine->timers, 4 * events,
+                        flags & NXT_ENGINE_TIMER_WHEEL)
+        != NXT_OK)
+    {
+        goto timers_fail;
+    }
+
     engine->max_connections = 0xffffffff;
 
     nxt_queue_init(&engine->joints);
+    nxt_queue_init(&engine->shares);
     nxt_queue_init(&engine->listen_connections);
     nxt_queue_init(&engine->idle_connections);
 
@@ -257,9 +261,15 @@ nxt_event_engine_post(nxt_event_engine_t *engine, nxt_work_t *work)
     }
 #endif
 
-    nxt_locked_work_queue_add(&engine->locked_work_queue, work);
+    /*
+     * The engine is signaled only by the first work posted after the
+     * engine has moved the posted works, the following works will be
+     * moved by the same signal handler invocation.
+     */
 
-    nxt_event_engine_signal(engine, 0);
+    if (nxt_atomic_work_queue_add(&engine->post_work_queue, work)) {
+        nxt_event_engine_signal(engine, 0);
+    }
 }
 
 
@@ -335,7 +345,7 @@ nxt_event_engine_post_handler(nxt_task_t *task, void *obj, void *data)
     thread = task->thread;
     engine = thread->engine;
 
-    nxt_locked_work_queue_move(thread, &engine->locked_work_queue,
+    nxt_atomic_work_queue_move(thread, &engine->post_work_queue,
                                &engine->fast_work_queue);
 }
 
@@ -428,6 +438,12 @@ nxt_event_engine_change(nxt_event_engine_t *engine,
         return NXT_ERROR;
     }
 
+    /*
+     * A post signal could be lost with the previous event facility,
+     * and the next posts will not signal while the works are pending.
+     */
+    nxt_event_engine_post_handler(&engine->task, NULL, NULL);
+
     if (engine->signals != NULL) {
 
         if (!engine->event.signal_support) {
@@ -418,6 +418,7 @@ nxt_fd_event_enable_accept(engine, ev)                                        \
 
 
 #define NXT_ENGINE_FIBERS      1
+#define NXT_ENGINE_TIMER_WHEEL 2
 
 
 typedef struct {
@@ -463,7 +464,7 @@ struct nxt_event_engine_s {
     nxt_work_queue_t           shutdown_work_queue;
     nxt_work_queue_t           close_work_queue;
 
-    nxt_locked_work_queue_t    locked_work_queue;
+    nxt_atomic_work_queue_t    post_work_queue;
 
     nxt_event_interface_t      event;
 
@@ -489,6 +490,7 @@ struct nxt_event_engine_s {
     nxt_port_t                 *port;
     nxt_mp_t                   *mem_pool;
     nxt_queue_t                joints;
+    nxt_queue_t                shares;
     nxt_queue_t                listen_connections;
     nxt_queue_t                idle_connections;
     nxt_array_t                *mem_cache;
@@ -42,6 +42,60 @@ nxt_file_open(nxt_task_t *task, nxt_file_t *file, nxt_uint_t mode,
 }
 
 
+/*
+ * nxt_file_temp_open() creates an anonymous temporary file on disk.
+ * file->name should be a template suitable for mkstemp().  An unnamed
+ * O_TMPFILE file is preferred in the template directory, otherwise
+ * the file is created with mkstemp() and is unlinked just after creation.
+ */
+
+nxt_int_t
+nxt_file_temp_open(nxt_task_t *task, nxt_file_t *file)
+{
+#if (NXT_HAVE_O_TMPFILE)
+    u_char  *p;
+
+    p = (u_char *) strrchr((char *) file->name, '/');
+
+    if (p != NULL && p != file->name) {
+        *p = '\0';
+
+        file->fd = open((char *) file->name, O_TMPFILE | O_RDWR | O_CLOEXEC,
+                        0600);
+
+        file->error = (file->fd == -1) ? nxt_errno : 0;
+
+        nxt_debug(task, "open(\"%FN\", O_TMPFILE): %FD err:%d",
+                  file->name, file->fd, file->error);
+
+        *p = '/';
+
+        if (file->fd != -1) {
+            return NXT_OK;
+        }
+    }
+
+#endif
+
+    file->fd = mkstemp((char *) file->name);
+
+    file->error = (file->fd == -1) ? nxt_errno : 0;
+
+    nxt_debug(task, "mkstemp(\"%FN\"): %FD err:%d",
+              file->name, file->fd, file->error);
+
+    if (file->fd != -1) {
+        (void) nxt_file_delete(file->name);
+        return NXT_OK;
+    }
+
+    nxt_log(task, NXT_LOG_CRIT, "temporary file \"%FN\" creation failed %E",
+            file->name, file->error);
+
+    return NXT_ERROR;
+}
+
+
 void
 nxt_file_close(nxt_task_t *task, nxt_file_t *file)
 {
@@ -126,6 +126,7 @@ NXT_EXPORT nxt_int_t nxt_file_open(nxt_task_t *task, nxt_file_t *file,
 #define NXT_FILE_OWNER_ACCESS       0600
 
 
+NXT_EXPORT nxt_int_t nxt_file_temp_open(nxt_task_t *task, nxt_file_t *file);
 NXT_EXPORT void nxt_file_close(nxt_task_t *task, nxt_file_t *file);
 NXT_EXPORT ssize_t nxt_file_write(nxt_file_t *file, const u_char *buf,
     size_t size, nxt_off_t offset);
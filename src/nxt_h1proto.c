@@ -16,6 +16,18 @@ static nxt_int_t nxt_h1p_transfer_encoding(void *ctx, nxt_http_field_t *field,
     uintptr_t data);
 static void nxt_h1p_request_body_read(nxt_task_t *task, nxt_http_request_t *r);
 static void nxt_h1p_body_read(nxt_task_t *task, void *obj, void *data);
+static void nxt_h1p_request_body_file(nxt_task_t *task, nxt_http_request_t *r,
+    size_t body_length);
+static void nxt_h1p_body_file_next(nxt_task_t *task, nxt_http_request_t *r);
+static void nxt_h1p_body_file_read(nxt_task_t *task, void *obj, void *data);
+static void nxt_h1p_body_file_write(nxt_task_t *task, nxt_http_request_t *r,
+    nxt_buf_t *b);
+static void nxt_h1p_body_file_written(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_h1p_body_file_error(nxt_task_t *task, void *obj, void *data);
+static void nxt_h1p_request_body_stream(nxt_task_t *task,
+    nxt_http_request_t *r, nxt_buf_t *b);
+static void nxt_h1p_body_stream_read(nxt_task_t *task, void *obj, void *data);
 static void nxt_h1p_request_local_addr(nxt_task_t *task, nxt_http_request_t *r);
 static void nxt_h1p_request_header_send(nxt_task_t *task,
     nxt_http_request_t *r);
@@ -37,11 +49,20 @@ static nxt_msec_t nxt_h1p_timeout_value(nxt_conn_t *c, uintptr_t data);
 static const nxt_conn_state_t  nxt_h1p_idle_state;
 static const nxt_conn_state_t  nxt_h1p_read_header_state;
 static const nxt_conn_state_t  nxt_h1p_read_body_state;
+static const nxt_conn_state_t  nxt_h1p_read_body_stream_state;
+static const nxt_conn_state_t  nxt_h1p_read_body_file_state;
 static const nxt_conn_state_t  nxt_h1p_send_state;
 
 
 const nxt_http_proto_body_read_t  nxt_http_proto_body_read[3] = {
     nxt_h1p_request_body_read,
+    nxt_h2p_request_body_read,
+    NULL,
+};
+
+
+const nxt_http_proto_body_stream_t  nxt_http_proto_body_stream[3] = {
+    nxt_h1p_request_body_stream,
     NULL,
     NULL,
 };
@@ -49,33 +70,33 @@ const nxt_http_proto_body_read_t  nxt_http_proto_body_read[3] = {
 
 const nxt_http_proto_local_addr_t  nxt_http_proto_local_addr[3] = {
     nxt_h1p_request_local_addr,
-    NULL,
+    nxt_h2p_request_local_addr,
     NULL,
 };
 
 
 const nxt_http_proto_header_send_t  nxt_http_proto_header_send[3] = {
     nxt_h1p_request_header_send,
-    NULL,
+    nxt_h2p_request_header_send,
     NULL,
 };
 
 
 const nxt_http_proto_send_t  nxt_http_proto_send[3] = {
     nxt_h1p_request_send,
-    NULL,
+    nxt_h2p_request_send,
     NULL,
 };
 
 
 const nxt_http_proto_close_t  nxt_http_proto_close[3] = {
     nxt_h1p_request_close,
-    NULL,
+    nxt_h2p_request_close,
     NULL,
 };
 
 
-static nxt_lvlhsh_t            nxt_h1p_fields_hash;
+static nxt_http_fields_hash_t  nxt_h1p_fields_hash;
 
 static nxt_http_field_proc_t   nxt_h1p_fields[] = {
     { nxt_string("Connection"),        &nxt_h1p_connection, 0 },
@@ -87,6 +108,11 @@ static nxt_http_field_proc_t   nxt_h1p_fields[] = {
     { nxt_string("Content-Type"),      &nxt_http_request_field,
         offsetof(nxt_http_request_t, content_type) },
     { nxt_string("Content-Length"),    &nxt_http_request_content_length, 0 },
+
+    { nxt_string("If-Modified-Since"), &nxt_http_request_field,
+        offsetof(nxt_http_request_t, if_modified_since) },
+    { nxt_string("If-None-Match"),     &nxt_http_request_field,
+        offsetof(nxt_http_request_t, if_none_match) },
 };
 
 
@@ -124,6 +150,15 @@ nxt_http_conn_init(nxt_task_t *task, void *obj, void *data)
 
     c->read_state = &nxt_h1p_idle_state;
 
+#if (NXT_SSLTLS)
+
+    if (skcf->ssltls != NULL) {
+        skcf->ssltls->conn_init(task, skcf->ssltls, c);
+        return;
+    }
+
+#endif
+
     nxt_conn_wait(c);
 }
 
@@ -200,6 +235,20 @@ nxt_h1p_header_parse(nxt_task_t *task, void *obj, void *data)
     nxt_debug(task, "h1p header parse");
 
     if (h1p == NULL) {
+        /* HTTP/2 connection preface is checked in the first request only. */
+
+        ret = nxt_h2p_preface(&c->read->mem);
+
+        if (ret == NXT_OK) {
+            nxt_h2p_conn_init(task, c);
+            return;
+        }
+
+        if (ret == NXT_AGAIN) {
+            nxt_conn_read(task->thread->engine, c);
+            return;
+        }
+
         h1p = nxt_mp_zget(c->mem_pool, sizeof(nxt_h1proto_t));
         if (nxt_slow_path(h1p == NULL)) {
             goto fail;
@@ -220,6 +269,7 @@ nxt_h1p_header_parse(nxt_task_t *task, void *obj, void *data)
         h1p->request = r;
         r->proto.h1 = h1p;
         joint = c->joint;
+        r->conf = joint;
         r->socket_conf = joint->socket_conf;
 
         r->remote = c->remote;
@@ -412,6 +462,25 @@ nxt_h1p_request_body_read(nxt_task_t *task, nxt_http_request_t *r)
 
     body_length = (size_t) r->content_length_n;
 
+    if (r->socket_conf->body_temp_threshold != 0
+        && body_length > r->socket_conf->body_temp_threshold)
+    {
+        nxt_h1p_request_body_file(task, r, body_length);
+        return;
+    }
+
+    if (r->socket_conf->body_stream_threshold != 0
+        && body_length > r->socket_conf->body_stream_threshold)
+    {
+        /*
+         * A body larger than "body_stream_threshold" is not buffered,
+         * it is passed to application by "body_buffer_size" parts
+         * on application demand.
+         */
+        r->body_rest = body_length;
+        goto ready;
+    }
+
     b = r->body;
 
     if (b == NULL) {
@@ -511,6 +580,327 @@ nxt_h1p_body_read(nxt_task_t *task, void *obj, void *data)
 }
 
 
+/*
+ * A body larger than "body_temp_threshold" is saved to an anonymous
+ * temporary file, which descriptor is passed to application.  Thus
+ * the router memory consumption does not depend on the body size.
+ * The file is written by the thread pool; the connection is not read
+ * while a body part is being written, so the request cannot be closed
+ * until the write job returns.
+ */
+
+static void
+nxt_h1p_request_body_file(nxt_task_t *task, nxt_http_request_t *r,
+    size_t body_length)
+{
+    size_t         size;
+    nxt_buf_t      *b, *in;
+    nxt_h1proto_t  *h1p;
+
+    h1p = r->proto.h1;
+
+    r->body_file = nxt_http_request_temp_file(task, r, "unit.body");
+    if (nxt_slow_path(r->body_file == NULL)) {
+        goto fail;
+    }
+
+    r->body_rest = body_length;
+
+    in = h1p->conn->read;
+
+    size = nxt_buf_mem_used_size(&in->mem);
+
+    if (size == 0) {
+        nxt_h1p_body_file_next(task, r);
+        return;
+    }
+
+    /* The body part read together with the request header. */
+
+    if (size > body_length) {
+        size = body_length;
+    }
+
+    b = nxt_buf_mem_alloc(r->mem_pool, 0, 0);
+    if (nxt_slow_path(b == NULL)) {
+        goto fail;
+    }
+
+    b->mem.start = in->mem.pos;
+    b->mem.pos = in->mem.pos;
+    b->mem.free = in->mem.pos + size;
+    b->mem.end = b->mem.free;
+
+    in->mem.pos += size;
+
+    nxt_h1p_body_file_write(task, r, b);
+
+    return;
+
+fail:
+
+    h1p->keepalive = 0;
+
+    nxt_http_request_error(task, r, NXT_HTTP_INTERNAL_SERVER_ERROR);
+}
+
+
+static const nxt_conn_state_t  nxt_h1p_read_body_file_state
+    nxt_aligned(64) =
+{
+    .ready_handler = nxt_h1p_body_file_read,
+    .close_handler = nxt_h1p_conn_close,
+    .error_handler = nxt_h1p_conn_error,
+
+    .timer_handler = nxt_h1p_conn_timeout,
+    .timer_value = nxt_h1p_timeout_value,
+    .timer_data = offsetof(nxt_socket_conf_t, body_read_timeout),
+    .timer_autoreset = 1,
+};
+
+
+static void
+nxt_h1p_body_file_next(nxt_task_t *task, nxt_http_request_t *r)
+{
+    size_t         size;
+    nxt_buf_t      *b, *in;
+    nxt_conn_t     *c;
+    nxt_h1proto_t  *h1p;
+
+    h1p = r->proto.h1;
+    c = h1p->conn;
+
+    if (r->body_rest == 0) {
+
+        if (c->read_state == &nxt_h1p_read_body_file_state) {
+            c->read = NULL;
+        }
+
+        nxt_work_queue_add(&task->thread->engine->fast_work_queue,
+                           r->state->ready_handler, task, r, NULL);
+        return;
+    }
+
+    if (c->read_state == &nxt_h1p_read_body_file_state) {
+        b = c->read;
+
+        b->mem.pos = b->mem.start;
+        b->mem.free = b->mem.start;
+
+        if ((nxt_off_t) (b->mem.end - b->mem.start) > r->body_rest) {
+            b->mem.end = b->mem.start + r->body_rest;
+        }
+
+    } else {
+        size = r->socket_conf->body_buffer_size;
+
+        if ((nxt_off_t) size > r->body_rest) {
+            size = (size_t) r->body_rest;
+        }
+
+        b = nxt_buf_mem_alloc(r->mem_pool, size, 0);
+        if (nxt_slow_path(b == NULL)) {
+            h1p->keepalive = 0;
+
+            nxt_http_request_error(task, r, NXT_HTTP_INTERNAL_SERVER_ERROR);
+            return;
+        }
+
+        in = c->read;
+        in->next = h1p->buffers;
+        h1p->buffers = in;
+
+        c->read = b;
+        c->read_state = &nxt_h1p_read_body_file_state;
+    }
+
+    nxt_conn_read(task->thread->engine, c);
+}
+
+
+static void
+nxt_h1p_body_file_read(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_buf_t      *b;
+    nxt_conn_t     *c;
+    nxt_h1proto_t  *h1p;
+
+    c = obj;
+    h1p = data;
+    b = c->read;
+
+    nxt_debug(task, "h1p body file read: %uD", c->nbytes);
+
+    if (nxt_buf_mem_free_size(&b->mem) != 0) {
+        nxt_conn_read(task->thread->engine, c);
+        return;
+    }
+
+    nxt_h1p_body_file_write(task, h1p->request, b);
+}
+
+
+static void
+nxt_h1p_body_file_write(nxt_task_t *task, nxt_http_request_t *r, nxt_buf_t *b)
+{
+    nxt_job_file_write_t  *jbw;
+
+    jbw = nxt_job_create(r->mem_pool, sizeof(nxt_job_file_write_t));
+    if (nxt_slow_path(jbw == NULL)) {
+        nxt_h1p_body_file_error(task, NULL, r);
+        return;
+    }
+
+    jbw->job.data = r;
+    jbw->job.thread_pool = nxt_runtime_thread_pool(task->thread->runtime);
+    jbw->job.abort_handler = nxt_h1p_body_file_error;
+
+    jbw->file = r->body_file;
+    jbw->offset = r->content_length_n - r->body_rest;
+    jbw->buffer = b;
+
+    jbw->ready_handler = nxt_h1p_body_file_written;
+    jbw->error_handler = nxt_h1p_body_file_error;
+
+    nxt_job_file_write(task, jbw);
+}
+
+
+static void
+nxt_h1p_body_file_written(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_http_request_t    *r;
+    nxt_job_file_write_t  *jbw;
+
+    jbw = obj;
+    r = data;
+
+    r->body_rest = r->content_length_n - jbw->offset;
+
+    nxt_job_destroy(task, jbw);
+
+    nxt_h1p_body_file_next(&r->proto.h1->conn->task, r);
+}
+
+
+static void
+nxt_h1p_body_file_error(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_conn_t          *c;
+    nxt_h1proto_t       *h1p;
+    nxt_http_request_t  *r;
+
+    r = data;
+    h1p = r->proto.h1;
+    c = h1p->conn;
+
+    if (obj != NULL) {
+        nxt_job_destroy(task, obj);
+        task = &c->task;
+    }
+
+    if (c->read_state == &nxt_h1p_read_body_file_state) {
+        c->read = NULL;
+    }
+
+    h1p->keepalive = 0;
+
+    nxt_http_request_error(task, r, NXT_HTTP_INTERNAL_SERVER_ERROR);
+}
+
+
+/*
+ * Reads the next part of a streamed body to the buffer.  The buffer
+ * free space should not exceed the rest of the body, otherwise a next
+ * pipelined request may be read to the buffer.
+ */
+
+static void
+nxt_h1p_request_body_stream(nxt_task_t *task, nxt_http_request_t *r,
+    nxt_buf_t *b)
+{
+    size_t         size;
+    nxt_buf_t      *in;
+    nxt_conn_t     *c;
+    nxt_h1proto_t  *h1p;
+
+    h1p = r->proto.h1;
+    c = h1p->conn;
+
+    in = c->read;
+
+    nxt_debug(task, "h1p body stream rest: %O", r->body_rest);
+
+    if (in != NULL) {
+        size = nxt_buf_mem_used_size(&in->mem);
+
+        if (size != 0) {
+            /* The body part read together with the request header. */
+
+            size = nxt_min(size, (size_t) nxt_buf_mem_free_size(&b->mem));
+
+            if ((nxt_off_t) size > r->body_rest) {
+                size = (size_t) r->body_rest;
+            }
+
+            b->mem.free = nxt_cpymem(b->mem.free, in->mem.pos, size);
+            in->mem.pos += size;
+            r->body_rest -= size;
+
+            nxt_work_queue_add(&task->thread->engine->fast_work_queue,
+                               r->body_state->ready_handler, task, r,
+                               r->body_data);
+            return;
+        }
+
+        in->next = h1p->buffers;
+        h1p->buffers = in;
+    }
+
+    c->read = b;
+    c->read_state = &nxt_h1p_read_body_stream_state;
+
+    nxt_conn_read(task->thread->engine, c);
+}
+
+
+static const nxt_conn_state_t  nxt_h1p_read_body_stream_state
+    nxt_aligned(64) =
+{
+    .ready_handler = nxt_h1p_body_stream_read,
+    .close_handler = nxt_h1p_conn_close,
+    .error_handler = nxt_h1p_conn_error,
+
+    .timer_handler = nxt_h1p_conn_timeout,
+    .timer_value = nxt_h1p_timeout_value,
+    .timer_data = offsetof(nxt_socket_conf_t, body_read_timeout),
+    .timer_autoreset = 1,
+};
+
+
+static void
+nxt_h1p_body_stream_read(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_conn_t          *c;
+    nxt_h1proto_t       *h1p;
+    nxt_http_request_t  *r;
+
+    c = obj;
+    h1p = data;
+
+    r = h1p->request;
+
+    c->read = NULL;
+    r->body_rest -= c->nbytes;
+
+    nxt_debug(task, "h1p body stream read: %uD rest: %O",
+              c->nbytes, r->body_rest);
+
+    nxt_work_queue_add(&task->thread->engine->fast_work_queue,
+                       r->body_state->ready_handler, task, r, r->body_data);
+}
+
+
 static void
 nxt_h1p_request_local_addr(nxt_task_t *task, nxt_http_request_t *r)
 {
@@ -856,16 +1246,33 @@ nxt_h1p_sent(nxt_task_t *task, void *obj, void *data)
 static void
 nxt_h1p_request_close(nxt_task_t *task, nxt_http_proto_t proto)
 {
-    nxt_conn_t     *c;
-    nxt_h1proto_t  *h1p;
+    nxt_conn_t          *c;
+    nxt_h1proto_t       *h1p;
+    nxt_http_request_t  *r;
 
     nxt_debug(task, "h1p request close");
 
     h1p = proto.h1;
+    r = h1p->request;
     h1p->request = NULL;
 
     c = h1p->conn;
 
+    if (r->body_rest != 0) {
+        /* The streamed request body has not been read completely. */
+        h1p->keepalive = 0;
+
+        if (c->read_state == &nxt_h1p_read_body_stream_state
+            && c->read != NULL)
+        {
+            c->read = NULL;
+
+            nxt_work_queue_add(&task->thread->engine->fast_work_queue,
+                               r->body_state->error_handler, task, r,
+                               r->body_data);
+        }
+    }
+
     if (h1p->keepalive) {
         nxt_h1p_keepalive(task, h1p, c);
 
@@ -0,0 +1,3310 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_router.h>
+#include <nxt_http.h>
+
+
+/*
+ * HTTP/2 connections are started with the "prior knowledge" client
+ * preface on a cleartext listener.  Each stream is a separate request
+ * which is handled by the common HTTP request code in the same way as
+ * an HTTP/1 request.  Request bodies are read into memory, responses
+ * are copied to DATA frames which are sent to client in weighted
+ * round-robin order limited by flow control windows.
+ *
+ * Since a request is passed to an application only with the whole body,
+ * the receive windows are updated as DATA frames arrive rather than as
+ * bodies are consumed, otherwise a large body would never be completed.
+ * Instead, the bodies buffered by all streams of a connection are
+ * limited by "max_body_size", a stream exceeding the limit along with
+ * other streams is refused and may be retried by client.
+ */
+
+
+#define NXT_H2_PREFACE             "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+
+#define NXT_H2_FRAME_HEADER_SIZE   9
+#define NXT_H2_FRAME_SIZE          16384
+#define NXT_H2_BUFFER_SIZE                                                    \
+    (NXT_H2_FRAME_HEADER_SIZE + NXT_H2_FRAME_SIZE)
+#define NXT_H2_WINDOW              65535
+#define NXT_H2_MAX_WINDOW          0x7fffffff
+#define NXT_H2_MAX_STREAMS         128
+#define NXT_H2_DEFAULT_WEIGHT      16
+
+/* Responses are copied to DATA frames by quantum * weight bytes. */
+#define NXT_H2_QUANTUM             1024
+/* The DATA frames size not yet sent to client. */
+#define NXT_H2_OUTPUT_SIZE         (4 * NXT_H2_FRAME_SIZE)
+
+#define NXT_H2_TABLE_SIZE          4096
+/* A table entry size includes 32 bytes of overhead. */
+#define NXT_H2_TABLE_ENTRIES       (NXT_H2_TABLE_SIZE / 32)
+#define NXT_H2_STATIC_ENTRIES      61
+#define NXT_H2_INTEGER_LEN         6
+
+#define NXT_H2_DATA                0
+#define NXT_H2_HEADERS             1
+#define NXT_H2_PRIORITY            2
+#define NXT_H2_RST_STREAM          3
+#define NXT_H2_SETTINGS            4
+#define NXT_H2_PUSH_PROMISE        5
+#define NXT_H2_PING                6
+#define NXT_H2_GOAWAY              7
+#define NXT_H2_WINDOW_UPDATE       8
+#define NXT_H2_CONTINUATION        9
+
+#define NXT_H2_END_STREAM          0x01
+#define NXT_H2_ACK                 0x01
+#define NXT_H2_END_HEADERS         0x04
+#define NXT_H2_PADDED              0x08
+#define NXT_H2_PRIORITY_FLAG       0x20
+
+#define NXT_H2_HEADER_TABLE_SIZE   1
+#define NXT_H2_ENABLE_PUSH         2
+#define NXT_H2_MAX_CONCURRENT      3
+#define NXT_H2_INITIAL_WINDOW      4
+#define NXT_H2_MAX_FRAME_SIZE      5
+
+#define NXT_H2_STATUS_INDEX        8
+#define NXT_H2_CONTENT_TYPE_INDEX  31
+#define NXT_H2_SERVER_INDEX        54
+
+
+typedef enum {
+    NXT_H2_NO_ERROR = 0,
+    NXT_H2_PROTOCOL_ERROR,
+    NXT_H2_INTERNAL_ERROR,
+    NXT_H2_FLOW_CONTROL_ERROR,
+    NXT_H2_SETTINGS_TIMEOUT,
+    NXT_H2_STREAM_CLOSED,
+    NXT_H2_FRAME_SIZE_ERROR,
+    NXT_H2_REFUSED_STREAM,
+    NXT_H2_CANCEL,
+    NXT_H2_COMPRESSION_ERROR,
+    NXT_H2_CONNECT_ERROR,
+    NXT_H2_ENHANCE_YOUR_CALM,
+} nxt_h2_error_t;
+
+
+typedef struct {
+    nxt_str_t                 name;
+    nxt_str_t                 value;
+} nxt_h2_entry_t;
+
+
+typedef struct {
+    nxt_h2_entry_t            *entries[NXT_H2_TABLE_ENTRIES];
+    uint32_t                  last;
+    uint32_t                  count;
+    uint32_t                  size;
+    uint32_t                  max_size;
+} nxt_h2_table_t;
+
+
+typedef struct {
+    nxt_conn_t                *conn;
+
+    nxt_lvlhsh_t              streams_hash;
+    nxt_queue_t               streams;
+    /* Streams which have a response part to send. */
+    nxt_queue_t               active;
+    nxt_uint_t                nstreams;
+    uint32_t                  last_stream;
+
+    int32_t                   send_window;
+    int32_t                   recv_window;
+    int32_t                   init_window;
+    size_t                    out_size;
+    /* The request bodies size buffered by all streams. */
+    size_t                    body_size;
+
+    /* A header block split into HEADERS and CONTINUATION frames. */
+    nxt_buf_t                 *block;
+    uint32_t                  block_stream;
+    uint16_t                  block_weight;
+    uint8_t                   block_flags;
+
+    nxt_h2_table_t            decoder;
+    nxt_h2_table_t            encoder;
+    /* The minimum encoder table size set by client after last update. */
+    uint32_t                  table_min;
+
+    uint8_t                   settings;      /* 1 bit */
+    uint8_t                   table_update;  /* 1 bit */
+    uint8_t                   goaway;        /* 1 bit */
+    uint8_t                   closing;       /* 1 bit */
+    uint8_t                   closed;        /* 1 bit */
+    uint8_t                   error;         /* 1 bit */
+} nxt_h2proto_t;
+
+
+struct nxt_h2stream_s {
+    nxt_h2proto_t             *h2p;
+    nxt_http_request_t        *request;
+    nxt_buf_t                 *out;
+
+    nxt_queue_link_t          link;
+    nxt_queue_link_t          active_link;
+
+    uint32_t                  id;
+    int32_t                   send_window;
+    int32_t                   recv_window;
+    uint16_t                  weight;
+    size_t                    body_size;
+
+    uint8_t                   active;        /* 1 bit */
+    uint8_t                   in_closed;     /* 1 bit */
+    uint8_t                   out_closed;    /* 1 bit */
+    uint8_t                   body_wait;     /* 1 bit */
+    uint8_t                   reset;         /* 1 bit */
+};
+
+
+typedef struct {
+    uint32_t                  length;
+    uint32_t                  stream_id;
+    uint8_t                   type;
+    uint8_t                   flags;
+    u_char                    *payload;
+} nxt_h2_frame_t;
+
+
+typedef struct {
+    nxt_mp_t                  *mem_pool;
+    /* The decoded fields are discarded if the list is NULL. */
+    nxt_list_t                *fields;
+    nxt_http_field_t          *cookie;
+
+    nxt_str_t                 method;
+    nxt_str_t                 path;
+    nxt_str_t                 scheme;
+    nxt_str_t                 authority;
+
+    size_t                    size;
+    size_t                    max_size;
+    nxt_http_status_t         status;
+
+    uint8_t                   regular;       /* 1 bit */
+    uint8_t                   host;          /* 1 bit */
+} nxt_h2_fields_ctx_t;
+
+
+typedef nxt_h2_error_t (*nxt_h2p_frame_handler_t)(nxt_task_t *task,
+    nxt_h2proto_t *h2p, nxt_h2_frame_t *frame);
+
+
+static void nxt_h2p_huffman_init(void);
+static ssize_t nxt_h2p_huffman_decode(u_char *dst, u_char *src, size_t size);
+static nxt_int_t nxt_h2p_static_hash_test(nxt_lvlhsh_query_t *lhq,
+    void *data);
+static nxt_int_t nxt_h2p_stream_hash_test(nxt_lvlhsh_query_t *lhq,
+    void *data);
+static void nxt_h2p_read(nxt_task_t *task, void *obj, void *data);
+static nxt_h2_error_t nxt_h2p_frame(nxt_task_t *task, nxt_h2proto_t *h2p,
+    nxt_h2_frame_t *frame);
+static nxt_h2_error_t nxt_h2p_data(nxt_task_t *task, nxt_h2proto_t *h2p,
+    nxt_h2_frame_t *frame);
+static nxt_http_status_t nxt_h2p_body_append(nxt_http_request_t *r,
+    u_char *p, size_t size);
+static void nxt_h2p_body_done(nxt_task_t *task, nxt_h2stream_t *stream);
+static nxt_h2_error_t nxt_h2p_headers(nxt_task_t *task, nxt_h2proto_t *h2p,
+    nxt_h2_frame_t *frame);
+static nxt_h2_error_t nxt_h2p_continuation(nxt_task_t *task,
+    nxt_h2proto_t *h2p, nxt_h2_frame_t *frame);
+static nxt_h2_error_t nxt_h2p_header_block(nxt_task_t *task,
+    nxt_h2proto_t *h2p, uint32_t id, nxt_uint_t flags, nxt_uint_t weight,
+    u_char *p, u_char *end);
+static nxt_h2_error_t nxt_h2p_request_create(nxt_task_t *task,
+    nxt_h2proto_t *h2p, uint32_t id, nxt_uint_t flags, nxt_uint_t weight,
+    u_char *p, u_char *end);
+static nxt_http_status_t nxt_h2p_request_init(nxt_http_request_t *r,
+    nxt_http_request_parse_t *rp, nxt_h2_fields_ctx_t *ctx);
+static nxt_h2_error_t nxt_h2p_fields_discard(nxt_h2proto_t *h2p, u_char *p,
+    u_char *end);
+static nxt_h2_error_t nxt_h2p_fields_decode(nxt_h2proto_t *h2p,
+    nxt_h2_fields_ctx_t *ctx, u_char *p, u_char *end);
+static nxt_int_t nxt_h2p_integer(u_char **pos, u_char *end, nxt_uint_t prefix,
+    uint32_t *value);
+static nxt_int_t nxt_h2p_string(nxt_mp_t *mp, u_char **pos, u_char *end,
+    nxt_str_t *str);
+static nxt_int_t nxt_h2p_field_add(nxt_h2_fields_ctx_t *ctx, nxt_str_t *name,
+    nxt_str_t *value);
+static nxt_int_t nxt_h2p_pseudo_field(nxt_h2_fields_ctx_t *ctx,
+    nxt_str_t *name, nxt_str_t *value);
+static nxt_bool_t nxt_h2p_connection_field(u_char *name, size_t length);
+static nxt_h2_entry_t *nxt_h2p_table_entry(nxt_h2_table_t *table,
+    uint32_t index);
+static nxt_int_t nxt_h2p_table_add(nxt_mp_t *mp, nxt_h2_table_t *table,
+    nxt_str_t *name, nxt_str_t *value);
+static void nxt_h2p_table_size(nxt_mp_t *mp, nxt_h2_table_t *table,
+    uint32_t size);
+static nxt_h2_error_t nxt_h2p_priority(nxt_task_t *task, nxt_h2proto_t *h2p,
+    nxt_h2_frame_t *frame);
+static nxt_h2_error_t nxt_h2p_rst_stream(nxt_task_t *task,
+    nxt_h2proto_t *h2p, nxt_h2_frame_t *frame);
+static nxt_h2_error_t nxt_h2p_settings(nxt_task_t *task, nxt_h2proto_t *h2p,
+    nxt_h2_frame_t *frame);
+static nxt_h2_error_t nxt_h2p_push_promise(nxt_task_t *task,
+    nxt_h2proto_t *h2p, nxt_h2_frame_t *frame);
+static nxt_h2_error_t nxt_h2p_ping(nxt_task_t *task, nxt_h2proto_t *h2p,
+    nxt_h2_frame_t *frame);
+static nxt_h2_error_t nxt_h2p_goaway(nxt_task_t *task, nxt_h2proto_t *h2p,
+    nxt_h2_frame_t *frame);
+static nxt_h2_error_t nxt_h2p_window_update(nxt_task_t *task,
+    nxt_h2proto_t *h2p, nxt_h2_frame_t *frame);
+static u_char *nxt_h2p_header_encode(nxt_h2proto_t *h2p,
+    nxt_http_request_t *r, u_char *p);
+static u_char *nxt_h2p_integer_encode(u_char *p, nxt_uint_t flags,
+    nxt_uint_t prefix, uint32_t value);
+static u_char *nxt_h2p_string_encode(u_char *p, u_char *src, size_t length);
+static nxt_buf_t *nxt_h2p_header_frames(nxt_h2proto_t *h2p, nxt_buf_t *header,
+    uint32_t id);
+static void nxt_h2p_output(nxt_task_t *task, nxt_h2proto_t *h2p);
+static nxt_int_t nxt_h2p_stream_output(nxt_task_t *task,
+    nxt_h2stream_t *stream, nxt_buf_t ***last_frame);
+static void nxt_h2p_stream_activate(nxt_h2proto_t *h2p,
+    nxt_h2stream_t *stream);
+static nxt_h2stream_t *nxt_h2p_stream_find(nxt_h2proto_t *h2p, uint32_t id);
+static nxt_h2_error_t nxt_h2p_stream_error(nxt_task_t *task,
+    nxt_h2stream_t *stream, nxt_h2_error_t code);
+static void nxt_h2p_stream_reset(nxt_task_t *task, nxt_h2stream_t *stream);
+static void nxt_h2p_request_error(nxt_task_t *task, void *obj, void *data);
+static void nxt_h2p_stream_free(nxt_task_t *task, nxt_h2stream_t *stream);
+static nxt_buf_t *nxt_h2p_frame_alloc(nxt_h2proto_t *h2p, nxt_uint_t type,
+    nxt_uint_t flags, uint32_t id, size_t length);
+static u_char *nxt_h2p_frame_header(u_char *p, nxt_uint_t type,
+    nxt_uint_t flags, uint32_t id, size_t length);
+static nxt_int_t nxt_h2p_frame_send(nxt_task_t *task, nxt_h2proto_t *h2p,
+    nxt_uint_t type, nxt_uint_t flags, uint32_t id, const u_char *payload,
+    size_t length);
+static nxt_int_t nxt_h2p_rst_send(nxt_task_t *task, nxt_h2proto_t *h2p,
+    uint32_t id, nxt_h2_error_t code);
+static nxt_int_t nxt_h2p_window_send(nxt_task_t *task, nxt_h2proto_t *h2p,
+    uint32_t id, uint32_t increment);
+static void nxt_h2p_write(nxt_task_t *task, nxt_h2proto_t *h2p, nxt_buf_t *b);
+static void nxt_h2p_sent(nxt_task_t *task, void *obj, void *data);
+static void nxt_h2p_error(nxt_task_t *task, nxt_h2proto_t *h2p,
+    nxt_h2_error_t code);
+static void nxt_h2p_shutdown(nxt_task_t *task, nxt_h2proto_t *h2p);
+static void nxt_h2p_close(nxt_task_t *task, nxt_h2proto_t *h2p);
+static void nxt_h2p_conn_close(nxt_task_t *task, void *obj, void *data);
+static void nxt_h2p_conn_error(nxt_task_t *task, void *obj, void *data);
+static void nxt_h2p_conn_timeout(nxt_task_t *task, void *obj, void *data);
+static void nxt_h2p_send_timeout(nxt_task_t *task, void *obj, void *data);
+static nxt_msec_t nxt_h2p_timeout_value(nxt_conn_t *c, uintptr_t data);
+
+
+static const nxt_conn_state_t  nxt_h2p_read_state;
+static const nxt_conn_state_t  nxt_h2p_write_state;
+
+
+#define nxt_h2p_uint32(p)                                                     \
+    (((uint32_t) (p)[0] << 24) | ((uint32_t) (p)[1] << 16)                    \
+     | ((uint32_t) (p)[2] << 8) | (uint32_t) (p)[3])
+
+
+#define nxt_h2p_uint32_set(p, n)                                              \
+    do {                                                                      \
+        (p)[0] = (u_char) ((n) >> 24);                                        \
+        (p)[1] = (u_char) ((n) >> 16);                                        \
+        (p)[2] = (u_char) ((n) >> 8);                                         \
+        (p)[3] = (u_char) (n);                                                \
+    } while (0)
+
+
+#define nxt_h2p_name_is(name, str)                                            \
+    ((name)->length == sizeof(str) - 1                                        \
+     && nxt_memcmp((name)->start, str, sizeof(str) - 1) == 0)
+
+
+static const nxt_h2p_frame_handler_t  nxt_h2p_frame_handlers[] = {
+    nxt_h2p_data,
+    nxt_h2p_headers,
+    nxt_h2p_priority,
+    nxt_h2p_rst_stream,
+    nxt_h2p_settings,
+    nxt_h2p_push_promise,
+    nxt_h2p_ping,
+    nxt_h2p_goaway,
+    nxt_h2p_window_update,
+    nxt_h2p_continuation,
+};
+
+
+static const nxt_h2_entry_t  nxt_h2p_static_table[NXT_H2_STATIC_ENTRIES] = {
+    { nxt_string(":authority"), nxt_string("") },
+    { nxt_string(":method"), nxt_string("GET") },
+    { nxt_string(":method"), nxt_string("POST") },
+    { nxt_string(":path"), nxt_string("/") },
+    { nxt_string(":path"), nxt_string("/index.html") },
+    { nxt_string(":scheme"), nxt_string("http") },
+    { nxt_string(":scheme"), nxt_string("https") },
+    { nxt_string(":status"), nxt_string("200") },
+    { nxt_string(":status"), nxt_string("204") },
+    { nxt_string(":status"), nxt_string("206") },
+    { nxt_string(":status"), nxt_string("304") },
+    { nxt_string(":status"), nxt_string("400") },
+    { nxt_string(":status"), nxt_string("404") },
+    { nxt_string(":status"), nxt_string("500") },
+    { nxt_string("accept-charset"), nxt_string("") },
+    { nxt_string("accept-encoding"), nxt_string("gzip, deflate") },
+    { nxt_string("accept-language"), nxt_string("") },
+    { nxt_string("accept-ranges"), nxt_string("") },
+    { nxt_string("accept"), nxt_string("") },
+    { nxt_string("access-control-allow-origin"), nxt_string("") },
+    { nxt_string("age"), nxt_string("") },
+    { nxt_string("allow"), nxt_string("") },
+    { nxt_string("authorization"), nxt_string("") },
+    { nxt_string("cache-control"), nxt_string("") },
+    { nxt_string("content-disposition"), nxt_string("") },
+    { nxt_string("content-encoding"), nxt_string("") },
+    { nxt_string("content-language"), nxt_string("") },
+    { nxt_string("content-length"), nxt_string("") },
+    { nxt_string("content-location"), nxt_string("") },
+    { nxt_string("content-range"), nxt_string("") },
+    { nxt_string("content-type"), nxt_string("") },
+    { nxt_string("cookie"), nxt_string("") },
+    { nxt_string("date"), nxt_string("") },
+    { nxt_string("etag"), nxt_string("") },
+    { nxt_string("expect"), nxt_string("") },
+    { nxt_string("expires"), nxt_string("") },
+    { nxt_string("from"), nxt_string("") },
+    { nxt_string("host"), nxt_string("") },
+    { nxt_string("if-match"), nxt_string("") },
+    { nxt_string("if-modified-since"), nxt_string("") },
+    { nxt_string("if-none-match"), nxt_string("") },
+    { nxt_string("if-range"), nxt_string("") },
+    { nxt_string("if-unmodified-since"), nxt_string("") },
+    { nxt_string("last-modified"), nxt_string("") },
+    { nxt_string("link"), nxt_string("") },
+    { nxt_string("location"), nxt_string("") },
+    { nxt_string("max-forwards"), nxt_string("") },
+    { nxt_string("proxy-authenticate"), nxt_string("") },
+    { nxt_string("proxy-authorization"), nxt_string("") },
+    { nxt_string("range"), nxt_string("") },
+    { nxt_string("referer"), nxt_string("") },
+    { nxt_string("refresh"), nxt_string("") },
+    { nxt_string("retry-after"), nxt_string("") },
+    { nxt_string("server"), nxt_string("") },
+    { nxt_string("set-cookie"), nxt_string("") },
+    { nxt_string("strict-transport-security"), nxt_string("") },
+    { nxt_string("transfer-encoding"), nxt_string("") },
+    { nxt_string("user-agent"), nxt_string("") },
+    { nxt_string("vary"), nxt_string("") },
+    { nxt_string("via"), nxt_string("") },
+    { nxt_string("www-authenticate"), nxt_string("") },
+};
+
+
+/* The Huffman code lengths of symbols 0-255 and EOS, RFC 7541 Appendix B. */
+
+static const uint8_t  nxt_h2p_huffman_lengths[257] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+     6, 10, 10, 12, 13,  6,  8, 11, 10, 10,  8, 11,  8,  6,  6,  6,
+     5,  5,  5,  6,  6,  6,  6,  6,  6,  6,  7,  8, 15,  6, 12, 10,
+    13,  6,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,
+     7,  7,  7,  7,  7,  7,  7,  7,  8,  7,  8, 13, 19, 13, 14,  6,
+    15,  5,  6,  5,  6,  5,  6,  6,  6,  5,  7,  7,  6,  6,  6,  5,
+     6,  7,  6,  5,  5,  6,  7,  7,  7,  7,  7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30,
+};
+
+
+#define NXT_H2_HUFFMAN_EOS      256
+#define NXT_H2_HUFFMAN_MIN_LEN  5
+#define NXT_H2_HUFFMAN_MAX_LEN  30
+
+/*
+ * The code is canonical, so symbols are decoded by code lengths: a code
+ * of a length is less than the limit of the length, if the limit value
+ * and the code are aligned to the left of a 32-bit window.
+ */
+static uint16_t  nxt_h2p_huffman_symbols[257];
+static uint32_t  nxt_h2p_huffman_first[NXT_H2_HUFFMAN_MAX_LEN + 1];
+static uint16_t  nxt_h2p_huffman_offset[NXT_H2_HUFFMAN_MAX_LEN + 1];
+static uint64_t  nxt_h2p_huffman_limit[NXT_H2_HUFFMAN_MAX_LEN + 1];
+
+
+static const nxt_lvlhsh_proto_t  nxt_h2p_static_hash_proto  nxt_aligned(64) = {
+    NXT_LVLHSH_DEFAULT,
+    nxt_h2p_static_hash_test,
+    nxt_lvlhsh_alloc,
+    nxt_lvlhsh_free,
+};
+
+
+static const nxt_lvlhsh_proto_t  nxt_h2p_stream_hash_proto  nxt_aligned(64) = {
+    NXT_LVLHSH_DEFAULT,
+    nxt_h2p_stream_hash_test,
+    nxt_lvlhsh_alloc,
+    nxt_lvlhsh_free,
+};
+
+
+/* The static table field names used by response header encoder. */
+static nxt_lvlhsh_t            nxt_h2p_static_hash;
+
+static nxt_http_fields_hash_t  nxt_h2p_fields_hash;
+
+static nxt_http_field_proc_t   nxt_h2p_fields[] = {
+    { nxt_string("host"),              &nxt_http_request_host, 0 },
+    { nxt_string("cookie"),            &nxt_http_request_field,
+        offsetof(nxt_http_request_t, cookie) },
+    { nxt_string("content-type"),      &nxt_http_request_field,
+        offsetof(nxt_http_request_t, content_type) },
+    { nxt_string("content-length"),    &nxt_http_request_content_length, 0 },
+
+    { nxt_string("if-modified-since"), &nxt_http_request_field,
+        offsetof(nxt_http_request_t, if_modified_since) },
+    { nxt_string("if-none-match"),     &nxt_http_request_field,
+        offsetof(nxt_http_request_t, if_none_match) },
+};
+
+
+nxt_int_t
+nxt_h2p_init(nxt_task_t *task, nxt_runtime_t *rt)
+{
+    nxt_int_t           ret;
+    nxt_uint_t          i;
+    nxt_lvlhsh_query_t  lhq;
+
+    nxt_h2p_huffman_init();
+
+    lhq.replace = 0;
+    lhq.proto = &nxt_h2p_static_hash_proto;
+    lhq.pool = NULL;
+
+    /* The first 14 entries are pseudo-header fields. */
+
+    for (i = 14; i < NXT_H2_STATIC_ENTRIES; i++) {
+        lhq.key = nxt_h2p_static_table[i].name;
+        lhq.key_hash = nxt_djb_hash(lhq.key.start, lhq.key.length);
+        lhq.value = (void *) &nxt_h2p_static_table[i];
+
+        ret = nxt_lvlhsh_insert(&nxt_h2p_static_hash, &lhq);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return NXT_ERROR;
+        }
+    }
+
+    return nxt_http_fields_hash(&nxt_h2p_fields_hash, rt->mem_pool,
+                                nxt_h2p_fields, nxt_nitems(nxt_h2p_fields));
+}
+
+
+static void
+nxt_h2p_huffman_init(void)
+{
+    uint32_t    code;
+    nxt_uint_t  len, count, n, s;
+
+    code = 0;
+    n = 0;
+
+    for (len = 1; len <= NXT_H2_HUFFMAN_MAX_LEN; len++) {
+        nxt_h2p_huffman_first[len] = code;
+        nxt_h2p_huffman_offset[len] = n;
+
+        count = 0;
+
+        for (s = 0; s <= NXT_H2_HUFFMAN_EOS; s++) {
+            if (nxt_h2p_huffman_lengths[s] == len) {
+                nxt_h2p_huffman_symbols[n++] = s;
+                count++;
+            }
+        }
+
+        nxt_h2p_huffman_limit[len] = (uint64_t) (code + count) << (32 - len);
+
+        code = (code + count) << 1;
+    }
+}
+
+
+static ssize_t
+nxt_h2p_huffman_decode(u_char *dst, u_char *src, size_t size)
+{
+    u_char      *p, *end, *start;
+    uint32_t    window;
+    uint64_t    bits;
+    nxt_uint_t  len, n, sym;
+
+    p = src;
+    end = src + size;
+    start = dst;
+
+    bits = 0;
+    n = 0;
+
+    for ( ;; ) {
+        while (n < 32 && p < end) {
+            bits = (bits << 8) | *p++;
+            n += 8;
+        }
+
+        if (n == 0) {
+            break;
+        }
+
+        if (n >= 32) {
+            window = (uint32_t) (bits >> (n - 32));
+
+        } else {
+            /* The missing bits are set as in the EOS padding. */
+            window = (uint32_t) (bits << (32 - n))
+                     | (((uint32_t) 1 << (32 - n)) - 1);
+        }
+
+        len = NXT_H2_HUFFMAN_MIN_LEN;
+
+        while (window >= nxt_h2p_huffman_limit[len]) {
+            len++;
+        }
+
+        if (len > n) {
+            /* The padding must be the EOS code prefix shorter than octet. */
+
+            if (n > 7 || bits != ((uint64_t) 1 << n) - 1) {
+                return NXT_ERROR;
+            }
+
+            break;
+        }
+
+        sym = nxt_h2p_huffman_symbols[nxt_h2p_huffman_offset[len]
+                                      + (window >> (32 - len))
+                                      - nxt_h2p_huffman_first[len]];
+
+        if (nxt_slow_path(sym == NXT_H2_HUFFMAN_EOS)) {
+            return NXT_ERROR;
+        }
+
+        *dst++ = (u_char) sym;
+
+        n -= len;
+        bits &= ((uint64_t) 1 << n) - 1;
+    }
+
+    return dst - start;
+}
+
+
+static nxt_int_t
+nxt_h2p_static_hash_test(nxt_lvlhsh_query_t *lhq, void *data)
+{
+    const nxt_h2_entry_t  *entry;
+
+    entry = data;
+
+    if (nxt_strstr_eq(&lhq->key, &entry->name)) {
+        return NXT_OK;
+    }
+
+    return NXT_DECLINED;
+}
+
+
+static nxt_int_t
+nxt_h2p_stream_hash_test(nxt_lvlhsh_query_t *lhq, void *data)
+{
+    nxt_h2stream_t  *stream;
+
+    stream = data;
+
+    if (stream->id == lhq->key_hash) {
+        return NXT_OK;
+    }
+
+    return NXT_DECLINED;
+}
+
+
+nxt_int_t
+nxt_h2p_preface(nxt_buf_mem_t *mem)
+{
+    size_t  size;
+
+    size = nxt_min((size_t) nxt_buf_mem_used_size(mem),
+                   sizeof(NXT_H2_PREFACE) - 1);
+
+    if (nxt_memcmp(mem->pos, NXT_H2_PREFACE, size) != 0) {
+        return NXT_DECLINED;
+    }
+
+    return (size == sizeof(NXT_H2_PREFACE) - 1) ? NXT_OK : NXT_AGAIN;
+}
+
+
+void
+nxt_h2p_conn_init(nxt_task_t *task, nxt_conn_t *c)
+{
+    size_t              size;
+    nxt_buf_t           *in, *b;
+    nxt_h2proto_t       *h2p;
+    nxt_event_engine_t  *engine;
+
+    static const u_char  settings[] = {
+        0, NXT_H2_MAX_CONCURRENT, 0, 0, 0, NXT_H2_MAX_STREAMS,
+    };
+
+    nxt_debug(task, "h2p conn init");
+
+    h2p = nxt_mp_zget(c->mem_pool, sizeof(nxt_h2proto_t));
+    if (nxt_slow_path(h2p == NULL)) {
+        goto fail;
+    }
+
+    in = c->read;
+    in->mem.pos += sizeof(NXT_H2_PREFACE) - 1;
+
+    size = nxt_buf_mem_used_size(&in->mem);
+
+    b = nxt_buf_mem_alloc(c->mem_pool, nxt_max(size, NXT_H2_BUFFER_SIZE), 0);
+    if (nxt_slow_path(b == NULL)) {
+        goto fail;
+    }
+
+    b->mem.free = nxt_cpymem(b->mem.free, in->mem.pos, size);
+
+    nxt_mp_free(c->mem_pool, in);
+    c->read = b;
+
+    h2p->conn = c;
+
+    nxt_queue_init(&h2p->streams);
+    nxt_queue_init(&h2p->active);
+
+    h2p->send_window = NXT_H2_WINDOW;
+    h2p->recv_window = NXT_H2_WINDOW;
+    h2p->init_window = NXT_H2_WINDOW;
+
+    h2p->decoder.max_size = NXT_H2_TABLE_SIZE;
+    h2p->encoder.max_size = NXT_H2_TABLE_SIZE;
+
+    c->socket.data = h2p;
+    c->read_state = &nxt_h2p_read_state;
+    c->write_state = &nxt_h2p_write_state;
+
+    engine = task->thread->engine;
+
+    /* The HTTP/1 header read timer. */
+    nxt_timer_disable(engine, &c->read_timer);
+
+    if (nxt_slow_path(nxt_h2p_frame_send(task, h2p, NXT_H2_SETTINGS, 0, 0,
+                                         settings, sizeof(settings))
+                      != NXT_OK))
+    {
+        h2p->error = 1;
+        nxt_h2p_close(task, h2p);
+        return;
+    }
+
+    if (size != 0) {
+        nxt_h2p_read(task, c, h2p);
+
+    } else {
+        nxt_conn_read(engine, c);
+    }
+
+    return;
+
+fail:
+
+    c->socket.data = NULL;
+
+    if (c->socket.fd != -1) {
+        c->write_state = &nxt_router_conn_close_state;
+
+        nxt_conn_close(task->thread->engine, c);
+    }
+}
+
+
+static const nxt_conn_state_t  nxt_h2p_read_state
+    nxt_aligned(64) =
+{
+    .ready_handler = nxt_h2p_read,
+    .close_handler = nxt_h2p_conn_close,
+    .error_handler = nxt_h2p_conn_error,
+
+    .timer_handler = nxt_h2p_conn_timeout,
+    .timer_value = nxt_h2p_timeout_value,
+    .timer_data = offsetof(nxt_socket_conf_t, idle_timeout),
+    .timer_autoreset = 1,
+};
+
+
+static void
+nxt_h2p_read(nxt_task_t *task, void *obj, void *data)
+{
+    u_char          *p, *end;
+    size_t          size;
+    nxt_buf_t       *b;
+    nxt_conn_t      *c;
+    nxt_h2proto_t   *h2p;
+    nxt_h2_error_t  err;
+    nxt_h2_frame_t  frame;
+
+    c = obj;
+    h2p = data;
+
+    nxt_debug(task, "h2p read");
+
+    if (h2p == NULL || h2p->closing) {
+        return;
+    }
+
+    b = c->read;
+
+    p = b->mem.pos;
+    end = b->mem.free;
+
+    while ((size_t) (end - p) >= NXT_H2_FRAME_HEADER_SIZE) {
+        frame.length = (p[0] << 16) | (p[1] << 8) | p[2];
+
+        if (frame.length > NXT_H2_FRAME_SIZE) {
+            err = NXT_H2_FRAME_SIZE_ERROR;
+            goto error;
+        }
+
+        if ((size_t) (end - p) < NXT_H2_FRAME_HEADER_SIZE + frame.length) {
+            break;
+        }
+
+        frame.type = p[3];
+        frame.flags = p[4];
+        frame.stream_id = nxt_h2p_uint32(&p[5]) & 0x7fffffff;
+        frame.payload = p + NXT_H2_FRAME_HEADER_SIZE;
+
+        nxt_debug(task, "h2p frame type:%d flags:%d stream:%uD length:%uD",
+                  frame.type, frame.flags, frame.stream_id, frame.length);
+
+        err = nxt_h2p_frame(task, h2p, &frame);
+
+        if (err != NXT_H2_NO_ERROR) {
+            goto error;
+        }
+
+        if (h2p->closing) {
+            return;
+        }
+
+        p += NXT_H2_FRAME_HEADER_SIZE + frame.length;
+    }
+
+    size = end - p;
+
+    nxt_memmove(b->mem.start, p, size);
+
+    b->mem.pos = b->mem.start;
+    b->mem.free = b->mem.start + size;
+
+    nxt_conn_read(task->thread->engine, c);
+
+    return;
+
+error:
+
+    nxt_h2p_error(task, h2p, err);
+}
+
+
+static nxt_h2_error_t
+nxt_h2p_frame(nxt_task_t *task, nxt_h2proto_t *h2p, nxt_h2_frame_t *frame)
+{
+    /* A header block cannot be interleaved with other frames. */
+
+    if (h2p->block != NULL
+        && (frame->type != NXT_H2_CONTINUATION
+            || frame->stream_id != h2p->block_stream))
+    {
+        return NXT_H2_PROTOCOL_ERROR;
+    }
+
+    if (!h2p->settings) {
+        /* The client preface ends with SETTINGS frame. */
+
+        if (frame->type != NXT_H2_SETTINGS || (frame->flags & NXT_H2_ACK)) {
+            return NXT_H2_PROTOCOL_ERROR;
+        }
+
+        h2p->settings = 1;
+    }
+
+    if (frame->type < nxt_nitems(nxt_h2p_frame_handlers)) {
+        return nxt_h2p_frame_handlers[frame->type](task, h2p, frame);
+    }
+
+    /* Unknown frame types are ignored. */
+
+    return NXT_H2_NO_ERROR;
+}
+
+
+static nxt_h2_error_t
+nxt_h2p_data(nxt_task_t *task, nxt_h2proto_t *h2p, nxt_h2_frame_t *frame)
+{
+    u_char             *p;
+    size_t             size;
+    nxt_h2stream_t     *stream;
+    nxt_http_status_t  status;
+
+    if (frame->stream_id == 0) {
+        return NXT_H2_PROTOCOL_ERROR;
+    }
+
+    if (frame->length > (uint32_t) h2p->recv_window) {
+        return NXT_H2_FLOW_CONTROL_ERROR;
+    }
+
+    h2p->recv_window -= frame->length;
+
+    if (h2p->recv_window < NXT_H2_WINDOW / 2) {
+        if (nxt_h2p_window_send(task, h2p, 0,
+                                NXT_H2_WINDOW - h2p->recv_window)
+            != NXT_OK)
+        {
+            return NXT_H2_INTERNAL_ERROR;
+        }
+
+        h2p->recv_window = NXT_H2_WINDOW;
+    }
+
+    p = frame->payload;
+    size = frame->length;
+
+    if (frame->flags & NXT_H2_PADDED) {
+        if (size == 0 || p[0] >= size) {
+            return NXT_H2_PROTOCOL_ERROR;
+        }
+
+        size -= 1 + p[0];
+        p++;
+    }
+
+    stream = nxt_h2p_stream_find(h2p, frame->stream_id);
+
+    if (stream == NULL) {
+        /* The frame of a closed stream is ignored. */
+        return (frame->stream_id > h2p->last_stream) ? NXT_H2_PROTOCOL_ERROR
+                                                     : NXT_H2_NO_ERROR;
+    }
+
+    if (stream->in_closed) {
+        return nxt_h2p_stream_error(task, stream, NXT_H2_STREAM_CLOSED);
+    }
+
+    if (frame->length > (uint32_t) stream->recv_window) {
+        return nxt_h2p_stream_error(task, stream, NXT_H2_FLOW_CONTROL_ERROR);
+    }
+
+    stream->recv_window -= frame->length;
+
+    if (frame->flags & NXT_H2_END_STREAM) {
+        stream->in_closed = 1;
+
+    } else if (stream->recv_window < NXT_H2_WINDOW / 2) {
+        if (nxt_h2p_window_send(task, h2p, stream->id,
+                                NXT_H2_WINDOW - stream->recv_window)
+            != NXT_OK)
+        {
+            return NXT_H2_INTERNAL_ERROR;
+        }
+
+        stream->recv_window = NXT_H2_WINDOW;
+    }
+
+    if (!stream->body_wait) {
+        /* The body of a request responded with an error is discarded. */
+        return NXT_H2_NO_ERROR;
+    }
+
+    /*
+     * A body exceeding the limit alone is rejected by
+     * nxt_h2p_body_append() with the 413 status.
+     */
+
+    if (h2p->body_size != stream->body_size
+        && h2p->body_size + size
+           > stream->request->socket_conf->max_body_size)
+    {
+        nxt_debug(task, "h2p stream %uD body refused, buffered: %uz",
+                  stream->id, h2p->body_size);
+
+        return nxt_h2p_stream_error(task, stream, NXT_H2_REFUSED_STREAM);
+    }
+
+    status = nxt_h2p_body_append(stream->request, p, size);
+
+    if (status == NXT_HTTP_INVALID) {
+        stream->body_size += size;
+        h2p->body_size += size;
+    }
+
+    if (status != NXT_HTTP_INVALID) {
+        stream->body_wait = 0;
+        nxt_http_request_error(task, stream->request, status);
+
+    } else if (stream->in_closed) {
+        nxt_h2p_body_done(task, stream);
+    }
+
+    return NXT_H2_NO_ERROR;
+}
+
+
+static nxt_http_status_t
+nxt_h2p_body_append(nxt_http_request_t *r, u_char *p, size_t size)
+{
+    size_t     used, capacity;
+    nxt_buf_t  *b, *body;
+
+    if (size == 0) {
+        return NXT_HTTP_INVALID;
+    }
+
+    body = r->body;
+    used = (body != NULL) ? nxt_buf_mem_used_size(&body->mem) : 0;
+
+    if (used + size > r->socket_conf->max_body_size) {
+        return NXT_HTTP_PAYLOAD_TOO_LARGE;
+    }
+
+    if (r->content_length_n != -1
+        && (nxt_off_t) (used + size) > r->content_length_n)
+    {
+        return NXT_HTTP_BAD_REQUEST;
+    }
+
+    if (body == NULL || (size_t) nxt_buf_mem_free_size(&body->mem) < size) {
+        /* A body without "content-length" is read to a growing buffer. */
+
+        capacity = (body != NULL) ? 2 * nxt_buf_mem_size(&body->mem) : 4096;
+        capacity = nxt_max(capacity, used + size);
+        capacity = nxt_min(capacity, r->socket_conf->max_body_size);
+
+        b = nxt_buf_mem_alloc(r->mem_pool, capacity, 0);
+        if (nxt_slow_path(b == NULL)) {
+            return NXT_HTTP_INTERNAL_SERVER_ERROR;
+        }
+
+        if (body != NULL) {
+            b->mem.free = nxt_cpymem(b->mem.free, body->mem.pos, used);
+            nxt_mp_free(r->mem_pool, body);
+        }
+
+        r->body = b;
+        body = b;
+    }
+
+    body->mem.free = nxt_cpymem(body->mem.free, p, size);
+
+    return NXT_HTTP_INVALID;
+}
+
+
+static void
+nxt_h2p_body_done(nxt_task_t *task, nxt_h2stream_t *stream)
+{
+    u_char              *p;
+    size_t              size;
+    uint32_t            hash;
+    nxt_uint_t          i;
+    nxt_http_field_t    *field;
+    nxt_http_request_t  *r;
+
+    static const char   name[] = "content-length";
+
+    r = stream->request;
+    stream->body_wait = 0;
+
+    size = (r->body != NULL) ? nxt_buf_mem_used_size(&r->body->mem) : 0;
+
+    nxt_debug(task, "h2p body done: %uz", size);
+
+    if (r->content_length_n != -1) {
+        if (r->content_length_n != (nxt_off_t) size) {
+            nxt_http_request_error(task, r, NXT_HTTP_BAD_REQUEST);
+            return;
+        }
+
+    } else if (size != 0) {
+        /* Application gets the body length in the "Content-Length" field. */
+
+        field = nxt_list_add(r->fields);
+        p = nxt_mp_nget(r->mem_pool, NXT_OFF_T_LEN);
+
+        if (nxt_slow_path(field == NULL || p == NULL)) {
+            nxt_http_request_error(task, r, NXT_HTTP_INTERNAL_SERVER_ERROR);
+            return;
+        }
+
+        hash = NXT_HTTP_FIELD_HASH_INIT;
+
+        for (i = 0; i < sizeof(name) - 1; i++) {
+            hash = nxt_http_field_hash_char(hash, (u_char) name[i]);
+        }
+
+        field->hash = nxt_http_field_hash_end(hash) & 0xffff;
+        field->skip = 0;
+        field->name_length = sizeof(name) - 1;
+        field->name = (u_char *) name;
+        field->value = p;
+        field->value_length = nxt_sprintf(p, p + NXT_OFF_T_LEN, "%uz", size)
+                              - p;
+
+        r->content_length = field;
+        r->content_length_n = size;
+    }
+
+    nxt_work_queue_add(&task->thread->engine->fast_work_queue,
+                       r->state->ready_handler, task, r, NULL);
+}
+
+
+static nxt_h2_error_t
+nxt_h2p_headers(nxt_task_t *task, nxt_h2proto_t *h2p, nxt_h2_frame_t *frame)
+{
+    u_char                   *p, *end;
+    size_t                   size, limit;
+    nxt_buf_t                *b;
+    nxt_uint_t               weight, padding;
+    nxt_socket_conf_joint_t  *joint;
+
+    if (frame->stream_id == 0 || (frame->stream_id & 1) == 0) {
+        return NXT_H2_PROTOCOL_ERROR;
+    }
+
+    p = frame->payload;
+    end = p + frame->length;
+    weight = NXT_H2_DEFAULT_WEIGHT;
+
+    if (frame->flags & NXT_H2_PADDED) {
+        if (p == end) {
+            return NXT_H2_PROTOCOL_ERROR;
+        }
+
+        padding = *p++;
+
+        if (padding > (size_t) (end - p)) {
+            return NXT_H2_PROTOCOL_ERROR;
+        }
+
+        end -= padding;
+    }
+
+    if (frame->flags & NXT_H2_PRIORITY_FLAG) {
+        /* Stream dependencies are ignored, only weight is used. */
+
+        if (end - p < 5) {
+            return NXT_H2_PROTOCOL_ERROR;
+        }
+
+        weight = p[4] + 1;
+        p += 5;
+    }
+
+    if (frame->flags & NXT_H2_END_HEADERS) {
+        return nxt_h2p_header_block(task, h2p, frame->stream_id, frame->flags,
+                                    weight, p, end);
+    }
+
+    size = end - p;
+    joint = h2p->conn->joint;
+    limit = joint->socket_conf->large_header_buffer_size
+            * joint->socket_conf->large_header_buffers;
+
+    if (size > limit) {
+        return NXT_H2_ENHANCE_YOUR_CALM;
+    }
+
+    b = nxt_buf_mem_alloc(h2p->conn->mem_pool, limit, 0);
+    if (nxt_slow_path(b == NULL)) {
+        return NXT_H2_INTERNAL_ERROR;
+    }
+
+    b->mem.free = nxt_cpymem(b->mem.free, p, size);
+
+    h2p->block = b;
+    h2p->block_stream = frame->stream_id;
+    h2p->block_flags = frame->flags;
+    h2p->block_weight = weight;
+
+    return NXT_H2_NO_ERROR;
+}
+
+
+static nxt_h2_error_t
+nxt_h2p_continuation(nxt_task_t *task, nxt_h2proto_t *h2p,
+    nxt_h2_frame_t *frame)
+{
+    nxt_buf_t       *b;
+    nxt_h2_error_t  err;
+
+    b = h2p->block;
+
+    if (b == NULL) {
+        return NXT_H2_PROTOCOL_ERROR;
+    }
+
+    if (frame->length > (size_t) nxt_buf_mem_free_size(&b->mem)) {
+        return NXT_H2_ENHANCE_YOUR_CALM;
+    }
+
+    b->mem.free = nxt_cpymem(b->mem.free, frame->payload, frame->length);
+
+    if (!(frame->flags & NXT_H2_END_HEADERS)) {
+        return NXT_H2_NO_ERROR;
+    }
+
+    h2p->block = NULL;
+
+    err = nxt_h2p_header_block(task, h2p, h2p->block_stream, h2p->block_flags,
+                               h2p->block_weight, b->mem.pos, b->mem.free);
+
+    nxt_mp_free(h2p->conn->mem_pool, b);
+
+    return err;
+}
+
+
+static nxt_h2_error_t
+nxt_h2p_header_block(nxt_task_t *task, nxt_h2proto_t *h2p, uint32_t id,
+    nxt_uint_t flags, nxt_uint_t weight, u_char *p, u_char *end)
+{
+    nxt_h2_error_t  err;
+    nxt_h2stream_t  *stream;
+
+    stream = nxt_h2p_stream_find(h2p, id);
+
+    if (stream != NULL) {
+        /* Trailer fields are decoded to keep the table and are discarded. */
+
+        err = nxt_h2p_fields_discard(h2p, p, end);
+        if (err != NXT_H2_NO_ERROR) {
+            return err;
+        }
+
+        if (stream->in_closed) {
+            return nxt_h2p_stream_error(task, stream, NXT_H2_STREAM_CLOSED);
+        }
+
+        if (!(flags & NXT_H2_END_STREAM)) {
+            return nxt_h2p_stream_error(task, stream, NXT_H2_PROTOCOL_ERROR);
+        }
+
+        stream->in_closed = 1;
+
+        if (stream->body_wait) {
+            nxt_h2p_body_done(task, stream);
+        }
+
+        return NXT_H2_NO_ERROR;
+    }
+
+    if (id <= h2p->last_stream || h2p->goaway) {
+        /* A closed stream or a stream after GOAWAY. */
+        return nxt_h2p_fields_discard(h2p, p, end);
+    }
+
+    h2p->last_stream = id;
+
+    if (h2p->nstreams >= NXT_H2_MAX_STREAMS) {
+        err = nxt_h2p_fields_discard(h2p, p, end);
+        if (err != NXT_H2_NO_ERROR) {
+            return err;
+        }
+
+        if (nxt_h2p_rst_send(task, h2p, id, NXT_H2_REFUSED_STREAM) != NXT_OK) {
+            return NXT_H2_INTERNAL_ERROR;
+        }
+
+        return NXT_H2_NO_ERROR;
+    }
+
+    return nxt_h2p_request_create(task, h2p, id, flags, weight, p, end);
+}
+
+
+static nxt_h2_error_t
+nxt_h2p_request_create(nxt_task_t *task, nxt_h2proto_t *h2p, uint32_t id,
+    nxt_uint_t flags, nxt_uint_t weight, u_char *p, u_char *end)
+{
+    nxt_int_t                 ret;
+    nxt_conn_t                *c;
+    nxt_h2_error_t            err;
+    nxt_h2stream_t            *stream;
+    nxt_socket_conf_t         *skcf;
+    nxt_http_status_t         status;
+    nxt_http_request_t        *r;
+    nxt_lvlhsh_query_t        lhq;
+    nxt_h2_fields_ctx_t       ctx;
+    nxt_socket_conf_joint_t   *joint;
+    nxt_http_request_parse_t  *rp;
+
+    c = h2p->conn;
+
+    r = nxt_http_request_create(task);
+    if (nxt_slow_path(r == NULL)) {
+        goto refuse;
+    }
+
+    stream = nxt_mp_zalloc(c->mem_pool, sizeof(nxt_h2stream_t));
+    if (nxt_slow_path(stream == NULL)) {
+        nxt_mp_release(r->mem_pool);
+        goto refuse;
+    }
+
+    stream->h2p = h2p;
+    stream->request = r;
+    stream->id = id;
+    stream->send_window = h2p->init_window;
+    stream->recv_window = NXT_H2_WINDOW;
+    stream->weight = weight;
+
+    lhq.key_hash = id;
+    lhq.key.length = 0;
+    lhq.key.start = NULL;
+    lhq.replace = 0;
+    lhq.value = stream;
+    lhq.proto = &nxt_h2p_stream_hash_proto;
+    lhq.pool = NULL;
+
+    if (nxt_slow_path(nxt_lvlhsh_insert(&h2p->streams_hash, &lhq) != NXT_OK)) {
+        nxt_mp_free(c->mem_pool, stream);
+        nxt_mp_release(r->mem_pool);
+        goto refuse;
+    }
+
+    nxt_queue_insert_tail(&h2p->streams, &stream->link);
+    h2p->nstreams++;
+
+    r->proto.h2 = stream;
+    r->protocol = NXT_HTTP_PROTO_H2;
+    joint = c->joint;
+    r->conf = joint;
+    skcf = joint->socket_conf;
+    r->socket_conf = skcf;
+    r->remote = c->remote;
+
+    nxt_memzero(&ctx, sizeof(nxt_h2_fields_ctx_t));
+
+    ctx.mem_pool = r->mem_pool;
+    ctx.max_size = skcf->large_header_buffer_size * skcf->large_header_buffers;
+
+    rp = nxt_mp_zget(r->mem_pool, sizeof(nxt_http_request_parse_t));
+
+    if (nxt_fast_path(rp != NULL)) {
+        ret = nxt_http_parse_request_init(rp, r->mem_pool);
+
+        if (nxt_fast_path(ret == NXT_OK)) {
+            ctx.fields = rp->fields;
+        }
+    }
+
+    if (nxt_slow_path(ctx.fields == NULL)) {
+        /* The block is still decoded to keep the table. */
+        ctx.status = NXT_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    err = nxt_h2p_fields_decode(h2p, &ctx, p, end);
+
+    if (err != NXT_H2_NO_ERROR) {
+        /* The request is closed on connection shutdown. */
+        return err;
+    }
+
+    if (flags & NXT_H2_END_STREAM) {
+        stream->in_closed = 1;
+    }
+
+    status = nxt_h2p_request_init(r, rp, &ctx);
+
+    if (nxt_fast_path(status == NXT_HTTP_INVALID)) {
+        r->state->ready_handler(task, r, NULL);
+
+    } else {
+        nxt_http_request_error(task, r, status);
+    }
+
+    return NXT_H2_NO_ERROR;
+
+refuse:
+
+    err = nxt_h2p_fields_discard(h2p, p, end);
+    if (err != NXT_H2_NO_ERROR) {
+        return err;
+    }
+
+    if (nxt_h2p_rst_send(task, h2p, id, NXT_H2_REFUSED_STREAM) != NXT_OK) {
+        return NXT_H2_INTERNAL_ERROR;
+    }
+
+    return NXT_H2_NO_ERROR;
+}
+
+
+/*
+ * The request line is built from pseudo-header fields and is parsed
+ * by the HTTP/1 parser to normalize the target and to split arguments.
+ */
+
+static nxt_http_status_t
+nxt_h2p_request_init(nxt_http_request_t *r, nxt_http_request_parse_t *rp,
+    nxt_h2_fields_ctx_t *ctx)
+{
+    u_char            *p;
+    size_t            size;
+    uint32_t          hash;
+    nxt_int_t         ret;
+    nxt_uint_t        i;
+    nxt_buf_mem_t     mem;
+    nxt_http_field_t  *field;
+
+    static const char       version[] = " HTTP/1.1\r\n\r\n";
+    static const nxt_str_t  http2 = nxt_string("HTTP/2.0");
+
+    if (ctx->status != NXT_HTTP_INVALID) {
+        return ctx->status;
+    }
+
+    if (ctx->method.start == NULL
+        || ctx->path.start == NULL
+        || ctx->scheme.start == NULL)
+    {
+        return NXT_HTTP_BAD_REQUEST;
+    }
+
+    if (ctx->authority.length != 0 && !ctx->host) {
+        field = nxt_list_add(rp->fields);
+        if (nxt_slow_path(field == NULL)) {
+            return NXT_HTTP_INTERNAL_SERVER_ERROR;
+        }
+
+        hash = NXT_HTTP_FIELD_HASH_INIT;
+
+        for (i = 0; i < sizeof("host") - 1; i++) {
+            hash = nxt_http_field_hash_char(hash, (u_char) "host"[i]);
+        }
+
+        field->hash = nxt_http_field_hash_end(hash) & 0xffff;
+        field->skip = 0;
+        field->name_length = sizeof("host") - 1;
+        field->value_length = ctx->authority.length;
+        field->name = (u_char *) "host";
+        field->value = ctx->authority.start;
+    }
+
+    size = ctx->method.length + 1 + ctx->path.length + sizeof(version) - 1;
+
+    p = nxt_mp_nget(r->mem_pool, size);
+    if (nxt_slow_path(p == NULL)) {
+        return NXT_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    mem.start = p;
+    mem.pos = p;
+
+    p = nxt_cpymem(p, ctx->method.start, ctx->method.length);
+    *p++ = ' ';
+    p = nxt_cpymem(p, ctx->path.start, ctx->path.length);
+    p = nxt_cpymem(p, version, sizeof(version) - 1);
+
+    mem.free = p;
+    mem.end = p;
+
+    ret = nxt_http_parse_request(rp, &mem);
+
+    if (nxt_slow_path(ret != NXT_DONE)) {
+        return (ret == NXT_ERROR) ? NXT_HTTP_INTERNAL_SERVER_ERROR
+                                  : NXT_HTTP_BAD_REQUEST;
+    }
+
+    r->target.start = rp->target_start;
+    r->target.length = rp->target_end - rp->target_start;
+
+    r->version = http2;
+
+    r->method = &rp->method;
+    r->path = &rp->path;
+    r->args = &rp->args;
+
+    r->fields = rp->fields;
+
+    ret = nxt_http_fields_process(r->fields, &nxt_h2p_fields_hash, r);
+
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return NXT_HTTP_BAD_REQUEST;
+    }
+
+    return NXT_HTTP_INVALID;
+}
+
+
+static nxt_h2_error_t
+nxt_h2p_fields_discard(nxt_h2proto_t *h2p, u_char *p, u_char *end)
+{
+    nxt_mp_t             *mp;
+    nxt_h2_error_t       err;
+    nxt_h2_fields_ctx_t  ctx;
+
+    mp = nxt_mp_create(1024, 128, 256, 32);
+    if (nxt_slow_path(mp == NULL)) {
+        return NXT_H2_INTERNAL_ERROR;
+    }
+
+    nxt_memzero(&ctx, sizeof(nxt_h2_fields_ctx_t));
+    ctx.mem_pool = mp;
+
+    err = nxt_h2p_fields_decode(h2p, &ctx, p, end);
+
+    nxt_mp_destroy(mp);
+
+    return err;
+}
+
+
+static nxt_h2_error_t
+nxt_h2p_fields_decode(nxt_h2proto_t *h2p, nxt_h2_fields_ctx_t *ctx, u_char *p,
+    u_char *end)
+{
+    u_char          *start;
+    uint32_t        index;
+    nxt_int_t       ret;
+    nxt_str_t       name, value;
+    nxt_bool_t      indexing, fields;
+    nxt_mp_t        *mp;
+    nxt_h2_entry_t  *entry;
+
+    fields = 0;
+
+    while (p < end) {
+
+        if (*p & 0x80) {
+            /* An indexed field. */
+
+            if (nxt_h2p_integer(&p, end, 7, &index) != NXT_OK) {
+                return NXT_H2_COMPRESSION_ERROR;
+            }
+
+            entry = nxt_h2p_table_entry(&h2p->decoder, index);
+            if (entry == NULL) {
+                return NXT_H2_COMPRESSION_ERROR;
+            }
+
+            name = entry->name;
+            value = entry->value;
+
+            if (index > NXT_H2_STATIC_ENTRIES && ctx->fields != NULL) {
+                /* A dynamic table entry may be evicted before request end. */
+
+                start = nxt_mp_nget(ctx->mem_pool,
+                                    name.length + value.length);
+                if (nxt_slow_path(start == NULL)) {
+                    return NXT_H2_INTERNAL_ERROR;
+                }
+
+                name.start = start;
+                nxt_memcpy(start, entry->name.start, name.length);
+                value.start = start + name.length;
+                nxt_memcpy(value.start, entry->value.start, value.length);
+            }
+
+            fields = 1;
+            goto add;
+        }
+
+        if ((*p & 0xe0) == 0x20) {
+            /* A dynamic table size update precedes fields. */
+
+            if (fields || nxt_h2p_integer(&p, end, 5, &index) != NXT_OK
+                || index > NXT_H2_TABLE_SIZE)
+            {
+                return NXT_H2_COMPRESSION_ERROR;
+            }
+
+            nxt_h2p_table_size(h2p->conn->mem_pool, &h2p->decoder, index);
+            continue;
+        }
+
+        indexing = ((*p & 0x40) != 0);
+
+        ret = nxt_h2p_integer(&p, end, indexing ? 6 : 4, &index);
+        if (ret != NXT_OK) {
+            return NXT_H2_COMPRESSION_ERROR;
+        }
+
+        mp = ctx->mem_pool;
+
+        if (index != 0) {
+            entry = nxt_h2p_table_entry(&h2p->decoder, index);
+            if (entry == NULL) {
+                return NXT_H2_COMPRESSION_ERROR;
+            }
+
+            name = entry->name;
+
+            if (index > NXT_H2_STATIC_ENTRIES) {
+                name.start = nxt_mp_nget(mp, name.length);
+                if (nxt_slow_path(name.start == NULL)) {
+                    return NXT_H2_INTERNAL_ERROR;
+                }
+
+                nxt_memcpy(name.start, entry->name.start, name.length);
+            }
+
+        } else {
+            ret = nxt_h2p_string(mp, &p, end, &name);
+            if (ret != NXT_OK) {
+                goto string_error;
+            }
+        }
+
+        ret = nxt_h2p_string(mp, &p, end, &value);
+        if (ret != NXT_OK) {
+            goto string_error;
+        }
+
+        if (indexing) {
+            ret = nxt_h2p_table_add(h2p->conn->mem_pool, &h2p->decoder,
+                                    &name, &value);
+            if (nxt_slow_path(ret != NXT_OK)) {
+                return NXT_H2_INTERNAL_ERROR;
+            }
+        }
+
+        fields = 1;
+
+    add:
+
+        if (nxt_slow_path(nxt_h2p_field_add(ctx, &name, &value) != NXT_OK)) {
+            return NXT_H2_INTERNAL_ERROR;
+        }
+    }
+
+    return NXT_H2_NO_ERROR;
+
+string_error:
+
+    return (ret == NXT_DECLINED) ? NXT_H2_COMPRESSION_ERROR
+                                 : NXT_H2_INTERNAL_ERROR;
+}
+
+
+static nxt_int_t
+nxt_h2p_integer(u_char **pos, u_char *end, nxt_uint_t prefix, uint32_t *value)
+{
+    u_char      *p, ch;
+    uint32_t    mask, n;
+    nxt_uint_t  shift;
+
+    p = *pos;
+    mask = (1 << prefix) - 1;
+
+    n = *p++ & mask;
+
+    if (n == mask) {
+        shift = 0;
+
+        do {
+            if (p == end || shift > 21) {
+                return NXT_DECLINED;
+            }
+
+            ch = *p++;
+            n += (uint32_t) (ch & 0x7f) << shift;
+            shift += 7;
+
+        } while (ch & 0x80);
+    }
+
+    *pos = p;
+    *value = n;
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_h2p_string(nxt_mp_t *mp, u_char **pos, u_char *end, nxt_str_t *str)
+{
+    u_char      *p, *dst;
+    ssize_t     n;
+    uint32_t    length;
+    nxt_bool_t  huffman;
+
+    p = *pos;
+
+    if (p == end) {
+        return NXT_DECLINED;
+    }
+
+    huffman = ((*p & 0x80) != 0);
+
+    if (nxt_h2p_integer(&p, end, 7, &length) != NXT_OK
+        || length > (size_t) (end - p))
+    {
+        return NXT_DECLINED;
+    }
+
+    if (length == 0) {
+        str->length = 0;
+        str->start = (u_char *) "";
+
+        *pos = p;
+        return NXT_OK;
+    }
+
+    if (huffman) {
+        /* The shortest code is 5 bits long. */
+        dst = nxt_mp_nget(mp, length * 8 / 5);
+        if (nxt_slow_path(dst == NULL)) {
+            return NXT_ERROR;
+        }
+
+        n = nxt_h2p_huffman_decode(dst, p, length);
+        if (n < 0) {
+            return NXT_DECLINED;
+        }
+
+    } else {
+        dst = nxt_mp_nget(mp, length);
+        if (nxt_slow_path(dst == NULL)) {
+            return NXT_ERROR;
+        }
+
+        nxt_memcpy(dst, p, length);
+        n = length;
+    }
+
+    str->length = n;
+    str->start = dst;
+
+    *pos = p + length;
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_h2p_field_add(nxt_h2_fields_ctx_t *ctx, nxt_str_t *name, nxt_str_t *value)
+{
+    u_char            *p, *start, ch;
+    size_t            i;
+    uint32_t          hash;
+    nxt_http_field_t  *field;
+
+    if (ctx->fields == NULL || ctx->status != NXT_HTTP_INVALID) {
+        return NXT_OK;
+    }
+
+    ctx->size += name->length + value->length;
+
+    if (ctx->size > ctx->max_size || name->length > 0xff) {
+        ctx->status = NXT_HTTP_REQUEST_HEADER_FIELDS_TOO_LARGE;
+        return NXT_OK;
+    }
+
+    if (name->length == 0) {
+        goto invalid;
+    }
+
+    if (name->start[0] == ':') {
+        if (ctx->regular) {
+            goto invalid;
+        }
+
+        return nxt_h2p_pseudo_field(ctx, name, value);
+    }
+
+    ctx->regular = 1;
+
+    hash = NXT_HTTP_FIELD_HASH_INIT;
+
+    for (i = 0; i < name->length; i++) {
+        ch = name->start[i];
+
+        if ((ch >= 'A' && ch <= 'Z') || ch <= ' ' || ch == ':' || ch >= 0x7f) {
+            goto invalid;
+        }
+
+        hash = nxt_http_field_hash_char(hash, ch);
+    }
+
+    for (i = 0; i < value->length; i++) {
+        ch = value->start[i];
+
+        if (ch == '\0' || ch == '\r' || ch == '\n') {
+            goto invalid;
+        }
+    }
+
+    if (nxt_h2p_connection_field(name->start, name->length)) {
+        goto invalid;
+    }
+
+    if (nxt_h2p_name_is(name, "te")
+        && !(value->length == sizeof("trailers") - 1
+             && nxt_memcmp(value->start, "trailers", value->length) == 0))
+    {
+        goto invalid;
+    }
+
+    if (nxt_h2p_name_is(name, "cookie") && ctx->cookie != NULL) {
+        /* Cookie crumbs are joined. */
+
+        field = ctx->cookie;
+
+        start = nxt_mp_nget(ctx->mem_pool,
+                            field->value_length + 2 + value->length);
+        if (nxt_slow_path(start == NULL)) {
+            return NXT_ERROR;
+        }
+
+        p = nxt_cpymem(start, field->value, field->value_length);
+        *p++ = ';';
+        *p++ = ' ';
+        nxt_memcpy(p, value->start, value->length);
+
+        field->value = start;
+
+        field->value_length += 2 + value->length;
+
+        return NXT_OK;
+    }
+
+    field = nxt_list_add(ctx->fields);
+    if (nxt_slow_path(field == NULL)) {
+        return NXT_ERROR;
+    }
+
+    field->hash = nxt_http_field_hash_end(hash) & 0xffff;
+    field->skip = 0;
+    field->name_length = name->length;
+    field->value_length = value->length;
+    field->name = name->start;
+    field->value = value->start;
+
+    if (nxt_h2p_name_is(name, "cookie")) {
+        ctx->cookie = field;
+
+    } else if (nxt_h2p_name_is(name, "host")) {
+        ctx->host = 1;
+    }
+
+    return NXT_OK;
+
+invalid:
+
+    ctx->status = NXT_HTTP_BAD_REQUEST;
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_h2p_pseudo_field(nxt_h2_fields_ctx_t *ctx, nxt_str_t *name,
+    nxt_str_t *value)
+{
+    size_t     i;
+    nxt_str_t  *field;
+
+    if (nxt_h2p_name_is(name, ":method")) {
+        field = &ctx->method;
+
+    } else if (nxt_h2p_name_is(name, ":path")) {
+        field = &ctx->path;
+
+    } else if (nxt_h2p_name_is(name, ":scheme")) {
+        field = &ctx->scheme;
+
+    } else if (nxt_h2p_name_is(name, ":authority")) {
+        field = &ctx->authority;
+
+    } else {
+        goto invalid;
+    }
+
+    if (field->start != NULL) {
+        goto invalid;
+    }
+
+    if (field == &ctx->method || field == &ctx->path) {
+        /* The fields are copied to the request line. */
+
+        if (value->length == 0) {
+            goto invalid;
+        }
+
+        for (i = 0; i < value->length; i++) {
+            if (value->start[i] <= ' ' || value->start[i] >= 0x7f) {
+                goto invalid;
+            }
+        }
+    }
+
+    *field = *value;
+
+    return NXT_OK;
+
+invalid:
+
+    ctx->status = NXT_HTTP_BAD_REQUEST;
+
+    return NXT_OK;
+}
+
+
+static nxt_bool_t
+nxt_h2p_connection_field(u_char *name, size_t length)
+{
+    nxt_uint_t  i;
+
+    static const nxt_str_t  fields[] = {
+        nxt_string("connection"),
+        nxt_string("keep-alive"),
+        nxt_string("proxy-connection"),
+        nxt_string("transfer-encoding"),
+        nxt_string("upgrade"),
+    };
+
+    for (i = 0; i < nxt_nitems(fields); i++) {
+        if (length == fields[i].length
+            && nxt_memcasecmp(name, fields[i].start, length) == 0)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+static nxt_h2_entry_t *
+nxt_h2p_table_entry(nxt_h2_table_t *table, uint32_t index)
+{
+    if (index == 0) {
+        return NULL;
+    }
+
+    if (index <= NXT_H2_STATIC_ENTRIES) {
+        return (nxt_h2_entry_t *) &nxt_h2p_static_table[index - 1];
+    }
+
+    index -= NXT_H2_STATIC_ENTRIES;
+
+    if (index > table->count) {
+        return NULL;
+    }
+
+    return table->entries[(table->last - index + 1)
+                          & (NXT_H2_TABLE_ENTRIES - 1)];
+}
+
+
+static nxt_int_t
+nxt_h2p_table_add(nxt_mp_t *mp, nxt_h2_table_t *table, nxt_str_t *name,
+    nxt_str_t *value)
+{
+    size_t          size;
+    uint32_t        max_size;
+    nxt_h2_entry_t  *entry;
+
+    size = name->length + value->length + 32;
+    max_size = table->max_size;
+
+    if (size > max_size) {
+        /* The table is cleared by a too large entry. */
+        nxt_h2p_table_size(mp, table, 0);
+        table->max_size = max_size;
+
+        return NXT_OK;
+    }
+
+    /* The entry is copied first, since its name may be an evicted entry. */
+
+    entry = nxt_mp_alloc(mp, sizeof(nxt_h2_entry_t) + name->length
+                             + value->length);
+    if (nxt_slow_path(entry == NULL)) {
+        return NXT_ERROR;
+    }
+
+    entry->name.length = name->length;
+    entry->name.start = (u_char *) entry + sizeof(nxt_h2_entry_t);
+    nxt_memcpy(entry->name.start, name->start, name->length);
+
+    entry->value.length = value->length;
+    entry->value.start = entry->name.start + name->length;
+    nxt_memcpy(entry->value.start, value->start, value->length);
+
+    nxt_h2p_table_size(mp, table, table->max_size - size);
+
+    table->max_size += size;
+    table->size += size;
+    table->count++;
+
+    table->last = (table->last + 1) & (NXT_H2_TABLE_ENTRIES - 1);
+    table->entries[table->last] = entry;
+
+    return NXT_OK;
+}
+
+
+static void
+nxt_h2p_table_size(nxt_mp_t *mp, nxt_h2_table_t *table, uint32_t size)
+{
+    nxt_h2_entry_t  *entry;
+
+    table->max_size = size;
+
+    while (table->size > size) {
+        entry = table->entries[(table->last - table->count + 1)
+                               & (NXT_H2_TABLE_ENTRIES - 1)];
+
+        table->size -= entry->name.length + entry->value.length + 32;
+        table->count--;
+
+        nxt_mp_free(mp, entry);
+    }
+}
+
+
+static nxt_h2_error_t
+nxt_h2p_priority(nxt_task_t *task, nxt_h2proto_t *h2p, nxt_h2_frame_t *frame)
+{
+    nxt_h2stream_t  *stream;
+
+    if (frame->stream_id == 0) {
+        return NXT_H2_PROTOCOL_ERROR;
+    }
+
+    if (frame->length != 5) {
+        return NXT_H2_FRAME_SIZE_ERROR;
+    }
+
+    stream = nxt_h2p_stream_find(h2p, frame->stream_id);
+
+    if (stream != NULL) {
+        stream->weight = frame->payload[4] + 1;
+    }
+
+    return NXT_H2_NO_ERROR;
+}
+
+
+static nxt_h2_error_t
+nxt_h2p_rst_stream(nxt_task_t *task, nxt_h2proto_t *h2p,
+    nxt_h2_frame_t *frame)
+{
+    nxt_h2stream_t  *stream;
+
+    if (frame->stream_id == 0) {
+        return NXT_H2_PROTOCOL_ERROR;
+    }
+
+    if (frame->length != 4) {
+        return NXT_H2_FRAME_SIZE_ERROR;
+    }
+
+    stream = nxt_h2p_stream_find(h2p, frame->stream_id);
+
+    if (stream == NULL) {
+        return (frame->stream_id > h2p->last_stream) ? NXT_H2_PROTOCOL_ERROR
+                                                     : NXT_H2_NO_ERROR;
+    }
+
+    nxt_debug(task, "h2p stream %uD reset by client: %uD",
+              stream->id, nxt_h2p_uint32(frame->payload));
+
+    stream->in_closed = 1;
+
+    nxt_h2p_stream_reset(task, stream);
+
+    return NXT_H2_NO_ERROR;
+}
+
+
+static nxt_h2_error_t
+nxt_h2p_settings(nxt_task_t *task, nxt_h2proto_t *h2p, nxt_h2_frame_t *frame)
+{
+    u_char          *p, *end;
+    int64_t         window;
+    uint32_t        value;
+    nxt_uint_t      id;
+    nxt_h2stream_t  *stream;
+
+    if (frame->stream_id != 0) {
+        return NXT_H2_PROTOCOL_ERROR;
+    }
+
+    if (frame->flags & NXT_H2_ACK) {
+        return (frame->length == 0) ? NXT_H2_NO_ERROR
+                                    : NXT_H2_FRAME_SIZE_ERROR;
+    }
+
+    if (frame->length % 6 != 0) {
+        return NXT_H2_FRAME_SIZE_ERROR;
+    }
+
+    p = frame->payload;
+    end = p + frame->length;
+
+    while (p < end) {
+        id = (p[0] << 8) | p[1];
+        value = nxt_h2p_uint32(&p[2]);
+        p += 6;
+
+        nxt_debug(task, "h2p setting %ui: %uD", id, value);
+
+        switch (id) {
+
+        case NXT_H2_HEADER_TABLE_SIZE:
+            value = nxt_min(value, NXT_H2_TABLE_SIZE);
+
+            if (value == h2p->encoder.max_size) {
+                break;
+            }
+
+            /* A size update is sent in the next header block. */
+
+            if (!h2p->table_update || value < h2p->table_min) {
+                h2p->table_min = value;
+            }
+
+            h2p->table_update = 1;
+
+            nxt_h2p_table_size(h2p->conn->mem_pool, &h2p->encoder, value);
+            break;
+
+        case NXT_H2_ENABLE_PUSH:
+            if (value > 1) {
+                return NXT_H2_PROTOCOL_ERROR;
+            }
+
+            break;
+
+        case NXT_H2_INITIAL_WINDOW:
+            if (value > NXT_H2_MAX_WINDOW) {
+                return NXT_H2_FLOW_CONTROL_ERROR;
+            }
+
+            nxt_queue_each(stream, &h2p->streams, nxt_h2stream_t, link) {
+
+                window = (int64_t) stream->send_window
+                         + (int64_t) value - h2p->init_window;
+
+                if (window > NXT_H2_MAX_WINDOW) {
+                    return NXT_H2_FLOW_CONTROL_ERROR;
+                }
+
+                stream->send_window = (int32_t) window;
+
+                nxt_h2p_stream_activate(h2p, stream);
+
+            } nxt_queue_loop;
+
+            h2p->init_window = value;
+            break;
+
+        case NXT_H2_MAX_FRAME_SIZE:
+            if (value < NXT_H2_FRAME_SIZE || value > 0xffffff) {
+                return NXT_H2_PROTOCOL_ERROR;
+            }
+
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    if (nxt_h2p_frame_send(task, h2p, NXT_H2_SETTINGS, NXT_H2_ACK, 0, NULL, 0)
+        != NXT_OK)
+    {
+        return NXT_H2_INTERNAL_ERROR;
+    }
+
+    nxt_h2p_output(task, h2p);
+
+    return NXT_H2_NO_ERROR;
+}
+
+
+static nxt_h2_error_t
+nxt_h2p_push_promise(nxt_task_t *task, nxt_h2proto_t *h2p,
+    nxt_h2_frame_t *frame)
+{
+    /* Client cannot push. */
+
+    return NXT_H2_PROTOCOL_ERROR;
+}
+
+
+static nxt_h2_error_t
+nxt_h2p_ping(nxt_task_t *task, nxt_h2proto_t *h2p, nxt_h2_frame_t *frame)
+{
+    if (frame->stream_id != 0) {
+        return NXT_H2_PROTOCOL_ERROR;
+    }
+
+    if (frame->length != 8) {
+        return NXT_H2_FRAME_SIZE_ERROR;
+    }
+
+    if (frame->flags & NXT_H2_ACK) {
+        return NXT_H2_NO_ERROR;
+    }
+
+    if (nxt_h2p_frame_send(task, h2p, NXT_H2_PING, NXT_H2_ACK, 0,
+                           frame->payload, 8)
+        != NXT_OK)
+    {
+        return NXT_H2_INTERNAL_ERROR;
+    }
+
+    return NXT_H2_NO_ERROR;
+}
+
+
+static nxt_h2_error_t
+nxt_h2p_goaway(nxt_task_t *task, nxt_h2proto_t *h2p, nxt_h2_frame_t *frame)
+{
+    if (frame->stream_id != 0) {
+        return NXT_H2_PROTOCOL_ERROR;
+    }
+
+    if (frame->length < 8) {
+        return NXT_H2_FRAME_SIZE_ERROR;
+    }
+
+    nxt_debug(task, "h2p goaway: %uD", nxt_h2p_uint32(&frame->payload[4]));
+
+    /* The started streams are completed. */
+
+    h2p->goaway = 1;
+
+    if (h2p->nstreams == 0) {
+        nxt_h2p_close(task, h2p);
+    }
+
+    return NXT_H2_NO_ERROR;
+}
+
+
+static nxt_h2_error_t
+nxt_h2p_window_update(nxt_task_t *task, nxt_h2proto_t *h2p,
+    nxt_h2_frame_t *frame)
+{
+    uint32_t        increment;
+    nxt_h2stream_t  *stream;
+
+    if (frame->length != 4) {
+        return NXT_H2_FRAME_SIZE_ERROR;
+    }
+
+    increment = nxt_h2p_uint32(frame->payload) & 0x7fffffff;
+
+    if (frame->stream_id == 0) {
+        if (increment == 0) {
+            return NXT_H2_PROTOCOL_ERROR;
+        }
+
+        if ((int64_t) h2p->send_window + increment > NXT_H2_MAX_WINDOW) {
+            return NXT_H2_FLOW_CONTROL_ERROR;
+        }
+
+        h2p->send_window += increment;
+
+        nxt_queue_each(stream, &h2p->streams, nxt_h2stream_t, link) {
+            nxt_h2p_stream_activate(h2p, stream);
+        } nxt_queue_loop;
+
+        nxt_h2p_output(task, h2p);
+
+        return NXT_H2_NO_ERROR;
+    }
+
+    stream = nxt_h2p_stream_find(h2p, frame->stream_id);
+
+    if (stream == NULL) {
+        return (frame->stream_id > h2p->last_stream) ? NXT_H2_PROTOCOL_ERROR
+                                                     : NXT_H2_NO_ERROR;
+    }
+
+    if (increment == 0) {
+        return nxt_h2p_stream_error(task, stream, NXT_H2_PROTOCOL_ERROR);
+    }
+
+    if ((int64_t) stream->send_window + increment > NXT_H2_MAX_WINDOW) {
+        return nxt_h2p_stream_error(task, stream, NXT_H2_FLOW_CONTROL_ERROR);
+    }
+
+    stream->send_window += increment;
+
+    nxt_h2p_stream_activate(h2p, stream);
+    nxt_h2p_output(task, h2p);
+
+    return NXT_H2_NO_ERROR;
+}
+
+
+void
+nxt_h2p_request_body_read(nxt_task_t *task, nxt_http_request_t *r)
+{
+    nxt_h2stream_t  *stream;
+
+    stream = r->proto.h2;
+
+    nxt_debug(task, "h2p body read %O", r->content_length_n);
+
+    if (r->content_length_n > (nxt_off_t) r->socket_conf->max_body_size) {
+        nxt_http_request_error(task, r, NXT_HTTP_PAYLOAD_TOO_LARGE);
+        return;
+    }
+
+    if (r->content_length_n > 0 && !stream->in_closed) {
+        r->body = nxt_buf_mem_alloc(r->mem_pool, r->content_length_n, 0);
+        if (nxt_slow_path(r->body == NULL)) {
+            nxt_http_request_error(task, r, NXT_HTTP_INTERNAL_SERVER_ERROR);
+            return;
+        }
+    }
+
+    if (stream->in_closed) {
+        nxt_h2p_body_done(task, stream);
+        return;
+    }
+
+    /* The body is read by nxt_h2p_data(). */
+
+    stream->body_wait = 1;
+}
+
+
+void
+nxt_h2p_request_local_addr(nxt_task_t *task, nxt_http_request_t *r)
+{
+    r->local = nxt_conn_local_addr(task, r->proto.h2->h2p->conn);
+}
+
+
+void
+nxt_h2p_request_header_send(nxt_task_t *task, nxt_http_request_t *r)
+{
+    u_char            *p;
+    size_t            size;
+    nxt_buf_t         *header, *out;
+    nxt_h2proto_t     *h2p;
+    nxt_h2stream_t    *stream;
+    nxt_http_field_t  *field;
+
+    nxt_debug(task, "h2p request header send");
+
+    r->header_sent = 1;
+    stream = r->proto.h2;
+    h2p = stream->h2p;
+
+    if (stream->reset) {
+        /* The request is closed by nxt_h2p_request_error(). */
+        return;
+    }
+
+    /* Two table size updates and ":status" literal. */
+    size = 2 * NXT_H2_INTEGER_LEN + 1 + 1 + 3;
+
+    nxt_list_each(field, r->resp.fields) {
+
+        if (!field->skip) {
+            size += 3 * NXT_H2_INTEGER_LEN;
+            size += field->name_length + field->value_length;
+        }
+
+    } nxt_list_loop;
+
+    header = nxt_buf_mem_alloc(h2p->conn->mem_pool,
+                               NXT_H2_FRAME_HEADER_SIZE + size, 0);
+    if (nxt_slow_path(header == NULL)) {
+        goto fail;
+    }
+
+    p = nxt_h2p_header_encode(h2p, r,
+                              header->mem.free + NXT_H2_FRAME_HEADER_SIZE);
+    if (nxt_slow_path(p == NULL)) {
+        goto fail;
+    }
+
+    header->mem.free = p;
+
+    out = nxt_h2p_header_frames(h2p, header, stream->id);
+    if (nxt_slow_path(out == NULL)) {
+        goto fail;
+    }
+
+    nxt_h2p_write(task, h2p, out);
+
+    nxt_work_queue_add(&task->thread->engine->fast_work_queue,
+                       r->state->ready_handler, task, r, NULL);
+
+    return;
+
+fail:
+
+    /* The encoder table may be inconsistent with client. */
+
+    h2p->error = 1;
+    nxt_h2p_shutdown(task, h2p);
+}
+
+
+static u_char *
+nxt_h2p_header_encode(nxt_h2proto_t *h2p, nxt_http_request_t *r, u_char *p)
+{
+    uint32_t            i, index;
+    nxt_int_t           ret;
+    nxt_str_t           name, value;
+    nxt_uint_t          status;
+    nxt_h2_table_t      *table;
+    nxt_h2_entry_t      *entry;
+    nxt_http_field_t    *field;
+    nxt_lvlhsh_query_t  lhq;
+    u_char              lowcase[0xff];
+
+    table = &h2p->encoder;
+
+    if (h2p->table_update) {
+        h2p->table_update = 0;
+
+        if (h2p->table_min < table->max_size) {
+            p = nxt_h2p_integer_encode(p, 0x20, 5, h2p->table_min);
+        }
+
+        p = nxt_h2p_integer_encode(p, 0x20, 5, table->max_size);
+    }
+
+    status = r->status;
+
+    switch (status) {
+
+    case NXT_HTTP_OK:
+        index = NXT_H2_STATUS_INDEX;
+        break;
+
+    case NXT_HTTP_NOT_MODIFIED:
+        index = NXT_H2_STATUS_INDEX + 3;
+        break;
+
+    case NXT_HTTP_BAD_REQUEST:
+        index = NXT_H2_STATUS_INDEX + 4;
+        break;
+
+    case NXT_HTTP_NOT_FOUND:
+        index = NXT_H2_STATUS_INDEX + 5;
+        break;
+
+    case NXT_HTTP_INTERNAL_SERVER_ERROR:
+        index = NXT_H2_STATUS_INDEX + 6;
+        break;
+
+    default:
+        index = 0;
+        break;
+    }
+
+    if (index != 0) {
+        *p++ = 0x80 | index;
+
+    } else {
+        *p++ = NXT_H2_STATUS_INDEX;
+        *p++ = 3;
+        *p++ = '0' + (status / 100) % 10;
+        *p++ = '0' + (status / 10) % 10;
+        *p++ = '0' + status % 10;
+    }
+
+    lhq.proto = &nxt_h2p_static_hash_proto;
+
+    nxt_list_each(field, r->resp.fields) {
+
+        if (field->skip) {
+            continue;
+        }
+
+        nxt_memcpy_lowcase(lowcase, field->name, field->name_length);
+
+        name.length = field->name_length;
+        name.start = lowcase;
+        value.length = field->value_length;
+        value.start = field->value;
+
+        if (nxt_h2p_connection_field(name.start, name.length)) {
+            continue;
+        }
+
+        for (i = 1; i <= table->count; i++) {
+            entry = table->entries[(table->last - i + 1)
+                                   & (NXT_H2_TABLE_ENTRIES - 1)];
+
+            if (nxt_strstr_eq(&entry->name, &name)
+                && nxt_strstr_eq(&entry->value, &value))
+            {
+                break;
+            }
+        }
+
+        if (i <= table->count) {
+            p = nxt_h2p_integer_encode(p, 0x80, 7, NXT_H2_STATIC_ENTRIES + i);
+            continue;
+        }
+
+        lhq.key = name;
+        lhq.key_hash = nxt_djb_hash(name.start, name.length);
+
+        if (nxt_lvlhsh_find(&nxt_h2p_static_hash, &lhq) == NXT_OK) {
+            index = (const nxt_h2_entry_t *) lhq.value - nxt_h2p_static_table
+                    + 1;
+        } else {
+            index = 0;
+        }
+
+        /* The fields usually repeated in all responses are indexed. */
+
+        if ((index == NXT_H2_SERVER_INDEX || index == NXT_H2_CONTENT_TYPE_INDEX)
+            && name.length + value.length + 32 <= table->max_size)
+        {
+            p = nxt_h2p_integer_encode(p, 0x40, 6, index);
+            p = nxt_h2p_string_encode(p, value.start, value.length);
+
+            ret = nxt_h2p_table_add(h2p->conn->mem_pool, table, &name, &value);
+            if (nxt_slow_path(ret != NXT_OK)) {
+                return NULL;
+            }
+
+            continue;
+        }
+
+        p = nxt_h2p_integer_encode(p, 0, 4, index);
+
+        if (index == 0) {
+            p = nxt_h2p_string_encode(p, name.start, name.length);
+        }
+
+        p = nxt_h2p_string_encode(p, value.start, value.length);
+
+    } nxt_list_loop;
+
+    return p;
+}
+
+
+static u_char *
+nxt_h2p_integer_encode(u_char *p, nxt_uint_t flags, nxt_uint_t prefix,
+    uint32_t value)
+{
+    uint32_t  mask;
+
+    mask = (1 << prefix) - 1;
+
+    if (value < mask) {
+        *p++ = flags | value;
+        return p;
+    }
+
+    *p++ = flags | mask;
+    value -= mask;
+
+    while (value >= 0x80) {
+        *p++ = 0x80 | (value & 0x7f);
+        value >>= 7;
+    }
+
+    *p++ = value;
+
+    return p;
+}
+
+
+static u_char *
+nxt_h2p_string_encode(u_char *p, u_char *src, size_t length)
+{
+    /* Strings are sent without Huffman encoding. */
+
+    p = nxt_h2p_integer_encode(p, 0, 7, length);
+
+    return nxt_cpymem(p, src, length);
+}
+
+
+/*
+ * The header block encoded after the frame header is split
+ * into HEADERS and CONTINUATION frames if it is too large.
+ */
+
+static nxt_buf_t *
+nxt_h2p_header_frames(nxt_h2proto_t *h2p, nxt_buf_t *header, uint32_t id)
+{
+    u_char      *p, *block;
+    size_t      size, n;
+    nxt_buf_t   *b, **next;
+    nxt_uint_t  type;
+
+    block = header->mem.pos + NXT_H2_FRAME_HEADER_SIZE;
+    size = header->mem.free - block;
+
+    n = nxt_min(size, NXT_H2_FRAME_SIZE);
+
+    (void) nxt_h2p_frame_header(header->mem.pos, NXT_H2_HEADERS,
+                                (n == size) ? NXT_H2_END_HEADERS : 0, id, n);
+
+    header->mem.free = block + n;
+
+    p = block + n;
+    size -= n;
+
+    next = &header->next;
+    type = NXT_H2_CONTINUATION;
+
+    while (size != 0) {
+        n = nxt_min(size, NXT_H2_FRAME_SIZE);
+
+        b = nxt_h2p_frame_alloc(h2p, type, (n == size) ? NXT_H2_END_HEADERS : 0,
+                                id, n);
+        if (nxt_slow_path(b == NULL)) {
+            return NULL;
+        }
+
+        b->mem.free = nxt_cpymem(b->mem.free, p, n);
+
+        p += n;
+        size -= n;
+
+        *next = b;
+        next = &b->next;
+    }
+
+    return header;
+}
+
+
+void
+nxt_h2p_request_send(nxt_task_t *task, nxt_http_request_t *r, nxt_buf_t *out)
+{
+    nxt_h2stream_t  *stream;
+
+    nxt_debug(task, "h2p request send");
+
+    stream = r->proto.h2;
+
+    if (stream->reset) {
+        /* The request is closed by nxt_h2p_request_error(). */
+        return;
+    }
+
+    nxt_buf_chain_add(&stream->out, out);
+
+    if (!stream->active) {
+        /* Even an exhausted window allows to send the last empty frame. */
+        stream->active = 1;
+        nxt_queue_insert_tail(&stream->h2p->active, &stream->active_link);
+    }
+
+    nxt_h2p_output(task, stream->h2p);
+}
+
+
+static void
+nxt_h2p_output(nxt_task_t *task, nxt_h2proto_t *h2p)
+{
+    nxt_buf_t         *out, **last;
+    nxt_h2stream_t    *stream;
+    nxt_queue_link_t  *lnk;
+
+    out = NULL;
+    last = &out;
+
+    while (h2p->out_size < NXT_H2_OUTPUT_SIZE
+           && !nxt_queue_is_empty(&h2p->active))
+    {
+        lnk = nxt_queue_first(&h2p->active);
+        nxt_queue_remove(lnk);
+
+        stream = nxt_queue_link_data(lnk, nxt_h2stream_t, active_link);
+        stream->active = 0;
+
+        if (nxt_slow_path(nxt_h2p_stream_output(task, stream, &last)
+                          != NXT_OK))
+        {
+            /* The stream frames should precede RST_STREAM frame. */
+
+            if (out != NULL) {
+                nxt_h2p_write(task, h2p, out);
+
+                out = NULL;
+                last = &out;
+            }
+
+            (void) nxt_h2p_stream_error(task, stream, NXT_H2_INTERNAL_ERROR);
+            continue;
+        }
+
+        nxt_h2p_stream_activate(h2p, stream);
+    }
+
+    if (out != NULL) {
+        nxt_h2p_write(task, h2p, out);
+    }
+}
+
+
+static nxt_int_t
+nxt_h2p_stream_output(nxt_task_t *task, nxt_h2stream_t *stream,
+    nxt_buf_t ***last_frame)
+{
+    u_char            *p;
+    size_t            size, n, quantum;
+    ssize_t           ret;
+    int32_t           window;
+    nxt_buf_t         *b, *next, *frame;
+    nxt_bool_t        last;
+    nxt_h2proto_t     *h2p;
+    nxt_work_queue_t  *wq;
+
+    h2p = stream->h2p;
+    wq = &task->thread->engine->fast_work_queue;
+
+    quantum = NXT_H2_QUANTUM * stream->weight;
+    frame = NULL;
+    last = 0;
+
+    b = stream->out;
+
+    for ( ;; ) {
+
+        while (b != NULL && nxt_buf_used_size(b) == 0) {
+            next = b->next;
+            last = nxt_buf_is_last(b);
+
+            nxt_work_queue_add(wq, b->completion_handler, task, b, b->parent);
+
+            b = next;
+
+            if (last) {
+                goto done;
+            }
+        }
+
+        window = nxt_min(stream->send_window, h2p->send_window);
+
+        if (b == NULL || window <= 0 || quantum == 0) {
+            break;
+        }
+
+        size = nxt_min((size_t) window, quantum);
+        size = nxt_min(size, NXT_H2_FRAME_SIZE);
+
+        n = 0;
+
+        for (next = b; next != NULL && n < size; next = next->next) {
+            n += nxt_buf_used_size(next);
+        }
+
+        size = nxt_min(size, n);
+
+        frame = nxt_h2p_frame_alloc(h2p, NXT_H2_DATA, 0, stream->id, size);
+        if (nxt_slow_path(frame == NULL)) {
+            goto fail;
+        }
+
+        p = frame->mem.free;
+        frame->mem.free += size;
+
+        quantum -= size;
+        stream->send_window -= size;
+        h2p->send_window -= size;
+        h2p->out_size += size;
+
+        **last_frame = frame;
+        *last_frame = &frame->next;
+
+        while (size != 0) {
+            n = nxt_buf_used_size(b);
+
+            if (n == 0) {
+                next = b->next;
+                nxt_work_queue_add(wq, b->completion_handler, task, b,
+                                   b->parent);
+                b = next;
+                continue;
+            }
+
+            n = nxt_min(n, size);
+
+            if (nxt_buf_is_file(b)) {
+                ret = nxt_file_read(b->file, p, n, b->file_pos);
+
+                if (nxt_slow_path(ret <= 0)) {
+                    goto fail;
+                }
+
+                n = ret;
+                b->file_pos += n;
+
+            } else {
+                nxt_memcpy(p, b->mem.pos, n);
+                b->mem.pos += n;
+            }
+
+            p += n;
+            size -= n;
+        }
+    }
+
+done:
+
+    stream->out = b;
+
+    if (last) {
+        stream->out_closed = 1;
+
+        if (frame != NULL) {
+            frame->mem.pos[4] |= NXT_H2_END_STREAM;
+
+        } else {
+            frame = nxt_h2p_frame_alloc(h2p, NXT_H2_DATA, NXT_H2_END_STREAM,
+                                        stream->id, 0);
+            if (nxt_slow_path(frame == NULL)) {
+                return NXT_ERROR;
+            }
+
+            **last_frame = frame;
+            *last_frame = &frame->next;
+        }
+    }
+
+    return NXT_OK;
+
+fail:
+
+    stream->out = b;
+
+    return NXT_ERROR;
+}
+
+
+static void
+nxt_h2p_stream_activate(nxt_h2proto_t *h2p, nxt_h2stream_t *stream)
+{
+    if (!stream->active
+        && !stream->reset
+        && stream->out != NULL
+        && stream->send_window > 0
+        && h2p->send_window > 0)
+    {
+        stream->active = 1;
+        nxt_queue_insert_tail(&h2p->active, &stream->active_link);
+    }
+}
+
+
+static nxt_h2stream_t *
+nxt_h2p_stream_find(nxt_h2proto_t *h2p, uint32_t id)
+{
+    nxt_lvlhsh_query_t  lhq;
+
+    lhq.key_hash = id;
+    lhq.key.length = 0;
+    lhq.key.start = NULL;
+    lhq.proto = &nxt_h2p_stream_hash_proto;
+
+    if (nxt_lvlhsh_find(&h2p->streams_hash, &lhq) == NXT_OK) {
+        return lhq.value;
+    }
+
+    return NULL;
+}
+
+
+static nxt_h2_error_t
+nxt_h2p_stream_error(nxt_task_t *task, nxt_h2stream_t *stream,
+    nxt_h2_error_t code)
+{
+    nxt_debug(task, "h2p stream %uD error: %d", stream->id, code);
+
+    if (!stream->reset
+        && nxt_h2p_rst_send(task, stream->h2p, stream->id, code) != NXT_OK)
+    {
+        return NXT_H2_INTERNAL_ERROR;
+    }
+
+    stream->in_closed = 1;
+
+    nxt_h2p_stream_reset(task, stream);
+
+    return NXT_H2_NO_ERROR;
+}
+
+
+/*
+ * The request of a reset stream is closed asynchronously,
+ * since the request handlers may be already queued.
+ */
+
+static void
+nxt_h2p_stream_reset(nxt_task_t *task, nxt_h2stream_t *stream)
+{
+    nxt_http_request_t  *r;
+
+    if (stream->reset) {
+        return;
+    }
+
+    stream->reset = 1;
+    stream->body_wait = 0;
+
+    if (stream->active) {
+        stream->active = 0;
+        nxt_queue_remove(&stream->active_link);
+    }
+
+    if (stream->out_closed) {
+        /* The request is closed by the last buffer completion handler. */
+        return;
+    }
+
+    r = stream->request;
+
+    nxt_mp_retain(r->mem_pool);
+
+    nxt_work_queue_add(&task->thread->engine->fast_work_queue,
+                       nxt_h2p_request_error, task, r, stream);
+}
+
+
+static void
+nxt_h2p_request_error(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_h2stream_t      *stream;
+    nxt_http_request_t  *r;
+
+    r = obj;
+    stream = data;
+
+    /* The stream exists while the request is not closed. */
+
+    if (r->proto.h2 == stream && !stream->out_closed) {
+        r->state->error_handler(task, r, stream);
+    }
+
+    nxt_mp_release(r->mem_pool);
+}
+
+
+void
+nxt_h2p_request_close(nxt_task_t *task, nxt_http_proto_t proto)
+{
+    nxt_h2proto_t   *h2p;
+    nxt_h2stream_t  *stream;
+
+    stream = proto.h2;
+    h2p = stream->h2p;
+
+    nxt_debug(task, "h2p request close: %uD", stream->id);
+
+    stream->request = NULL;
+
+    if (!h2p->closing && !stream->reset) {
+
+        if (!stream->out_closed) {
+            (void) nxt_h2p_rst_send(task, h2p, stream->id,
+                                    NXT_H2_INTERNAL_ERROR);
+
+        } else if (!stream->in_closed) {
+            /* The rest of request body is not required. */
+            (void) nxt_h2p_rst_send(task, h2p, stream->id, NXT_H2_NO_ERROR);
+        }
+    }
+
+    nxt_h2p_stream_free(task, stream);
+}
+
+
+static void
+nxt_h2p_stream_free(nxt_task_t *task, nxt_h2stream_t *stream)
+{
+    nxt_conn_t          *c;
+    nxt_h2proto_t       *h2p;
+    nxt_lvlhsh_query_t  lhq;
+
+    h2p = stream->h2p;
+    c = h2p->conn;
+
+    if (stream->active) {
+        nxt_queue_remove(&stream->active_link);
+    }
+
+    nxt_queue_remove(&stream->link);
+
+    h2p->body_size -= stream->body_size;
+
+    lhq.key_hash = stream->id;
+    lhq.key.length = 0;
+    lhq.key.start = NULL;
+    lhq.proto = &nxt_h2p_stream_hash_proto;
+    lhq.pool = NULL;
+
+    (void) nxt_lvlhsh_delete(&h2p->streams_hash, &lhq);
+
+    nxt_mp_free(c->mem_pool, stream);
+
+    h2p->nstreams--;
+
+    if (h2p->nstreams != 0) {
+        return;
+    }
+
+    if (h2p->closing || h2p->goaway) {
+        nxt_h2p_close(task, h2p);
+
+    } else {
+        nxt_conn_timer(task->thread->engine, c, &nxt_h2p_read_state,
+                       &c->read_timer);
+    }
+}
+
+
+static nxt_buf_t *
+nxt_h2p_frame_alloc(nxt_h2proto_t *h2p, nxt_uint_t type, nxt_uint_t flags,
+    uint32_t id, size_t length)
+{
+    nxt_buf_t  *b;
+
+    b = nxt_buf_mem_alloc(h2p->conn->mem_pool,
+                          NXT_H2_FRAME_HEADER_SIZE + length, 0);
+
+    if (nxt_fast_path(b != NULL)) {
+        b->mem.free = nxt_h2p_frame_header(b->mem.free, type, flags, id,
+                                           length);
+    }
+
+    return b;
+}
+
+
+static u_char *
+nxt_h2p_frame_header(u_char *p, nxt_uint_t type, nxt_uint_t flags,
+    uint32_t id, size_t length)
+{
+    *p++ = (u_char) (length >> 16);
+    *p++ = (u_char) (length >> 8);
+    *p++ = (u_char) length;
+    *p++ = (u_char) type;
+    *p++ = (u_char) flags;
+
+    nxt_h2p_uint32_set(p, id);
+
+    return p + 4;
+}
+
+
+static nxt_int_t
+nxt_h2p_frame_send(nxt_task_t *task, nxt_h2proto_t *h2p, nxt_uint_t type,
+    nxt_uint_t flags, uint32_t id, const u_char *payload, size_t length)
+{
+    nxt_buf_t  *b;
+
+    b = nxt_h2p_frame_alloc(h2p, type, flags, id, length);
+    if (nxt_slow_path(b == NULL)) {
+        return NXT_ERROR;
+    }
+
+    if (length != 0) {
+        b->mem.free = nxt_cpymem(b->mem.free, payload, length);
+    }
+
+    nxt_h2p_write(task, h2p, b);
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_h2p_rst_send(nxt_task_t *task, nxt_h2proto_t *h2p, uint32_t id,
+    nxt_h2_error_t code)
+{
+    u_char  payload[4];
+
+    nxt_h2p_uint32_set(payload, code);
+
+    return nxt_h2p_frame_send(task, h2p, NXT_H2_RST_STREAM, 0, id, payload, 4);
+}
+
+
+static nxt_int_t
+nxt_h2p_window_send(nxt_task_t *task, nxt_h2proto_t *h2p, uint32_t id,
+    uint32_t increment)
+{
+    u_char  payload[4];
+
+    nxt_h2p_uint32_set(payload, increment);
+
+    return nxt_h2p_frame_send(task, h2p, NXT_H2_WINDOW_UPDATE, 0, id,
+                              payload, 4);
+}
+
+
+static void
+nxt_h2p_write(nxt_task_t *task, nxt_h2proto_t *h2p, nxt_buf_t *b)
+{
+    nxt_conn_t  *c;
+
+    if (nxt_slow_path(h2p->closed)) {
+        return;
+    }
+
+    c = h2p->conn;
+
+    if (c->write == NULL) {
+        c->write = b;
+
+        nxt_conn_write(task->thread->engine, c);
+
+    } else {
+        nxt_buf_chain_add(&c->write, b);
+    }
+}
+
+
+static const nxt_conn_state_t  nxt_h2p_write_state
+    nxt_aligned(64) =
+{
+    .ready_handler = nxt_h2p_sent,
+    .close_handler = nxt_h2p_conn_close,
+    .error_handler = nxt_h2p_conn_error,
+
+    .timer_handler = nxt_h2p_send_timeout,
+    .timer_value = nxt_h2p_timeout_value,
+    .timer_data = offsetof(nxt_socket_conf_t, send_timeout),
+    .timer_autoreset = 1,
+};
+
+
+static void
+nxt_h2p_sent(nxt_task_t *task, void *obj, void *data)
+{
+    u_char         *p;
+    nxt_buf_t      *b, *next;
+    nxt_conn_t     *c;
+    nxt_h2proto_t  *h2p;
+
+    c = obj;
+    h2p = data;
+
+    nxt_debug(task, "h2p sent");
+
+    if (h2p == NULL || h2p->closed) {
+        return;
+    }
+
+    for (b = c->write; b != NULL; b = next) {
+
+        if (nxt_buf_mem_used_size(&b->mem) != 0) {
+            break;
+        }
+
+        next = b->next;
+        p = b->mem.start;
+
+        if (p[3] == NXT_H2_DATA) {
+            h2p->out_size -= (p[0] << 16) | (p[1] << 8) | p[2];
+        }
+
+        nxt_mp_free(c->mem_pool, b);
+    }
+
+    c->write = b;
+
+    if (b != NULL) {
+        nxt_conn_write(task->thread->engine, c);
+    }
+
+    nxt_h2p_output(task, h2p);
+
+    if (h2p->closing) {
+        nxt_h2p_close(task, h2p);
+    }
+}
+
+
+static void
+nxt_h2p_error(nxt_task_t *task, nxt_h2proto_t *h2p, nxt_h2_error_t code)
+{
+    u_char  payload[8];
+
+    nxt_debug(task, "h2p error: %d", code);
+
+    if (!h2p->closing) {
+        nxt_h2p_uint32_set(payload, h2p->last_stream);
+        nxt_h2p_uint32_set(&payload[4], code);
+
+        if (nxt_h2p_frame_send(task, h2p, NXT_H2_GOAWAY, 0, 0, payload, 8)
+            != NXT_OK)
+        {
+            h2p->error = 1;
+        }
+    }
+
+    nxt_h2p_shutdown(task, h2p);
+}
+
+
+static void
+nxt_h2p_shutdown(nxt_task_t *task, nxt_h2proto_t *h2p)
+{
+    nxt_h2stream_t  *stream;
+
+    nxt_debug(task, "h2p shutdown");
+
+    h2p->closing = 1;
+
+    nxt_queue_each(stream, &h2p->streams, nxt_h2stream_t, link) {
+        nxt_h2p_stream_reset(task, stream);
+    } nxt_queue_loop;
+
+    nxt_h2p_close(task, h2p);
+}
+
+
+static void
+nxt_h2p_close(nxt_task_t *task, nxt_h2proto_t *h2p)
+{
+    nxt_conn_t  *c;
+
+    h2p->closing = 1;
+
+    if (h2p->closed || h2p->nstreams != 0) {
+        return;
+    }
+
+    c = h2p->conn;
+
+    if (c->write != NULL && !h2p->error) {
+        /* The close is called again by nxt_h2p_sent(). */
+        return;
+    }
+
+    nxt_debug(task, "h2p close");
+
+    h2p->closed = 1;
+    c->socket.data = NULL;
+
+    if (c->socket.fd != -1) {
+        c->write_state = &nxt_router_conn_close_state;
+
+        nxt_conn_close(task->thread->engine, c);
+    }
+}
+
+
+static void
+nxt_h2p_conn_close(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_h2proto_t  *h2p;
+
+    h2p = data;
+
+    nxt_debug(task, "h2p conn close");
+
+    if (h2p == NULL || h2p->closed) {
+        return;
+    }
+
+    h2p->error = 1;
+
+    nxt_h2p_shutdown(task, h2p);
+}
+
+
+static void
+nxt_h2p_conn_error(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_debug(task, "h2p conn error");
+
+    nxt_h2p_conn_close(task, obj, data);
+}
+
+
+static void
+nxt_h2p_conn_timeout(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_conn_t     *c;
+    nxt_timer_t    *timer;
+    nxt_h2proto_t  *h2p;
+
+    timer = obj;
+
+    nxt_debug(task, "h2p conn timeout");
+
+    c = nxt_read_timer_conn(timer);
+    h2p = c->socket.data;
+
+    if (h2p != NULL && !h2p->closing && h2p->nstreams == 0) {
+        nxt_h2p_error(task, h2p, NXT_H2_NO_ERROR);
+    }
+}
+
+
+static void
+nxt_h2p_send_timeout(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_conn_t     *c;
+    nxt_timer_t    *timer;
+    nxt_h2proto_t  *h2p;
+
+    timer = obj;
+
+    nxt_debug(task, "h2p send timeout");
+
+    c = nxt_write_timer_conn(timer);
+    c->socket.timedout = 1;
+
+    h2p = c->socket.data;
+
+    if (h2p != NULL && !h2p->closed) {
+        h2p->error = 1;
+        nxt_h2p_shutdown(task, h2p);
+    }
+}
+
+
+static nxt_msec_t
+nxt_h2p_timeout_value(nxt_conn_t *c, uintptr_t data)
+{
+    nxt_h2proto_t            *h2p;
+    nxt_socket_conf_joint_t  *joint;
+
+    h2p = c->socket.data;
+
+    /* The idle timeout is not set while there are open streams. */
+
+    if (data == offsetof(nxt_socket_conf_t, idle_timeout)
+        && h2p != NULL && h2p->nstreams != 0)
+    {
+        return 0;
+    }
+
+    joint = c->joint;
+
+    return nxt_value_at(nxt_msec_t, joint->socket_conf, data);
+}
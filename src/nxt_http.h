@@ -20,6 +20,7 @@ typedef enum {
     NXT_HTTP_NOT_MODIFIED = 304,
 
     NXT_HTTP_BAD_REQUEST = 400,
+    NXT_HTTP_NOT_FOUND = 404,
     NXT_HTTP_LENGTH_REQUIRED = 411,
     NXT_HTTP_PAYLOAD_TOO_LARGE = 413,
     NXT_HTTP_URI_TOO_LONG = 414,
@@ -65,12 +66,22 @@ typedef struct {
 } nxt_h1proto_t;
 
 
+typedef struct nxt_h2stream_s  nxt_h2stream_t;
+
+
 typedef union {
     void                            *any;
     nxt_h1proto_t                   *h1;
+    nxt_h2stream_t                  *h2;
 } nxt_http_proto_t;
 
 
+typedef enum {
+    NXT_HTTP_PROTO_H1 = 0,
+    NXT_HTTP_PROTO_H2,
+} nxt_http_protocol_t;
+
+
 #define nxt_http_field_name_set(_field, _name)                                \
     do {                                                                      \
          (_field)->name_length = sizeof(_name) - 1;                           \
@@ -87,6 +98,10 @@ typedef union {
     } while (0)
 
 
+#define NXT_HTTP_DATE_FORMAT  "%s, %02d %s %4d %02d:%02d:%02d GMT"
+#define NXT_HTTP_DATE_LEN     (sizeof("Wed, 31 Dec 1986 16:40:00 GMT") - 1)
+
+
 typedef struct {
     nxt_list_t                      *fields;
     nxt_http_field_t                *date;
@@ -98,6 +113,7 @@ typedef struct {
 
 struct nxt_http_request_s {
     nxt_http_proto_t                proto;
+    nxt_socket_conf_joint_t         *conf;
     nxt_socket_conf_t               *socket_conf;
 
     nxt_mp_t                        *mem_pool;
@@ -106,6 +122,23 @@ struct nxt_http_request_s {
     nxt_buf_t                       *out;
     const nxt_http_request_state_t  *state;
 
+    /* A streamed request body. */
+    nxt_off_t                       body_rest;
+    const nxt_http_request_state_t  *body_state;
+    void                            *body_data;
+
+    /* A request body saved to a temporary file. */
+    nxt_file_t                      *body_file;
+
+    /* A request passed to application, nxt_app_parse_ctx_t. */
+    void                            *app_data;
+
+    /* A file sent by router, nxt_http_static_file_t. */
+    void                            *static_file;
+
+    /* A response cache query, nxt_http_cache_query_t. */
+    void                            *cache;
+
     nxt_str_t                       target;
     nxt_str_t                       version;
     nxt_str_t                       *method;
@@ -117,6 +150,8 @@ struct nxt_http_request_s {
     nxt_http_field_t                *content_type;
     nxt_http_field_t                *content_length;
     nxt_http_field_t                *cookie;
+    nxt_http_field_t                *if_modified_since;
+    nxt_http_field_t                *if_none_match;
     nxt_off_t                       content_length_n;
 
     nxt_sockaddr_t                  *remote;
@@ -134,6 +169,8 @@ struct nxt_http_request_s {
 
 typedef void (*nxt_http_proto_body_read_t)(nxt_task_t *task,
     nxt_http_request_t *r);
+typedef void (*nxt_http_proto_body_stream_t)(nxt_task_t *task,
+    nxt_http_request_t *r, nxt_buf_t *b);
 typedef void (*nxt_http_proto_local_addr_t)(nxt_task_t *task,
     nxt_http_request_t *r);
 typedef void (*nxt_http_proto_header_send_t)(nxt_task_t *task,
@@ -146,14 +183,27 @@ typedef void (*nxt_http_proto_close_t)(nxt_task_t *task,
 
 nxt_int_t nxt_http_init(nxt_task_t *task, nxt_runtime_t *rt);
 nxt_int_t nxt_h1p_init(nxt_task_t *task, nxt_runtime_t *rt);
-nxt_int_t nxt_http_response_hash_init(nxt_task_t *task, nxt_runtime_t *rt);
+nxt_int_t nxt_h2p_init(nxt_task_t *task, nxt_runtime_t *rt);
+nxt_int_t nxt_h2p_preface(nxt_buf_mem_t *mem);
+void nxt_h2p_conn_init(nxt_task_t *task, nxt_conn_t *c);
+void nxt_h2p_request_body_read(nxt_task_t *task, nxt_http_request_t *r);
+void nxt_h2p_request_local_addr(nxt_task_t *task, nxt_http_request_t *r);
+void nxt_h2p_request_header_send(nxt_task_t *task, nxt_http_request_t *r);
+void nxt_h2p_request_send(nxt_task_t *task, nxt_http_request_t *r,
+    nxt_buf_t *out);
+void nxt_h2p_request_close(nxt_task_t *task, nxt_http_proto_t proto);
 
 void nxt_http_conn_init(nxt_task_t *task, void *obj, void *data);
 nxt_http_request_t *nxt_http_request_create(nxt_task_t *task);
 void nxt_http_request_error(nxt_task_t *task, nxt_http_request_t *r,
     nxt_http_status_t status);
 void nxt_http_request_read_body(nxt_task_t *task, nxt_http_request_t *r);
+void nxt_http_app_request(nxt_task_t *task, nxt_http_request_t *r);
+void nxt_http_request_body_stream(nxt_task_t *task, nxt_http_request_t *r,
+    nxt_buf_t *b);
 void nxt_http_request_local_addr(nxt_task_t *task, nxt_http_request_t *r);
+nxt_file_t *nxt_http_request_temp_file(nxt_task_t *task,
+    nxt_http_request_t *r, const char *name);
 void nxt_http_request_header_send(nxt_task_t *task, nxt_http_request_t *r);
 void nxt_http_request_send(nxt_task_t *task, nxt_http_request_t *r,
     nxt_buf_t *out);
@@ -161,6 +211,20 @@ void nxt_http_request_release(nxt_task_t *task, nxt_http_request_t *r);
 nxt_buf_t *nxt_http_request_last_buffer(nxt_task_t *task,
     nxt_http_request_t *r);
 void nxt_http_request_close_handler(nxt_task_t *task, void *obj, void *data);
+u_char *nxt_http_date(u_char *buf, nxt_realtime_t *now, struct tm *tm,
+    size_t size, const char *format);
+
+nxt_int_t nxt_http_static_handler(nxt_task_t *task, nxt_http_request_t *r);
+void nxt_http_static_cache_free(nxt_http_static_cache_t *cache);
+
+nxt_http_cache_t *nxt_http_cache_create(size_t size, nxt_time_t valid,
+    nxt_time_t stale, nxt_msec_t lock_timeout);
+void nxt_http_cache_free(nxt_http_cache_t *cache);
+nxt_int_t nxt_http_cache_handler(nxt_task_t *task, nxt_http_request_t *r,
+    nxt_http_cache_t *cache);
+void nxt_http_cache_response(nxt_task_t *task, nxt_http_request_t *r);
+void nxt_http_cache_body(nxt_task_t *task, nxt_http_request_t *r, nxt_buf_t *b,
+    nxt_bool_t last);
 
 nxt_int_t nxt_http_request_host(void *ctx, nxt_http_field_t *field,
     uintptr_t data);
@@ -168,12 +232,14 @@ nxt_int_t nxt_http_request_field(void *ctx, nxt_http_field_t *field,
     uintptr_t offset);
 nxt_int_t nxt_http_request_content_length(void *ctx, nxt_http_field_t *field,
     uintptr_t data);
+nxt_int_t nxt_http_response_field_process(nxt_http_request_t *r,
+    nxt_http_field_t *field, nxt_uint_t id);
 
 
-extern nxt_lvlhsh_t                        nxt_response_fields_hash;
 extern const nxt_conn_state_t              nxt_router_conn_close_state;
 
 extern const nxt_http_proto_body_read_t    nxt_http_proto_body_read[];
+extern const nxt_http_proto_body_stream_t  nxt_http_proto_body_stream[];
 extern const nxt_http_proto_local_addr_t   nxt_http_proto_local_addr[];
 extern const nxt_http_proto_header_send_t  nxt_http_proto_header_send[];
 extern const nxt_http_proto_send_t         nxt_http_proto_send[];
@@ -0,0 +1,1487 @@
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_router.h>
+#include <nxt_http.h>
+
+
+/*
+ * The application response cache keeps responses to GET requests in router
+ * memory, so hot resources are sent without passing requests to application.
+ * The cache belongs to an application and is shared by all router engines,
+ * so it is protected by a spinlock.  Like nxt_cache, it consists of a level
+ * hash of entries and a least recently used queue used to evict entries
+ * when the cache size is exceeded.  An entry is held by requests being sent,
+ * so a replaced or evicted entry is freed only after the last response.
+ *
+ * Freshness is set by "Cache-Control: s-maxage" or "max-age", or by "Expires"
+ * response header fields, otherwise the application "cache" "valid" value
+ * is used.  After the entry has expired, the first request is passed to
+ * application to update the entry, and until the stale time set by
+ * "Cache-Control: stale-while-revalidate" or the "cache" "stale" value has
+ * passed, other requests are served with the stale entry.
+ *
+ * Concurrent requests for a missing or an expired entry being updated are
+ * collapsed into one application request: an empty entry holds the key
+ * while the response is received, and the same requests wait in the entry
+ * like nxt_cache_query_wait_t waiters.  The received response is sent to
+ * all of them in their engines, even if it is not fresh enough to be cached.
+ * If the response cannot be shared, the waiting requests are passed to
+ * application.  A request waits no longer than the "cache" "lock_timeout"
+ * and then is passed to application as well.  A waiter is allocated apart
+ * from the request, since a request can be closed, for example, by HTTP/2
+ * stream reset, while its waiter has been already posted to the engine.
+ *
+ * A request with "Authorization" is served only with an entry stored from
+ * a response which allows shared caching by "Cache-Control: public",
+ * "s-maxage", or "must-revalidate", and only such a response to the request
+ * is stored.  The request does not wait for an entry being updated.
+ */
+
+/* A response larger than the cache size divided by the value is not cached. */
+#define NXT_HTTP_CACHE_ENTRY_RATIO  8
+
+#define NXT_HTTP_CACHE_BODY_SIZE    4096
+
+
+struct nxt_http_cache_s {
+    nxt_thread_spinlock_t    lock;
+    nxt_lvlhsh_t             hash;
+    nxt_queue_t              entries;   /* LRU */
+
+    size_t                   size;
+    size_t                   max_size;
+
+    nxt_time_t               valid;
+    nxt_time_t               stale;
+
+    nxt_msec_t               lock_timeout;
+};
+
+
+typedef struct nxt_http_cache_query_s  nxt_http_cache_query_t;
+typedef struct nxt_http_cache_entry_s  nxt_http_cache_entry_t;
+
+
+/* A request waiting for the response being received. */
+
+typedef struct {
+    nxt_queue_link_t         link;
+    nxt_http_cache_t         *cache;
+
+    /* The received response entry or NULL. */
+    nxt_http_cache_entry_t   *entry;
+
+    /* The request is NULL if it has been closed. */
+    nxt_http_request_t       *request;
+
+    nxt_event_engine_t       *engine;
+    nxt_work_t               work;
+    nxt_timer_t              timer;
+
+    uint8_t                  waiting;  /* 1 bit */
+} nxt_http_cache_waiter_t;
+
+
+struct nxt_http_cache_entry_s {
+    nxt_queue_link_t         link;
+    uint32_t                 count;
+
+    uint8_t                  updating;  /* 1 bit */
+    uint8_t                  deleted;   /* 1 bit */
+    uint8_t                  shared;    /* 1 bit */
+
+    nxt_http_status_t        status:16;
+
+    nxt_time_t               date;
+    nxt_time_t               valid;
+    nxt_time_t               stale;
+
+    size_t                   size;
+
+    /* The requests waiting for the response being received. */
+    nxt_queue_t              waiting;
+
+    nxt_uint_t               nfields;
+    nxt_http_field_t         *fields;
+
+    u_char                   *body;
+    size_t                   body_size;
+
+    nxt_str_t                key;
+};
+
+
+struct nxt_http_cache_query_s {
+    nxt_http_cache_t         *cache;
+
+    /* An entry being sent or being updated. */
+    nxt_http_cache_entry_t   *entry;
+
+    nxt_str_t                key;
+    uint32_t                 key_hash;
+
+    nxt_time_t               valid;
+    nxt_time_t               stale;
+
+    /*
+     * The response header fields being stored are copied, since the
+     * application response header buffer is released before the body.
+     */
+    nxt_http_field_t         *fields;
+    nxt_uint_t               nfields;
+    size_t                   fields_size;
+
+    /* A response body being stored. */
+    u_char                   *body;
+    size_t                   body_size;
+    size_t                   body_alloc;
+
+    /* A request waiting for the response of the updating request. */
+    nxt_http_cache_waiter_t  *waiter;
+
+    uint8_t                  head;           /* 1 bit */
+    uint8_t                  store;          /* 1 bit */
+    uint8_t                  updating;       /* 1 bit */
+    uint8_t                  authorization;  /* 1 bit */
+    uint8_t                  shared;         /* 1 bit */
+};
+
+
+static nxt_int_t nxt_http_cache_send(nxt_task_t *task, nxt_http_request_t *r,
+    nxt_http_cache_query_t *q);
+static void nxt_http_cache_send_body(nxt_task_t *task, void *obj, void *data);
+static nxt_bool_t nxt_http_cache_authorization(nxt_http_request_t *r);
+static nxt_http_cache_entry_t *nxt_http_cache_sentinel(nxt_http_cache_t *cache,
+    nxt_http_cache_query_t *q, nxt_queue_t *unused);
+static nxt_int_t nxt_http_cache_wait(nxt_task_t *task, nxt_http_request_t *r,
+    nxt_http_cache_entry_t *e);
+static void nxt_http_cache_wake_handler(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_http_cache_wait_timeout(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_http_cache_waiter_free(nxt_task_t *task,
+    nxt_http_cache_waiter_t *w);
+static void nxt_http_cache_waiter_free_handler(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_http_cache_waiting(nxt_http_cache_query_t *q,
+    nxt_http_cache_entry_t *e, nxt_queue_t *waiting);
+static void nxt_http_cache_wake(nxt_task_t *task, nxt_queue_t *waiting);
+static nxt_int_t nxt_http_cache_control(nxt_http_field_t *field,
+    nxt_time_t *max_age, nxt_time_t *stale, nxt_bool_t *shared);
+static nxt_time_t nxt_http_cache_seconds(u_char *p, u_char *end);
+static nxt_int_t nxt_http_cache_fields_copy(nxt_http_request_t *r,
+    nxt_http_cache_query_t *q);
+static void nxt_http_cache_store(nxt_task_t *task, nxt_http_request_t *r,
+    nxt_http_cache_query_t *q);
+static nxt_int_t nxt_http_cache_entry_insert(nxt_http_cache_t *cache,
+    nxt_http_cache_entry_t *e, uint32_t key_hash, nxt_queue_t *unused);
+static void nxt_http_cache_entry_delete(nxt_http_cache_t *cache,
+    nxt_http_cache_entry_t *e, nxt_queue_t *unused);
+static void nxt_http_cache_entries_free(nxt_queue_t *unused);
+static void nxt_http_cache_entry_release(nxt_http_cache_t *cache,
+    nxt_http_cache_entry_t *e);
+static void nxt_http_cache_update_cancel(nxt_task_t *task,
+    nxt_http_cache_query_t *q);
+static void nxt_http_cache_query_cleanup(nxt_task_t *task, void *obj,
+    void *data);
+static nxt_int_t nxt_http_cache_lvlhsh_test(nxt_lvlhsh_query_t *lhq,
+    void *data);
+
+
+static const nxt_http_request_state_t  nxt_http_cache_send_state;
+
+
+static const nxt_lvlhsh_proto_t  nxt_http_cache_proto  nxt_aligned(64) = {
+    NXT_LVLHSH_DEFAULT,
+    nxt_http_cache_lvlhsh_test,
+    nxt_lvlhsh_alloc,
+    nxt_lvlhsh_free,
+};
+
+
+nxt_http_cache_t *
+nxt_http_cache_create(size_t size, nxt_time_t valid, nxt_time_t stale,
+    nxt_msec_t lock_timeout)
+{
+    nxt_http_cache_t  *cache;
+
+    cache = nxt_zalloc(sizeof(nxt_http_cache_t));
+    if (nxt_slow_path(cache == NULL)) {
+        return NULL;
+    }
+
+    nxt_queue_init(&cache->entries);
+
+    cache->max_size = size;
+    cache->valid = valid;
+    cache->stale = stale;
+    cache->lock_timeout = lock_timeout;
+
+    return cache;
+}
+
+
+void
+nxt_http_cache_free(nxt_http_cache_t *cache)
+{
+    nxt_queue_t             unused;
+    nxt_http_cache_entry_t  *e;
+
+    if (cache == NULL) {
+        return;
+    }
+
+    nxt_queue_init(&unused);
+
+    while (!nxt_queue_is_empty(&cache->entries)) {
+        e = nxt_queue_link_data(nxt_queue_first(&cache->entries),
+                                nxt_http_cache_entry_t, link);
+
+        nxt_http_cache_entry_delete(cache, e, &unused);
+    }
+
+    nxt_http_cache_entries_free(&unused);
+
+    nxt_free(cache);
+}
+
+
+/*
+ * Returns NXT_DECLINED if the request should be passed to application,
+ * otherwise the cached response is being sent.
+ */
+
+nxt_int_t
+nxt_http_cache_handler(nxt_task_t *task, nxt_http_request_t *r,
+    nxt_http_cache_t *cache)
+{
+    u_char                  *p;
+    size_t                  length;
+    nxt_bool_t              head;
+    nxt_time_t              now;
+    nxt_queue_t             unused;
+    nxt_lvlhsh_query_t      lhq;
+    nxt_http_cache_entry_t  *e;
+    nxt_http_cache_query_t  *q;
+
+    static const nxt_str_t  get = nxt_string("GET");
+    static const nxt_str_t  head_method = nxt_string("HEAD");
+
+    if (r->method == NULL || r->target.length == 0) {
+        return NXT_DECLINED;
+    }
+
+    head = nxt_strstr_eq(r->method, &head_method);
+
+    if (!head && !nxt_strstr_eq(r->method, &get)) {
+        return NXT_DECLINED;
+    }
+
+    q = nxt_mp_zget(r->mem_pool, sizeof(nxt_http_cache_query_t));
+    if (nxt_slow_path(q == NULL)) {
+        return NXT_DECLINED;
+    }
+
+    /*
+     * The host is not validated and may contain "/", so its length
+     * precedes it in the key to separate the host from the target.
+     */
+
+    length = (r->host != NULL) ? r->host->value_length : 0;
+
+    p = nxt_mp_nget(r->mem_pool,
+                    NXT_SIZE_T_LEN + 1 + length + r->target.length);
+    if (nxt_slow_path(p == NULL)) {
+        return NXT_DECLINED;
+    }
+
+    q->key.start = p;
+
+    p = nxt_sprintf(p, p + NXT_SIZE_T_LEN + 1, "%uz:", length);
+
+    if (length != 0) {
+        p = nxt_cpymem(p, r->host->value, length);
+    }
+
+    p = nxt_cpymem(p, r->target.start, r->target.length);
+
+    q->key.length = p - q->key.start;
+    q->key_hash = nxt_djb_hash(q->key.start, q->key.length);
+
+    q->cache = cache;
+    q->head = head;
+    q->authorization = nxt_http_cache_authorization(r);
+
+    if (nxt_slow_path(nxt_mp_cleanup(r->mem_pool, nxt_http_cache_query_cleanup,
+                                     task, q, NULL)
+                      != NXT_OK))
+    {
+        return NXT_DECLINED;
+    }
+
+    r->cache = q;
+
+    lhq.key_hash = q->key_hash;
+    lhq.key = q->key;
+    lhq.proto = &nxt_http_cache_proto;
+    lhq.pool = NULL;
+
+    now = nxt_thread_time(task->thread);
+
+    nxt_queue_init(&unused);
+
+    nxt_thread_spin_lock(&cache->lock);
+
+    if (nxt_lvlhsh_find(&cache->hash, &lhq) == NXT_OK) {
+        e = lhq.value;
+
+        if (q->authorization && !e->shared) {
+            nxt_thread_spin_unlock(&cache->lock);
+
+            nxt_debug(task, "http cache authorization");
+
+            return NXT_DECLINED;
+        }
+
+        if (now < e->valid || (now < e->stale && e->updating)) {
+            e->count++;
+            q->entry = e;
+
+            nxt_queue_remove(&e->link);
+            nxt_queue_insert_tail(&cache->entries, &e->link);
+
+            nxt_thread_spin_unlock(&cache->lock);
+
+            nxt_debug(task, "http cache hit%s", (now < e->valid) ? ""
+                                                                 : " stale");
+
+            return nxt_http_cache_send(task, r, q);
+        }
+
+        if (e->updating) {
+
+            if (q->authorization) {
+                nxt_thread_spin_unlock(&cache->lock);
+
+                nxt_debug(task, "http cache authorization");
+
+                return NXT_DECLINED;
+            }
+
+            /* The request waits for the response being received. */
+
+            if (nxt_fast_path(nxt_http_cache_wait(task, r, e) == NXT_OK)) {
+                nxt_thread_spin_unlock(&cache->lock);
+
+                nxt_debug(task, "http cache wait");
+
+                return NXT_OK;
+            }
+
+            nxt_thread_spin_unlock(&cache->lock);
+
+            return NXT_DECLINED;
+        }
+
+        if (!head) {
+            /* The request updates the expired entry. */
+            e->updating = 1;
+            e->count++;
+            q->entry = e;
+            q->updating = 1;
+        }
+
+    } else if (!head) {
+        /*
+         * An empty expired entry holds the key whilst the response
+         * is received, so the same requests wait for the response.
+         */
+
+        e = nxt_http_cache_sentinel(cache, q, &unused);
+
+        if (nxt_fast_path(e != NULL)) {
+            e->updating = 1;
+            e->count++;
+            q->entry = e;
+            q->updating = 1;
+        }
+    }
+
+    nxt_thread_spin_unlock(&cache->lock);
+
+    nxt_http_cache_entries_free(&unused);
+
+    nxt_debug(task, "http cache miss");
+
+    /* A response to HEAD request has no body and is not cached. */
+    q->store = q->updating;
+
+    return NXT_DECLINED;
+}
+
+
+static nxt_bool_t
+nxt_http_cache_authorization(nxt_http_request_t *r)
+{
+    nxt_http_field_t  *field;
+
+    nxt_list_each(field, r->fields) {
+
+        if (field->name_length == 13
+            && nxt_strncasecmp(field->name, (u_char *) "Authorization", 13)
+               == 0)
+        {
+            return 1;
+        }
+
+    } nxt_list_loop;
+
+    return 0;
+}
+
+
+/* The function is called with the cache lock held. */
+
+static nxt_http_cache_entry_t *
+nxt_http_cache_sentinel(nxt_http_cache_t *cache, nxt_http_cache_query_t *q,
+    nxt_queue_t *unused)
+{
+    size_t                  size;
+    nxt_http_cache_entry_t  *e;
+
+    size = sizeof(nxt_http_cache_entry_t) + q->key.length;
+
+    e = nxt_zalloc(size);
+    if (nxt_slow_path(e == NULL)) {
+        return NULL;
+    }
+
+    e->count = 1;
+    e->size = size;
+
+    nxt_queue_init(&e->waiting);
+
+    e->key.start = nxt_pointer_to(e, sizeof(nxt_http_cache_entry_t));
+    e->key.length = q->key.length;
+    nxt_memcpy(e->key.start, q->key.start, q->key.length);
+
+    if (nxt_slow_path(nxt_http_cache_entry_insert(cache, e, q->key_hash,
+                                                  unused)
+                      != NXT_OK))
+    {
+        nxt_free(e);
+        return NULL;
+    }
+
+    return e;
+}
+
+
+/* The function is called with the cache lock held. */
+
+static nxt_int_t
+nxt_http_cache_wait(nxt_task_t *task, nxt_http_request_t *r,
+    nxt_http_cache_entry_t *e)
+{
+    nxt_event_engine_t       *engine;
+    nxt_http_cache_query_t   *q;
+    nxt_http_cache_waiter_t  *w;
+
+    q = r->cache;
+
+    w = nxt_zalloc(sizeof(nxt_http_cache_waiter_t));
+    if (nxt_slow_path(w == NULL)) {
+        return NXT_ERROR;
+    }
+
+    engine = task->thread->engine;
+
+    w->cache = q->cache;
+    w->request = r;
+    w->engine = engine;
+    w->waiting = 1;
+
+    w->work.handler = nxt_http_cache_wake_handler;
+    w->work.task = task;
+    w->work.obj = w;
+
+    w->timer.task = &engine->task;
+    w->timer.work_queue = &engine->fast_work_queue;
+    w->timer.log = engine->task.log;
+    w->timer.precision = NXT_TIMER_DEFAULT_PRECISION;
+    w->timer.handler = nxt_http_cache_wait_timeout;
+
+    nxt_queue_insert_tail(&e->waiting, &w->link);
+
+    q->waiter = w;
+
+    if (q->cache->lock_timeout != 0) {
+        nxt_timer_add(engine, &w->timer, q->cache->lock_timeout);
+    }
+
+    return NXT_OK;
+}
+
+
+static void
+nxt_http_cache_wake_handler(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_http_request_t       *r;
+    nxt_http_cache_entry_t   *e;
+    nxt_http_cache_query_t   *q;
+    nxt_http_cache_waiter_t  *w;
+
+    w = obj;
+    r = w->request;
+    e = w->entry;
+
+    if (r == NULL) {
+        nxt_debug(task, "http cache wake closed");
+
+        if (e != NULL) {
+            nxt_http_cache_entry_release(w->cache, e);
+        }
+
+        nxt_http_cache_waiter_free(task, w);
+        return;
+    }
+
+    q = r->cache;
+    q->waiter = NULL;
+    q->entry = e;
+
+    nxt_http_cache_waiter_free(task, w);
+
+    if (e != NULL) {
+        nxt_debug(task, "http cache wake hit");
+
+        (void) nxt_http_cache_send(task, r, q);
+        return;
+    }
+
+    nxt_debug(task, "http cache wake miss");
+
+    nxt_http_app_request(task, r);
+}
+
+
+static void
+nxt_http_cache_wait_timeout(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_bool_t               waiting;
+    nxt_timer_t              *timer;
+    nxt_http_cache_t         *cache;
+    nxt_http_request_t       *r;
+    nxt_http_cache_waiter_t  *w;
+
+    timer = obj;
+
+    w = nxt_timer_data(timer, nxt_http_cache_waiter_t, timer);
+    cache = w->cache;
+
+    nxt_thread_spin_lock(&cache->lock);
+
+    waiting = w->waiting;
+
+    if (waiting) {
+        nxt_queue_remove(&w->link);
+        w->waiting = 0;
+    }
+
+    nxt_thread_spin_unlock(&cache->lock);
+
+    if (!waiting) {
+        /* The waiter has been already posted to the engine. */
+        return;
+    }
+
+    nxt_debug(task, "http cache wait timed out");
+
+    r = w->request;
+
+    ((nxt_http_cache_query_t *) r->cache)->waiter = NULL;
+
+    nxt_http_cache_waiter_free(task, w);
+
+    nxt_http_app_request(task, r);
+}
+
+
+static void
+nxt_http_cache_waiter_free(nxt_task_t *task, nxt_http_cache_waiter_t *w)
+{
+    nxt_event_engine_t  *engine;
+
+    engine = w->engine;
+
+    /* The timer may be still in the engine timer changes. */
+
+    if (nxt_timer_delete(engine, &w->timer)) {
+        w->timer.handler = nxt_http_cache_waiter_free_handler;
+        nxt_timer_add(engine, &w->timer, 0);
+        return;
+    }
+
+    nxt_free(w);
+}
+
+
+static void
+nxt_http_cache_waiter_free_handler(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_timer_t  *timer;
+
+    timer = obj;
+
+    nxt_free(nxt_timer_data(timer, nxt_http_cache_waiter_t, timer));
+}
+
+
+/* The function is called with the cache lock held. */
+
+static void
+nxt_http_cache_waiting(nxt_http_cache_query_t *q, nxt_http_cache_entry_t *e,
+    nxt_queue_t *waiting)
+{
+    nxt_queue_link_t         *link;
+    nxt_http_cache_waiter_t  *w;
+
+    nxt_queue_init(waiting);
+
+    while (!nxt_queue_is_empty(&q->entry->waiting)) {
+        link = nxt_queue_first(&q->entry->waiting);
+        nxt_queue_remove(link);
+        nxt_queue_insert_tail(waiting, link);
+
+        w = nxt_queue_link_data(link, nxt_http_cache_waiter_t, link);
+
+        w->waiting = 0;
+        w->entry = e;
+
+        if (e != NULL) {
+            e->count++;
+        }
+    }
+
+    q->entry->updating = 0;
+    q->updating = 0;
+}
+
+
+static void
+nxt_http_cache_wake(nxt_task_t *task, nxt_queue_t *waiting)
+{
+    nxt_http_cache_waiter_t  *w;
+
+    /* A waiter may be freed by its engine as soon as it has been posted. */
+
+    nxt_queue_each(w, waiting, nxt_http_cache_waiter_t, link) {
+
+        if (w->engine == task->thread->engine) {
+            nxt_work_queue_add(&w->engine->fast_work_queue, w->work.handler,
+                               w->work.task, w->work.obj, w->work.data);
+
+        } else {
+            w->work.next = NULL;
+            nxt_event_engine_post(w->engine, &w->work);
+        }
+
+    } nxt_queue_loop;
+}
+
+
+static nxt_int_t
+nxt_http_cache_send(nxt_task_t *task, nxt_http_request_t *r,
+    nxt_http_cache_query_t *q)
+{
+    u_char                  *p;
+    nxt_uint_t              i;
+    nxt_time_t              now;
+    nxt_http_field_t        *field;
+    nxt_http_cache_entry_t  *e;
+
+    e = q->entry;
+
+    for (i = 0; i < e->nfields; i++) {
+        field = nxt_list_add(r->resp.fields);
+        if (nxt_slow_path(field == NULL)) {
+            goto fail;
+        }
+
+        *field = e->fields[i];
+    }
+
+    field = nxt_list_zero_add(r->resp.fields);
+    if (nxt_slow_path(field == NULL)) {
+        goto fail;
+    }
+
+    p = nxt_mp_nget(r->mem_pool, NXT_TIME_T_LEN);
+    if (nxt_slow_path(p == NULL)) {
+        goto fail;
+    }
+
+    now = nxt_thread_time(task->thread);
+
+    nxt_http_field_name_set(field, "Age");
+    field->value = p;
+    p = nxt_sprintf(p, p + NXT_TIME_T_LEN, "%T", nxt_max(now - e->date, 0));
+    field->value_length = p - field->value;
+
+    r->status = e->status;
+    r->resp.content_length = NULL;
+    r->resp.content_length_n = e->body_size;
+
+    r->state = &nxt_http_cache_send_state;
+
+    nxt_http_request_header_send(task, r);
+
+    return NXT_OK;
+
+fail:
+
+    nxt_http_request_error(task, r, NXT_HTTP_INTERNAL_SERVER_ERROR);
+
+    return NXT_OK;
+}
+
+
+static const nxt_http_request_state_t  nxt_http_cache_send_state
+    nxt_aligned(64) =
+{
+    .ready_handler = nxt_http_cache_send_body,
+    .error_handler = nxt_http_request_close_handler,
+};
+
+
+static void
+nxt_http_cache_send_body(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_buf_t               *out, *last;
+    nxt_http_request_t      *r;
+    nxt_http_cache_entry_t  *e;
+    nxt_http_cache_query_t  *q;
+
+    r = obj;
+    q = r->cache;
+    e = q->entry;
+
+    nxt_debug(task, "http cache send body");
+
+    last = nxt_http_request_last_buffer(task, r);
+    if (nxt_slow_path(last == NULL)) {
+        return;
+    }
+
+    out = last;
+
+    if (!q->head && e->body_size != 0) {
+        out = nxt_buf_mem_alloc(r->mem_pool, 0, 0);
+        if (nxt_slow_path(out == NULL)) {
+            nxt_http_request_release(task, r);
+            return;
+        }
+
+        /* The entry is held until the request is released. */
+
+        out->mem.start = e->body;
+        out->mem.pos = e->body;
+        out->mem.free = e->body + e->body_size;
+        out->mem.end = out->mem.free;
+        out->next = last;
+    }
+
+    nxt_http_request_send(task, r, out);
+}
+
+
+/*
+ * The function is called by router after the application response header
+ * has been processed and tests if the response can be cached.
+ */
+
+void
+nxt_http_cache_response(nxt_task_t *task, nxt_http_request_t *r)
+{
+    size_t                  size;
+    nxt_off_t               length;
+    nxt_bool_t              shared;
+    nxt_time_t              now, max_age, stale, expires;
+    nxt_http_field_t        *field;
+    nxt_http_cache_t        *cache;
+    nxt_http_cache_query_t  *q;
+
+    q = r->cache;
+
+    if (q == NULL || !q->store) {
+        return;
+    }
+
+    switch (r->status) {
+
+    case NXT_HTTP_OK:
+    case NXT_HTTP_MULTIPLE_CHOICES:
+    case NXT_HTTP_MOVED_PERMANENTLY:
+    case NXT_HTTP_NOT_FOUND:
+        break;
+
+    default:
+        goto cancel;
+    }
+
+    cache = q->cache;
+
+    max_age = -1;
+    stale = -1;
+    expires = -1;
+    shared = 0;
+
+    nxt_list_each(field, r->resp.fields) {
+
+        if (field->skip) {
+            continue;
+        }
+
+        switch (field->name_length) {
+
+        case 4:
+            if (nxt_strncasecmp(field->name, (u_char *) "Vary", 4) == 0) {
+                goto cancel;
+            }
+
+            break;
+
+        case 7:
+            if (nxt_strncasecmp(field->name, (u_char *) "Expires", 7) == 0) {
+                /* An invalid date means the response has expired. */
+                expires = nxt_time_parse(field->value, field->value_length);
+                expires = nxt_max(expires, 0);
+            }
+
+            break;
+
+        case 10:
+            if (nxt_strncasecmp(field->name, (u_char *) "Set-Cookie", 10)
+                == 0)
+            {
+                goto cancel;
+            }
+
+            break;
+
+        case 13:
+            if (nxt_strncasecmp(field->name, (u_char *) "Cache-Control", 13)
+                == 0
+                && nxt_http_cache_control(field, &max_age, &stale, &shared)
+                   != NXT_OK)
+            {
+                goto cancel;
+            }
+
+            break;
+        }
+
+    } nxt_list_loop;
+
+    if (q->authorization && !shared) {
+        goto cancel;
+    }
+
+    now = nxt_thread_time(task->thread);
+
+    if (max_age < 0) {
+        if (expires >= 0) {
+            max_age = expires - now;
+
+        } else {
+            max_age = cache->valid;
+        }
+    }
+
+    /* An expired response is only sent to the waiting requests. */
+    max_age = nxt_max(max_age, 0);
+
+    if (stale < 0) {
+        stale = cache->stale;
+    }
+
+    size = cache->max_size / NXT_HTTP_CACHE_ENTRY_RATIO;
+    length = r->resp.content_length_n;
+
+    if (r->resp.content_length != NULL) {
+        length = nxt_off_t_parse(r->resp.content_length->value,
+                                 r->resp.content_length->value_length);
+    }
+
+    if (length > (nxt_off_t) size
+        || nxt_slow_path(nxt_http_cache_fields_copy(r, q) != NXT_OK))
+    {
+        goto cancel;
+    }
+
+    q->valid = now + max_age;
+    q->stale = q->valid + stale;
+    q->shared = shared;
+
+    q->body_alloc = (length > 0) ? (size_t) length : NXT_HTTP_CACHE_BODY_SIZE;
+
+    nxt_debug(task, "http cache store valid:%T stale:%T", max_age, stale);
+
+    return;
+
+cancel:
+
+    nxt_http_cache_update_cancel(task, q);
+}
+
+
+static nxt_int_t
+nxt_http_cache_control(nxt_http_field_t *field, nxt_time_t *max_age,
+    nxt_time_t *stale, nxt_bool_t *shared)
+{
+    u_char      *p, *start, *end, *value;
+    size_t      length;
+    nxt_time_t  n;
+    nxt_bool_t  s_maxage;
+
+    s_maxage = 0;
+    p = field->value;
+    end = p + field->value_length;
+
+    while (p < end) {
+
+        while (p < end && (*p == ' ' || *p == '\t' || *p == ',')) {
+            p++;
+        }
+
+        start = p;
+
+        while (p < end && *p != ',') {
+            p++;
+        }
+
+        length = p - start;
+
+        while (length != 0
+               && (start[length - 1] == ' ' || start[length - 1] == '\t'))
+        {
+            length--;
+        }
+
+        if (length == 0) {
+            continue;
+        }
+
+        value = nxt_memchr(start, '=', length);
+
+        if (value == NULL) {
+            if ((length == 8
+                 && (nxt_strncasecmp(start, (u_char *) "no-store", 8) == 0
+                     || nxt_strncasecmp(start, (u_char *) "no-cache", 8) == 0))
+                || (length == 7
+                    && nxt_strncasecmp(start, (u_char *) "private", 7) == 0))
+            {
+                return NXT_DECLINED;
+            }
+
+            if ((length == 6
+                 && nxt_strncasecmp(start, (u_char *) "public", 6) == 0)
+                || (length == 15
+                    && nxt_strncasecmp(start, (u_char *) "must-revalidate",
+                                       15)
+                       == 0))
+            {
+                *shared = 1;
+            }
+
+            continue;
+        }
+
+        n = nxt_http_cache_seconds(value + 1, start + length);
+
+        length = value - start;
+
+        if (length == 8
+            && nxt_strncasecmp(start, (u_char *) "s-maxage", 8) == 0)
+        {
+            if (n < 0) {
+                return NXT_DECLINED;
+            }
+
+            *max_age = n;
+            *shared = 1;
+            s_maxage = 1;
+
+        } else if (length == 7
+                   && nxt_strncasecmp(start, (u_char *) "max-age", 7) == 0)
+        {
+            if (n < 0) {
+                return NXT_DECLINED;
+            }
+
+            if (!s_maxage) {
+                *max_age = n;
+            }
+
+        } else if (length == 22
+                   && nxt_strncasecmp(start,
+                                      (u_char *) "stale-while-revalidate", 22)
+                      == 0)
+        {
+            *stale = nxt_max(n, 0);
+
+        } else if (length == 7
+                   && nxt_strncasecmp(start, (u_char *) "private", 7) == 0)
+        {
+            /* "private" with field names. */
+            return NXT_DECLINED;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_time_t
+nxt_http_cache_seconds(u_char *p, u_char *end)
+{
+    if (p < end && *p == '"' && end[-1] == '"' && end - p >= 2) {
+        p++;
+        end--;
+    }
+
+    if (p == end) {
+        return -1;
+    }
+
+    return nxt_int_parse(p, end - p);
+}
+
+
+static nxt_int_t
+nxt_http_cache_fields_copy(nxt_http_request_t *r, nxt_http_cache_query_t *q)
+{
+    u_char            *p;
+    size_t            size;
+    nxt_uint_t        n;
+    nxt_http_field_t  *field, *f;
+
+    n = 0;
+    size = 0;
+
+    /* "Date" and "Content-Length" are set on sending. */
+
+    nxt_list_each(field, r->resp.fields) {
+
+        if (field->skip || field == r->resp.date
+            || field == r->resp.content_length)
+        {
+            continue;
+        }
+
+        n++;
+        size += field->name_length + field->value_length;
+
+    } nxt_list_loop;
+
+    f = nxt_mp_alloc(r->mem_pool, n * sizeof(nxt_http_field_t) + size);
+    if (nxt_slow_path(f == NULL)) {
+        return NXT_ERROR;
+    }
+
+    q->fields = f;
+    q->nfields = n;
+    q->fields_size = size;
+
+    p = (u_char *) &f[n];
+
+    nxt_list_each(field, r->resp.fields) {
+
+        if (field->skip || field == r->resp.date
+            || field == r->resp.content_length)
+        {
+            continue;
+        }
+
+        *f = *field;
+
+        f->name = p;
+        p = nxt_cpymem(p, field->name, field->name_length);
+
+        f->value = p;
+        p = nxt_cpymem(p, field->value, field->value_length);
+
+        f++;
+
+    } nxt_list_loop;
+
+    return NXT_OK;
+}
+
+
+/*
+ * The function is called by router for response body buffers
+ * before they are sent or saved to a temporary file.
+ */
+
+void
+nxt_http_cache_body(nxt_task_t *task, nxt_http_request_t *r, nxt_buf_t *b,
+    nxt_bool_t last)
+{
+    u_char                  *p;
+    size_t                  size, max_size;
+    nxt_http_cache_query_t  *q;
+
+    q = r->cache;
+
+    if (q == NULL || !q->store) {
+        return;
+    }
+
+    max_size = q->cache->max_size / NXT_HTTP_CACHE_ENTRY_RATIO;
+
+    for ( /* void */ ; b != NULL; b = b->next) {
+
+        if (nxt_buf_is_sync(b) || !nxt_buf_is_mem(b)) {
+            continue;
+        }
+
+        size = nxt_buf_mem_used_size(&b->mem);
+
+        if (size == 0) {
+            continue;
+        }
+
+        if (q->body_size + size > max_size) {
+            goto cancel;
+        }
+
+        if (q->body == NULL || q->body_size + size > q->body_alloc) {
+            q->body_alloc = nxt_max(q->body_alloc, q->body_size + size);
+
+            if (q->body != NULL) {
+                q->body_alloc = nxt_min(q->body_alloc * 2, max_size);
+            }
+
+            p = nxt_realloc(q->body, q->body_alloc);
+            if (nxt_slow_path(p == NULL)) {
+                goto cancel;
+            }
+
+            q->body = p;
+        }
+
+        nxt_memcpy(q->body + q->body_size, b->mem.pos, size);
+        q->body_size += size;
+    }
+
+    if (last) {
+        nxt_http_cache_store(task, r, q);
+    }
+
+    return;
+
+cancel:
+
+    nxt_debug(task, "http cache store cancelled");
+
+    nxt_http_cache_update_cancel(task, q);
+}
+
+
+static void
+nxt_http_cache_store(nxt_task_t *task, nxt_http_request_t *r,
+    nxt_http_cache_query_t *q)
+{
+    u_char                  *p;
+    size_t                  size;
+    nxt_uint_t              i;
+    nxt_queue_t             unused, waiting;
+    nxt_http_field_t        *f;
+    nxt_http_cache_t        *cache;
+    nxt_http_cache_entry_t  *e;
+
+    q->store = 0;
+    cache = q->cache;
+
+    size = sizeof(nxt_http_cache_entry_t)
+           + q->nfields * sizeof(nxt_http_field_t) + q->fields_size
+           + q->key.length + q->body_size;
+
+    e = (size <= cache->max_size) ? nxt_malloc(size) : NULL;
+
+    if (nxt_slow_path(e == NULL)) {
+        nxt_http_cache_update_cancel(task, q);
+        return;
+    }
+
+    nxt_memzero(e, sizeof(nxt_http_cache_entry_t));
+
+    nxt_queue_init(&e->waiting);
+
+    e->count = 1;
+    e->status = r->status;
+    e->date = nxt_thread_time(task->thread);
+    e->valid = q->valid;
+    e->stale = q->stale;
+    e->shared = q->shared;
+    e->size = size;
+    e->nfields = q->nfields;
+
+    e->fields = nxt_pointer_to(e, sizeof(nxt_http_cache_entry_t));
+    p = (u_char *) &e->fields[q->nfields];
+
+    for (i = 0; i < q->nfields; i++) {
+        f = &e->fields[i];
+        *f = q->fields[i];
+
+        f->name = p;
+        p = nxt_cpymem(p, q->fields[i].name, f->name_length);
+
+        f->value = p;
+        p = nxt_cpymem(p, q->fields[i].value, f->value_length);
+    }
+
+    e->key.start = p;
+    e->key.length = q->key.length;
+    p = nxt_cpymem(p, q->key.start, q->key.length);
+
+    e->body = p;
+    e->body_size = q->body_size;
+
+    if (q->body_size != 0) {
+        nxt_memcpy(p, q->body, q->body_size);
+    }
+
+    nxt_queue_init(&unused);
+
+    nxt_thread_spin_lock(&cache->lock);
+
+    if (q->valid > e->date
+        && nxt_http_cache_entry_insert(cache, e, q->key_hash, &unused)
+           == NXT_OK)
+    {
+        nxt_debug(task, "http cache stored \"%V\" %uz", &e->key,
+                  e->body_size);
+
+    } else {
+        /* The response is only sent to the waiting requests. */
+        e->deleted = 1;
+        e->count--;
+    }
+
+    nxt_http_cache_waiting(q, e, &waiting);
+
+    if (e->count == 0) {
+        nxt_queue_insert_tail(&unused, &e->link);
+    }
+
+    nxt_thread_spin_unlock(&cache->lock);
+
+    nxt_http_cache_entries_free(&unused);
+
+    nxt_http_cache_wake(task, &waiting);
+}
+
+
+/* The function is called with the cache lock held. */
+
+static nxt_int_t
+nxt_http_cache_entry_insert(nxt_http_cache_t *cache, nxt_http_cache_entry_t *e,
+    uint32_t key_hash, nxt_queue_t *unused)
+{
+    nxt_lvlhsh_query_t      lhq;
+    nxt_http_cache_entry_t  *old;
+
+    lhq.key_hash = key_hash;
+    lhq.key = e->key;
+    lhq.replace = 1;
+    lhq.value = e;
+    lhq.proto = &nxt_http_cache_proto;
+    lhq.pool = NULL;
+
+    if (nxt_slow_path(nxt_lvlhsh_insert(&cache->hash, &lhq) != NXT_OK)) {
+        return NXT_ERROR;
+    }
+
+    old = lhq.value;
+
+    if (old != e) {
+        /* The replaced entry has been already removed from the hash. */
+        old->deleted = 1;
+
+        nxt_queue_remove(&old->link);
+        cache->size -= old->size;
+
+        if (--old->count == 0) {
+            nxt_queue_insert_tail(unused, &old->link);
+        }
+    }
+
+    while (cache->size + e->size > cache->max_size) {
+        old = nxt_queue_link_data(nxt_queue_first(&cache->entries),
+                                  nxt_http_cache_entry_t, link);
+
+        nxt_http_cache_entry_delete(cache, old, unused);
+    }
+
+    nxt_queue_insert_tail(&cache->entries, &e->link);
+    cache->size += e->size;
+
+    return NXT_OK;
+}
+
+
+/* The function is called with the cache lock held. */
+
+static void
+nxt_http_cache_entry_delete(nxt_http_cache_t *cache, nxt_http_cache_entry_t *e,
+    nxt_queue_t *unused)
+{
+    nxt_lvlhsh_query_t  lhq;
+
+    lhq.key = e->key;
+    lhq.key_hash = nxt_djb_hash(lhq.key.start, lhq.key.length);
+    lhq.proto = &nxt_http_cache_proto;
+    lhq.pool = NULL;
+
+    (void) nxt_lvlhsh_delete(&cache->hash, &lhq);
+
+    e->deleted = 1;
+
+    nxt_queue_remove(&e->link);
+    cache->size -= e->size;
+
+    if (--e->count == 0) {
+        nxt_queue_insert_tail(unused, &e->link);
+    }
+}
+
+
+static void
+nxt_http_cache_entries_free(nxt_queue_t *unused)
+{
+    nxt_queue_link_t  *link;
+
+    while (!nxt_queue_is_empty(unused)) {
+        link = nxt_queue_first(unused);
+        nxt_queue_remove(link);
+
+        nxt_free(nxt_queue_link_data(link, nxt_http_cache_entry_t, link));
+    }
+}
+
+
+static void
+nxt_http_cache_entry_release(nxt_http_cache_t *cache, nxt_http_cache_entry_t *e)
+{
+    nxt_bool_t  unused;
+
+    nxt_thread_spin_lock(&cache->lock);
+
+    unused = (--e->count == 0);
+
+    nxt_thread_spin_unlock(&cache->lock);
+
+    if (unused) {
+        nxt_free(e);
+    }
+}
+
+
+/*
+ * The response is not stored, so the waiting requests are passed
+ * to application and the next request will update the entry.
+ */
+
+static void
+nxt_http_cache_update_cancel(nxt_task_t *task, nxt_http_cache_query_t *q)
+{
+    nxt_queue_t       waiting;
+    nxt_http_cache_t  *cache;
+
+    q->store = 0;
+
+    if (!q->updating) {
+        return;
+    }
+
+    cache = q->cache;
+
+    nxt_thread_spin_lock(&cache->lock);
+
+    nxt_http_cache_waiting(q, NULL, &waiting);
+
+    nxt_thread_spin_unlock(&cache->lock);
+
+    nxt_http_cache_wake(task, &waiting);
+}
+
+
+static void
+nxt_http_cache_query_cleanup(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_bool_t               waiting;
+    nxt_http_cache_t         *cache;
+    nxt_http_cache_query_t   *q;
+    nxt_http_cache_waiter_t  *w;
+
+    q = obj;
+    cache = q->cache;
+
+    if (q->body != NULL) {
+        nxt_free(q->body);
+    }
+
+    w = q->waiter;
+
+    if (w != NULL) {
+        /* The request has been closed while waiting. */
+
+        nxt_thread_spin_lock(&cache->lock);
+
+        waiting = w->waiting;
+
+        if (waiting) {
+            nxt_queue_remove(&w->link);
+            w->waiting = 0;
+        }
+
+        nxt_thread_spin_unlock(&cache->lock);
+
+        if (waiting) {
+            nxt_http_cache_waiter_free(task, w);
+
+        } else {
+            /* The posted waiter releases the entry and frees itself. */
+            w->request = NULL;
+        }
+
+        return;
+    }
+
+    if (q->entry == NULL) {
+        return;
+    }
+
+    nxt_http_cache_update_cancel(task, q);
+
+    nxt_http_cache_entry_release(cache, q->entry);
+}
+
+
+static nxt_int_t
+nxt_http_cache_lvlhsh_test(nxt_lvlhsh_query_t *lhq, void *data)
+{
+    nxt_http_cache_entry_t  *e;
+
+    e = data;
+
+    if (nxt_strstr_eq(&lhq->key, &e->key)) {
+        return NXT_OK;
+    }
+
+    return NXT_DECLINED;
+}
@@ -16,6 +16,12 @@ static nxt_int_t nxt_http_parse_field_name(nxt_http_request_parse_t *rp,
 static nxt_int_t nxt_http_parse_field_value(nxt_http_request_parse_t *rp,
     u_char **pos, u_char *end);
 static u_char *nxt_http_lookup_field_end(u_char *p, u_char *end);
+#if (NXT_HAVE_X86_SIMD)
+static u_char *nxt_http_lookup_field_name_sse42(u_char *p, u_char *end);
+static u_char *nxt_http_lookup_field_end_sse42(u_char *p, u_char *end);
+static u_char *nxt_http_lookup_field_name_avx2(u_char *p, u_char *end);
+static u_char *nxt_http_lookup_field_end_avx2(u_char *p, u_char *end);
+#endif
 static nxt_int_t nxt_http_parse_field_end(nxt_http_request_parse_t *rp,
     u_char **pos, u_char *end);
 
@@ -34,9 +40,27 @@ static nxt_int_t nxt_http_field_hash_collision(nxt_lvlhsh_query_t *lhq,
 
 #define NXT_HTTP_FIELD_LVLHSH_SHIFT     5
 
-#define NXT_HTTP_FIELD_HASH_INIT        159406
-#define nxt_http_field_hash_char(h, c)  (((h) << 4) + (h) + (c))
-#define nxt_http_field_hash_end(h)      (((h) >> 16) ^ (h))
+#define NXT_HTTP_FIELDS_HASH_MAX_BITS   12
+
+
+typedef struct {
+    /* Skips token characters, NULL if the scalar loop is faster. */
+    u_char                    *(*field_name)(u_char *p, u_char *end);
+    /* Finds the first control character. */
+    u_char                    *(*field_end)(u_char *p, u_char *end);
+} nxt_http_lookup_t;
+
+
+static const nxt_http_lookup_t  nxt_http_lookup[] = {
+    { NULL, nxt_http_lookup_field_end },
+#if (NXT_HAVE_X86_SIMD)
+    { nxt_http_lookup_field_name_sse42, nxt_http_lookup_field_end_sse42 },
+    { nxt_http_lookup_field_name_avx2, nxt_http_lookup_field_end_avx2 },
+#endif
+};
+
+
+static const nxt_http_lookup_t  *nxt_http_lookup_handlers = &nxt_http_lookup[0];
 
 
 typedef enum {
@@ -506,7 +530,7 @@ static nxt_int_t
 nxt_http_parse_field_name(nxt_http_request_parse_t *rp, u_char **pos,
     u_char *end)
 {
-    u_char    *p, c;
+    u_char    *p, *e, c;
     size_t    len;
     uint32_t  hash;
 
@@ -526,6 +550,17 @@ nxt_http_parse_field_name(nxt_http_request_parse_t *rp, u_char **pos,
     p = *pos + rp->field_name.length;
     hash = rp->field_hash;
 
+    if (nxt_http_lookup_handlers->field_name != NULL) {
+        e = nxt_http_lookup_handlers->field_name(p, end);
+
+        /* All bytes before "e" are valid token characters. */
+
+        while (p != e) {
+            hash = nxt_http_field_hash_char(hash, normal[*p]);
+            p++;
+        }
+    }
+
     while (nxt_fast_path(end - p >= 8)) {
 
 #define nxt_field_name_test_char(ch)                                          \
@@ -629,7 +664,7 @@ nxt_http_parse_field_value(nxt_http_request_parse_t *rp, u_char **pos,
 
     p += rp->field_value.length;
 
-    p = nxt_http_lookup_field_end(p, end);
+    p = nxt_http_lookup_handlers->field_end(p, end);
 
     if (nxt_slow_path(p == end)) {
         len = p - *pos;
@@ -736,6 +771,171 @@ nxt_http_lookup_field_end(u_char *p, u_char *end)
 }
 
 
+#if (NXT_HAVE_X86_SIMD)
+
+/*
+ * The vector lookups stop where less than a vector of data is left
+ * and the rest is scanned by the scalar code.
+ */
+
+__attribute__((target("sse4.2")))
+static u_char *
+nxt_http_lookup_field_name_sse42(u_char *p, u_char *end)
+{
+    int      n;
+    __m128i  token, x;
+
+    token = _mm_setr_epi8('-', '-', '0', '9', 'A', 'Z', '_', '_', 'a', 'z',
+                          0, 0, 0, 0, 0, 0);
+
+    while (nxt_fast_path(end - p >= 16)) {
+        x = _mm_loadu_si128((__m128i *) p);
+
+        n = _mm_cmpestri(token, 10, x, 16,
+                         _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES
+                         | _SIDD_NEGATIVE_POLARITY | _SIDD_LEAST_SIGNIFICANT);
+
+        if (n != 16) {
+            return p + n;
+        }
+
+        p += 16;
+    }
+
+    return p;
+}
+
+
+__attribute__((target("sse4.2")))
+static u_char *
+nxt_http_lookup_field_end_sse42(u_char *p, u_char *end)
+{
+    int      m;
+    __m128i  ctrl, x;
+
+    ctrl = _mm_set1_epi8(0x0f);
+
+    while (nxt_fast_path(end - p >= 16)) {
+        x = _mm_loadu_si128((__m128i *) p);
+
+        /* Bytes less than 0x10 are equal to min(byte, 0x0f). */
+        m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(x, ctrl), x));
+
+        if (m != 0) {
+            return p + __builtin_ctz(m);
+        }
+
+        p += 16;
+    }
+
+    return nxt_http_lookup_field_end(p, end);
+}
+
+
+__attribute__((target("avx2")))
+static u_char *
+nxt_http_lookup_field_name_avx2(u_char *p, u_char *end)
+{
+    uint32_t  m;
+    __m256i   x, d, l, t, digit, digits, alpha, alphas, lower, dash, under;
+
+    digit = _mm256_set1_epi8('0');
+    digits = _mm256_set1_epi8(9);
+    alpha = _mm256_set1_epi8('a');
+    alphas = _mm256_set1_epi8('z' - 'a');
+    lower = _mm256_set1_epi8(0x20);
+    dash = _mm256_set1_epi8('-');
+    under = _mm256_set1_epi8('_');
+
+    while (nxt_fast_path(end - p >= 32)) {
+        x = _mm256_loadu_si256((__m256i *) p);
+
+        /* Unsigned "x - lo <= hi - lo" range checks. */
+
+        d = _mm256_sub_epi8(x, digit);
+        t = _mm256_cmpeq_epi8(_mm256_min_epu8(d, digits), d);
+
+        l = _mm256_sub_epi8(_mm256_or_si256(x, lower), alpha);
+        t = _mm256_or_si256(t, _mm256_cmpeq_epi8(_mm256_min_epu8(l, alphas),
+                                                 l));
+
+        t = _mm256_or_si256(t, _mm256_cmpeq_epi8(x, dash));
+        t = _mm256_or_si256(t, _mm256_cmpeq_epi8(x, under));
+
+        m = ~(uint32_t) _mm256_movemask_epi8(t);
+
+        if (m != 0) {
+            return p + __builtin_ctz(m);
+        }
+
+        p += 32;
+    }
+
+    return p;
+}
+
+
+__attribute__((target("avx2")))
+static u_char *
+nxt_http_lookup_field_end_avx2(u_char *p, u_char *end)
+{
+    uint32_t  m;
+    __m256i   ctrl, x;
+
+    ctrl = _mm256_set1_epi8(0x0f);
+
+    while (nxt_fast_path(end - p >= 32)) {
+        x = _mm256_loadu_si256((__m256i *) p);
+
+        m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(x, ctrl),
+                                                   x));
+        if (m != 0) {
+            return p + __builtin_ctz(m);
+        }
+
+        p += 32;
+    }
+
+    return nxt_http_lookup_field_end_sse42(p, end);
+}
+
+#endif
+
+
+nxt_http_parse_simd_t
+nxt_http_parse_simd_detect(void)
+{
+#if (NXT_HAVE_X86_SIMD)
+
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+        return NXT_HTTP_PARSE_SIMD_AVX2;
+    }
+
+    if (__builtin_cpu_supports("sse4.2")) {
+        return NXT_HTTP_PARSE_SIMD_SSE42;
+    }
+
+#endif
+
+    return NXT_HTTP_PARSE_SIMD_NONE;
+}
+
+
+nxt_int_t
+nxt_http_parse_simd_set(nxt_http_parse_simd_t simd)
+{
+    if (simd > nxt_http_parse_simd_detect()) {
+        return NXT_DECLINED;
+    }
+
+    nxt_http_lookup_handlers = &nxt_http_lookup[simd];
+
+    return NXT_OK;
+}
+
+
 static nxt_int_t
 nxt_http_parse_field_end(nxt_http_request_parse_t *rp, u_char **pos,
     u_char *end)
@@ -1138,19 +1338,21 @@ nxt_http_field_hash_collision(nxt_lvlhsh_query_t *lhq, void *data)
 
 
 nxt_int_t
-nxt_http_fields_hash(nxt_lvlhsh_t *hash, nxt_mp_t *mp,
+nxt_http_fields_hash(nxt_http_fields_hash_t *hash, nxt_mp_t *mp,
     nxt_http_field_proc_t items[], nxt_uint_t count)
 {
-    u_char              ch;
-    uint32_t            key;
-    nxt_str_t           *name;
-    nxt_int_t           ret;
-    nxt_uint_t          i, j;
-    nxt_lvlhsh_query_t  lhq;
-
-    lhq.replace = 0;
-    lhq.proto = &nxt_http_fields_hash_proto;
-    lhq.pool = mp;
+    u_char                      ch;
+    size_t                      size;
+    uint16_t                    *keys;
+    uint32_t                    key;
+    nxt_str_t                   *name;
+    nxt_uint_t                  i, j, bits, shift, mask;
+    nxt_http_fields_hash_elt_t  *elts, *elt;
+
+    keys = nxt_mp_alloc(mp, count * sizeof(uint16_t));
+    if (nxt_slow_path(keys == NULL)) {
+        return NXT_ERROR;
+    }
 
     for (i = 0; i < count; i++) {
         key = NXT_HTTP_FIELD_HASH_INIT;
@@ -1161,18 +1363,61 @@ nxt_http_fields_hash(nxt_lvlhsh_t *hash, nxt_mp_t *mp,
             key = nxt_http_field_hash_char(key, ch);
         }
 
-        lhq.key_hash = nxt_http_field_hash_end(key) & 0xffff;
-        lhq.key = *name;
-        lhq.value = &items[i];
+        keys[i] = nxt_http_field_hash_end(key) & 0xffff;
+    }
 
-        ret = nxt_lvlhsh_insert(hash, &lhq);
+    bits = 0;
 
-        if (nxt_slow_path(ret != NXT_OK)) {
+    while ((1U << bits) < count) {
+        bits++;
+    }
+
+    /*
+     * The smallest table and the lowest bit range of the hash
+     * without collisions are searched for.
+     */
+
+    for ( /* void */ ; bits <= NXT_HTTP_FIELDS_HASH_MAX_BITS; bits++) {
+        mask = (1 << bits) - 1;
+        size = (mask + 1) * sizeof(nxt_http_fields_hash_elt_t);
+
+        elts = nxt_mp_alloc(mp, size);
+        if (nxt_slow_path(elts == NULL)) {
+            nxt_mp_free(mp, keys);
             return NXT_ERROR;
         }
+
+        for (shift = 0; shift <= 16 - bits; shift++) {
+            nxt_memzero(elts, size);
+
+            for (i = 0; i < count; i++) {
+                elt = &elts[(keys[i] >> shift) & mask];
+
+                if (elt->proc != NULL) {
+                    break;
+                }
+
+                elt->proc = &items[i];
+                elt->hash = keys[i];
+            }
+
+            if (i == count) {
+                hash->elts = elts;
+                hash->mask = mask;
+                hash->shift = shift;
+
+                nxt_mp_free(mp, keys);
+
+                return NXT_OK;
+            }
+        }
+
+        nxt_mp_free(mp, elts);
     }
 
-    return NXT_OK;
+    nxt_mp_free(mp, keys);
+
+    return NXT_ERROR;
 }
 
 
@@ -1220,26 +1465,31 @@ nxt_http_fields_hash_collisions(nxt_lvlhsh_t *hash, nxt_mp_t *mp,
 
 
 nxt_int_t
-nxt_http_fields_process(nxt_list_t *fields, nxt_lvlhsh_t *hash, void *ctx)
+nxt_http_fields_process(nxt_list_t *fields, nxt_http_fields_hash_t *hash,
+    void *ctx)
 {
-    nxt_int_t              ret;
-    nxt_http_field_t       *field;
-    nxt_lvlhsh_query_t     lhq;
-    nxt_http_field_proc_t  *proc;
-
-    lhq.proto = &nxt_http_fields_hash_proto;
+    nxt_int_t                   ret;
+    nxt_http_field_t            *field;
+    nxt_http_field_proc_t       *proc;
+    nxt_http_fields_hash_elt_t  *elt;
 
     nxt_list_each(field, fields) {
 
-        lhq.key_hash = field->hash;
-        lhq.key.length = field->name_length;
-        lhq.key.start = field->name;
+        elt = &hash->elts[(field->hash >> hash->shift) & hash->mask];
 
-        if (nxt_lvlhsh_find(hash, &lhq) != NXT_OK) {
+        if (elt->hash != field->hash || elt->proc == NULL) {
             continue;
         }
 
-        proc = lhq.value;
+        proc = elt->proc;
+
+        if (proc->name.length != field->name_length
+            || nxt_memcasecmp(proc->name.start, field->name,
+                              field->name_length)
+               != 0)
+        {
+            continue;
+        }
 
         ret = proc->handler(ctx, field, proc->data);
 
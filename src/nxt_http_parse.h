@@ -15,6 +15,13 @@ typedef enum {
 } nxt_http_parse_error_t;
 
 
+typedef enum {
+    NXT_HTTP_PARSE_SIMD_NONE = 0,
+    NXT_HTTP_PARSE_SIMD_SSE42,
+    NXT_HTTP_PARSE_SIMD_AVX2,
+} nxt_http_parse_simd_t;
+
+
 typedef struct nxt_http_request_parse_s  nxt_http_request_parse_t;
 typedef struct nxt_http_field_s          nxt_http_field_t;
 typedef struct nxt_http_fields_hash_s    nxt_http_fields_hash_t;
@@ -83,6 +90,29 @@ typedef struct {
 } nxt_http_field_proc_t;
 
 
+#define NXT_HTTP_FIELD_HASH_INIT        159406
+#define nxt_http_field_hash_char(h, c)  (((h) << 4) + (h) + (c))
+#define nxt_http_field_hash_end(h)      (((h) >> 16) ^ (h))
+
+
+typedef struct {
+    nxt_http_field_proc_t     *proc;
+    uint16_t                  hash;
+} nxt_http_fields_hash_elt_t;
+
+
+/*
+ * A collision free table of the known fields indexed by a bit range
+ * of the field hash calculated by the parser.
+ */
+
+struct nxt_http_fields_hash_s {
+    nxt_http_fields_hash_elt_t  *elts;
+    uint16_t                    mask;
+    uint8_t                     shift;
+};
+
+
 struct nxt_http_field_s {
     uint16_t                  hash;
     uint8_t                   skip;             /* 1 bit */
@@ -100,12 +130,15 @@ nxt_int_t nxt_http_parse_request(nxt_http_request_parse_t *rp,
 nxt_int_t nxt_http_parse_fields(nxt_http_request_parse_t *rp,
     nxt_buf_mem_t *b);
 
-nxt_int_t nxt_http_fields_hash(nxt_lvlhsh_t *hash, nxt_mp_t *mp,
+nxt_http_parse_simd_t nxt_http_parse_simd_detect(void);
+nxt_int_t nxt_http_parse_simd_set(nxt_http_parse_simd_t simd);
+
+nxt_int_t nxt_http_fields_hash(nxt_http_fields_hash_t *hash, nxt_mp_t *mp,
     nxt_http_field_proc_t items[], nxt_uint_t count);
 nxt_uint_t nxt_http_fields_hash_collisions(nxt_lvlhsh_t *hash, nxt_mp_t *mp,
     nxt_http_field_proc_t items[], nxt_uint_t count, nxt_bool_t level);
-nxt_int_t nxt_http_fields_process(nxt_list_t *fields, nxt_lvlhsh_t *hash,
-    void *ctx);
+nxt_int_t nxt_http_fields_process(nxt_list_t *fields,
+    nxt_http_fields_hash_t *hash, void *ctx);
 
 
 #endif /* _NXT_HTTP_PARSER_H_INCLUDED_ */
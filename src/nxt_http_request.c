@@ -9,11 +9,10 @@
 
 
 static void nxt_http_request_start(nxt_task_t *task, void *obj, void *data);
-static void nxt_http_app_request(nxt_task_t *task, void *obj, void *data);
+static void nxt_http_request_handler(nxt_task_t *task, void *obj, void *data);
 static void nxt_http_request_done(nxt_task_t *task, void *obj, void *data);
-
-static u_char *nxt_http_date(u_char *buf, nxt_realtime_t *now, struct tm *tm,
-    size_t size, const char *format);
+static void nxt_http_request_temp_file_close(nxt_task_t *task, void *obj,
+    void *data);
 
 
 static const nxt_http_request_state_t  nxt_http_request_init_state;
@@ -27,11 +26,11 @@ nxt_http_init(nxt_task_t *task, nxt_runtime_t *rt)
 
     ret = nxt_h1p_init(task, rt);
 
-    if (ret != NXT_OK) {
+    if (nxt_slow_path(ret != NXT_OK)) {
         return ret;
     }
 
-    return nxt_http_response_hash_init(task, rt);
+    return nxt_h2p_init(task, rt);
 }
 
 
@@ -137,21 +136,45 @@ nxt_http_request_start(nxt_task_t *task, void *obj, void *data)
 static const nxt_http_request_state_t  nxt_http_request_body_state
     nxt_aligned(64) =
 {
-    .ready_handler = nxt_http_app_request,
+    .ready_handler = nxt_http_request_handler,
     .error_handler = nxt_http_request_close_handler,
 };
 
 
 static void
-nxt_http_app_request(nxt_task_t *task, void *obj, void *data)
+nxt_http_request_handler(nxt_task_t *task, void *obj, void *data)
 {
-    nxt_int_t            ret;
-    nxt_event_engine_t   *engine;
-    nxt_http_request_t   *r;
-    nxt_app_parse_ctx_t  *ar;
+    nxt_app_t           *app;
+    nxt_http_request_t  *r;
 
     r = obj;
 
+    /* An existent file is sent by router, otherwise by application. */
+
+    if (r->socket_conf->share.length != 0
+        && nxt_http_static_handler(task, r) == NXT_OK)
+    {
+        return;
+    }
+
+    app = r->socket_conf->application;
+
+    if (app != NULL && app->cache != NULL
+        && nxt_http_cache_handler(task, r, app->cache) == NXT_OK)
+    {
+        return;
+    }
+
+    nxt_http_app_request(task, r);
+}
+
+
+void
+nxt_http_app_request(nxt_task_t *task, nxt_http_request_t *r)
+{
+    nxt_event_engine_t   *engine;
+    nxt_app_parse_ctx_t  *ar;
+
     ar = nxt_mp_zget(r->mem_pool, sizeof(nxt_app_parse_ctx_t));
     if (nxt_slow_path(ar == NULL)) {
         nxt_http_request_error(task, r, NXT_HTTP_INTERNAL_SERVER_ERROR);
@@ -162,6 +185,8 @@ nxt_http_app_request(nxt_task_t *task, void *obj, void *data)
     ar->mem_pool = r->mem_pool;
     nxt_mp_retain(r->mem_pool);
 
+    r->app_data = ar;
+
     // STUB
     engine = task->thread->engine;
     ar->timer.task = &engine->task;
@@ -221,19 +246,16 @@ nxt_http_app_request(nxt_task_t *task, void *obj, void *data)
         ar->r.header.cookie.start = r->cookie->value;
     }
 
-    if (r->body != NULL) {
+    if (r->body != NULL || r->body_rest != 0 || r->body_file != NULL) {
         ar->r.body.buf = r->body;
         ar->r.body.preread_size = r->content_length_n;
         ar->r.header.parsed_content_length = r->content_length_n;
     }
 
-    ar->r.body.done = 1;
+    ar->r.body.fd = (r->body_file != NULL) ? r->body_file->fd : -1;
 
-    ret = nxt_http_parse_request_init(&ar->resp_parser, r->mem_pool);
-    if (nxt_slow_path(ret != NXT_OK)) {
-        nxt_http_request_error(task, r, NXT_HTTP_INTERNAL_SERVER_ERROR);
-        return;
-    }
+    /* The rest of a large body is requested by application on demand. */
+    ar->r.body.done = (r->body_rest == 0);
 
     nxt_router_process_http_request(task, ar);
 }
@@ -248,6 +270,16 @@ nxt_http_request_read_body(nxt_task_t *task, nxt_http_request_t *r)
 }
 
 
+void
+nxt_http_request_body_stream(nxt_task_t *task, nxt_http_request_t *r,
+    nxt_buf_t *b)
+{
+    if (r->proto.any != NULL) {
+        nxt_http_proto_body_stream[r->protocol](task, r, b);
+    }
+}
+
+
 void
 nxt_http_request_local_addr(nxt_task_t *task, nxt_http_request_t *r)
 {
@@ -257,6 +289,67 @@ nxt_http_request_local_addr(nxt_task_t *task, nxt_http_request_t *r)
 }
 
 
+/*
+ * A temporary file is created in the "temp_path" directory with the
+ * "name.XXXXXX" template and is closed on the request pool destruction.
+ */
+
+nxt_file_t *
+nxt_http_request_temp_file(nxt_task_t *task, nxt_http_request_t *r,
+    const char *name)
+{
+    u_char      *p;
+    size_t      length;
+    nxt_str_t   *path;
+    nxt_file_t  *file;
+
+    static const char  suffix[] = ".XXXXXX";
+
+    path = &r->socket_conf->temp_path;
+    length = nxt_strlen(name);
+
+    file = nxt_mp_zget(r->mem_pool, sizeof(nxt_file_t) + path->length
+                                    + 1 + length + sizeof(suffix));
+    if (nxt_slow_path(file == NULL)) {
+        return NULL;
+    }
+
+    p = (u_char *) (file + 1);
+    file->name = (nxt_file_name_t *) p;
+
+    p = nxt_cpymem(p, path->start, path->length);
+    *p++ = '/';
+    p = nxt_cpymem(p, name, length);
+    nxt_memcpy(p, suffix, sizeof(suffix));
+
+    if (nxt_slow_path(nxt_file_temp_open(task, file) != NXT_OK)) {
+        return NULL;
+    }
+
+    if (nxt_slow_path(nxt_mp_cleanup(r->mem_pool,
+                                     nxt_http_request_temp_file_close,
+                                     &task->thread->engine->task, file, NULL)
+                      != NXT_OK))
+    {
+        nxt_file_close(task, file);
+        return NULL;
+    }
+
+    return file;
+}
+
+
+static void
+nxt_http_request_temp_file_close(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_file_t  *file;
+
+    file = obj;
+
+    nxt_file_close(task, file);
+}
+
+
 void
 nxt_http_request_header_send(nxt_task_t *task, nxt_http_request_t *r)
 {
@@ -266,8 +359,8 @@ nxt_http_request_header_send(nxt_task_t *task, nxt_http_request_t *r)
     static nxt_time_string_t  date_cache = {
         (nxt_atomic_uint_t) -1,
         nxt_http_date,
-        "%s, %02d %s %4d %02d:%02d:%02d GMT",
-        sizeof("Wed, 31 Dec 1986 16:40:00 GMT") - 1,
+        NXT_HTTP_DATE_FORMAT,
+        NXT_HTTP_DATE_LEN,
         NXT_THREAD_TIME_GMT,
         NXT_THREAD_TIME_SEC,
     };
@@ -416,15 +509,17 @@ nxt_http_request_close_handler(nxt_task_t *task, void *obj, void *data)
     handler = nxt_http_proto_close[r->protocol];
 
     r->proto.any = NULL;
-    nxt_mp_release(r->mem_pool);
 
     if (proto.any != NULL) {
+        /* The protocol handler may test the request state. */
         handler(task, proto);
     }
+
+    nxt_mp_release(r->mem_pool);
 }
 
 
-static u_char *
+u_char *
 nxt_http_date(u_char *buf, nxt_realtime_t *now, struct tm *tm, size_t size,
     const char *format)
 {
@@ -16,26 +16,40 @@ static nxt_int_t nxt_http_response_field(void *ctx, nxt_http_field_t *field,
     uintptr_t offset);
 
 
-nxt_lvlhsh_t  nxt_response_fields_hash;
+/* The fields known to router indexed by nxt_app_resp_field_id_t. */
 
 static nxt_http_field_proc_t   nxt_response_fields[] = {
-    { nxt_string("Status"),         &nxt_http_response_status, 0 },
-    { nxt_string("Server"),         &nxt_http_response_skip, 0 },
-    { nxt_string("Date"),           &nxt_http_response_field,
-        offsetof(nxt_http_request_t, resp.date) },
-    { nxt_string("Connection"),     &nxt_http_response_skip, 0 },
-    { nxt_string("Content-Type"),   &nxt_http_response_field,
-        offsetof(nxt_http_request_t, resp.content_type) },
-    { nxt_string("Content-Length"), &nxt_http_response_field,
-        offsetof(nxt_http_request_t, resp.content_length) },
+    [NXT_APP_RESP_FIELD_STATUS] =
+        { nxt_string("Status"),         &nxt_http_response_status, 0 },
+    [NXT_APP_RESP_FIELD_SERVER] =
+        { nxt_string("Server"),         &nxt_http_response_skip, 0 },
+    [NXT_APP_RESP_FIELD_DATE] =
+        { nxt_string("Date"),           &nxt_http_response_field,
+            offsetof(nxt_http_request_t, resp.date) },
+    [NXT_APP_RESP_FIELD_CONNECTION] =
+        { nxt_string("Connection"),     &nxt_http_response_skip, 0 },
+    [NXT_APP_RESP_FIELD_CONTENT_TYPE] =
+        { nxt_string("Content-Type"),   &nxt_http_response_field,
+            offsetof(nxt_http_request_t, resp.content_type) },
+    [NXT_APP_RESP_FIELD_CONTENT_LENGTH] =
+        { nxt_string("Content-Length"), &nxt_http_response_field,
+            offsetof(nxt_http_request_t, resp.content_length) },
 };
 
 
 nxt_int_t
-nxt_http_response_hash_init(nxt_task_t *task, nxt_runtime_t *rt)
+nxt_http_response_field_process(nxt_http_request_t *r, nxt_http_field_t *field,
+    nxt_uint_t id)
 {
-    return nxt_http_fields_hash(&nxt_response_fields_hash, rt->mem_pool,
-                    nxt_response_fields, nxt_nitems(nxt_response_fields));
+    nxt_http_field_proc_t  *proc;
+
+    if (id == NXT_APP_RESP_FIELD_OTHER || id >= NXT_APP_RESP_FIELD_MAX) {
+        return NXT_OK;
+    }
+
+    proc = &nxt_response_fields[id];
+
+    return proc->handler(r, field, proc->data);
 }
 
 
@@ -0,0 +1,556 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_router.h>
+#include <nxt_http.h>
+
+
+/*
+ * The open file cache keeps descriptors and attributes of files found in
+ * the listener "share" directory, as well as absent files, so requests to
+ * application do not cost additional system calls.  The cache belongs to
+ * a listener joint and so is used by a single engine without locks.
+ * Entries are reopened after NXT_HTTP_STATIC_VALID seconds, expired least
+ * recently used entries are closed on lookups.  An entry is held by
+ * requests being sent, so a replaced entry is closed only after the last
+ * response is sent.
+ */
+
+#define NXT_HTTP_STATIC_VALID      1
+#define NXT_HTTP_STATIC_MAX_FILES  256
+
+#define NXT_HTTP_STATIC_ETAG_LEN   (2 + NXT_TIME_T_HEXLEN + 1 + NXT_OFF_T_HEXLEN)
+
+
+typedef struct {
+    nxt_queue_link_t         link;
+    nxt_file_t               file;
+
+    nxt_time_t               valid;
+    nxt_off_t                size;
+    uint32_t                 count;
+
+    uint8_t                  etag_length;
+    u_char                   etag[NXT_HTTP_STATIC_ETAG_LEN];
+    u_char                   last_modified[NXT_HTTP_DATE_LEN];
+
+    /* The request path, the file name follows it. */
+    nxt_str_t                key;
+    u_char                   name[1];
+} nxt_http_static_file_t;
+
+
+struct nxt_http_static_cache_s {
+    nxt_lvlhsh_t             hash;
+    nxt_queue_t              files;   /* LRU */
+    nxt_uint_t               nfiles;
+};
+
+
+typedef struct {
+    nxt_str_t                exten;
+    const char               *type;
+} nxt_http_static_type_t;
+
+
+static nxt_http_static_file_t *nxt_http_static_file(nxt_task_t *task,
+    nxt_http_request_t *r, nxt_str_t *path);
+static nxt_http_static_file_t *nxt_http_static_file_open(nxt_task_t *task,
+    nxt_http_request_t *r, nxt_str_t *path);
+static void nxt_http_static_file_remove(nxt_http_static_cache_t *cache,
+    nxt_http_static_file_t *sf);
+static void nxt_http_static_file_release(nxt_http_static_file_t *sf);
+static void nxt_http_static_file_cleanup(nxt_task_t *task, void *obj,
+    void *data);
+static nxt_int_t nxt_http_static_not_modified(nxt_http_request_t *r,
+    nxt_http_static_file_t *sf);
+static const char *nxt_http_static_type(nxt_str_t *path);
+static nxt_int_t nxt_http_static_lvlhsh_test(nxt_lvlhsh_query_t *lhq,
+    void *data);
+static void nxt_http_static_send_body(nxt_task_t *task, void *obj,
+    void *data);
+
+
+static const nxt_http_request_state_t  nxt_http_static_send_state;
+
+
+static const nxt_lvlhsh_proto_t  nxt_http_static_proto  nxt_aligned(64) = {
+    NXT_LVLHSH_DEFAULT,
+    nxt_http_static_lvlhsh_test,
+    nxt_lvlhsh_alloc,
+    nxt_lvlhsh_free,
+};
+
+
+static const nxt_http_static_type_t  nxt_http_static_types[] = {
+    { nxt_string("html"),   "text/html" },
+    { nxt_string("htm"),    "text/html" },
+    { nxt_string("css"),    "text/css" },
+    { nxt_string("txt"),    "text/plain" },
+    { nxt_string("xml"),    "text/xml" },
+    { nxt_string("js"),     "application/javascript" },
+    { nxt_string("json"),   "application/json" },
+    { nxt_string("pdf"),    "application/pdf" },
+    { nxt_string("zip"),    "application/zip" },
+    { nxt_string("gif"),    "image/gif" },
+    { nxt_string("jpg"),    "image/jpeg" },
+    { nxt_string("jpeg"),   "image/jpeg" },
+    { nxt_string("png"),    "image/png" },
+    { nxt_string("svg"),    "image/svg+xml" },
+    { nxt_string("ico"),    "image/x-icon" },
+    { nxt_string("webp"),   "image/webp" },
+    { nxt_string("woff"),   "font/woff" },
+    { nxt_string("woff2"),  "font/woff2" },
+    { nxt_string("mp4"),    "video/mp4" },
+};
+
+
+/*
+ * Returns NXT_DECLINED if the request should be passed to application,
+ * otherwise the response is being sent.
+ */
+
+nxt_int_t
+nxt_http_static_handler(nxt_task_t *task, nxt_http_request_t *r)
+{
+    size_t                  length;
+    nxt_bool_t              head;
+    nxt_http_field_t        *field;
+    nxt_http_static_file_t  *sf;
+
+    static const nxt_str_t  get = nxt_string("GET");
+    static const nxt_str_t  head_method = nxt_string("HEAD");
+
+    if (r->method == NULL || r->path == NULL) {
+        return NXT_DECLINED;
+    }
+
+    head = nxt_strstr_eq(r->method, &head_method);
+
+    if (!head && !nxt_strstr_eq(r->method, &get)) {
+        return NXT_DECLINED;
+    }
+
+    length = r->path->length;
+
+    /* A directory index is generated by application. */
+
+    if (length == 0 || r->path->start[0] != '/'
+        || r->path->start[length - 1] == '/')
+    {
+        return NXT_DECLINED;
+    }
+
+    /* The path is already normalized, but may contain decoded "%00". */
+
+    if (nxt_memchr(r->path->start, '\0', length) != NULL) {
+        return NXT_DECLINED;
+    }
+
+    sf = nxt_http_static_file(task, r, r->path);
+
+    if (sf == NULL) {
+        return NXT_DECLINED;
+    }
+
+    sf->count++;
+
+    if (nxt_slow_path(nxt_mp_cleanup(r->mem_pool, nxt_http_static_file_cleanup,
+                                     task, sf, NULL)
+                      != NXT_OK))
+    {
+        nxt_http_static_file_release(sf);
+        goto fail;
+    }
+
+    r->resp.fields = nxt_list_create(r->mem_pool, 8, sizeof(nxt_http_field_t));
+    if (nxt_slow_path(r->resp.fields == NULL)) {
+        goto fail;
+    }
+
+    field = nxt_list_zero_add(r->resp.fields);
+    if (nxt_slow_path(field == NULL)) {
+        goto fail;
+    }
+
+    nxt_http_field_name_set(field, "Last-Modified");
+    field->value = sf->last_modified;
+    field->value_length = NXT_HTTP_DATE_LEN;
+
+    field = nxt_list_zero_add(r->resp.fields);
+    if (nxt_slow_path(field == NULL)) {
+        goto fail;
+    }
+
+    nxt_http_field_name_set(field, "ETag");
+    field->value = sf->etag;
+    field->value_length = sf->etag_length;
+
+    r->resp.content_length = NULL;
+    r->resp.content_length_n = sf->size;
+
+    if (nxt_http_static_not_modified(r, sf)) {
+        r->status = NXT_HTTP_NOT_MODIFIED;
+        head = 1;
+
+    } else {
+        field = nxt_list_zero_add(r->resp.fields);
+        if (nxt_slow_path(field == NULL)) {
+            goto fail;
+        }
+
+        nxt_http_field_name_set(field, "Content-Type");
+        field->value = (u_char *) nxt_http_static_type(r->path);
+        field->value_length = nxt_strlen(field->value);
+
+        r->status = NXT_HTTP_OK;
+    }
+
+    if (head) {
+        /* The response body is not sent. */
+        sf = NULL;
+    }
+
+    r->static_file = sf;
+    r->state = &nxt_http_static_send_state;
+
+    nxt_http_request_header_send(task, r);
+
+    return NXT_OK;
+
+fail:
+
+    nxt_http_request_error(task, r, NXT_HTTP_INTERNAL_SERVER_ERROR);
+
+    return NXT_OK;
+}
+
+
+static const nxt_http_request_state_t  nxt_http_static_send_state
+    nxt_aligned(64) =
+{
+    .ready_handler = nxt_http_static_send_body,
+    .error_handler = nxt_http_request_close_handler,
+};
+
+
+static void
+nxt_http_static_send_body(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_buf_t               *out, *last;
+    nxt_http_request_t      *r;
+    nxt_http_static_file_t  *sf;
+
+    r = obj;
+    sf = r->static_file;
+
+    nxt_debug(task, "http static send body");
+
+    last = nxt_http_request_last_buffer(task, r);
+    if (nxt_slow_path(last == NULL)) {
+        return;
+    }
+
+    out = last;
+
+    if (sf != NULL && sf->size != 0) {
+        out = nxt_buf_file_alloc(r->mem_pool, 0, 0);
+        if (nxt_slow_path(out == NULL)) {
+            nxt_http_request_release(task, r);
+            return;
+        }
+
+        out->file = &sf->file;
+        out->file_pos = 0;
+        out->file_end = sf->size;
+        out->next = last;
+    }
+
+    nxt_http_request_send(task, r, out);
+}
+
+
+static nxt_http_static_file_t *
+nxt_http_static_file(nxt_task_t *task, nxt_http_request_t *r, nxt_str_t *path)
+{
+    nxt_uint_t               n;
+    nxt_time_t               now;
+    nxt_lvlhsh_query_t       lhq;
+    nxt_http_static_file_t   *sf;
+    nxt_http_static_cache_t  *cache;
+
+    cache = r->conf->static_cache;
+
+    if (cache == NULL) {
+        cache = nxt_zalloc(sizeof(nxt_http_static_cache_t));
+        if (nxt_slow_path(cache == NULL)) {
+            return NULL;
+        }
+
+        nxt_queue_init(&cache->files);
+
+        r->conf->static_cache = cache;
+    }
+
+    now = nxt_thread_time(task->thread);
+
+    for (n = 0; n < 2 && !nxt_queue_is_empty(&cache->files); n++) {
+        sf = nxt_queue_link_data(nxt_queue_first(&cache->files),
+                                 nxt_http_static_file_t, link);
+
+        if (now < sf->valid) {
+            break;
+        }
+
+        nxt_http_static_file_remove(cache, sf);
+    }
+
+    lhq.key_hash = nxt_djb_hash(path->start, path->length);
+    lhq.key = *path;
+    lhq.proto = &nxt_http_static_proto;
+    lhq.pool = NULL;
+
+    if (nxt_lvlhsh_find(&cache->hash, &lhq) == NXT_OK) {
+        sf = lhq.value;
+
+        if (now < sf->valid) {
+            nxt_queue_remove(&sf->link);
+            nxt_queue_insert_tail(&cache->files, &sf->link);
+
+            return (sf->file.fd != NXT_FILE_INVALID) ? sf : NULL;
+        }
+
+        nxt_http_static_file_remove(cache, sf);
+    }
+
+    sf = nxt_http_static_file_open(task, r, path);
+    if (nxt_slow_path(sf == NULL)) {
+        return NULL;
+    }
+
+    sf->valid = now + NXT_HTTP_STATIC_VALID;
+
+    lhq.replace = 0;
+    lhq.value = sf;
+
+    if (nxt_slow_path(nxt_lvlhsh_insert(&cache->hash, &lhq) != NXT_OK)) {
+        /* The file is returned but is not cached. */
+        nxt_http_static_file_release(sf);
+
+        return NULL;
+    }
+
+    nxt_queue_insert_tail(&cache->files, &sf->link);
+
+    if (++cache->nfiles > NXT_HTTP_STATIC_MAX_FILES) {
+        nxt_http_static_file_remove(cache, nxt_queue_link_data(
+                                               nxt_queue_first(&cache->files),
+                                               nxt_http_static_file_t, link));
+    }
+
+    return (sf->file.fd != NXT_FILE_INVALID) ? sf : NULL;
+}
+
+
+static nxt_http_static_file_t *
+nxt_http_static_file_open(nxt_task_t *task, nxt_http_request_t *r,
+    nxt_str_t *path)
+{
+    u_char                  *p;
+    size_t                  length;
+    struct tm               tm;
+    nxt_str_t               *share;
+    nxt_file_info_t         fi;
+    nxt_http_static_file_t  *sf;
+
+    share = &r->socket_conf->share;
+
+    length = share->length + path->length;
+
+    sf = nxt_zalloc(sizeof(nxt_http_static_file_t) + length);
+    if (nxt_slow_path(sf == NULL)) {
+        return NULL;
+    }
+
+    p = nxt_cpymem(sf->name, share->start, share->length);
+    p = nxt_cpymem(p, path->start, path->length);
+    *p = '\0';
+
+    sf->key.length = path->length;
+    sf->key.start = sf->name + share->length;
+    sf->count = 1;
+
+    sf->file.name = sf->name;
+
+    if (nxt_file_open(task, &sf->file, NXT_FILE_RDONLY, NXT_FILE_OPEN, 0)
+        != NXT_OK)
+    {
+        sf->file.fd = NXT_FILE_INVALID;
+        return sf;
+    }
+
+    if (nxt_file_info(&sf->file, &fi) != NXT_OK || !nxt_is_file(&fi)) {
+        nxt_file_close(task, &sf->file);
+        sf->file.fd = NXT_FILE_INVALID;
+        return sf;
+    }
+
+    sf->size = nxt_file_size(&fi);
+
+    p = nxt_sprintf(sf->etag, sf->etag + NXT_HTTP_STATIC_ETAG_LEN,
+                    "\"%xT-%xO\"", nxt_file_mtime(&fi), sf->size);
+    sf->etag_length = p - sf->etag;
+
+    nxt_gmtime(nxt_file_mtime(&fi), &tm);
+
+    (void) nxt_http_date(sf->last_modified, NULL, &tm, NXT_HTTP_DATE_LEN,
+                         NXT_HTTP_DATE_FORMAT);
+
+    return sf;
+}
+
+
+static void
+nxt_http_static_file_remove(nxt_http_static_cache_t *cache,
+    nxt_http_static_file_t *sf)
+{
+    nxt_lvlhsh_query_t  lhq;
+
+    lhq.key = sf->key;
+    lhq.key_hash = nxt_djb_hash(lhq.key.start, lhq.key.length);
+    lhq.proto = &nxt_http_static_proto;
+    lhq.pool = NULL;
+
+    (void) nxt_lvlhsh_delete(&cache->hash, &lhq);
+
+    nxt_queue_remove(&sf->link);
+    cache->nfiles--;
+
+    nxt_http_static_file_release(sf);
+}
+
+
+static void
+nxt_http_static_file_release(nxt_http_static_file_t *sf)
+{
+    if (--sf->count != 0) {
+        return;
+    }
+
+    if (sf->file.fd != NXT_FILE_INVALID) {
+        nxt_fd_close(sf->file.fd);
+    }
+
+    nxt_free(sf);
+}
+
+
+static void
+nxt_http_static_file_cleanup(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_http_static_file_release(obj);
+}
+
+
+void
+nxt_http_static_cache_free(nxt_http_static_cache_t *cache)
+{
+    nxt_queue_link_t        *link;
+    nxt_http_static_file_t  *sf;
+
+    if (cache == NULL) {
+        return;
+    }
+
+    while (!nxt_queue_is_empty(&cache->files)) {
+        link = nxt_queue_first(&cache->files);
+        sf = nxt_queue_link_data(link, nxt_http_static_file_t, link);
+
+        nxt_http_static_file_remove(cache, sf);
+    }
+
+    nxt_free(cache);
+}
+
+
+static nxt_int_t
+nxt_http_static_not_modified(nxt_http_request_t *r, nxt_http_static_file_t *sf)
+{
+    u_char            *end;
+    nxt_http_field_t  *field;
+
+    field = r->if_none_match;
+
+    if (field != NULL) {
+        end = field->value + field->value_length;
+
+        if (field->value_length == 1 && field->value[0] == '*') {
+            return 1;
+        }
+
+        return (nxt_memstrn(field->value, end, (char *) sf->etag,
+                            sf->etag_length)
+                != NULL);
+    }
+
+    field = r->if_modified_since;
+
+    if (field != NULL) {
+        return (field->value_length == NXT_HTTP_DATE_LEN
+                && nxt_memcmp(field->value, sf->last_modified,
+                              NXT_HTTP_DATE_LEN) == 0);
+    }
+
+    return 0;
+}
+
+
+static const char *
+nxt_http_static_type(nxt_str_t *path)
+{
+    u_char      *p, *end;
+    nxt_str_t   exten;
+    nxt_uint_t  i;
+
+    end = path->start + path->length;
+
+    for (p = end; p > path->start; p--) {
+
+        if (p[-1] == '.') {
+            exten.start = p;
+            exten.length = end - p;
+
+            for (i = 0; i < nxt_nitems(nxt_http_static_types); i++) {
+                if (nxt_strcasestr_eq(&exten, &nxt_http_static_types[i].exten))
+                {
+                    return nxt_http_static_types[i].type;
+                }
+            }
+
+            break;
+        }
+
+        if (p[-1] == '/') {
+            break;
+        }
+    }
+
+    return "application/octet-stream";
+}
+
+
+static nxt_int_t
+nxt_http_static_lvlhsh_test(nxt_lvlhsh_query_t *lhq, void *data)
+{
+    nxt_http_static_file_t  *sf;
+
+    sf = data;
+
+    if (nxt_strstr_eq(&lhq->key, &sf->key)) {
+        return NXT_OK;
+    }
+
+    return NXT_DECLINED;
+}
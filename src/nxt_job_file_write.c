@@ -0,0 +1,65 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_main.h>
+
+
+static void nxt_job_file_write_handler(nxt_task_t *task, void *obj,
+    void *data);
+
+
+void
+nxt_job_file_write(nxt_task_t *task, nxt_job_file_write_t *jbw)
+{
+    jbw->task.thread = task->thread;
+    jbw->task.log = task->log;
+    jbw->task.ident = task->ident;
+
+    jbw->job.task = &jbw->task;
+
+    nxt_job_set_name(&jbw->job, "job file write");
+
+    nxt_job_start(task, &jbw->job, nxt_job_file_write_handler);
+}
+
+
+static void
+nxt_job_file_write_handler(nxt_task_t *task, void *obj, void *data)
+{
+    size_t                size;
+    ssize_t               n;
+    nxt_buf_t             *b;
+    nxt_work_handler_t    handler;
+    nxt_job_file_write_t  *jbw;
+
+    jbw = obj;
+
+    handler = jbw->ready_handler;
+
+    for (b = jbw->buffer; b != NULL; b = b->next) {
+
+        if (!nxt_buf_is_mem(b) || nxt_buf_is_sync(b)) {
+            continue;
+        }
+
+        while (b->mem.pos < b->mem.free) {
+            size = b->mem.free - b->mem.pos;
+
+            n = nxt_file_write(jbw->file, b->mem.pos, size, jbw->offset);
+
+            if (nxt_slow_path(n <= 0)) {
+                handler = jbw->error_handler;
+                goto done;
+            }
+
+            b->mem.pos += n;
+            jbw->offset += n;
+        }
+    }
+
+done:
+
+    nxt_job_return(task, &jbw->job, handler);
+}
@@ -0,0 +1,36 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#ifndef _NXT_JOB_FILE_WRITE_H_INCLUDED_
+#define _NXT_JOB_FILE_WRITE_H_INCLUDED_
+
+
+/*
+ * A job writes memory buffers of the "buffer" chain to the file starting
+ * at the "offset".  The written buffers are consumed and the offset is
+ * advanced, so on error the offset points just after the written data.
+ * Non-memory and sync buffers are skipped.  The job has its own task,
+ * since a thread pool thread sets the task thread; the handlers should
+ * not use the task after the job is destroyed.
+ */
+
+typedef struct {
+    nxt_job_t           job;
+    nxt_task_t          task;
+
+    nxt_file_t          *file;
+    nxt_off_t           offset;
+    nxt_buf_t           *buffer;
+
+    nxt_work_handler_t  ready_handler;
+    nxt_work_handler_t  error_handler;
+} nxt_job_file_write_t;
+
+
+NXT_EXPORT void nxt_job_file_write(nxt_task_t *task,
+    nxt_job_file_write_t *jbw);
+
+
+#endif /* _NXT_JOB_FILE_WRITE_H_INCLUDED_ */
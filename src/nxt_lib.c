@@ -99,12 +99,18 @@ nxt_lib_start(const char *app, char **argv, char ***envp)
 
     nxt_thread_spin_init(nxt_ncpu, 0);
 
+#if (NXT_HAVE_CPU_AFFINITY)
+    nxt_cpu_affinity_init(&nxt_main_task);
+#endif
+
     nxt_random_init(&thread->random);
 
     nxt_pagesize = getpagesize();
 
     nxt_debug(&nxt_main_task, "pagesize: %ui", nxt_pagesize);
 
+    (void) nxt_http_parse_simd_set(nxt_http_parse_simd_detect());
+
     if (argv != NULL) {
         update = (argv[0] == app);
 
@@ -286,7 +286,7 @@ nxt_listen_socket_pool_min_size(nxt_listen_socket_t *ls)
     if (ls->ssltls) {
         size += 4 * sizeof(void *)   /* SSL/TLS connection */
                 + sizeof(nxt_buf_mem_t)
-                + sizeof(nxt_mem_pool_cleanup_t);
+                + sizeof(nxt_work_t);
     }
 
 #endif
@@ -20,6 +20,16 @@ typedef struct {
 
     uint32_t                  count;
 
+#if (NXT_HAVE_REUSEPORT)
+    /*
+     * SO_REUSEPORT sockets, one per router engine, the first one
+     * is also stored in the "socket" field.
+     */
+    nxt_socket_t              *sockets;
+    uint32_t                  nsockets;
+    uint8_t                   reuseport_cpu;       /* 1 bit */
+#endif
+
     uint8_t                   flags;
     uint8_t                   read_after_accept;   /* 1 bit */
 
@@ -60,6 +60,7 @@ typedef uint16_t                     nxt_port_id_t;
 #include <nxt_thread.h>
 #include <nxt_process_type.h>
 #include <nxt_process.h>
+#include <nxt_cpu_affinity.h>
 #include <nxt_utf8.h>
 #include <nxt_file_name.h>
 
@@ -142,6 +143,7 @@ typedef void (*nxt_event_conn_handler_t)(nxt_thread_t *thr, nxt_conn_t *c);
 
 #include <nxt_job.h>
 #include <nxt_job_file.h>
+#include <nxt_job_file_write.h>
 #include <nxt_buf_filter.h>
 
 #include <nxt_job_resolve.h>
@@ -17,6 +17,7 @@ typedef struct {
     nxt_socket_error_t  error;
     u_char              *start;
     u_char              *end;
+    uint8_t             reuseport;  /* 1 bit */
 } nxt_listening_socket_t;
 
 
@@ -59,6 +60,16 @@ static void nxt_main_port_modules_handler(nxt_task_t *task,
 static int nxt_cdecl nxt_app_lang_compare(const void *v1, const void *v2);
 static void nxt_main_port_conf_store_handler(nxt_task_t *task,
     nxt_port_recv_msg_t *msg);
+#if (NXT_SSLTLS)
+static void nxt_main_port_cert_store_handler(nxt_task_t *task,
+    nxt_port_recv_msg_t *msg);
+static void nxt_main_port_cert_get_handler(nxt_task_t *task,
+    nxt_port_recv_msg_t *msg);
+static nxt_port_t *nxt_main_cert_port(nxt_task_t *task,
+    nxt_port_recv_msg_t *msg, nxt_process_type_t type);
+static nxt_int_t nxt_main_cert_file_name(nxt_task_t *task, nxt_mp_t *mp,
+    nxt_buf_t *b, nxt_file_name_str_t *name, u_char **end);
+#endif
 
 
 const nxt_sig_event_t  nxt_main_process_signals[] = {
@@ -73,6 +84,11 @@ const nxt_sig_event_t  nxt_main_process_signals[] = {
 
 static nxt_bool_t  nxt_exiting;
 
+#if (NXT_HAVE_CPU_AFFINITY)
+/* Application processes are placed on CPUs or nodes in turn. */
+static nxt_uint_t  nxt_main_affinity_index;
+#endif
+
 
 nxt_int_t
 nxt_main_process_start(nxt_thread_t *thr, nxt_task_t *task,
@@ -119,6 +135,12 @@ static nxt_conf_map_t  nxt_common_app_conf[] = {
         NXT_CONF_MAP_CSTRZ,
         offsetof(nxt_common_app_conf_t, working_directory),
     },
+
+    {
+        nxt_string("affinity"),
+        NXT_CONF_MAP_STR,
+        offsetof(nxt_common_app_conf_t, affinity),
+    },
 };
 
 
@@ -307,6 +329,10 @@ static nxt_port_handlers_t  nxt_main_process_port_handlers = {
     .socket         = nxt_main_port_socket_handler,
     .modules        = nxt_main_port_modules_handler,
     .conf_store     = nxt_main_port_conf_store_handler,
+#if (NXT_SSLTLS)
+    .cert_store     = nxt_main_port_cert_store_handler,
+    .cert_get       = nxt_main_port_cert_get_handler,
+#endif
     .rpc_ready      = nxt_port_rpc_handler,
     .rpc_error      = nxt_port_rpc_handler,
 };
@@ -567,6 +593,12 @@ nxt_main_start_worker_process(nxt_task_t *task, nxt_runtime_t *rt,
     init->stream = stream;
     init->restart = NULL;
 
+#if (NXT_HAVE_CPU_AFFINITY)
+    if (app_conf->affinity.length != 0) {
+        app_conf->affinity_index = nxt_main_affinity_index++;
+    }
+#endif
+
     return nxt_main_create_worker_process(task, rt, init);
 }
 
@@ -919,6 +951,10 @@ nxt_main_port_socket_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg)
     ls.start = message;
     ls.end = message + sizeof(message);
 
+    /* A byte after the sockaddr requests a SO_REUSEPORT socket. */
+    ls.reuseport = ((size_t) nxt_buf_mem_used_size(&b->mem)
+                    > nxt_sockaddr_size(sa));
+
     port = nxt_runtime_port_find(task->thread->runtime, msg->port_msg.pid,
                                  msg->port_msg.reply_port);
 
@@ -993,6 +1029,20 @@ nxt_main_listening_socket(nxt_sockaddr_t *sa, nxt_listening_socket_t *ls)
         goto fail;
     }
 
+#if (NXT_HAVE_REUSEPORT)
+
+    if (ls->reuseport
+        && setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &enable, length) != 0)
+    {
+        ls->end = nxt_sprintf(ls->start, ls->end,
+                              "setsockopt(\\\"%*s\\\", SO_REUSEPORT) failed %E",
+                              (size_t) sa->length, nxt_sockaddr_start(sa),
+                              nxt_errno);
+        goto fail;
+    }
+
+#endif
+
 #if (NXT_INET6)
 
     if (sa->u.sockaddr.sa_family == AF_INET6) {
@@ -1112,6 +1162,7 @@ nxt_main_port_modules_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg)
     nxt_mp_t               *mp;
     nxt_int_t              ret;
     nxt_buf_t              *b;
+    nxt_port_t             *port;
     nxt_runtime_t          *rt;
     nxt_conf_value_t       *conf, *root, *value;
     nxt_app_lang_module_t  *lang;
@@ -1120,7 +1171,14 @@ nxt_main_port_modules_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg)
 
     rt = task->thread->runtime;
 
-    if (msg->port_msg.pid != rt->port_by_type[NXT_PROCESS_DISCOVERY]->pid) {
+    port = rt->port_by_type[NXT_PROCESS_DISCOVERY];
+
+    /*
+     * The discovery process exits right after sending the modules,
+     * so its port may be already removed on SIGCHLD processing.
+     */
+
+    if (port != NULL && msg->port_msg.pid != port->pid) {
         return;
     }
 
@@ -1266,3 +1324,220 @@ error:
 
     nxt_log(task, NXT_LOG_ALERT, "failed to store current configuration");
 }
+
+
+#if (NXT_SSLTLS)
+
+/*
+ * A certificate message contains a null-terminated certificate name
+ * followed by a PEM bundle; an empty bundle deletes the certificate.
+ */
+
+static void
+nxt_main_port_cert_store_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg)
+{
+    u_char               *start;
+    size_t               size;
+    ssize_t              n;
+    nxt_mp_t             *mp;
+    nxt_buf_t            *b;
+    nxt_int_t            ret;
+    nxt_file_t           file;
+    nxt_port_t           *port;
+    nxt_runtime_t        *rt;
+    nxt_file_name_str_t  name, tmp;
+
+    port = nxt_main_cert_port(task, msg, NXT_PROCESS_CONTROLLER);
+    if (nxt_slow_path(port == NULL)) {
+        return;
+    }
+
+    ret = NXT_ERROR;
+
+    rt = task->thread->runtime;
+
+    mp = nxt_mp_create(1024, 128, 256, 32);
+    if (nxt_slow_path(mp == NULL)) {
+        goto done;
+    }
+
+    b = nxt_buf_chk_make_plain(mp, msg->buf, msg->size);
+    if (nxt_slow_path(b == NULL)) {
+        goto done;
+    }
+
+    if (nxt_main_cert_file_name(task, mp, b, &name, &start) != NXT_OK) {
+        goto done;
+    }
+
+    size = b->mem.free - start;
+
+    if (size == 0) {
+        nxt_debug(task, "delete certificate \"%FN\"", name.start);
+
+        if (nxt_file_delete(name.start) == NXT_OK || nxt_errno == NXT_ENOENT) {
+            ret = NXT_OK;
+        }
+
+        goto done;
+    }
+
+    nxt_debug(task, "store certificate \"%FN\"", name.start);
+
+    if (mkdir(rt->certs, 0700) != 0 && nxt_errno != NXT_EEXIST) {
+        nxt_log(task, NXT_LOG_ALERT, "mkdir(\"%s\") failed %E",
+                rt->certs, nxt_errno);
+        goto done;
+    }
+
+    if (nxt_file_name_create(mp, &tmp, "%FN.tmp%Z", name.start) != NXT_OK) {
+        goto done;
+    }
+
+    nxt_memzero(&file, sizeof(nxt_file_t));
+
+    file.name = tmp.start;
+
+    if (nxt_file_open(task, &file, NXT_FILE_WRONLY, NXT_FILE_TRUNCATE,
+                      NXT_FILE_OWNER_ACCESS)
+        != NXT_OK)
+    {
+        goto done;
+    }
+
+    n = nxt_file_write(&file, start, size, 0);
+
+    nxt_file_close(task, &file);
+
+    if (nxt_slow_path(n != (ssize_t) size)) {
+        (void) nxt_file_delete(tmp.start);
+        goto done;
+    }
+
+    ret = nxt_file_rename(tmp.start, name.start);
+
+done:
+
+    (void) nxt_port_socket_write(task, port,
+                                 (ret == NXT_OK) ? NXT_PORT_MSG_RPC_READY_LAST
+                                                 : NXT_PORT_MSG_RPC_ERROR,
+                                 -1, msg->port_msg.stream, 0, NULL);
+
+    if (mp != NULL) {
+        nxt_mp_destroy(mp);
+    }
+}
+
+
+static void
+nxt_main_port_cert_get_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg)
+{
+    u_char               *end;
+    nxt_mp_t             *mp;
+    nxt_buf_t            *b;
+    nxt_file_t           file;
+    nxt_port_t           *port;
+    nxt_port_msg_type_t  type;
+    nxt_file_name_str_t  name;
+
+    port = nxt_main_cert_port(task, msg, NXT_PROCESS_ROUTER);
+    if (nxt_slow_path(port == NULL)) {
+        return;
+    }
+
+    nxt_memzero(&file, sizeof(nxt_file_t));
+
+    file.fd = -1;
+    type = NXT_PORT_MSG_RPC_ERROR;
+
+    mp = nxt_mp_create(1024, 128, 256, 32);
+    if (nxt_slow_path(mp == NULL)) {
+        goto done;
+    }
+
+    b = nxt_buf_chk_make_plain(mp, msg->buf, msg->size);
+    if (nxt_slow_path(b == NULL)) {
+        goto done;
+    }
+
+    if (nxt_main_cert_file_name(task, mp, b, &name, &end) != NXT_OK) {
+        goto done;
+    }
+
+    file.name = name.start;
+
+    /* The router has no access to the certificates directory. */
+
+    if (nxt_file_open(task, &file, NXT_FILE_RDONLY, NXT_FILE_OPEN, 0)
+        == NXT_OK)
+    {
+        type = NXT_PORT_MSG_RPC_READY_LAST | NXT_PORT_MSG_CLOSE_FD;
+    }
+
+done:
+
+    (void) nxt_port_socket_write(task, port, type, file.fd,
+                                 msg->port_msg.stream, 0, NULL);
+
+    if (mp != NULL) {
+        nxt_mp_destroy(mp);
+    }
+}
+
+
+/*
+ * Only the controller stores certificates and only the router gets them,
+ * application processes must not access private keys.  The reply is sent
+ * to the found port, so a descriptor cannot be obtained by a process which
+ * has sent a pid and a port id of another one.
+ */
+
+static nxt_port_t *
+nxt_main_cert_port(nxt_task_t *task, nxt_port_recv_msg_t *msg,
+    nxt_process_type_t type)
+{
+    nxt_port_t  *port;
+
+    port = nxt_runtime_port_find(task->thread->runtime, msg->port_msg.pid,
+                                 msg->port_msg.reply_port);
+
+    if (nxt_fast_path(port != NULL && port->type == type)) {
+        return port;
+    }
+
+    nxt_log(task, NXT_LOG_ALERT,
+            "certificate message from process %PI rejected",
+            msg->port_msg.pid);
+
+    return NULL;
+}
+
+
+static nxt_int_t
+nxt_main_cert_file_name(nxt_task_t *task, nxt_mp_t *mp, nxt_buf_t *b,
+    nxt_file_name_str_t *name, u_char **end)
+{
+    u_char     *p;
+    nxt_str_t  cert;
+
+    p = nxt_memchr(b->mem.pos, '\0', b->mem.free - b->mem.pos);
+
+    cert.start = b->mem.pos;
+    cert.length = (p != NULL) ? (size_t) (p - b->mem.pos) : 0;
+
+    if (cert.length == 0
+        || nxt_memchr(cert.start, '/', cert.length) != NULL
+        || nxt_str_eq(&cert, ".", 1)
+        || nxt_str_eq(&cert, "..", 2))
+    {
+        nxt_log(task, NXT_LOG_ALERT, "invalid certificate name received");
+        return NXT_ERROR;
+    }
+
+    *end = p + 1;
+
+    return nxt_file_name_create(mp, name, "%s%V%Z",
+                                task->thread->runtime->certs, &cert);
+}
+
+#endif
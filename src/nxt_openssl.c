@@ -1,4 +1,3 @@
-
 /*
  * Copyright (C) Igor Sysoev
  * Copyright (C) NGINX, Inc.
@@ -8,36 +7,101 @@
 #include <openssl/ssl.h>
 #include <openssl/conf.h>
 #include <openssl/err.h>
+#include <openssl/rand.h>
+
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+#include <openssl/core_names.h>
+#endif
+
+
+#if (defined SSL_OP_ENABLE_KTLS && !defined OPENSSL_NO_KTLS)
+#define NXT_OPENSSL_KTLS  1
+#else
+#define NXT_OPENSSL_KTLS  0
+#endif
+
+
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+typedef EVP_MAC_CTX  nxt_openssl_hmac_t;
+#else
+typedef HMAC_CTX     nxt_openssl_hmac_t;
+#endif
 
 
 typedef struct {
     SSL            *session;
 
     int            ssl_error;
-    uint8_t        times;      /* 2 bits */
 
+    /* The bytes sent since the connection has been idle. */
+    size_t         boost;
+    nxt_msec_t     last;
+
+    /* A record which has been copied but has not been sent yet. */
     nxt_buf_mem_t  buffer;
 } nxt_openssl_conn_t;
 
 
-static nxt_int_t nxt_openssl_server_init(nxt_ssltls_conf_t *conf);
+typedef struct {
+    u_char                    name[16];
+    u_char                    aes_key[32];
+    u_char                    hmac_key[32];
+    nxt_time_t                created;
+} nxt_openssl_ticket_key_t;
+
+
+/*
+ * Session ticket keys are shared by all engines using the context.
+ * The current key encrypts new tickets during the key lifetime, after
+ * that it becomes the previous key which still decrypts tickets issued
+ * at the end of its lifetime, and such tickets are renewed.
+ */
+
+typedef struct {
+    nxt_thread_spinlock_t     lock;
+    nxt_time_t                lifetime;
+    nxt_openssl_ticket_key_t  keys[2];
+} nxt_openssl_tickets_t;
+
+
+static nxt_int_t nxt_openssl_start(nxt_task_t *task);
+static nxt_int_t nxt_openssl_server_init(nxt_task_t *task,
+    nxt_ssltls_conf_t *conf, nxt_mp_t *mp);
+static nxt_int_t nxt_openssl_chain_check(nxt_task_t *task, u_char *start,
+    size_t length);
+static nxt_int_t nxt_openssl_chain_load(nxt_task_t *task, SSL_CTX *ctx,
+    u_char *start, size_t length, nxt_uint_t level);
+static nxt_int_t nxt_openssl_chain_file_load(nxt_task_t *task, SSL_CTX *ctx,
+    nxt_fd_t fd);
+static void nxt_openssl_ctx_cleanup(nxt_task_t *task, void *obj, void *data);
+static int nxt_openssl_ticket_key_callback(SSL *s, u_char *name, u_char *iv,
+    EVP_CIPHER_CTX *ectx, nxt_openssl_hmac_t *hctx, int enc);
+static nxt_int_t nxt_openssl_ticket_key(nxt_openssl_tickets_t *tickets,
+    nxt_time_t now, nxt_openssl_ticket_key_t *key);
+static nxt_int_t nxt_openssl_ticket_hmac_init(nxt_openssl_hmac_t *hctx,
+    nxt_openssl_ticket_key_t *key);
+#ifdef TLSEXT_TYPE_application_layer_protocol_negotiation
+static int nxt_openssl_alpn_select(SSL *s, const unsigned char **out,
+    unsigned char *outlen, const unsigned char *in, unsigned int inlen,
+    void *arg);
+#endif
 
 static void nxt_openssl_conn_init(nxt_task_t *task, nxt_ssltls_conf_t *conf,
     nxt_conn_t *c);
-static void nxt_openssl_session_cleanup(nxt_task_t *task, void *data);
+static void nxt_openssl_conn_cleanup(nxt_task_t *task, void *obj, void *data);
 static void nxt_openssl_conn_handshake(nxt_task_t *task, void *obj, void *data);
-static void nxt_openssl_conn_io_read(nxt_task_t *task, void *obj, void *data);
-static void nxt_openssl_conn_io_shutdown(nxt_task_t *task, void *obj,
-    void *data);
-static ssize_t nxt_openssl_conn_io_write_chunk(nxt_conn_t *c, nxt_buf_t *b,
-    size_t limit);
-static ssize_t nxt_openssl_conn_io_send(nxt_conn_t *c, void *buf, size_t size);
+static ssize_t nxt_openssl_conn_io_recvbuf(nxt_conn_t *c, nxt_buf_t *b);
+static void nxt_openssl_conn_io_write(nxt_task_t *task, void *obj, void *data);
+static ssize_t nxt_openssl_conn_io_sendbuf(nxt_task_t *task, nxt_conn_t *c,
+    nxt_buf_t *b);
+static ssize_t nxt_openssl_conn_copy(nxt_task_t *task, nxt_buf_t *b,
+    u_char *p, size_t size);
 static nxt_int_t nxt_openssl_conn_test_error(nxt_task_t *task,
     nxt_conn_t *c, int ret, nxt_err_t sys_err, nxt_work_handler_t handler);
-static void nxt_cdecl nxt_openssl_conn_error(nxt_conn_t *c, nxt_err_t err,
+static void nxt_cdecl nxt_openssl_conn_error(nxt_task_t *task, nxt_err_t err,
     const char *fmt, ...);
-static nxt_uint_t nxt_openssl_log_error_level(nxt_conn_t *c, nxt_err_t err);
-static void nxt_cdecl nxt_openssl_log_error(nxt_uint_t level, nxt_log_t *log,
+static nxt_uint_t nxt_openssl_log_error_level(nxt_err_t err);
+static void nxt_cdecl nxt_openssl_log_error(nxt_task_t *task, nxt_uint_t level,
     const char *fmt, ...);
 static u_char *nxt_openssl_copy_error(u_char *p, u_char *end);
 
@@ -45,6 +109,7 @@ static u_char *nxt_openssl_copy_error(u_char *p, u_char *end);
 const nxt_ssltls_lib_t  nxt_openssl_lib = {
     nxt_openssl_server_init,
     NULL,
+    nxt_openssl_chain_check,
 };
 
 
@@ -52,26 +117,53 @@ static nxt_conn_io_t  nxt_openssl_conn_io = {
     NULL,
     NULL,
 
-    nxt_openssl_conn_io_read,
+    nxt_conn_io_read,
+    nxt_openssl_conn_io_recvbuf,
+    NULL,
+
+    nxt_openssl_conn_io_write,
+    NULL,
+    NULL,
     NULL,
     NULL,
 
+    NULL,
+};
+
+
+#if (NXT_OPENSSL_KTLS)
+
+/*
+ * After the handshake the kernel TLS encrypts the data written to
+ * a socket, so responses are sent with writev() and sendfile().
+ */
+
+static nxt_conn_io_t  nxt_openssl_ktls_conn_io = {
+    NULL,
+    NULL,
+
+    nxt_conn_io_read,
+    nxt_openssl_conn_io_recvbuf,
+    NULL,
+
     nxt_conn_io_write,
-    nxt_openssl_conn_io_write_chunk,
     NULL,
     NULL,
-    nxt_openssl_conn_io_send,
+    NULL,
+    NULL,
 
-    nxt_openssl_conn_io_shutdown,
+    NULL,
 };
 
+#endif
+
 
 static long  nxt_openssl_version;
-static int   nxt_openssl_connection_index;
+static int   nxt_openssl_context_index;
 
 
 static nxt_int_t
-nxt_openssl_start(nxt_thread_t *thr)
+nxt_openssl_start(nxt_task_t *task)
 {
     int  index;
 
@@ -79,6 +171,21 @@ nxt_openssl_start(nxt_thread_t *thr)
         return NXT_OK;
     }
 
+#if (OPENSSL_VERSION_NUMBER >= 0x10100003L)
+
+    if (OPENSSL_init_ssl(OPENSSL_INIT_LOAD_CONFIG, NULL) == 0) {
+        nxt_openssl_log_error(task, NXT_LOG_CRIT,
+                              "OPENSSL_init_ssl() failed");
+        return NXT_ERROR;
+    }
+
+    nxt_openssl_version = OpenSSL_version_num();
+
+    nxt_log(task, NXT_LOG_INFO, "%s, %xl",
+            OpenSSL_version(OPENSSL_VERSION), nxt_openssl_version);
+
+#else
+
     SSL_load_error_strings();
 
     OPENSSL_config(NULL);
@@ -93,8 +200,10 @@ nxt_openssl_start(nxt_thread_t *thr)
 
     nxt_openssl_version = SSLeay();
 
-    nxt_log_error(NXT_LOG_INFO, thr->log, "%s, %xl",
-                  SSLeay_version(SSLEAY_VERSION), nxt_openssl_version);
+    nxt_log(task, NXT_LOG_INFO, "%s, %xl",
+            SSLeay_version(SSLEAY_VERSION), nxt_openssl_version);
+
+#endif
 
 #ifndef SSL_OP_NO_COMPRESSION
     {
@@ -113,37 +222,48 @@ nxt_openssl_start(nxt_thread_t *thr)
     }
 #endif
 
-    index = SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL);
+    index = SSL_CTX_get_ex_new_index(0, NULL, NULL, NULL, NULL);
 
     if (index == -1) {
-        nxt_openssl_log_error(NXT_LOG_CRIT, thr->log,
-                              "SSL_get_ex_new_index() failed");
+        nxt_openssl_log_error(task, NXT_LOG_CRIT,
+                              "SSL_CTX_get_ex_new_index() failed");
         return NXT_ERROR;
     }
 
-    nxt_openssl_connection_index = index;
+    nxt_openssl_context_index = index;
 
     return NXT_OK;
 }
 
 
 static nxt_int_t
-nxt_openssl_server_init(nxt_ssltls_conf_t *conf)
+nxt_openssl_server_init(nxt_task_t *task, nxt_ssltls_conf_t *conf,
+    nxt_mp_t *mp)
 {
-    SSL_CTX              *ctx;
-    const char           *certificate, *key, *ciphers, *ca_certificate;
-    nxt_thread_t         *thr;
-    STACK_OF(X509_NAME)  *list;
-
-    thr = nxt_thread();
+    SSL_CTX                *ctx;
+    const char             *ciphers, *ca_certificate;
+    nxt_openssl_tickets_t  *tickets;
+    STACK_OF(X509_NAME)    *list;
 
-    if (nxt_openssl_start(thr) != NXT_OK) {
+    if (nxt_openssl_start(task) != NXT_OK) {
         return NXT_ERROR;
     }
 
+#if (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+    ctx = SSL_CTX_new(TLS_server_method());
+#else
     ctx = SSL_CTX_new(SSLv23_server_method());
+#endif
+
     if (ctx == NULL) {
-        nxt_openssl_log_error(NXT_LOG_CRIT, thr->log, "SSL_CTX_new() failed");
+        nxt_openssl_log_error(task, NXT_LOG_CRIT, "SSL_CTX_new() failed");
+        return NXT_ERROR;
+    }
+
+    if (nxt_mp_cleanup(mp, nxt_openssl_ctx_cleanup, task, ctx, NULL)
+        != NXT_OK)
+    {
+        SSL_CTX_free(ctx);
         return NXT_ERROR;
     }
 
@@ -158,6 +278,22 @@ nxt_openssl_server_init(nxt_ssltls_conf_t *conf)
     SSL_CTX_set_options(ctx, SSL_OP_NO_COMPRESSION);
 #endif
 
+#ifdef SSL_OP_NO_RENEGOTIATION
+    /*
+     * A renegotiation would require to read a socket while
+     * writing a response and vice versa.
+     */
+    SSL_CTX_set_options(ctx, SSL_OP_NO_RENEGOTIATION);
+#endif
+
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+    /*
+     * Clients often close connections without the "close notify" alert,
+     * so such a close is handled as a normal one.
+     */
+    SSL_CTX_set_options(ctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+
 #ifdef SSL_MODE_RELEASE_BUFFERS
 
     if (nxt_openssl_version >= 10001078) {
@@ -171,31 +307,25 @@ nxt_openssl_server_init(nxt_ssltls_conf_t *conf)
 
 #endif
 
-    certificate = conf->certificate;
-
-    if (SSL_CTX_use_certificate_chain_file(ctx, certificate) == 0) {
-        nxt_openssl_log_error(NXT_LOG_CRIT, thr->log,
-                              "SSL_CTX_use_certificate_file(\"%s\") failed",
-                              certificate);
-        goto fail;
-    }
-
-    key = conf->certificate_key;
+#if (NXT_OPENSSL_KTLS)
+    /*
+     * OpenSSL enables the "tls" TCP upper layer protocol on a socket
+     * after the handshake, if the kernel supports the negotiated cipher.
+     */
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#endif
 
-    if (SSL_CTX_use_PrivateKey_file(ctx, key, SSL_FILETYPE_PEM) == 0) {
-        nxt_openssl_log_error(NXT_LOG_CRIT, thr->log,
-                              "SSL_CTX_use_PrivateKey_file(\"%s\") failed",
-                              key);
-        goto fail;
+    if (nxt_openssl_chain_file_load(task, ctx, conf->chain_file) != NXT_OK) {
+        return NXT_ERROR;
     }
 
     ciphers = (conf->ciphers != NULL) ? conf->ciphers : "HIGH:!aNULL:!MD5";
 
     if (SSL_CTX_set_cipher_list(ctx, ciphers) == 0) {
-        nxt_openssl_log_error(NXT_LOG_CRIT, thr->log,
+        nxt_openssl_log_error(task, NXT_LOG_CRIT,
                               "SSL_CTX_set_cipher_list(\"%s\") failed",
                               ciphers);
-        goto fail;
+        return NXT_ERROR;
     }
 
     SSL_CTX_set_options(ctx, SSL_OP_CIPHER_SERVER_PREFERENCE);
@@ -211,19 +341,19 @@ nxt_openssl_server_init(nxt_ssltls_conf_t *conf)
         ca_certificate = conf->ca_certificate;
 
         if (SSL_CTX_load_verify_locations(ctx, ca_certificate, NULL) == 0) {
-            nxt_openssl_log_error(NXT_LOG_CRIT, thr->log,
+            nxt_openssl_log_error(task, NXT_LOG_CRIT,
                               "SSL_CTX_load_verify_locations(\"%s\") failed",
                               ca_certificate);
-            goto fail;
+            return NXT_ERROR;
         }
 
         list = SSL_load_client_CA_file(ca_certificate);
 
         if (list == NULL) {
-            nxt_openssl_log_error(NXT_LOG_CRIT, thr->log,
+            nxt_openssl_log_error(task, NXT_LOG_CRIT,
                               "SSL_load_client_CA_file(\"%s\") failed",
                               ca_certificate);
-            goto fail;
+            return NXT_ERROR;
         }
 
         /*
@@ -235,26 +365,437 @@ nxt_openssl_server_init(nxt_ssltls_conf_t *conf)
         SSL_CTX_set_client_CA_list(ctx, list);
     }
 
+    /*
+     * The context is shared by all router engines, so its built-in
+     * session cache resumes sessions established in any engine.
+     */
+
+    if (conf->session_cache != 0) {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(ctx, conf->session_cache);
+
+    } else {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    }
+
+    SSL_CTX_set_timeout(ctx, conf->session_timeout);
+
+    if (SSL_CTX_set_session_id_context(ctx, conf->name.start,
+                                   nxt_min(conf->name.length,
+                                           SSL_MAX_SID_CTX_LENGTH))
+        == 0)
+    {
+        nxt_openssl_log_error(task, NXT_LOG_CRIT,
+                              "SSL_CTX_set_session_id_context() failed");
+        return NXT_ERROR;
+    }
+
+    tickets = nxt_mp_zget(mp, sizeof(nxt_openssl_tickets_t));
+    if (nxt_slow_path(tickets == NULL)) {
+        return NXT_ERROR;
+    }
+
+    tickets->lifetime = conf->session_timeout;
+
+    if (SSL_CTX_set_ex_data(ctx, nxt_openssl_context_index, tickets) == 0) {
+        nxt_openssl_log_error(task, NXT_LOG_CRIT,
+                              "SSL_CTX_set_ex_data() failed");
+        return NXT_ERROR;
+    }
+
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, nxt_openssl_ticket_key_callback);
+#else
+    SSL_CTX_set_tlsext_ticket_key_cb(ctx, nxt_openssl_ticket_key_callback);
+#endif
+
+#ifdef TLSEXT_TYPE_application_layer_protocol_negotiation
+    SSL_CTX_set_alpn_select_cb(ctx, nxt_openssl_alpn_select, NULL);
+#endif
+
     return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_openssl_chain_check(nxt_task_t *task, u_char *start, size_t length)
+{
+    SSL_CTX    *ctx;
+    nxt_int_t  ret;
+
+    if (nxt_openssl_start(task) != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+#if (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+    ctx = SSL_CTX_new(TLS_server_method());
+#else
+    ctx = SSL_CTX_new(SSLv23_server_method());
+#endif
+
+    if (ctx == NULL) {
+        nxt_openssl_log_error(task, NXT_LOG_CRIT, "SSL_CTX_new() failed");
+        return NXT_ERROR;
+    }
+
+    ret = nxt_openssl_chain_load(task, ctx, start, length, NXT_LOG_INFO);
+
+    SSL_CTX_free(ctx);
+
+    return (ret == NXT_OK) ? NXT_OK : NXT_DECLINED;
+}
+
+
+/*
+ * The first certificate of a bundle is the server certificate and the
+ * rest are the intermediate certificates; the private key can be placed
+ * anywhere in the bundle.
+ */
+
+static nxt_int_t
+nxt_openssl_chain_load(nxt_task_t *task, SSL_CTX *ctx, u_char *start,
+    size_t length, nxt_uint_t level)
+{
+    BIO        *bio;
+    X509       *cert, *ca;
+    u_long     err;
+    EVP_PKEY   *key;
+    nxt_int_t  ret;
+
+    ret = NXT_ERROR;
+
+    bio = BIO_new_mem_buf(start, length);
+    if (bio == NULL) {
+        nxt_openssl_log_error(task, NXT_LOG_CRIT, "BIO_new_mem_buf() failed");
+        return NXT_ERROR;
+    }
+
+    cert = PEM_read_bio_X509_AUX(bio, NULL, NULL, NULL);
+    if (cert == NULL) {
+        nxt_openssl_log_error(task, level, "PEM_read_bio_X509_AUX() failed");
+        goto fail;
+    }
+
+    if (SSL_CTX_use_certificate(ctx, cert) != 1) {
+        X509_free(cert);
+        nxt_openssl_log_error(task, level, "SSL_CTX_use_certificate() failed");
+        goto fail;
+    }
+
+    X509_free(cert);
+
+    for ( ;; ) {
+        ca = PEM_read_bio_X509(bio, NULL, NULL, NULL);
+
+        if (ca == NULL) {
+            err = ERR_peek_last_error();
+
+            if (ERR_GET_LIB(err) == ERR_LIB_PEM
+                && ERR_GET_REASON(err) == PEM_R_NO_START_LINE)
+            {
+                ERR_clear_error();
+                break;
+            }
+
+            nxt_openssl_log_error(task, level, "PEM_read_bio_X509() failed");
+            goto fail;
+        }
+
+        if (SSL_CTX_add0_chain_cert(ctx, ca) != 1) {
+            X509_free(ca);
+            nxt_openssl_log_error(task, level,
+                                  "SSL_CTX_add0_chain_cert() failed");
+            goto fail;
+        }
+    }
+
+    BIO_free(bio);
+
+    bio = BIO_new_mem_buf(start, length);
+    if (bio == NULL) {
+        nxt_openssl_log_error(task, NXT_LOG_CRIT, "BIO_new_mem_buf() failed");
+        return NXT_ERROR;
+    }
+
+    key = PEM_read_bio_PrivateKey(bio, NULL, NULL, NULL);
+    if (key == NULL) {
+        nxt_openssl_log_error(task, level, "PEM_read_bio_PrivateKey() failed");
+        goto fail;
+    }
+
+    if (SSL_CTX_use_PrivateKey(ctx, key) != 1) {
+        EVP_PKEY_free(key);
+        nxt_openssl_log_error(task, level, "SSL_CTX_use_PrivateKey() failed");
+        goto fail;
+    }
+
+    EVP_PKEY_free(key);
+
+    if (SSL_CTX_check_private_key(ctx) != 1) {
+        nxt_openssl_log_error(task, level,
+                              "SSL_CTX_check_private_key() failed");
+        goto fail;
+    }
+
+    ret = NXT_OK;
 
 fail:
 
+    BIO_free(bio);
+
+    return ret;
+}
+
+
+static nxt_int_t
+nxt_openssl_chain_file_load(nxt_task_t *task, SSL_CTX *ctx, nxt_fd_t fd)
+{
+    u_char           *buf;
+    size_t           size;
+    ssize_t          n;
+    nxt_int_t        ret;
+    nxt_file_t       file;
+    nxt_file_info_t  fi;
+
+    nxt_memzero(&file, sizeof(nxt_file_t));
+
+    file.fd = fd;
+    file.name = (nxt_file_name_t *) "certificate";
+
+    if (nxt_file_info(&file, &fi) != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    size = nxt_file_size(&fi);
+
+    buf = nxt_malloc(size);
+    if (nxt_slow_path(buf == NULL)) {
+        return NXT_ERROR;
+    }
+
+    n = nxt_file_read(&file, buf, size, 0);
+
+    if (n == (ssize_t) size) {
+        ret = nxt_openssl_chain_load(task, ctx, buf, size, NXT_LOG_CRIT);
+
+    } else {
+        nxt_log(task, NXT_LOG_CRIT, "certificate file was truncated");
+        ret = NXT_ERROR;
+    }
+
+    nxt_free(buf);
+
+    return ret;
+}
+
+
+static void
+nxt_openssl_ctx_cleanup(nxt_task_t *task, void *obj, void *data)
+{
+    SSL_CTX  *ctx;
+
+    ctx = obj;
+
+    /* The connections still in progress keep their references. */
+
     SSL_CTX_free(ctx);
+}
+
+
+static int
+nxt_openssl_ticket_key_callback(SSL *s, u_char *name, u_char *iv,
+    EVP_CIPHER_CTX *ectx, nxt_openssl_hmac_t *hctx, int enc)
+{
+    nxt_uint_t                i;
+    nxt_time_t                now;
+    nxt_openssl_tickets_t     *tickets;
+    nxt_openssl_ticket_key_t  key, *k;
+
+    tickets = SSL_CTX_get_ex_data(SSL_get_SSL_CTX(s),
+                                  nxt_openssl_context_index);
+
+    now = nxt_thread_time(nxt_thread());
+
+    if (enc == 1) {
+        if (nxt_openssl_ticket_key(tickets, now, &key) != NXT_OK) {
+            return -1;
+        }
+
+        if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1) {
+            return -1;
+        }
+
+        if (EVP_EncryptInit_ex(ectx, EVP_aes_256_cbc(), NULL, key.aes_key, iv)
+            != 1)
+        {
+            return -1;
+        }
+
+        if (nxt_openssl_ticket_hmac_init(hctx, &key) != NXT_OK) {
+            return -1;
+        }
+
+        nxt_memcpy(name, key.name, sizeof(key.name));
+
+        return 1;
+    }
+
+    nxt_thread_spin_lock(&tickets->lock);
+
+    for (i = 0; i < 2; i++) {
+        k = &tickets->keys[i];
+
+        if (nxt_memcmp(name, k->name, sizeof(k->name)) == 0
+            && now < k->created + 2 * tickets->lifetime)
+        {
+            key = *k;
+            break;
+        }
+    }
+
+    nxt_thread_spin_unlock(&tickets->lock);
+
+    if (i == 2) {
+        /* An unknown or expired key, a full handshake is required. */
+        return 0;
+    }
+
+    if (nxt_openssl_ticket_hmac_init(hctx, &key) != NXT_OK) {
+        return -1;
+    }
+
+    if (EVP_DecryptInit_ex(ectx, EVP_aes_256_cbc(), NULL, key.aes_key, iv)
+        != 1)
+    {
+        return -1;
+    }
 
-    return NXT_ERROR;
+    /* A ticket encrypted with the previous key is renewed. */
+
+    return (i == 0) ? 1 : 2;
 }
 
 
+static nxt_int_t
+nxt_openssl_ticket_key(nxt_openssl_tickets_t *tickets, nxt_time_t now,
+    nxt_openssl_ticket_key_t *key)
+{
+    nxt_bool_t  expired;
+
+    nxt_thread_spin_lock(&tickets->lock);
+
+    expired = (now >= tickets->keys[0].created + tickets->lifetime);
+
+    if (!expired) {
+        *key = tickets->keys[0];
+    }
+
+    nxt_thread_spin_unlock(&tickets->lock);
+
+    if (!expired) {
+        return NXT_OK;
+    }
+
+    /* The new key is generated outside of the lock. */
+
+    if (RAND_bytes(key->name, sizeof(key->name)) != 1
+        || RAND_bytes(key->aes_key, sizeof(key->aes_key)) != 1
+        || RAND_bytes(key->hmac_key, sizeof(key->hmac_key)) != 1)
+    {
+        return NXT_ERROR;
+    }
+
+    key->created = now;
+
+    nxt_thread_spin_lock(&tickets->lock);
+
+    if (now >= tickets->keys[0].created + tickets->lifetime) {
+        tickets->keys[1] = tickets->keys[0];
+        tickets->keys[0] = *key;
+
+    } else {
+        /* Another engine has already rotated the keys. */
+        *key = tickets->keys[0];
+    }
+
+    nxt_thread_spin_unlock(&tickets->lock);
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_openssl_ticket_hmac_init(nxt_openssl_hmac_t *hctx,
+    nxt_openssl_ticket_key_t *key)
+{
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+
+    OSSL_PARAM  params[3];
+
+    static char  digest[] = "SHA256";
+
+    params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY,
+                                                  key->hmac_key,
+                                                  sizeof(key->hmac_key));
+    params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                                                 digest, 0);
+    params[2] = OSSL_PARAM_construct_end();
+
+    if (EVP_MAC_CTX_set_params(hctx, params) != 1) {
+        return NXT_ERROR;
+    }
+
+#else
+
+    if (HMAC_Init_ex(hctx, key->hmac_key, sizeof(key->hmac_key),
+                     EVP_sha256(), NULL)
+        != 1)
+    {
+        return NXT_ERROR;
+    }
+
+#endif
+
+    return NXT_OK;
+}
+
+
+#ifdef TLSEXT_TYPE_application_layer_protocol_negotiation
+
+static int
+nxt_openssl_alpn_select(SSL *s, const unsigned char **out,
+    unsigned char *outlen, const unsigned char *in, unsigned int inlen,
+    void *arg)
+{
+    int            ret;
+    unsigned char  *p;
+
+    /* HTTP/2 is preferred, a client sends its preface anyway. */
+
+    static const unsigned char  protocols[] = "\x02h2\x08http/1.1";
+
+    ret = SSL_select_next_proto(&p, outlen, protocols, sizeof(protocols) - 1,
+                                in, inlen);
+
+    if (ret != OPENSSL_NPN_NEGOTIATED) {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+
+    *out = p;
+
+    return SSL_TLSEXT_ERR_OK;
+}
+
+#endif
+
+
 static void
 nxt_openssl_conn_init(nxt_task_t *task, nxt_ssltls_conf_t *conf, nxt_conn_t *c)
 {
-    int                     ret;
-    SSL                     *s;
-    SSL_CTX                 *ctx;
-    nxt_openssl_conn_t      *ssltls;
-    nxt_mem_pool_cleanup_t  *mpcl;
+    SSL                 *s;
+    nxt_openssl_conn_t  *ssltls;
 
-    nxt_log_debug(c->socket.log, "openssl conn init");
+    nxt_debug(task, "openssl conn init");
 
     ssltls = nxt_mp_zget(c->mem_pool, sizeof(nxt_openssl_conn_t));
     if (ssltls == NULL) {
@@ -262,41 +803,31 @@ nxt_openssl_conn_init(nxt_task_t *task, nxt_ssltls_conf_t *conf, nxt_conn_t *c)
     }
 
     c->u.ssltls = ssltls;
-    nxt_buf_mem_set_size(&ssltls->buffer, conf->buffer_size);
-
-    mpcl = nxt_mem_pool_cleanup(c->mem_pool, 0);
-    if (mpcl == NULL) {
-        goto fail;
-    }
 
-    ctx = conf->ctx;
-
-    s = SSL_new(ctx);
+    s = SSL_new(conf->ctx);
     if (s == NULL) {
-        nxt_openssl_log_error(NXT_LOG_CRIT, c->socket.log, "SSL_new() failed");
+        nxt_openssl_log_error(task, NXT_LOG_CRIT, "SSL_new() failed");
         goto fail;
     }
 
     ssltls->session = s;
-    mpcl->handler = nxt_openssl_session_cleanup;
-    mpcl->data = ssltls;
-
-    ret = SSL_set_fd(s, c->socket.fd);
 
-    if (ret == 0) {
-        nxt_openssl_log_error(NXT_LOG_CRIT, c->socket.log,
-                              "SSL_set_fd(%d) failed", c->socket.fd);
+    if (nxt_mp_cleanup(c->mem_pool, nxt_openssl_conn_cleanup,
+                       &task->thread->engine->task, ssltls, NULL)
+        != NXT_OK)
+    {
+        SSL_free(s);
         goto fail;
     }
 
-    SSL_set_accept_state(s);
-
-    if (SSL_set_ex_data(s, nxt_openssl_connection_index, c) == 0) {
-        nxt_openssl_log_error(NXT_LOG_CRIT, c->socket.log,
-                              "SSL_set_ex_data() failed");
+    if (SSL_set_fd(s, c->socket.fd) == 0) {
+        nxt_openssl_log_error(task, NXT_LOG_CRIT, "SSL_set_fd(%d) failed",
+                              c->socket.fd);
         goto fail;
     }
 
+    SSL_set_accept_state(s);
+
     c->io = &nxt_openssl_conn_io;
     c->sendfile = NXT_CONN_SENDFILE_OFF;
 
@@ -311,15 +842,20 @@ fail:
 
 
 static void
-nxt_openssl_session_cleanup(nxt_task_t *task, void *data)
+nxt_openssl_conn_cleanup(nxt_task_t *task, void *obj, void *data)
 {
     nxt_openssl_conn_t  *ssltls;
 
-    ssltls = data;
+    ssltls = obj;
 
-    nxt_debug(task, "openssl session cleanup");
+    nxt_debug(task, "openssl conn cleanup");
 
-    nxt_free(ssltls->buffer.start);
+    /*
+     * The socket is already closed, so the "close notify" alert is
+     * not sent, however, the session is kept in the session cache.
+     */
+    SSL_set_shutdown(ssltls->session,
+                     SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
 
     SSL_free(ssltls->session);
 }
@@ -332,14 +868,18 @@ nxt_openssl_conn_handshake(nxt_task_t *task, void *obj, void *data)
     nxt_int_t           n;
     nxt_err_t           err;
     nxt_conn_t          *c;
+    nxt_work_handler_t  handler;
+    nxt_event_engine_t  *engine;
     nxt_openssl_conn_t  *ssltls;
 
     c = obj;
     ssltls = c->u.ssltls;
 
-    nxt_debug(task, "openssl conn handshake: %d", ssltls->times);
+    nxt_debug(task, "openssl conn handshake");
+
+    engine = task->thread->engine;
 
-    /* "ssltls->times == 1" is suitable to run SSL_do_handshake() in job. */
+    c->socket.error_handler = c->read_state->error_handler;
 
     ret = SSL_do_handshake(ssltls->session);
 
@@ -351,233 +891,310 @@ nxt_openssl_conn_handshake(nxt_task_t *task, void *obj, void *data)
 
     if (ret > 0) {
         /* ret == 1, the handshake was successfully completed. */
-        nxt_openssl_conn_io_read(task, c, data);
+
+        nxt_timer_disable(engine, &c->read_timer);
+
+#if (NXT_OPENSSL_KTLS)
+
+        if (BIO_get_ktls_send(SSL_get_wbio(ssltls->session))) {
+            nxt_debug(task, "openssl conn ktls send");
+
+            c->io = &nxt_openssl_ktls_conn_io;
+            c->sendfile = NXT_CONN_SENDFILE_ON;
+        }
+
+#endif
+
+        nxt_conn_wait(c);
         return;
     }
 
     n = nxt_openssl_conn_test_error(task, c, ret, err,
                                     nxt_openssl_conn_handshake);
 
+    if (n == NXT_AGAIN) {
+        if (c->read_timer.state == NXT_TIMER_DISABLED) {
+            nxt_conn_timer(engine, c, c->read_state, &c->read_timer);
+        }
+
+        return;
+    }
+
     if (n == NXT_ERROR) {
-        nxt_openssl_conn_error(c, err, "SSL_do_handshake(%d) failed",
+        nxt_openssl_conn_error(task, err, "SSL_do_handshake(%d) failed",
                                c->socket.fd);
 
-        nxt_work_queue_add(c->read_work_queue, c->read_state->error_handler,
-                           task, c, data);
+        handler = c->read_state->error_handler;
 
-    } else if (ssltls->ssl_error == SSL_ERROR_WANT_READ && ssltls->times < 2) {
-        ssltls->times++;
+    } else {
+        handler = c->read_state->close_handler;
     }
+
+    nxt_work_queue_add(c->read_work_queue, handler, task, c, data);
 }
 
 
-static void
-nxt_openssl_conn_io_read(nxt_task_t *task, void *obj, void *data)
+static ssize_t
+nxt_openssl_conn_io_recvbuf(nxt_conn_t *c, nxt_buf_t *b)
 {
     int                 ret;
-    nxt_buf_t           *b;
+    size_t              size;
     nxt_int_t           n;
     nxt_err_t           err;
+    nxt_task_t          *task;
+    nxt_openssl_conn_t  *ssltls;
+
+    ssltls = c->u.ssltls;
+    task = c->socket.task;
+
+    size = b->mem.end - b->mem.free;
+
+    ret = SSL_read(ssltls->session, b->mem.free, size);
+
+    err = (ret <= 0) ? nxt_socket_errno : 0;
+
+    nxt_debug(task, "SSL_read(%d, %p, %uz): %d err:%d",
+              c->socket.fd, b->mem.free, size, ret, err);
+
+    if (ret > 0) {
+        /* c->socket.read_ready is kept. */
+        return ret;
+    }
+
+    n = nxt_openssl_conn_test_error(task, c, ret, err, c->io->read);
+
+    if (n == NXT_ERROR) {
+        nxt_openssl_conn_error(task, err, "SSL_read(%d, %p, %uz) failed",
+                               c->socket.fd, b->mem.free, size);
+    }
+
+    return n;
+}
+
+
+/*
+ * A record is copied from the buffer chain, however, the chain is
+ * updated only when the record has been written, so the last response
+ * bytes are not considered sent while they are buffered.  If SSL_write()
+ * can not complete, the same record is written again.
+ */
+
+static void
+nxt_openssl_conn_io_write(nxt_task_t *task, void *obj, void *data)
+{
+    size_t              limit;
+    ssize_t             ret;
+    nxt_buf_t           *b;
+    nxt_off_t           sent;
     nxt_conn_t          *c;
-    nxt_work_handler_t  handler;
+    nxt_event_engine_t  *engine;
     nxt_openssl_conn_t  *ssltls;
 
     c = obj;
 
-    nxt_debug(task, "openssl conn read");
+    nxt_debug(task, "openssl conn write fd:%d", c->socket.fd);
+
+    if (!c->socket.write_ready || c->write == NULL) {
+        return;
+    }
+
+    engine = task->thread->engine;
 
-    handler = c->read_state->ready_handler;
-    b = c->read;
+    c->socket.write_handler = nxt_openssl_conn_io_write;
+    c->socket.error_handler = c->write_state->error_handler;
 
-    /* b == NULL is used to test descriptor readiness. */
+    ssltls = c->u.ssltls;
 
-    if (b != NULL) {
-        ssltls = c->u.ssltls;
+    if (engine->timers.now - ssltls->last >= NXT_SSLTLS_IDLE_TIMEOUT) {
+        ssltls->boost = 0;
+    }
 
-        ret = SSL_read(ssltls->session, b->mem.free, b->mem.end - b->mem.free);
+    b = c->write;
+    sent = 0;
+    limit = 10 * 1024 * 1024;
 
-        err = (ret <= 0) ? nxt_socket_errno : 0;
+    for ( ;; ) {
+        ret = nxt_openssl_conn_io_sendbuf(task, c, b);
 
-        nxt_debug(task, "SSL_read(%d, %p, %uz): %d err:%d",
-                  c->socket.fd, b->mem.free, b->mem.end - b->mem.free,
-                  ret, err);
+        if (ret < 0) {
+            /* ret == NXT_AGAIN || ret == NXT_ERROR. */
+            break;
+        }
 
-        if (ret > 0) {
-            /* c->socket.read_ready is kept. */
-            b->mem.free += ret;
-            handler = c->read_state->ready_handler;
+        sent += ret;
 
-        } else {
-            n = nxt_openssl_conn_test_error(task, c, ret, err,
-                                            nxt_openssl_conn_io_read);
+        b = nxt_sendbuf_update(b, ret);
 
-            if (nxt_fast_path(n != NXT_ERROR)) {
-                return;
-            }
+        if (b == NULL) {
+            /* The whole chain has been sent, the buffer is released. */
+            nxt_mp_free(c->mem_pool, ssltls->buffer.start);
+            nxt_memzero(&ssltls->buffer, sizeof(nxt_buf_mem_t));
 
-            nxt_openssl_conn_error(c, err, "SSL_read(%d, %p, %uz) failed",
-                                   c->socket.fd, b->mem.free,
-                                   b->mem.end - b->mem.free);
+            nxt_fd_event_block_write(engine, &c->socket);
+            break;
+        }
 
-            handler = c->read_state->error_handler;
+        if (ret == 0 || (size_t) sent >= limit) {
+            break;
         }
     }
 
-    nxt_work_queue_add(c->read_work_queue, handler, task, c, data);
-}
+    ssltls->last = engine->timers.now;
 
+    nxt_debug(task, "openssl conn: %z sent:%O", ret, sent);
 
-static ssize_t
-nxt_openssl_conn_io_write_chunk(nxt_conn_t *c, nxt_buf_t *b, size_t limit)
-{
-    nxt_openssl_conn_t  *ssltls;
+    if (sent != 0) {
+        if (c->write_state->timer_autoreset) {
+            nxt_timer_disable(engine, &c->write_timer);
+        }
+    }
 
-    nxt_debug(c->socket.task, "openssl conn write chunk");
+    if (ret == NXT_AGAIN) {
+        nxt_conn_timer(engine, c, c->write_state, &c->write_timer);
 
-    ssltls = c->u.ssltls;
+        if (nxt_fd_event_is_disabled(c->socket.write)) {
+            nxt_fd_event_enable_write(engine, &c->socket);
+        }
+
+    } else if (ret >= 0 && b != NULL) {
+        /* Postpone writing until next event poll. */
+        nxt_work_queue_add(&engine->fast_work_queue, nxt_openssl_conn_io_write,
+                           task, c, data);
+    }
 
-    return nxt_sendbuf_copy_coalesce(c, &ssltls->buffer, b, limit);
+    if (ret == 0 || sent != 0) {
+        /* "ret == 0" means a sync buffer was processed. */
+        c->sent += sent;
+        nxt_work_queue_add(c->write_work_queue, c->write_state->ready_handler,
+                           task, c, data);
+    }
+
+    if (nxt_slow_path(ret == NXT_ERROR)) {
+        nxt_fd_event_block_write(engine, &c->socket);
+
+        nxt_work_queue_add(c->write_work_queue, c->write_state->error_handler,
+                           task, c, data);
+    }
 }
 
 
 static ssize_t
-nxt_openssl_conn_io_send(nxt_conn_t *c, void *buf, size_t size)
+nxt_openssl_conn_io_sendbuf(nxt_task_t *task, nxt_conn_t *c, nxt_buf_t *b)
 {
     int                 ret;
+    size_t              size;
+    ssize_t             n;
     nxt_err_t           err;
-    nxt_int_t           n;
+    nxt_buf_mem_t       *bm;
     nxt_openssl_conn_t  *ssltls;
 
     ssltls = c->u.ssltls;
+    bm = &ssltls->buffer;
 
-    ret = SSL_write(ssltls->session, buf, size);
+    if (bm->pos == bm->free) {
 
-    if (ret <= 0) {
-        err = nxt_socket_errno;
-        c->socket.error = err;
+        if (bm->start == NULL) {
+            bm->start = nxt_mp_alloc(c->mem_pool, NXT_SSLTLS_BUFFER_SIZE);
+            if (nxt_slow_path(bm->start == NULL)) {
+                return NXT_ERROR;
+            }
 
-    } else {
-        err = 0;
-    }
+            bm->end = bm->start + NXT_SSLTLS_BUFFER_SIZE;
+        }
 
-    nxt_log_debug(c->socket.log, "SSL_write(%d, %p, %uz): %d err:%d",
-                  c->socket.fd, buf, size, ret, err);
+        size = (ssltls->boost < NXT_SSLTLS_BOOST_SIZE)
+               ? NXT_SSLTLS_RECORD_SIZE : NXT_SSLTLS_BUFFER_SIZE;
 
-    if (ret > 0) {
-        return ret;
-    }
+        n = nxt_openssl_conn_copy(task, b, bm->start, size);
 
-    n = nxt_openssl_conn_test_error(c->socket.task, c, ret, err,
-                                    nxt_conn_io_write);
+        if (n <= 0) {
+            /* n == 0 if the chain has only sync buffers. */
+            return n;
+        }
 
-    if (n == NXT_ERROR) {
-        nxt_openssl_conn_error(c, err, "SSL_write(%d, %p, %uz) failed",
-                               c->socket.fd, buf, size);
+        bm->pos = bm->start;
+        bm->free = bm->start + n;
     }
 
-    return n;
-}
-
+    size = bm->free - bm->pos;
 
-static void
-nxt_openssl_conn_io_shutdown(nxt_task_t *task, void *obj, void *data)
-{
-    int                 ret, mode;
-    SSL                 *s;
-    nxt_err_t           err;
-    nxt_int_t           n;
-    nxt_bool_t          quiet, once;
-    nxt_conn_t          *c;
-    nxt_work_handler_t  handler;
-    nxt_openssl_conn_t  *ssltls;
+    ret = SSL_write(ssltls->session, bm->pos, size);
 
-    c = obj;
+    err = (ret <= 0) ? nxt_socket_errno : 0;
 
-    nxt_debug(task, "openssl conn shutdown");
+    nxt_debug(task, "SSL_write(%d, %p, %uz): %d err:%d",
+              c->socket.fd, bm->pos, size, ret, err);
 
-    ssltls = c->u.ssltls;
-    s = ssltls->session;
+    if (ret > 0) {
+        bm->pos = bm->free;
+        ssltls->boost += ret;
 
-    if (s == NULL) {
-        handler = c->write_state->close_handler;
-        goto done;
+        return ret;
     }
 
-    mode = SSL_get_shutdown(s);
-
-    if (c->socket.timedout || c->socket.error != 0) {
-        quiet = 1;
+    n = nxt_openssl_conn_test_error(task, c, ret, err,
+                                    nxt_openssl_conn_io_write);
 
-    } else if (c->socket.closed && !(mode & SSL_RECEIVED_SHUTDOWN)) {
-        quiet = 1;
+    if (n == NXT_ERROR) {
+        nxt_openssl_conn_error(task, err, "SSL_write(%d, %p, %uz) failed",
+                               c->socket.fd, bm->pos, size);
 
-    } else {
-        quiet = 0;
+    } else if (n == 0) {
+        /* The connection was closed while writing. */
+        n = NXT_ERROR;
     }
 
-    SSL_set_quiet_shutdown(s, quiet);
-
-    once = 1;
+    return n;
+}
 
-    for ( ;; ) {
-        SSL_set_shutdown(s, mode);
 
-        ret = SSL_shutdown(s);
+static ssize_t
+nxt_openssl_conn_copy(nxt_task_t *task, nxt_buf_t *b, u_char *p, size_t size)
+{
+    size_t   copied, n, used;
+    ssize_t  ret;
 
-        err = (ret <= 0) ? nxt_socket_errno : 0;
+    copied = 0;
 
-        nxt_debug(task, "SSL_shutdown(%d, %d, %b): %d err:%d",
-                  c->socket.fd, mode, quiet, ret, err);
+    for ( /* void */ ; b != NULL && copied < size; b = b->next) {
 
-        if (ret > 0) {
-            /* ret == 1, the shutdown was successfully completed. */
-            handler = c->write_state->close_handler;
-            goto done;
+        if (nxt_buf_is_sync(b)) {
+            continue;
         }
 
-        if (ret == 0) {
-            /*
-             * If SSL_shutdown() returns 0 then it should be called
-             * again.  The second SSL_shutdown() call should returns
-             * -1/SSL_ERROR_WANT_READ or -1/SSL_ERROR_WANT_WRITE.
-             * OpenSSL prior to 0.9.8m version however never returns
-             * -1 at all.  Fortunately, OpenSSL internals preserve
-             * correct status available via SSL_get_error(-1).
-             */
-            if (once) {
-                mode = SSL_get_shutdown(s);
-                once = 0;
-                continue;
-            }
+        used = nxt_buf_used_size(b);
+        n = nxt_min(used, size - copied);
 
-            ret = -1;
+        if (n == 0) {
+            continue;
         }
 
-        /* ret == -1 */
-
-        break;
-    }
+        if (nxt_buf_is_file(b)) {
+            ret = nxt_file_read(b->file, p + copied, n, b->file_pos);
 
-    n = nxt_openssl_conn_test_error(task, c, ret, err,
-                                    nxt_openssl_conn_io_shutdown);
+            if (nxt_slow_path(ret <= 0)) {
+                if (ret == 0) {
+                    nxt_log(task, NXT_LOG_ERR, "file %FD was truncated",
+                            b->file->fd);
+                }
 
-    if (nxt_fast_path(n == 0)) {
-        return;
-    }
+                return NXT_ERROR;
+            }
 
-    if (n != NXT_ERROR) {  /* n == NXT_AGAIN */
-        c->socket.error_handler = c->read_state->error_handler;
-        nxt_timer_add(task->thread->engine, &c->read_timer, 5000);
-        return;
-    }
+            n = ret;
 
-    nxt_openssl_conn_error(c, err, "SSL_shutdown(%d) failed", c->socket.fd);
+        } else {
+            nxt_memcpy(p + copied, b->mem.pos, n);
+        }
 
-    handler = c->write_state->error_handler;
+        copied += n;
 
-done:
+        if (n < used) {
+            break;
+        }
+    }
 
-    nxt_work_queue_add(c->write_work_queue, handler, task, c, data);
+    return copied;
 }
 
 
@@ -586,20 +1203,17 @@ nxt_openssl_conn_test_error(nxt_task_t *task, nxt_conn_t *c, int ret,
     nxt_err_t sys_err, nxt_work_handler_t handler)
 {
     u_long              lib_err;
-    nxt_work_queue_t    *wq;
     nxt_openssl_conn_t  *ssltls;
 
     ssltls = c->u.ssltls;
 
     ssltls->ssl_error = SSL_get_error(ssltls->session, ret);
 
-    nxt_log_debug(c->socket.log, "SSL_get_error(): %d", ssltls->ssl_error);
+    nxt_debug(task, "SSL_get_error(): %d", ssltls->ssl_error);
 
     switch (ssltls->ssl_error) {
 
     case SSL_ERROR_WANT_READ:
-        nxt_fd_event_block_write(task->thread->engine, &c->socket);
-
         c->socket.read_ready = 0;
         c->socket.read_handler = handler;
 
@@ -610,8 +1224,6 @@ nxt_openssl_conn_test_error(nxt_task_t *task, nxt_conn_t *c, int ret,
         return NXT_AGAIN;
 
     case SSL_ERROR_WANT_WRITE:
-        nxt_fd_event_block_read(task->thread->engine, &c->socket);
-
         c->socket.write_ready = 0;
         c->socket.write_handler = handler;
 
@@ -638,18 +1250,6 @@ nxt_openssl_conn_test_error(nxt_task_t *task, nxt_conn_t *c, int ret,
 
     case SSL_ERROR_ZERO_RETURN:
         /* A "close notify" alert. */
-
-        if (c->read_state != NULL) {
-            wq = c->read_work_queue;
-            handler = c->read_state->close_handler;
-
-        } else {
-            wq = c->write_work_queue;
-            handler = c->write_state->close_handler;
-        }
-
-        nxt_work_queue_add(wq, handler, task, c, c->socket.data);
-
         return 0;
 
     default: /* SSL_ERROR_SSL, etc. */
@@ -660,17 +1260,16 @@ nxt_openssl_conn_test_error(nxt_task_t *task, nxt_conn_t *c, int ret,
 
 
 static void nxt_cdecl
-nxt_openssl_conn_error(nxt_conn_t *c, nxt_err_t err, const char *fmt, ...)
+nxt_openssl_conn_error(nxt_task_t *task, nxt_err_t err, const char *fmt, ...)
 {
     u_char      *p, *end;
     va_list     args;
     nxt_uint_t  level;
     u_char      msg[NXT_MAX_ERROR_STR];
 
-    c->socket.error = err;
-    level = nxt_openssl_log_error_level(c, err);
+    level = nxt_openssl_log_error_level(err);
 
-    if (nxt_log_level_enough(c->socket.log, level)) {
+    if (nxt_log_level_enough(task->log, level)) {
 
         end = msg + sizeof(msg);
 
@@ -684,7 +1283,7 @@ nxt_openssl_conn_error(nxt_conn_t *c, nxt_err_t err, const char *fmt, ...)
 
         p = nxt_openssl_copy_error(p, end);
 
-        nxt_log_error(level, c->socket.log, "%*s", p - msg, msg);
+        nxt_log(task, level, "%*s", p - msg, msg);
 
     } else {
         ERR_clear_error();
@@ -693,7 +1292,7 @@ nxt_openssl_conn_error(nxt_conn_t *c, nxt_err_t err, const char *fmt, ...)
 
 
 static nxt_uint_t
-nxt_openssl_log_error_level(nxt_conn_t *c, nxt_err_t err)
+nxt_openssl_log_error_level(nxt_err_t err)
 {
     switch (ERR_GET_REASON(ERR_peek_error())) {
 
@@ -706,7 +1305,9 @@ nxt_openssl_log_error_level(nxt_conn_t *c, nxt_err_t err)
     case SSL_R_ERROR_IN_RECEIVED_CIPHER_LIST:             /*  151 */
     case SSL_R_EXCESSIVE_MESSAGE_SIZE:                    /*  152 */
     case SSL_R_LENGTH_MISMATCH:                           /*  159 */
+#ifdef SSL_R_NO_CIPHERS_PASSED
     case SSL_R_NO_CIPHERS_PASSED:                         /*  182 */
+#endif
     case SSL_R_NO_CIPHERS_SPECIFIED:                      /*  183 */
     case SSL_R_NO_COMPRESSION_SPECIFIED:                  /*  187 */
     case SSL_R_NO_SHARED_CIPHER:                          /*  193 */
@@ -768,7 +1369,7 @@ nxt_openssl_log_error_level(nxt_conn_t *c, nxt_err_t err)
 
 
 static void nxt_cdecl
-nxt_openssl_log_error(nxt_uint_t level, nxt_log_t *log, const char *fmt, ...)
+nxt_openssl_log_error(nxt_task_t *task, nxt_uint_t level, const char *fmt, ...)
 {
     u_char   *p, *end;
     va_list  args;
@@ -782,7 +1383,7 @@ nxt_openssl_log_error(nxt_uint_t level, nxt_log_t *log, const char *fmt, ...)
 
     p = nxt_openssl_copy_error(p, end);
 
-    nxt_log_error(level, log, "%*s", p - msg, msg);
+    nxt_log(task, level, "%*s", p - msg, msg);
 }
 
 
@@ -812,7 +1413,11 @@ nxt_openssl_copy_error(u_char *p, u_char *end)
     clear = 0;
 
     for ( ;; ) {
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+        err = ERR_get_error_all(NULL, NULL, NULL, &data, &flags);
+#else
         err = ERR_get_error_line_data(NULL, NULL, &data, &flags);
+#endif
         if (err == 0) {
             break;
         }
@@ -123,6 +123,7 @@ typedef struct {
     nxt_str_t            script;
     nxt_app_wmsg_t       *wmsg;
 
+    nxt_app_fields_t     fields;
     size_t               body_preread_size;
 } nxt_php_run_ctx_t;
 
@@ -364,12 +365,14 @@ nxt_php_read_request(nxt_task_t *task, nxt_app_rmsg_t *rmsg,
     RC(nxt_app_msg_read_size(task, rmsg, &s));
     h->parsed_content_length = s;
 
+    RC(nxt_app_msg_read_fields(task, rmsg, &ctx->fields));
+
     RC(nxt_app_msg_read_size(task, ctx->rmsg, &ctx->body_preread_size));
 
 #undef NXT_READ
 #undef RC
 
-    /* Further headers read moved to nxt_php_register_variables. */
+    /* The fields are registered in nxt_php_register_variables(). */
     return NXT_OK;
 
 fail:
@@ -522,20 +525,13 @@ nxt_php_flush(void *server_context)
 static int
 nxt_php_send_headers(sapi_headers_struct *sapi_headers TSRMLS_DC)
 {
-    size_t               len;
-    u_char               *status, buf[64];
-    nxt_int_t            rc;
+    u_char               *colon, *value, *end;
+    nxt_int_t            rc, status;
+    nxt_uint_t           n;
     nxt_php_run_ctx_t    *ctx;
     sapi_header_struct   *h;
     zend_llist_position  zpos;
 
-    static const u_char default_repsonse[]
-        = "Status: 200\r\n"
-          "\r\n";
-
-    static const u_char status_200[] = "Status: 200";
-    static const u_char cr_lf[] = "\r\n";
-
     ctx = SG(server_context);
 
 #define RC(S)                                                                 \
@@ -547,46 +543,63 @@ nxt_php_send_headers(sapi_headers_struct *sapi_headers TSRMLS_DC)
     } while(0)
 
     if (SG(request_info).no_headers == 1) {
-        RC(nxt_php_write(ctx, default_repsonse, sizeof(default_repsonse) - 1,
-                      1, 0));
+        RC(nxt_app_msg_write_status(ctx->task, ctx->wmsg, 200, 0));
+        RC(nxt_app_msg_flush(ctx->task, ctx->wmsg, 0));
         return SAPI_HEADER_SENT_SUCCESSFULLY;
     }
 
     if (SG(sapi_headers).http_status_line) {
-        status = (u_char *) SG(sapi_headers).http_status_line;
-        len = nxt_strlen(status);
+        status = -1;
 
-        if (len < 12) {
-            goto fail;
+        if (nxt_strlen(SG(sapi_headers).http_status_line) >= 12) {
+            status = nxt_int_parse((u_char *) SG(sapi_headers).http_status_line
+                                   + 9, 3);
         }
 
-        RC(nxt_php_write(ctx, status_200, sizeof(status_200) - 4, 0, 0));
-        RC(nxt_php_write(ctx, status + 9, 3, 0, 0));
-
     } else if (SG(sapi_headers).http_response_code) {
-        status = nxt_sprintf(buf, buf + sizeof(buf), "%03d",
-                        SG(sapi_headers).http_response_code);
-        len = status - buf;
-
-        RC(nxt_php_write(ctx, status_200, sizeof(status_200) - 4, 0, 0));
-        RC(nxt_php_write(ctx, buf, len, 0, 0));
+        status = SG(sapi_headers).http_response_code;
 
     } else {
-        RC(nxt_php_write(ctx, status_200, sizeof(status_200) - 1, 0, 0));
+        status = 200;
     }
 
-    RC(nxt_php_write(ctx, cr_lf, sizeof(cr_lf) - 1, 0, 0));
+    n = 0;
 
     h = zend_llist_get_first_ex(&sapi_headers->headers, &zpos);
 
     while (h) {
-        RC(nxt_php_write(ctx, (u_char *) h->header, h->header_len, 0, 0));
-        RC(nxt_php_write(ctx, cr_lf, sizeof(cr_lf) - 1, 0, 0));
+        if (nxt_memchr(h->header, ':', h->header_len) != NULL) {
+            n++;
+        }
 
         h = zend_llist_get_next_ex(&sapi_headers->headers, &zpos);
     }
 
-    RC(nxt_php_write(ctx, cr_lf, sizeof(cr_lf) - 1, 1, 0));
+    RC(nxt_app_msg_write_status(ctx->task, ctx->wmsg, status, n));
+
+    h = zend_llist_get_first_ex(&sapi_headers->headers, &zpos);
+
+    while (h) {
+        end = (u_char *) h->header + h->header_len;
+        colon = nxt_memchr(h->header, ':', h->header_len);
+
+        if (colon != NULL) {
+            value = colon + 1;
+
+            while (value < end && *value == ' ') {
+                value++;
+            }
+
+            RC(nxt_app_msg_write_field(ctx->task, ctx->wmsg,
+                                       (u_char *) h->header,
+                                       colon - (u_char *) h->header,
+                                       value, end - value));
+        }
+
+        h = zend_llist_get_next_ex(&sapi_headers->headers, &zpos);
+    }
+
+    RC(nxt_app_msg_flush(ctx->task, ctx->wmsg, 0));
 
 #undef RC
 
@@ -623,7 +636,7 @@ nxt_php_read_post(char *buffer, uint count_bytes TSRMLS_DC)
     }
 
     rest = nxt_min(ctx->body_preread_size, (size_t) count_bytes);
-    size = nxt_app_msg_read_raw(ctx->task, ctx->rmsg, buffer, rest);
+    size = nxt_app_msg_read_body(ctx->task, ctx->rmsg, buffer, rest);
 
     ctx->body_preread_size -= size;
 
@@ -649,11 +662,12 @@ nxt_php_register_variables(zval *track_vars_array TSRMLS_DC)
 {
     u_char                    *colon;
     nxt_str_t                 n, v;
-    nxt_int_t                 rc;
     nxt_str_t                 host, server_name, server_port;
+    nxt_uint_t                i;
     nxt_task_t                *task;
     nxt_php_run_ctx_t         *ctx;
     nxt_app_request_header_t  *h;
+    u_char                    name[NXT_APP_FIELD_ENV_NAME_SIZE];
 
     static nxt_str_t def_host = nxt_string("localhost");
     static nxt_str_t def_port = nxt_string("80");
@@ -751,17 +765,16 @@ nxt_php_register_variables(zval *track_vars_array TSRMLS_DC)
     NXT_PHP_SET("REMOTE_ADDR", ctx->r.remote);
     NXT_PHP_SET("SERVER_ADDR", ctx->r.local);
 
-    while (nxt_app_msg_read_str(task, ctx->rmsg, &n) == NXT_OK) {
-        if (nxt_slow_path(n.length == 0)) {
+    for (i = 0; i < ctx->fields.count; i++) {
+        if (nxt_slow_path(nxt_app_fields_get(&ctx->fields, i, &n, &v)
+                          != NXT_OK))
+        {
             break;
         }
 
-        rc = nxt_app_msg_read_str(task, ctx->rmsg, &v);
-        if (nxt_slow_path(rc != NXT_OK)) {
-            break;
-        }
+        nxt_app_field_env_name(name, &n);
 
-        NXT_PHP_SET(n.start, v);
+        NXT_PHP_SET(name, v);
     }
 
 #undef NXT_PHP_SET
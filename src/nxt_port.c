@@ -18,8 +18,9 @@ static nxt_atomic_uint_t nxt_port_last_id = 1;
 static void
 nxt_port_mp_cleanup(nxt_task_t *task, void *obj, void *data)
 {
-    nxt_mp_t    *mp;
-    nxt_port_t  *port;
+    nxt_mp_t              *mp;
+    nxt_port_t            *port;
+    nxt_port_ring_recv_t  *rr;
 
     port = obj;
     mp = data;
@@ -30,11 +31,20 @@ nxt_port_mp_cleanup(nxt_task_t *task, void *obj, void *data)
     nxt_assert(port->use_count == 0);
     nxt_assert(port->app_link.next == NULL);
     nxt_assert(port->idle_link.next == NULL);
+    nxt_assert(port->share_link.next == NULL);
 
     nxt_assert(nxt_queue_is_empty(&port->messages));
     nxt_assert(nxt_lvlhsh_is_empty(&port->rpc_streams));
     nxt_assert(nxt_lvlhsh_is_empty(&port->rpc_peers));
 
+    nxt_queue_each(rr, &port->rings, nxt_port_ring_recv_t, link) {
+
+        nxt_port_ring_detach(rr->mmap_handler);
+
+    } nxt_queue_loop;
+
+    nxt_port_ring_release(port);
+
     nxt_thread_mutex_destroy(&port->write_mutex);
 
     nxt_mp_free(mp, port);
@@ -68,6 +78,7 @@ nxt_port_new(nxt_task_t *task, nxt_port_id_t id, nxt_pid_t pid,
         nxt_queue_init(&port->messages);
         nxt_thread_mutex_create(&port->write_mutex);
         nxt_queue_init(&port->pending_requests);
+        nxt_queue_init(&port->rings);
 
     } else {
         nxt_mp_destroy(mp);
@@ -107,6 +118,9 @@ nxt_port_release(nxt_task_t *task, nxt_port_t *port)
     nxt_debug(task, "port %p %d:%d release, type %d", port, port->pid,
               port->id, port->type);
 
+    nxt_debug(task, "port %p %d:%d sent %ui messages in %ui calls", port,
+              port->pid, port->id, port->write_msgs, port->write_calls);
+
     if (port->app != NULL) {
         nxt_router_app_use(task, port->app, -1);
 
@@ -353,6 +367,44 @@ fail_close:
 }
 
 
+void
+nxt_port_ring_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg)
+{
+    void                  *mmap_handler;
+    nxt_port_t            *port;
+    nxt_port_ring_t       *ring;
+    nxt_port_ring_recv_t  *rr;
+
+    if (msg->size == 0) {
+        /* Wakeup, the ring has been already read by the port. */
+        return;
+    }
+
+    port = msg->port;
+
+    ring = nxt_port_ring_attach(task, msg, &mmap_handler);
+    if (nxt_slow_path(ring == NULL)) {
+        nxt_log(task, NXT_LOG_CRIT, "failed to attach ring of process %PI",
+                msg->port_msg.pid);
+        return;
+    }
+
+    rr = nxt_mp_zalloc(port->mem_pool, sizeof(nxt_port_ring_recv_t));
+    if (nxt_slow_path(rr == NULL)) {
+        nxt_port_ring_detach(mmap_handler);
+        return;
+    }
+
+    rr->pid = msg->port_msg.pid;
+    rr->ring = ring;
+    rr->mmap_handler = mmap_handler;
+
+    nxt_queue_init(&rr->pending);
+
+    nxt_queue_insert_tail(&port->rings, &rr->link);
+}
+
+
 void
 nxt_port_change_log_file(nxt_task_t *task, nxt_runtime_t *rt, nxt_uint_t slot,
     nxt_fd_t fd)
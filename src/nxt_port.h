@@ -18,6 +18,8 @@ struct nxt_port_handlers_s {
     nxt_port_handler_t  socket;
     nxt_port_handler_t  modules;
     nxt_port_handler_t  conf_store;
+    nxt_port_handler_t  cert_store;
+    nxt_port_handler_t  cert_get;
 
     /* File descriptor exchange. */
     nxt_port_handler_t  change_file;
@@ -35,6 +37,15 @@ struct nxt_port_handlers_s {
 
     /* Various data. */
     nxt_port_handler_t  data;
+
+    /* Request body streaming. */
+    nxt_port_handler_t  body;
+
+    /* Shared memory message ring. */
+    nxt_port_handler_t  ring;
+
+    /* Response flow control. */
+    nxt_port_handler_t  credit;
 };
 
 
@@ -56,6 +67,8 @@ typedef enum {
     _NXT_PORT_MSG_SOCKET        = nxt_port_handler_idx(socket),
     _NXT_PORT_MSG_MODULES       = nxt_port_handler_idx(modules),
     _NXT_PORT_MSG_CONF_STORE    = nxt_port_handler_idx(conf_store),
+    _NXT_PORT_MSG_CERT_STORE    = nxt_port_handler_idx(cert_store),
+    _NXT_PORT_MSG_CERT_GET      = nxt_port_handler_idx(cert_get),
 
     _NXT_PORT_MSG_CHANGE_FILE   = nxt_port_handler_idx(change_file),
     _NXT_PORT_MSG_NEW_PORT      = nxt_port_handler_idx(new_port),
@@ -66,6 +79,9 @@ typedef enum {
     _NXT_PORT_MSG_QUIT          = nxt_port_handler_idx(quit),
 
     _NXT_PORT_MSG_DATA          = nxt_port_handler_idx(data),
+    _NXT_PORT_MSG_BODY          = nxt_port_handler_idx(body),
+    _NXT_PORT_MSG_RING          = nxt_port_handler_idx(ring),
+    _NXT_PORT_MSG_CREDIT        = nxt_port_handler_idx(credit),
 
     NXT_PORT_MSG_MAX            = sizeof(nxt_port_handlers_t) /
                                       sizeof(nxt_port_handler_t),
@@ -79,6 +95,8 @@ typedef enum {
     NXT_PORT_MSG_SOCKET         = _NXT_PORT_MSG_SOCKET | NXT_PORT_MSG_LAST,
     NXT_PORT_MSG_MODULES        = _NXT_PORT_MSG_MODULES | NXT_PORT_MSG_LAST,
     NXT_PORT_MSG_CONF_STORE     = _NXT_PORT_MSG_CONF_STORE | NXT_PORT_MSG_LAST,
+    NXT_PORT_MSG_CERT_STORE     = _NXT_PORT_MSG_CERT_STORE | NXT_PORT_MSG_LAST,
+    NXT_PORT_MSG_CERT_GET       = _NXT_PORT_MSG_CERT_GET | NXT_PORT_MSG_LAST,
 
     NXT_PORT_MSG_CHANGE_FILE    = _NXT_PORT_MSG_CHANGE_FILE | NXT_PORT_MSG_LAST,
     NXT_PORT_MSG_NEW_PORT       = _NXT_PORT_MSG_NEW_PORT | NXT_PORT_MSG_LAST,
@@ -92,6 +110,14 @@ typedef enum {
 
     NXT_PORT_MSG_DATA           = _NXT_PORT_MSG_DATA,
     NXT_PORT_MSG_DATA_LAST      = _NXT_PORT_MSG_DATA | NXT_PORT_MSG_LAST,
+
+    NXT_PORT_MSG_BODY           = _NXT_PORT_MSG_BODY,
+    NXT_PORT_MSG_BODY_LAST      = _NXT_PORT_MSG_BODY | NXT_PORT_MSG_LAST,
+
+    NXT_PORT_MSG_RING           = _NXT_PORT_MSG_RING | NXT_PORT_MSG_LAST,
+
+    NXT_PORT_MSG_CREDIT         = _NXT_PORT_MSG_CREDIT,
+    NXT_PORT_MSG_CREDIT_LAST    = _NXT_PORT_MSG_CREDIT | NXT_PORT_MSG_LAST,
 } nxt_port_msg_type_t;
 
 
@@ -117,6 +143,9 @@ typedef struct {
 
     /* Message delivery tracking enabled, next chunk is tracking msg. */
     uint8_t              tracking;  /* 1 bit */
+
+    /* Sender's shared memory ring is resumed after this message. */
+    uint8_t              ring;      /* 1 bit */
 } nxt_port_msg_t;
 
 
@@ -147,7 +176,24 @@ struct nxt_port_recv_msg_s {
     } u;
 };
 
-typedef struct nxt_app_s  nxt_app_t;
+typedef struct nxt_port_ring_s  nxt_port_ring_t;
+
+/* Element of nxt_port_t.rings, incoming shared memory ring. */
+typedef struct {
+    nxt_queue_link_t    link;
+    nxt_pid_t           pid;
+    nxt_port_ring_t     *ring;
+    void                *mmap_handler;
+
+    /* Socket messages received before the ring is read up to them. */
+    nxt_queue_t         pending;
+
+    /* The ring is suspended till a socket message resumes it. */
+    nxt_bool_t          blocked;
+} nxt_port_ring_recv_t;
+
+typedef struct nxt_app_s        nxt_app_t;
+typedef struct nxt_app_share_s  nxt_app_share_t;
 
 struct nxt_port_s {
     nxt_fd_event_t      socket;
@@ -161,6 +207,12 @@ struct nxt_port_s {
     nxt_queue_link_t    idle_link;  /* for nxt_app_t.idle_ports */
     nxt_msec_t          idle_start;
 
+    nxt_queue_link_t    share_link; /* for nxt_app_share_t.ports */
+    nxt_app_share_t     *share;
+
+    /* The process is unaccounted by its application, under app->mutex. */
+    uint8_t             app_closed;  /* 1 bit */
+
     nxt_queue_t         messages;   /* of nxt_port_send_msg_t */
     nxt_thread_mutex_t  write_mutex;
 
@@ -173,6 +225,9 @@ struct nxt_port_s {
     uint32_t            app_responses;
     nxt_queue_t         pending_requests;
 
+    /* EWMA of application response time, updated without locking. */
+    nxt_nsec_t          app_latency;
+
     nxt_port_handler_t  handler;
     nxt_port_handler_t  *data;
 
@@ -196,6 +251,20 @@ struct nxt_port_s {
 
     struct iovec        *iov;
     void                *mmsg_buf;
+
+    /* Sent messages and system calls, to see how writes are batched. */
+    nxt_uint_t          write_msgs;
+    nxt_uint_t          write_calls;
+
+    /* Shared memory ring for outgoing messages. */
+    nxt_port_ring_t     *ring;
+    void                *ring_mmap_handler;
+    nxt_atomic_t        ring_lock;
+    uint8_t             ring_enabled;  /* 1 bit */
+    uint8_t             ring_ready;    /* 1 bit */
+    uint8_t             ring_socket;   /* 1 bit */
+
+    nxt_queue_t         rings;      /* of nxt_port_ring_recv_t */
 };
 
 
@@ -263,6 +332,7 @@ void nxt_port_change_log_file_handler(nxt_task_t *task,
 void nxt_port_mmap_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg);
 void nxt_port_data_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg);
 void nxt_port_remove_pid_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg);
+void nxt_port_ring_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg);
 void nxt_port_empty_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg);
 
 nxt_int_t nxt_port_post(nxt_task_t *task, nxt_port_t *port,
@@ -109,10 +109,10 @@ nxt_port_mmaps_destroy(nxt_port_mmaps_t *port_mmaps, nxt_bool_t free_elts)
 static void
 nxt_port_mmap_buf_completion(nxt_task_t *task, void *obj, void *data)
 {
+    size_t                   n;
     u_char                   *p;
     nxt_mp_t                 *mp;
     nxt_buf_t                *b;
-    nxt_chunk_id_t           c;
     nxt_port_mmap_header_t   *hdr;
     nxt_port_mmap_handler_t  *mmap_handler;
 
@@ -144,29 +144,32 @@ nxt_port_mmap_buf_completion(nxt_task_t *task, void *obj, void *data)
 
     if (b->is_port_mmap_sent && b->mem.pos > b->mem.start) {
         /*
-         * Chunks until b->mem.pos has been sent to other side,
+         * Chunks or slots until b->mem.pos has been sent to other side,
          * let's release rest (if any).
          */
-        p = b->mem.pos - 1;
-        c = nxt_port_mmap_chunk_id(hdr, p) + 1;
-        p = nxt_port_mmap_chunk_start(hdr, c);
+        p = nxt_port_mmap_range_end(hdr, b->mem.pos);
 
     } else {
         p = b->mem.start;
-        c = nxt_port_mmap_chunk_id(hdr, p);
     }
 
-    nxt_port_mmap_free_junk(p, b->mem.end - p);
+    /* The buffer end may be set inside the last chunk or slot. */
+    if (p < b->mem.end) {
+        nxt_port_mmap_free_junk(p, b->mem.end - p);
+    }
 
     nxt_debug(task, "mmap buf completion: %p [%p,%uz] (sent=%d), "
               "%PI->%PI,%d,%d", b, b->mem.start, b->mem.end - b->mem.start,
-              b->is_port_mmap_sent, hdr->src_pid, hdr->dst_pid, hdr->id, c);
+              b->is_port_mmap_sent, hdr->src_pid, hdr->dst_pid, hdr->id,
+              nxt_port_mmap_chunk_id(hdr, p));
 
-    while (p < b->mem.end) {
-        nxt_port_mmap_set_chunk_free(hdr->free_map, c);
+    nxt_port_mmap_free_range(hdr, p, b->mem.end);
 
-        p += PORT_MMAP_CHUNK_SIZE;
-        c++;
+    n = nxt_port_mmap_reclaim(hdr);
+
+    if (n != 0) {
+        nxt_debug(task, "mmap %PI->%PI,%d: %uz free chunks reclaimed",
+                  hdr->src_pid, hdr->dst_pid, hdr->id, n);
     }
 
 release_buf:
@@ -178,6 +181,24 @@ release_buf:
 }
 
 
+static void
+nxt_port_mmap_advise(nxt_task_t *task, void *mem)
+{
+#if (NXT_HAVE_MADV_HUGEPAGE)
+
+    /*
+     * Transparent huge pages reduce TLB misses if they are enabled
+     * for shared memory in "advise" mode.
+     */
+    if (madvise(mem, PORT_MMAP_SIZE, MADV_HUGEPAGE) != 0) {
+        nxt_debug(task, "madvise(%p, MADV_HUGEPAGE) failed %E",
+                  mem, nxt_errno);
+    }
+
+#endif
+}
+
+
 nxt_port_mmap_handler_t *
 nxt_port_incoming_port_mmap(nxt_task_t *task, nxt_process_t *process,
     nxt_fd_t fd)
@@ -208,6 +229,8 @@ nxt_port_incoming_port_mmap(nxt_task_t *task, nxt_process_t *process,
         return NULL;
     }
 
+    nxt_port_mmap_advise(task, mem);
+
     hdr = mem;
 
     mmap_handler = nxt_zalloc(sizeof(nxt_port_mmap_handler_t));
@@ -336,6 +359,8 @@ nxt_port_new_port_mmap(nxt_task_t *task, nxt_process_t *process,
         goto remove_fail;
     }
 
+    nxt_port_mmap_advise(task, mem);
+
     mmap_handler->hdr = mem;
     port_mmap->mmap_handler = mmap_handler;
     nxt_port_mmap_handler_use(mmap_handler, 1);
@@ -365,7 +390,9 @@ nxt_port_new_port_mmap(nxt_task_t *task, nxt_process_t *process,
     /* TODO handle error */
     (void) nxt_port_socket_write(task, port, NXT_PORT_MSG_MMAP, fd, 0, 0, NULL);
 
-    nxt_log(task, NXT_LOG_DEBUG, "new mmap #%D created for %PI -> %PI",
+    /* Additional segments are created under load, log them to watch it. */
+    nxt_log(task, hdr->id == 0 ? NXT_LOG_DEBUG : NXT_LOG_INFO,
+            "new mmap #%D created for %PI -> %PI",
             hdr->id, nxt_pid, process->pid);
 
     return mmap_handler;
@@ -380,9 +407,47 @@ remove_fail:
 }
 
 
+static nxt_bool_t
+nxt_port_mmap_get_free_run(nxt_free_map_t *m, nxt_chunk_id_t *c, size_t n)
+{
+    size_t          len;
+    nxt_chunk_id_t  i, start;
+
+    len = 0;
+    start = 0;
+
+    for (i = 0; i < PORT_MMAP_CHUNK_COUNT; i++) {
+
+        if ((m[FREE_IDX(i)] & FREE_MASK(i)) == 0) {
+            len = 0;
+            continue;
+        }
+
+        if (len == 0) {
+            start = i;
+        }
+
+        len++;
+
+        if (len == n) {
+            /* The rest of run is acquired when the buffer is filled. */
+            if (nxt_port_mmap_chk_set_chunk_busy(m, start)) {
+                *c = start;
+                return 1;
+            }
+
+            len = 0;
+            i = start;
+        }
+    }
+
+    return 0;
+}
+
+
 static nxt_port_mmap_handler_t *
 nxt_port_mmap_get(nxt_task_t *task, nxt_port_t *port, nxt_chunk_id_t *c,
-    nxt_bool_t tracking)
+    size_t nchunks, nxt_bool_t tracking)
 {
     nxt_process_t            *process;
     nxt_free_map_t           *free_map;
@@ -402,6 +467,109 @@ nxt_port_mmap_get(nxt_task_t *task, nxt_port_t *port, nxt_chunk_id_t *c,
 
     end_port_mmap = process->outgoing.elts + process->outgoing.size;
 
+    for ( ;; ) {
+
+        for (port_mmap = process->outgoing.elts;
+             port_mmap < end_port_mmap;
+             port_mmap++)
+        {
+            mmap_handler = port_mmap->mmap_handler;
+            hdr = mmap_handler->hdr;
+
+            if (hdr->sent_over != 0xFFFFu && hdr->sent_over != port->id) {
+                continue;
+            }
+
+            free_map = tracking ? hdr->free_tracking_map : hdr->free_map;
+
+            if (nchunks > 1) {
+                if (nxt_port_mmap_get_free_run(free_map, c, nchunks)) {
+                    goto unlock_return;
+                }
+
+            } else if (nxt_port_mmap_get_free_chunk(free_map, c)) {
+                goto unlock_return;
+            }
+        }
+
+        if (nchunks <= 1) {
+            break;
+        }
+
+        /*
+         * There is no long enough run, a shorter buffer is better than
+         * a new segment.
+         */
+        nchunks = 1;
+    }
+
+    /* TODO introduce port_mmap limit and release wait. */
+
+    mmap_handler = nxt_port_new_port_mmap(task, process, port, tracking);
+
+unlock_return:
+
+    nxt_thread_mutex_unlock(&process->outgoing.mutex);
+
+    return mmap_handler;
+}
+
+
+static nxt_bool_t
+nxt_port_mmap_get_free_slots(nxt_atomic_t *m, size_t n, nxt_chunk_id_t *slot)
+{
+    nxt_uint_t      i;
+    nxt_slot_map_t  map, free, run;
+
+    for ( ;; ) {
+        map = *m;
+
+        free = ~map & SLOT_MASK(0, PORT_MMAP_SLOT_COUNT);
+        run = free;
+
+        for (i = 1; i < n; i++) {
+            run &= free >> i;
+        }
+
+        if (run == 0) {
+            return 0;
+        }
+
+        i = __builtin_ffsll(run) - 1;
+
+        if (nxt_atomic_cmp_set(m, map, map | SLOT_MASK(i, n)) != 0) {
+            *slot = i;
+            return 1;
+        }
+    }
+}
+
+
+/*
+ * Slab is a chunk split into slots.  A segment owner allocates slots
+ * from the last slab of segment, the slab is closed when it cannot
+ * satisfy a request.
+ */
+
+static nxt_port_mmap_handler_t *
+nxt_port_mmap_get_slots(nxt_task_t *task, nxt_port_t *port, nxt_chunk_id_t *c,
+    nxt_chunk_id_t *slot, size_t nslots)
+{
+    nxt_process_t            *process;
+    nxt_port_mmap_t          *port_mmap;
+    nxt_port_mmap_t          *end_port_mmap;
+    nxt_port_mmap_header_t   *hdr;
+    nxt_port_mmap_handler_t  *mmap_handler;
+
+    process = port->process;
+    if (nxt_slow_path(process == NULL)) {
+        return NULL;
+    }
+
+    nxt_thread_mutex_lock(&process->outgoing.mutex);
+
+    end_port_mmap = process->outgoing.elts + process->outgoing.size;
+
     for (port_mmap = process->outgoing.elts;
          port_mmap < end_port_mmap;
          port_mmap++)
@@ -413,16 +581,37 @@ nxt_port_mmap_get(nxt_task_t *task, nxt_port_t *port, nxt_chunk_id_t *c,
             continue;
         }
 
-        free_map = tracking ? hdr->free_tracking_map : hdr->free_map;
+        *c = mmap_handler->slab;
 
-        if (nxt_port_mmap_get_free_chunk(free_map, c)) {
-            goto unlock_return;
+        if ((hdr->slot_map[*c] & SLOT_OPEN) != 0) {
+
+            if (nxt_port_mmap_get_free_slots(&hdr->slot_map[*c], nslots,
+                                             slot))
+            {
+                goto unlock_return;
+            }
+
+            nxt_port_mmap_set_slots_free(hdr, *c, SLOT_OPEN);
+        }
+
+        if (nxt_port_mmap_get_free_chunk(hdr->free_map, c)) {
+            goto open_slab;
         }
     }
 
-    /* TODO introduce port_mmap limit and release wait. */
+    mmap_handler = nxt_port_new_port_mmap(task, process, port, 0);
+    if (nxt_slow_path(mmap_handler == NULL)) {
+        goto unlock_return;
+    }
 
-    mmap_handler = nxt_port_new_port_mmap(task, process, port, tracking);
+    hdr = mmap_handler->hdr;
+    *c = 0;
+
+open_slab:
+
+    hdr->slot_map[*c] = SLOT_OPEN | SLOT_MASK(0, nslots);
+    mmap_handler->slab = *c;
+    *slot = 0;
 
 unlock_return:
 
@@ -470,7 +659,7 @@ nxt_port_mmap_get_tracking(nxt_task_t *task, nxt_port_t *port,
 
     nxt_debug(task, "request tracking for stream #%uD", stream);
 
-    mmap_handler = nxt_port_mmap_get(task, port, &c, 1);
+    mmap_handler = nxt_port_mmap_get(task, port, &c, 1, 1);
     if (nxt_slow_path(mmap_handler == NULL)) {
         return NXT_ERROR;
     }
@@ -594,10 +783,10 @@ nxt_port_mmap_tracking_read(nxt_task_t *task, nxt_port_recv_msg_t *msg)
 nxt_buf_t *
 nxt_port_mmap_get_buf(nxt_task_t *task, nxt_port_t *port, size_t size)
 {
-    size_t                   nchunks;
+    size_t                   nchunks, nslots;
     nxt_mp_t                 *mp;
     nxt_buf_t                *b;
-    nxt_chunk_id_t           c;
+    nxt_chunk_id_t           c, slot;
     nxt_port_mmap_header_t   *hdr;
     nxt_port_mmap_handler_t  *mmap_handler;
 
@@ -611,7 +800,25 @@ nxt_port_mmap_get_buf(nxt_task_t *task, nxt_port_t *port, size_t size)
     b->completion_handler = nxt_port_mmap_buf_completion;
     nxt_buf_set_port_mmap(b);
 
-    mmap_handler = nxt_port_mmap_get(task, port, &c, 0);
+    nchunks = size / PORT_MMAP_CHUNK_SIZE;
+    if ((size % PORT_MMAP_CHUNK_SIZE) != 0 || nchunks == 0) {
+        nchunks++;
+    }
+
+    nslots = 0;
+
+    if (size <= PORT_MMAP_SLAB_MAX_SIZE) {
+        nslots = size / PORT_MMAP_SLOT_SIZE;
+        if ((size % PORT_MMAP_SLOT_SIZE) != 0 || nslots == 0) {
+            nslots++;
+        }
+
+        mmap_handler = nxt_port_mmap_get_slots(task, port, &c, &slot, nslots);
+
+    } else {
+        mmap_handler = nxt_port_mmap_get(task, port, &c, nchunks, 0);
+    }
+
     if (nxt_slow_path(mmap_handler == NULL)) {
         mp = task->thread->engine->mem_pool;
         nxt_mp_free(mp, b);
@@ -625,16 +832,25 @@ nxt_port_mmap_get_buf(nxt_task_t *task, nxt_port_t *port, size_t size)
 
     hdr = mmap_handler->hdr;
 
+    if (nslots != 0) {
+        b->mem.start = nxt_port_mmap_slot_start(hdr, c, slot);
+        b->mem.pos = b->mem.start;
+        b->mem.free = b->mem.start;
+        b->mem.end = b->mem.start + nslots * PORT_MMAP_SLOT_SIZE;
+
+        nxt_debug(task, "outgoing mmap buf allocation: %p [%p,%uz] "
+                  "%PI->%PI,%d,%d:%d", b, b->mem.start,
+                  b->mem.end - b->mem.start, hdr->src_pid, hdr->dst_pid,
+                  hdr->id, c, slot);
+
+        return b;
+    }
+
     b->mem.start = nxt_port_mmap_chunk_start(hdr, c);
     b->mem.pos = b->mem.start;
     b->mem.free = b->mem.start;
     b->mem.end = b->mem.start + PORT_MMAP_CHUNK_SIZE;
 
-    nchunks = size / PORT_MMAP_CHUNK_SIZE;
-    if ((size % PORT_MMAP_CHUNK_SIZE) != 0 || nchunks == 0) {
-        nchunks++;
-    }
-
     nxt_debug(task, "outgoing mmap buf allocation: %p [%p,%uz] %PI->%PI,%d,%d",
               b, b->mem.start, b->mem.end - b->mem.start,
               hdr->src_pid, hdr->dst_pid, hdr->id, c);
@@ -658,6 +874,59 @@ nxt_port_mmap_get_buf(nxt_task_t *task, nxt_port_t *port, size_t size)
 }
 
 
+static nxt_int_t
+nxt_port_mmap_increase_slots(nxt_task_t *task, nxt_buf_t *b, nxt_chunk_id_t c,
+    size_t size, size_t min_size)
+{
+    size_t                   nslots, free_size;
+    nxt_chunk_id_t           slot, start;
+    nxt_port_mmap_header_t   *hdr;
+    nxt_port_mmap_handler_t  *mmap_handler;
+
+    mmap_handler = b->parent;
+    hdr = mmap_handler->hdr;
+
+    free_size = nxt_buf_mem_free_size(&b->mem);
+
+    start = nxt_port_mmap_slot_id(hdr, c, b->mem.end);
+
+    nslots = size / PORT_MMAP_SLOT_SIZE;
+    if ((size % PORT_MMAP_SLOT_SIZE) != 0 || nslots == 0) {
+        nslots++;
+    }
+
+    slot = start;
+
+    /* A slab buffer grows up to the chunk end only. */
+    while (nslots > 0 && slot < PORT_MMAP_SLOT_COUNT) {
+
+        if (nxt_port_mmap_chk_set_slot_busy(&hdr->slot_map[c], slot) == 0) {
+            break;
+        }
+
+        slot++;
+        nslots--;
+    }
+
+    if (nslots != 0
+        && min_size > free_size + PORT_MMAP_SLOT_SIZE * (slot - start))
+    {
+        if (slot != start) {
+            nxt_port_mmap_set_slots_free(hdr, c,
+                                         SLOT_MASK(start, slot - start));
+        }
+
+        nxt_debug(task, "failed to increase, %uz slots busy", nslots);
+
+        return NXT_ERROR;
+    }
+
+    b->mem.end += PORT_MMAP_SLOT_SIZE * (slot - start);
+
+    return NXT_OK;
+}
+
+
 nxt_int_t
 nxt_port_mmap_increase_buf(nxt_task_t *task, nxt_buf_t *b, size_t size,
     size_t min_size)
@@ -684,10 +953,16 @@ nxt_port_mmap_increase_buf(nxt_task_t *task, nxt_buf_t *b, size_t size,
     mmap_handler = b->parent;
     hdr = mmap_handler->hdr;
 
-    start = nxt_port_mmap_chunk_id(hdr, b->mem.end);
-
     size -= free_size;
 
+    c = nxt_port_mmap_chunk_id(hdr, b->mem.start);
+
+    if (hdr->slot_map[c] != 0) {
+        return nxt_port_mmap_increase_slots(task, b, c, size, min_size);
+    }
+
+    start = nxt_port_mmap_chunk_id(hdr, b->mem.end);
+
     nchunks = size / PORT_MMAP_CHUNK_SIZE;
     if ((size % PORT_MMAP_CHUNK_SIZE) != 0 || nchunks == 0) {
         nchunks++;
@@ -731,7 +1006,6 @@ static nxt_buf_t *
 nxt_port_mmap_get_incoming_buf(nxt_task_t *task, nxt_port_t *port,
     nxt_pid_t spid, nxt_port_mmap_msg_t *mmap_msg)
 {
-    size_t                   nchunks;
     nxt_buf_t                *b;
     nxt_port_mmap_header_t   *hdr;
     nxt_port_mmap_handler_t  *mmap_handler;
@@ -751,17 +1025,13 @@ nxt_port_mmap_get_incoming_buf(nxt_task_t *task, nxt_port_t *port,
 
     nxt_buf_set_port_mmap(b);
 
-    nchunks = mmap_msg->size / PORT_MMAP_CHUNK_SIZE;
-    if ((mmap_msg->size % PORT_MMAP_CHUNK_SIZE) != 0) {
-        nchunks++;
-    }
-
     hdr = mmap_handler->hdr;
 
-    b->mem.start = nxt_port_mmap_chunk_start(hdr, mmap_msg->chunk_id);
+    b->mem.start = nxt_port_mmap_msg_start(hdr, mmap_msg->chunk_id);
     b->mem.pos = b->mem.start;
     b->mem.free = b->mem.start + mmap_msg->size;
-    b->mem.end = b->mem.start + nchunks * PORT_MMAP_CHUNK_SIZE;
+    b->mem.end = (mmap_msg->size != 0)
+                 ? nxt_port_mmap_range_end(hdr, b->mem.free) : b->mem.free;
 
     b->parent = mmap_handler;
     nxt_port_mmap_handler_use(mmap_handler, 1);
@@ -776,7 +1046,7 @@ nxt_port_mmap_get_incoming_buf(nxt_task_t *task, nxt_port_t *port,
 
 void
 nxt_port_mmap_write(nxt_task_t *task, nxt_port_t *port,
-    nxt_port_send_msg_t *msg, nxt_sendbuf_coalesce_t *sb)
+    nxt_port_send_msg_t *msg, nxt_sendbuf_coalesce_t *sb, void *mmsg_buf)
 {
     size_t                   bsize;
     nxt_buf_t                *bmem;
@@ -789,7 +1059,7 @@ nxt_port_mmap_write(nxt_task_t *task, nxt_port_t *port,
                     "via shared memory", sb->size, port->pid);
 
     bsize = sb->niov * sizeof(nxt_port_mmap_msg_t);
-    mmap_msg = port->mmsg_buf;
+    mmap_msg = mmsg_buf;
 
     bmem = msg->buf;
 
@@ -811,7 +1081,7 @@ nxt_port_mmap_write(nxt_task_t *task, nxt_port_t *port,
         hdr = mmap_handler->hdr;
 
         mmap_msg->mmap_id = hdr->id;
-        mmap_msg->chunk_id = nxt_port_mmap_chunk_id(hdr, bmem->mem.pos);
+        mmap_msg->chunk_id = nxt_port_mmap_msg_id(hdr, bmem->mem.pos);
         mmap_msg->size = sb->iobuf[i].iov_len;
 
         nxt_debug(task, "mmap_msg={%D, %D, %D} to %PI",
@@ -819,7 +1089,7 @@ nxt_port_mmap_write(nxt_task_t *task, nxt_port_t *port,
                   port->pid);
     }
 
-    sb->iobuf[0].iov_base = port->mmsg_buf;
+    sb->iobuf[0].iov_base = mmsg_buf;
     sb->iobuf[0].iov_len = bsize;
     sb->niov = 1;
     sb->size = bsize;
@@ -932,3 +1202,139 @@ nxt_port_mmap_get_method(nxt_task_t *task, nxt_port_t *port, nxt_buf_t *b)
 
     return m;
 }
+
+
+nxt_int_t
+nxt_port_ring_start(nxt_task_t *task, nxt_port_t *port)
+{
+    nxt_buf_t                *b;
+    nxt_chunk_id_t           c;
+    nxt_port_ring_t          *ring;
+    nxt_port_mmap_msg_t      *mmap_msg;
+    nxt_port_mmap_header_t   *hdr;
+    nxt_port_mmap_handler_t  *mmap_handler;
+
+    if (sizeof(nxt_port_ring_t) > PORT_MMAP_CHUNK_SIZE) {
+        return NXT_DECLINED;
+    }
+
+    /*
+     * The ring is started once, the lock is not released.  It also
+     * prevents recursion when a new mmap segment is sent to the port.
+     */
+    if (!nxt_atomic_try_lock(&port->ring_lock)) {
+        return NXT_DECLINED;
+    }
+
+    mmap_handler = nxt_port_mmap_get(task, port, &c, 1, 0);
+    if (nxt_slow_path(mmap_handler == NULL)) {
+        return NXT_ERROR;
+    }
+
+    hdr = mmap_handler->hdr;
+
+    b = nxt_buf_mem_ts_alloc(task, task->thread->engine->mem_pool,
+                             sizeof(nxt_port_mmap_msg_t));
+    if (nxt_slow_path(b == NULL)) {
+        nxt_port_mmap_set_chunk_free(hdr->free_map, c);
+        return NXT_ERROR;
+    }
+
+    nxt_port_mmap_handler_use(mmap_handler, 1);
+
+    ring = (nxt_port_ring_t *) nxt_port_mmap_chunk_start(hdr, c);
+
+    ring->head = 0;
+    ring->waiting = 0;
+    ring->tail = 0;
+
+    port->ring = ring;
+    port->ring_mmap_handler = mmap_handler;
+
+    mmap_msg = (nxt_port_mmap_msg_t *) b->mem.pos;
+
+    mmap_msg->mmap_id = hdr->id;
+    mmap_msg->chunk_id = c;
+    mmap_msg->size = sizeof(nxt_port_ring_t);
+
+    b->mem.free += sizeof(nxt_port_mmap_msg_t);
+
+    nxt_debug(task, "start ring %PI->%PI,%d,%d",
+              hdr->src_pid, hdr->dst_pid, hdr->id, c);
+
+    return nxt_port_socket_write(task, port, NXT_PORT_MSG_RING, -1, 0, 0, b);
+}
+
+
+void
+nxt_port_ring_release(nxt_port_t *port)
+{
+    nxt_chunk_id_t           c;
+    nxt_port_mmap_header_t   *hdr;
+    nxt_port_mmap_handler_t  *mmap_handler;
+
+    mmap_handler = port->ring_mmap_handler;
+
+    if (mmap_handler == NULL) {
+        return;
+    }
+
+    hdr = mmap_handler->hdr;
+
+    c = nxt_port_mmap_chunk_id(hdr, (u_char *) port->ring);
+    nxt_port_mmap_set_chunk_free(hdr->free_map, c);
+
+    nxt_port_mmap_handler_use(mmap_handler, -1);
+
+    port->ring = NULL;
+    port->ring_mmap_handler = NULL;
+}
+
+
+nxt_port_ring_t *
+nxt_port_ring_attach(nxt_task_t *task, nxt_port_recv_msg_t *msg,
+    void **mmap_handler)
+{
+    nxt_buf_t                *b;
+    nxt_port_mmap_msg_t      *mmap_msg;
+    nxt_port_mmap_handler_t  *handler;
+
+    b = msg->buf;
+
+    if (nxt_slow_path(nxt_buf_used_size(b)
+                      < (int) sizeof(nxt_port_mmap_msg_t)))
+    {
+        return NULL;
+    }
+
+    mmap_msg = (nxt_port_mmap_msg_t *) b->mem.pos;
+
+    if (nxt_slow_path(mmap_msg->chunk_id >= PORT_MMAP_CHUNK_COUNT
+                      || mmap_msg->size != sizeof(nxt_port_ring_t)))
+    {
+        return NULL;
+    }
+
+    handler = nxt_port_get_port_incoming_mmap(task, msg->port_msg.pid,
+                                              mmap_msg->mmap_id);
+    if (nxt_slow_path(handler == NULL)) {
+        return NULL;
+    }
+
+    nxt_port_mmap_handler_use(handler, 1);
+
+    *mmap_handler = handler;
+
+    nxt_debug(task, "attach ring %PI->%PI,%d,%d", handler->hdr->src_pid,
+              handler->hdr->dst_pid, handler->hdr->id, mmap_msg->chunk_id);
+
+    return (nxt_port_ring_t *) nxt_port_mmap_chunk_start(handler->hdr,
+                                                         mmap_msg->chunk_id);
+}
+
+
+void
+nxt_port_ring_detach(void *mmap_handler)
+{
+    nxt_port_mmap_handler_use(mmap_handler, -1);
+}
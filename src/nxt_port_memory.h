@@ -39,7 +39,8 @@ nxt_port_mmap_tracking_read(nxt_task_t *task, nxt_port_recv_msg_t *msg);
 /*
  * Allocates nxt_but_t structure from port's mem_pool, assigns this buf 'mem'
  * pointers to first available shared mem bucket(s). 'size' used as a hint to
- * acquire several successive buckets if possible.
+ * acquire several successive buckets if possible, small buffers are placed
+ * in slots of a bucket.
  *
  * This function assumes that current thread operates the 'port' exclusively.
  */
@@ -55,7 +56,7 @@ nxt_port_incoming_port_mmap(nxt_task_t *task, nxt_process_t *process,
 
 void
 nxt_port_mmap_write(nxt_task_t *task, nxt_port_t *port,
-    nxt_port_send_msg_t *msg, nxt_sendbuf_coalesce_t *sb);
+    nxt_port_send_msg_t *msg, nxt_sendbuf_coalesce_t *sb, void *mmsg_buf);
 
 void
 nxt_port_mmap_read(nxt_task_t *task, nxt_port_recv_msg_t *msg);
@@ -72,4 +73,38 @@ nxt_port_method_t
 nxt_port_mmap_get_method(nxt_task_t *task, nxt_port_t *port, nxt_buf_t *b);
 
 
+#define NXT_PORT_RING_SLOTS      64
+#define NXT_PORT_RING_SLOT_SIZE  128
+
+typedef struct {
+    /* Message size, 0 is a marker which suspends the ring. */
+    uint32_t              size;
+    /* nxt_port_msg_t followed by message payload. */
+    u_char                data[NXT_PORT_RING_SLOT_SIZE - sizeof(uint32_t)];
+} nxt_port_ring_slot_t;
+
+/*
+ * Single producer single consumer ring of port messages placed
+ * in a shared memory chunk.  The producer is serialized by port
+ * write_mutex, the consumer is a port read handler.
+ */
+struct nxt_port_ring_s {
+    /* Updated by consumer. */
+    nxt_atomic_t          head;
+    /* Consumer sleeps and should be woken up via the socket. */
+    nxt_atomic_t          waiting;
+
+    /* Updated by producer. */
+    nxt_atomic_t          tail  nxt_aligned(64);
+
+    nxt_port_ring_slot_t  slot[NXT_PORT_RING_SLOTS]  nxt_aligned(64);
+};
+
+nxt_int_t nxt_port_ring_start(nxt_task_t *task, nxt_port_t *port);
+void nxt_port_ring_release(nxt_port_t *port);
+nxt_port_ring_t *nxt_port_ring_attach(nxt_task_t *task,
+    nxt_port_recv_msg_t *msg, void **mmap_handler);
+void nxt_port_ring_detach(void *mmap_handler);
+
+
 #endif /* _NXT_PORT_MEMORY_H_INCLUDED_ */
@@ -15,13 +15,13 @@
 #ifdef NXT_MMAP_TINY_CHUNK
 
 #define PORT_MMAP_CHUNK_SIZE    16
-#define PORT_MMAP_HEADER_SIZE   1024
+#define PORT_MMAP_HEADER_SIZE   2048
 #define PORT_MMAP_DATA_SIZE     1024
 
 #else
 
 #define PORT_MMAP_CHUNK_SIZE    (1024 * 16)
-#define PORT_MMAP_HEADER_SIZE   (1024 * 4)
+#define PORT_MMAP_HEADER_SIZE   (1024 * 12)
 #define PORT_MMAP_DATA_SIZE     (1024 * 1024 * 10)
 
 #endif
@@ -30,6 +30,22 @@
 #define PORT_MMAP_SIZE          (PORT_MMAP_HEADER_SIZE + PORT_MMAP_DATA_SIZE)
 #define PORT_MMAP_CHUNK_COUNT   (PORT_MMAP_DATA_SIZE / PORT_MMAP_CHUNK_SIZE)
 
+/*
+ * Small buffers are allocated in slots of a slab chunk, larger ones
+ * occupy successive chunks.
+ */
+#define PORT_MMAP_SLOT_COUNT    16
+#define PORT_MMAP_SLOT_SIZE     (PORT_MMAP_CHUNK_SIZE / PORT_MMAP_SLOT_COUNT)
+#define PORT_MMAP_SLAB_MAX_SIZE (PORT_MMAP_CHUNK_SIZE / 4)
+
+/*
+ * Pages of free chunks are returned to the system when the number of
+ * busy chunks in a segment falls below the low-water mark.  The first
+ * chunks of the first segment are kept since they are reused most often.
+ */
+#define PORT_MMAP_LOW_WATER     (PORT_MMAP_CHUNK_COUNT / 10)
+#define PORT_MMAP_KEEP_CHUNKS   (PORT_MMAP_CHUNK_COUNT / 5)
+
 
 typedef uint32_t  nxt_chunk_id_t;
 
@@ -45,23 +61,46 @@ typedef nxt_atomic_uint_t  nxt_free_map_t;
 #define MAX_FREE_IDX FREE_IDX(PORT_MMAP_CHUNK_COUNT)
 
 
+typedef nxt_atomic_uint_t  nxt_slot_map_t;
+
+#define SLOT_MASK(slot, n)                                                    \
+    ((((nxt_slot_map_t) 1 << (n)) - 1) << (slot))
+
+/* The slab is still used for allocations by the segment owner. */
+#define SLOT_OPEN  ((nxt_slot_map_t) 1 << PORT_MMAP_SLOT_COUNT)
+
+/*
+ * A buffer in a slab chunk is addressed by nxt_port_mmap_msg_t.chunk_id
+ * with the slot number plus one in the upper bits.
+ */
+#define SLOT_SHIFT  16
+
+#define SLOT_CHUNK(id)  ((id) & ((1 << SLOT_SHIFT) - 1))
+
+
 /* Mapped at the start of shared memory segment. */
 struct nxt_port_mmap_header_s {
     uint32_t        id;
     nxt_pid_t       src_pid; /* For sanity check. */
     nxt_pid_t       dst_pid; /* For sanity check. */
     nxt_port_id_t   sent_over;
+    /* A chunk beyond the kept ones has been released. */
+    nxt_atomic_t    reclaim;
     nxt_free_map_t  free_map[MAX_FREE_IDX];
     nxt_free_map_t  free_map_padding;
     nxt_free_map_t  free_tracking_map[MAX_FREE_IDX];
     nxt_free_map_t  free_tracking_map_padding;
     nxt_atomic_t    tracking[PORT_MMAP_CHUNK_COUNT];
+    /* Busy slots of slab chunks, zero for other chunks. */
+    nxt_atomic_t    slot_map[PORT_MMAP_CHUNK_COUNT];
 };
 
 
 struct nxt_port_mmap_handler_s {
     nxt_port_mmap_header_t  *hdr;
     nxt_atomic_t            use_count;
+    /* The last slab chunk of outgoing segment. */
+    nxt_chunk_id_t          slab;
 };
 
 /*
@@ -77,7 +116,7 @@ typedef struct nxt_port_mmap_msg_s nxt_port_mmap_msg_t;
 /* Passed as a second iov chunk when 'mmap' bit in nxt_port_msg_t is 1. */
 struct nxt_port_mmap_msg_s {
     uint32_t            mmap_id;    /* Mmap index in nxt_process_t.outgoing. */
-    nxt_chunk_id_t      chunk_id;   /* Mmap chunk index. */
+    nxt_chunk_id_t      chunk_id;   /* Mmap chunk index and slot. */
     uint32_t            size;       /* Payload data size. */
 };
 
@@ -191,4 +230,214 @@ nxt_port_mmap_set_chunk_free(nxt_free_map_t *m, nxt_chunk_id_t c)
 }
 
 
+nxt_inline u_char *
+nxt_port_mmap_slot_start(nxt_port_mmap_header_t *hdr, nxt_chunk_id_t c,
+    nxt_chunk_id_t slot)
+{
+    return nxt_port_mmap_chunk_start(hdr, c) + slot * PORT_MMAP_SLOT_SIZE;
+}
+
+
+nxt_inline nxt_chunk_id_t
+nxt_port_mmap_slot_id(nxt_port_mmap_header_t *hdr, nxt_chunk_id_t c,
+    u_char *p)
+{
+    return (p - nxt_port_mmap_chunk_start(hdr, c)) / PORT_MMAP_SLOT_SIZE;
+}
+
+
+nxt_inline nxt_bool_t
+nxt_port_mmap_chk_set_slot_busy(nxt_atomic_t *m, nxt_chunk_id_t slot)
+{
+    nxt_slot_map_t  map;
+
+    for ( ;; ) {
+        map = *m;
+
+        if ((map & SLOT_MASK(slot, 1)) != 0) {
+            return 0;
+        }
+
+        if (nxt_atomic_cmp_set(m, map, map | SLOT_MASK(slot, 1)) != 0) {
+            return 1;
+        }
+    }
+}
+
+
+#define nxt_port_mmap_keep_chunks(hdr)                                        \
+    ((hdr)->id == 0 ? PORT_MMAP_KEEP_CHUNKS : 0)
+
+
+/*
+ * The slab chunk is returned to free map by the side which releases
+ * its last slot after the owner has closed the slab.
+ */
+
+nxt_inline void
+nxt_port_mmap_set_slots_free(nxt_port_mmap_header_t *hdr, nxt_chunk_id_t c,
+    nxt_slot_map_t mask)
+{
+    if (nxt_atomic_and_fetch(&hdr->slot_map[c], ~mask) == 0) {
+        nxt_port_mmap_set_chunk_free(hdr->free_map, c);
+
+        if (c >= nxt_port_mmap_keep_chunks(hdr)) {
+            hdr->reclaim = 1;
+        }
+    }
+}
+
+
+/*
+ * Free chunks are marked busy while their pages are removed, so neither
+ * the segment owner nor a concurrent reclaim can use them meanwhile.
+ * Returns the number of reclaimed chunks.
+ */
+
+nxt_inline size_t
+nxt_port_mmap_reclaim(nxt_port_mmap_header_t *hdr)
+{
+#if (NXT_HAVE_MADV_REMOVE)
+
+    size_t          i, nfree, n;
+    nxt_chunk_id_t  c, start;
+
+    if (hdr->reclaim == 0) {
+        return 0;
+    }
+
+    nfree = 0;
+
+    for (i = 0; i < MAX_FREE_IDX; i++) {
+        nfree += __builtin_popcountll(hdr->free_map[i]);
+    }
+
+    if (PORT_MMAP_CHUNK_COUNT - nfree >= PORT_MMAP_LOW_WATER
+        || !nxt_atomic_cmp_set(&hdr->reclaim, 1, 0))
+    {
+        return 0;
+    }
+
+    n = 0;
+
+    for (c = nxt_port_mmap_keep_chunks(hdr); c < PORT_MMAP_CHUNK_COUNT; c++) {
+        start = c;
+
+        while (c < PORT_MMAP_CHUNK_COUNT
+               && nxt_port_mmap_chk_set_chunk_busy(hdr->free_map, c))
+        {
+            c++;
+        }
+
+        if (c == start) {
+            continue;
+        }
+
+        (void) madvise(nxt_port_mmap_chunk_start(hdr, start),
+                       (c - start) * PORT_MMAP_CHUNK_SIZE, MADV_REMOVE);
+
+        n += c - start;
+
+        while (start < c) {
+            nxt_port_mmap_set_chunk_free(hdr->free_map, start);
+            start++;
+        }
+    }
+
+    return n;
+
+#else
+
+    return 0;
+
+#endif
+}
+
+
+/*
+ * Releases chunks or slots of the [p, end) range started at its boundary.
+ * Contiguous buffers are coalesced on sending, so the range may cover both
+ * slab and whole chunks; each chunk is released according to its own kind.
+ */
+
+nxt_inline void
+nxt_port_mmap_free_range(nxt_port_mmap_header_t *hdr, u_char *p, u_char *end)
+{
+    u_char          *next, *last;
+    nxt_chunk_id_t  c, slot, n;
+
+    while (p < end) {
+        c = nxt_port_mmap_chunk_id(hdr, p);
+        next = nxt_port_mmap_chunk_start(hdr, c + 1);
+
+        if (hdr->slot_map[c] != 0) {
+            last = (end < next) ? end : next;
+
+            slot = nxt_port_mmap_slot_id(hdr, c, p);
+            n = nxt_port_mmap_slot_id(hdr, c, last - 1) + 1 - slot;
+
+            nxt_port_mmap_set_slots_free(hdr, c, SLOT_MASK(slot, n));
+
+        } else {
+            nxt_port_mmap_set_chunk_free(hdr->free_map, c);
+
+            if (c >= nxt_port_mmap_keep_chunks(hdr)) {
+                hdr->reclaim = 1;
+            }
+        }
+
+        p = next;
+    }
+}
+
+
+nxt_inline nxt_chunk_id_t
+nxt_port_mmap_msg_id(nxt_port_mmap_header_t *hdr, u_char *p)
+{
+    nxt_chunk_id_t  c;
+
+    c = nxt_port_mmap_chunk_id(hdr, p);
+
+    if (hdr->slot_map[c] == 0) {
+        return c;
+    }
+
+    return c | ((nxt_port_mmap_slot_id(hdr, c, p) + 1) << SLOT_SHIFT);
+}
+
+
+nxt_inline u_char *
+nxt_port_mmap_msg_start(nxt_port_mmap_header_t *hdr, nxt_chunk_id_t id)
+{
+    nxt_chunk_id_t  slot;
+
+    slot = id >> SLOT_SHIFT;
+
+    if (slot == 0) {
+        return nxt_port_mmap_chunk_start(hdr, id);
+    }
+
+    return nxt_port_mmap_slot_start(hdr, SLOT_CHUNK(id), slot - 1);
+}
+
+
+/* Rounds the range end up to the boundary of its last chunk or slot. */
+
+nxt_inline u_char *
+nxt_port_mmap_range_end(nxt_port_mmap_header_t *hdr, u_char *end)
+{
+    u_char          *p;
+    size_t          unit;
+    nxt_chunk_id_t  c;
+
+    c = nxt_port_mmap_chunk_id(hdr, end - 1);
+    p = nxt_port_mmap_chunk_start(hdr, c);
+
+    unit = (hdr->slot_map[c] != 0) ? PORT_MMAP_SLOT_SIZE
+                                   : PORT_MMAP_CHUNK_SIZE;
+
+    return p + (end - p + unit - 1) / unit * unit;
+}
+
+
 #endif /* _NXT_PORT_MEMORY_INT_H_INCLUDED_ */
@@ -8,7 +8,24 @@
 
 
 static void nxt_port_write_handler(nxt_task_t *task, void *obj, void *data);
+#if (NXT_HAVE_SENDMMSG)
+static ssize_t nxt_port_write_batch(nxt_task_t *task, nxt_port_t *port,
+    nxt_port_send_msg_t *msg, nxt_uint_t niov, size_t size,
+    nxt_port_method_t m, int *use_delta);
+#endif
+static ssize_t nxt_port_ring_write(nxt_task_t *task, nxt_port_t *port,
+    nxt_port_send_msg_t *msg, struct iovec *iov, nxt_uint_t niov);
+static void nxt_port_ring_wakeup(nxt_task_t *task, nxt_port_t *port);
 static void nxt_port_read_handler(nxt_task_t *task, void *obj, void *data);
+static nxt_port_ring_recv_t *nxt_port_ring_find(nxt_port_t *port,
+    nxt_pid_t pid);
+static void nxt_port_ring_socket_msg(nxt_task_t *task, nxt_port_t *port,
+    nxt_port_ring_recv_t *rr, nxt_port_recv_msg_t *msg);
+static void nxt_port_ring_read(nxt_task_t *task, nxt_port_t *port,
+    nxt_port_ring_recv_t *rr);
+static void nxt_port_ring_wait(nxt_task_t *task, nxt_port_t *port);
+static void nxt_port_read_msg(nxt_task_t *task, nxt_port_t *port,
+    nxt_port_recv_msg_t *msg);
 static void nxt_port_read_msg_process(nxt_task_t *task, nxt_port_t *port,
     nxt_port_recv_msg_t *msg);
 static nxt_buf_t *nxt_port_buf_alloc(nxt_port_t *port);
@@ -255,9 +272,18 @@ nxt_port_socket_twrite(nxt_task_t *task, nxt_port_t *port, nxt_uint_t type,
     msg.port_msg.nf = 0;
     msg.port_msg.mf = 0;
     msg.port_msg.tracking = tracking != NULL;
+    msg.port_msg.ring = 0;
 
     msg.work.data = NULL;
 
+    /*
+     * The ring is started with the first message which may be passed
+     * through it, the peer already knows this process at that moment.
+     */
+    if (port->ring_enabled && port->ring_lock == 0 && fd == -1) {
+        (void) nxt_port_ring_start(task, port);
+    }
+
     if (port->socket.write_ready) {
         nxt_port_write_handler(task, &port->socket, &msg);
     } else {
@@ -361,7 +387,7 @@ nxt_port_write_handler(nxt_task_t *task, void *obj, void *data)
          * is bigger than PORT_MMAP_MIN_SIZE.
          */
         if (m == NXT_PORT_METHOD_MMAP && plain_size > PORT_MMAP_MIN_SIZE) {
-            nxt_port_mmap_write(task, port, msg, &sb);
+            nxt_port_mmap_write(task, port, msg, &sb, port->mmsg_buf);
 
         } else {
             m = NXT_PORT_METHOD_PLAIN;
@@ -370,7 +396,44 @@ nxt_port_write_handler(nxt_task_t *task, void *obj, void *data)
         msg->port_msg.last |= sb.last;
         msg->port_msg.mf = sb.limit_reached || sb.nmax_reached;
 
-        n = nxt_socketpair_send(&port->socket, msg->fd, iov, sb.niov + 1);
+#if (NXT_HAVE_SENDMMSG)
+
+        if (sb.buf == NULL
+            && msg->fd == -1
+            && msg->port_msg.type != _NXT_PORT_MSG_RING
+            && !port->ring_ready
+            && msg->link.next != NULL
+            && nxt_queue_next(&msg->link) != nxt_queue_tail(&port->messages))
+        {
+            n = nxt_port_write_batch(task, port, msg, sb.niov + 1, plain_size,
+                                     m, &use_delta);
+
+            if (nxt_slow_path(n == NXT_ERROR)) {
+                goto fail;
+            }
+
+            continue;
+        }
+
+#endif
+
+        if (port->ring_ready) {
+            n = nxt_port_ring_write(task, port, msg, iov, sb.niov + 1);
+
+        } else {
+            n = nxt_socketpair_send(&port->socket, msg->fd, iov, sb.niov + 1);
+
+            if (n > 0) {
+                port->write_calls++;
+                port->write_msgs++;
+
+                if (msg->port_msg.type == _NXT_PORT_MSG_RING
+                    && port->ring != NULL)
+                {
+                    port->ring_ready = 1;
+                }
+            }
+        }
 
         if (n > 0) {
             if (nxt_slow_path((size_t) n != sb.size + iov[0].iov_len)) {
@@ -469,6 +532,281 @@ unlock_mutex:
 }
 
 
+#if (NXT_HAVE_SENDMMSG)
+
+#define NXT_PORT_BATCH_MAX  8
+/* The size of nxt_port_mmap_msg_t. */
+#define NXT_PORT_MMSG_SIZE  (3 * sizeof(uint32_t))
+
+
+/*
+ * Queued messages which are sent in one datagram each and without file
+ * descriptors are sent by one system call.  The first message is already
+ * prepared in port->iov and port->mmsg_buf, the others are placed after it.
+ */
+
+static ssize_t
+nxt_port_write_batch(nxt_task_t *task, nxt_port_t *port,
+    nxt_port_send_msg_t *msg, nxt_uint_t niov, size_t size,
+    nxt_port_method_t m, int *use_delta)
+{
+    u_char                  *mmsg_buf;
+    size_t                  mmsg_free;
+    ssize_t                 n;
+    nxt_uint_t              i, k, iov_free;
+    struct iovec            *iov;
+    nxt_work_queue_t        *wq;
+    nxt_queue_link_t        *lnk;
+    nxt_sendbuf_coalesce_t  sb;
+    size_t                  sizes[NXT_PORT_BATCH_MAX];
+    nxt_port_method_t       methods[NXT_PORT_BATCH_MAX];
+    nxt_port_send_msg_t     *msgs[NXT_PORT_BATCH_MAX];
+    struct mmsghdr          mmsg[NXT_PORT_BATCH_MAX];
+
+    nxt_memzero(mmsg, sizeof(mmsg));
+
+    mmsg[0].msg_hdr.msg_iov = port->iov;
+    mmsg[0].msg_hdr.msg_iovlen = niov;
+    msgs[0] = msg;
+    sizes[0] = size;
+    methods[0] = m;
+
+    iov = port->iov + niov;
+    iov_free = NXT_IOBUF_MAX * 10 - niov;
+
+    /* See nxt_port_write_enable() for the buffer sizes. */
+
+    mmsg_buf = port->mmsg_buf;
+    mmsg_free = NXT_PORT_MMSG_SIZE * NXT_IOBUF_MAX * 10;
+
+    if (msg->port_msg.mmap) {
+        mmsg_buf += port->iov[1].iov_len;
+        mmsg_free -= port->iov[1].iov_len;
+    }
+
+    k = 1;
+
+    for (lnk = nxt_queue_next(&msg->link);
+         lnk != nxt_queue_tail(&port->messages) && k < NXT_PORT_BATCH_MAX;
+         lnk = nxt_queue_next(lnk))
+    {
+        msg = nxt_queue_link_data(lnk, nxt_port_send_msg_t, link);
+
+        /* The ring is used after the ring message is sent. */
+
+        if (msg->fd != -1 || msg->port_msg.type == _NXT_PORT_MSG_RING) {
+            break;
+        }
+
+        iov[0].iov_base = &msg->port_msg;
+        iov[0].iov_len = sizeof(nxt_port_msg_t);
+
+        if (msg->port_msg.tracking) {
+            iov[0].iov_len += sizeof(msg->tracking_msg);
+        }
+
+        sb.buf = msg->buf;
+        sb.iobuf = &iov[1];
+        sb.nmax = nxt_min(iov_free - 1, mmsg_free / NXT_PORT_MMSG_SIZE);
+        sb.sync = 0;
+        sb.last = 0;
+        sb.size = 0;
+        sb.limit = port->max_size;
+
+        sb.limit_reached = 0;
+        sb.nmax_reached = 0;
+
+        m = nxt_port_mmap_get_method(task, port, msg->buf);
+
+        if (m == NXT_PORT_METHOD_MMAP) {
+            sb.limit = (1ULL << 31) - 1;
+        }
+
+        nxt_sendbuf_mem_coalesce(task, &sb);
+
+        if (sb.buf != NULL) {
+            /* The message is sent in several parts or does not fit. */
+            break;
+        }
+
+        sizes[k] = sb.size;
+
+        if (m == NXT_PORT_METHOD_MMAP && sb.size > PORT_MMAP_MIN_SIZE) {
+            nxt_port_mmap_write(task, port, msg, &sb, mmsg_buf);
+
+            mmsg_buf += sb.size;
+            mmsg_free -= sb.size;
+
+        } else {
+            m = NXT_PORT_METHOD_PLAIN;
+        }
+
+        msg->port_msg.last |= sb.last;
+        msg->port_msg.mf = 0;
+
+        mmsg[k].msg_hdr.msg_iov = iov;
+        mmsg[k].msg_hdr.msg_iovlen = sb.niov + 1;
+
+        msgs[k] = msg;
+        methods[k] = m;
+
+        iov += sb.niov + 1;
+        iov_free -= sb.niov + 1;
+
+        k++;
+
+        if (iov_free < 2 || mmsg_free < NXT_PORT_MMSG_SIZE) {
+            break;
+        }
+    }
+
+    n = nxt_socketpair_send_batch(&port->socket, mmsg, k);
+
+    if (n <= 0) {
+        return n;
+    }
+
+    port->write_calls++;
+    port->write_msgs += n;
+
+    nxt_debug(task, "port %d: %z of %ui messages sent, %ui messages "
+              "in %ui calls", port->socket.fd, n, k, port->write_msgs,
+              port->write_calls);
+
+    wq = &task->thread->engine->fast_work_queue;
+
+    for (i = 0; i < (nxt_uint_t) n; i++) {
+        msg = msgs[i];
+
+        msg->buf = nxt_sendbuf_completion(task, wq, msg->buf, sizes[i],
+                                          methods[i] == NXT_PORT_METHOD_MMAP);
+
+        nxt_queue_remove(&msg->link);
+        (*use_delta)--;
+
+        nxt_work_queue_add(wq, nxt_port_release_send_msg, task, msg,
+                           msg->work.data);
+    }
+
+    return n;
+}
+
+#endif
+
+
+/*
+ * A message without file descriptor which fits in a ring slot is put
+ * in the shared memory ring, the peer is woken up via the socket only
+ * if it sleeps.  Other messages are sent via the socket, a marker put
+ * in the ring before them suspends the ring till a socket message
+ * with the "ring" flag.
+ */
+
+static ssize_t
+nxt_port_ring_write(nxt_task_t *task, nxt_port_t *port,
+    nxt_port_send_msg_t *msg, struct iovec *iov, nxt_uint_t niov)
+{
+    u_char                *p;
+    size_t                size;
+    ssize_t               n;
+    nxt_uint_t            i;
+    nxt_port_ring_t       *ring;
+    nxt_atomic_uint_t     tail, free;
+    nxt_port_ring_slot_t  *slot;
+
+    ring = port->ring;
+
+    tail = ring->tail;
+    free = NXT_PORT_RING_SLOTS - (tail - ring->head);
+
+    if (!port->ring_socket) {
+        slot = &ring->slot[tail % NXT_PORT_RING_SLOTS];
+
+        size = 0;
+
+        for (i = 0; i < niov; i++) {
+            size += iov[i].iov_len;
+        }
+
+        /* A slot is always left for a marker. */
+
+        if (msg->fd == -1 && size <= sizeof(slot->data) && free >= 2) {
+            msg->port_msg.ring = 0;
+
+            p = slot->data;
+
+            for (i = 0; i < niov; i++) {
+                p = nxt_cpymem(p, iov[i].iov_base, iov[i].iov_len);
+            }
+
+            slot->size = size;
+
+            /* A full barrier, the slot is filled before tail is updated. */
+            (void) nxt_atomic_fetch_add(&ring->tail, 1);
+
+            if (ring->waiting != 0
+                && nxt_atomic_cmp_set(&ring->waiting, 1, 0))
+            {
+                nxt_port_ring_wakeup(task, port);
+            }
+
+            return size;
+        }
+
+        nxt_debug(task, "port %d: suspend ring", port->socket.fd);
+
+        slot->size = 0;
+
+        (void) nxt_atomic_fetch_add(&ring->tail, 1);
+
+        free--;
+        port->ring_socket = 1;
+    }
+
+    msg->port_msg.ring = (free >= 2);
+
+    n = nxt_socketpair_send(&port->socket, msg->fd, iov, niov);
+
+    if (n > 0 && msg->port_msg.ring) {
+        nxt_debug(task, "port %d: resume ring", port->socket.fd);
+
+        port->ring_socket = 0;
+    }
+
+    return n;
+}
+
+
+static void
+nxt_port_ring_wakeup(nxt_task_t *task, nxt_port_t *port)
+{
+    struct iovec    iov;
+    nxt_port_msg_t  port_msg;
+
+    nxt_debug(task, "port %d: wakeup ring", port->socket.fd);
+
+    port_msg.stream = 0;
+    port_msg.pid = nxt_pid;
+    port_msg.reply_port = 0;
+    port_msg.type = _NXT_PORT_MSG_RING;
+    port_msg.last = 1;
+    port_msg.mmap = 0;
+    port_msg.nf = 0;
+    port_msg.mf = 0;
+    port_msg.tracking = 0;
+    port_msg.ring = 0;
+
+    iov.iov_base = &port_msg;
+    iov.iov_len = sizeof(nxt_port_msg_t);
+
+    /*
+     * The wakeup is not needed if the socket is full,
+     * the peer has messages to read anyway.
+     */
+    (void) nxt_socketpair_send(&port->socket, -1, &iov, 1);
+}
+
+
 void
 nxt_port_read_enable(nxt_task_t *task, nxt_port_t *port)
 {
@@ -497,11 +835,12 @@ nxt_port_read_close(nxt_port_t *port)
 static void
 nxt_port_read_handler(nxt_task_t *task, void *obj, void *data)
 {
-    ssize_t              n;
-    nxt_buf_t            *b;
-    nxt_port_t           *port;
-    struct iovec         iov[2];
-    nxt_port_recv_msg_t  msg;
+    ssize_t               n;
+    nxt_buf_t             *b;
+    nxt_port_t            *port;
+    struct iovec          iov[2];
+    nxt_port_ring_recv_t  *rr;
+    nxt_port_recv_msg_t   msg;
 
     port = msg.port = nxt_container_of(obj, nxt_port_t, socket);
 
@@ -528,14 +867,19 @@ nxt_port_read_handler(nxt_task_t *task, void *obj, void *data)
             msg.buf = b;
             msg.size = n;
 
-            nxt_port_read_msg_process(task, port, &msg);
+            rr = NULL;
+
+            if (!nxt_queue_is_empty(&port->rings)
+                && (size_t) n >= sizeof(nxt_port_msg_t))
+            {
+                rr = nxt_port_ring_find(port, msg.port_msg.pid);
+            }
+
+            if (rr != NULL) {
+                nxt_port_ring_socket_msg(task, port, rr, &msg);
 
-            /*
-             * To disable instant completion or buffer re-usage,
-             * handler should reset 'msg.buf'.
-             */
-            if (msg.buf == b) {
-                nxt_port_buf_free(port, b);
+            } else {
+                nxt_port_read_msg(task, port, &msg);
             }
 
             if (port->socket.read_ready) {
@@ -548,6 +892,10 @@ nxt_port_read_handler(nxt_task_t *task, void *obj, void *data)
         if (n == NXT_AGAIN) {
             nxt_port_buf_free(port, b);
 
+            if (!nxt_queue_is_empty(&port->rings)) {
+                nxt_port_ring_wait(task, port);
+            }
+
             nxt_fd_event_enable_read(task->thread->engine, &port->socket);
             return;
         }
@@ -561,6 +909,221 @@ nxt_port_read_handler(nxt_task_t *task, void *obj, void *data)
 }
 
 
+static nxt_port_ring_recv_t *
+nxt_port_ring_find(nxt_port_t *port, nxt_pid_t pid)
+{
+    nxt_port_ring_recv_t  *rr;
+
+    nxt_queue_each(rr, &port->rings, nxt_port_ring_recv_t, link) {
+
+        if (rr->pid == pid) {
+            return rr;
+        }
+
+    } nxt_queue_loop;
+
+    return NULL;
+}
+
+
+typedef struct {
+    nxt_queue_link_t     link;   /* for nxt_port_ring_recv_t.pending */
+    nxt_port_recv_msg_t  msg;
+} nxt_port_ring_msg_t;
+
+
+/*
+ * A socket message from the ring producer is processed after messages
+ * put in the ring before it, that is, when a marker is read from the ring.
+ */
+
+static void
+nxt_port_ring_socket_msg(nxt_task_t *task, nxt_port_t *port,
+    nxt_port_ring_recv_t *rr, nxt_port_recv_msg_t *msg)
+{
+    nxt_port_ring_msg_t  *rmsg;
+
+    if (msg->port_msg.type == _NXT_PORT_MSG_RING
+        && msg->size == sizeof(nxt_port_msg_t))
+    {
+        /* Wakeup. */
+        nxt_port_buf_free(port, msg->buf);
+
+        nxt_port_ring_read(task, port, rr);
+        return;
+    }
+
+    rmsg = nxt_mp_alloc(port->mem_pool, sizeof(nxt_port_ring_msg_t));
+
+    if (nxt_slow_path(rmsg == NULL)) {
+        nxt_port_read_msg(task, port, msg);
+        return;
+    }
+
+    rmsg->msg = *msg;
+
+    nxt_queue_insert_tail(&rr->pending, &rmsg->link);
+
+    nxt_port_ring_read(task, port, rr);
+}
+
+
+static void
+nxt_port_ring_read(nxt_task_t *task, nxt_port_t *port,
+    nxt_port_ring_recv_t *rr)
+{
+    size_t                size;
+    nxt_buf_t             *b;
+    nxt_atomic_uint_t     head, tail;
+    nxt_queue_link_t      *lnk;
+    nxt_port_ring_t       *ring;
+    nxt_port_ring_msg_t   *rmsg;
+    nxt_port_ring_slot_t  *slot;
+    nxt_port_recv_msg_t   msg;
+
+    ring = rr->ring;
+    tail = ring->head;
+
+    for ( ;; ) {
+
+        if (rr->blocked) {
+            if (nxt_queue_is_empty(&rr->pending)) {
+                return;
+            }
+
+            lnk = nxt_queue_first(&rr->pending);
+            nxt_queue_remove(lnk);
+
+            rmsg = nxt_queue_link_data(lnk, nxt_port_ring_msg_t, link);
+            msg = rmsg->msg;
+
+            nxt_mp_free(port->mem_pool, rmsg);
+
+            nxt_port_read_msg(task, port, &msg);
+
+            if (msg.port_msg.ring) {
+                nxt_debug(task, "port %d: ring of process %PI resumed",
+                          port->socket.fd, rr->pid);
+
+                rr->blocked = 0;
+            }
+
+            continue;
+        }
+
+        /* The ring may be read ahead by a nested call. */
+        head = ring->head;
+
+        if ((nxt_atomic_int_t) (tail - head) <= 0) {
+            /* A full barrier, the slots are read after tail. */
+            tail = nxt_atomic_fetch_add(&ring->tail, 0);
+
+            if (tail == head) {
+                return;
+            }
+        }
+
+        slot = &ring->slot[head % NXT_PORT_RING_SLOTS];
+        size = slot->size;
+
+        if (size == 0) {
+            (void) nxt_atomic_fetch_add(&ring->head, 1);
+
+            nxt_debug(task, "port %d: ring of process %PI suspended",
+                      port->socket.fd, rr->pid);
+
+            rr->blocked = 1;
+            continue;
+        }
+
+        if (nxt_slow_path(size < sizeof(nxt_port_msg_t)
+                          || size > sizeof(slot->data)))
+        {
+            nxt_log(task, NXT_LOG_CRIT,
+                    "port %d: invalid ring message size:%uz",
+                    port->socket.fd, size);
+
+            (void) nxt_atomic_fetch_add(&ring->head, 1);
+            continue;
+        }
+
+        b = nxt_port_buf_alloc(port);
+
+        if (nxt_slow_path(b == NULL)) {
+            return;
+        }
+
+        nxt_memcpy(&msg.port_msg, slot->data, sizeof(nxt_port_msg_t));
+        nxt_memcpy(b->mem.pos, slot->data + sizeof(nxt_port_msg_t),
+                   size - sizeof(nxt_port_msg_t));
+
+        /* A full barrier, the slot is released after it has been read. */
+        (void) nxt_atomic_fetch_add(&ring->head, 1);
+
+        msg.fd = -1;
+        msg.buf = b;
+        msg.port = port;
+        msg.size = size;
+
+        nxt_port_read_msg(task, port, &msg);
+    }
+}
+
+
+/*
+ * The consumer reads the rings and then marks them as waiting before
+ * it sleeps, a producer wakes it up via the socket after that.
+ */
+
+static void
+nxt_port_ring_wait(nxt_task_t *task, nxt_port_t *port)
+{
+    nxt_port_ring_t       *ring;
+    nxt_port_ring_recv_t  *rr;
+
+    nxt_queue_each(rr, &port->rings, nxt_port_ring_recv_t, link) {
+
+        ring = rr->ring;
+
+        for ( ;; ) {
+            nxt_port_ring_read(task, port, rr);
+
+            if (rr->blocked) {
+                /* The ring is resumed by a socket message. */
+                break;
+            }
+
+            (void) nxt_atomic_cmp_set(&ring->waiting, 0, 1);
+
+            if (ring->head == ring->tail) {
+                break;
+            }
+        }
+
+    } nxt_queue_loop;
+}
+
+
+static void
+nxt_port_read_msg(nxt_task_t *task, nxt_port_t *port,
+    nxt_port_recv_msg_t *msg)
+{
+    nxt_buf_t  *b;
+
+    b = msg->buf;
+
+    nxt_port_read_msg_process(task, port, msg);
+
+    /*
+     * To disable instant completion or buffer re-usage,
+     * handler should reset 'msg.buf'.
+     */
+    if (msg->buf == b) {
+        nxt_port_buf_free(port, b);
+    }
+}
+
+
 static nxt_int_t
 nxt_port_lvlhsh_frag_test(nxt_lvlhsh_query_t *lhq, void *data)
 {
@@ -781,6 +1344,9 @@ nxt_port_read_msg_process(nxt_task_t *task, nxt_port_t *port,
                 }
 
                 port->handler(task, msg);
+
+            } else if (msg->fd != -1) {
+                nxt_fd_close(msg->fd);
             }
         }
     }
@@ -87,8 +87,7 @@ nxt_inline nxt_int_t nxt_python_write(nxt_python_run_ctx_t *ctx,
                       const u_char *data, size_t len,
                       nxt_bool_t flush, nxt_bool_t last);
 
-nxt_inline nxt_int_t nxt_python_write_py_str(nxt_python_run_ctx_t *ctx,
-                      PyObject *str, nxt_bool_t flush, nxt_bool_t last);
+static PyObject *nxt_python_str_bytes(PyObject *str);
 
 
 static uint32_t  compat[] = {
@@ -653,12 +652,15 @@ static PyObject *
 nxt_python_get_environ(nxt_task_t *task, nxt_app_rmsg_t *rmsg,
     nxt_python_run_ctx_t *ctx)
 {
-    size_t          s;
-    u_char          *colon;
-    PyObject        *environ;
-    nxt_int_t       rc;
-    nxt_str_t       n, v, target, path, query;
-    nxt_str_t       host, server_name, server_port;
+    size_t            s;
+    u_char            *colon;
+    PyObject          *environ;
+    nxt_int_t         rc;
+    nxt_str_t         n, v, target, path, query;
+    nxt_str_t         host, server_name, server_port;
+    nxt_uint_t        i;
+    nxt_app_fields_t  fields;
+    u_char            name[NXT_APP_FIELD_ENV_NAME_SIZE];
 
     static nxt_str_t def_host = nxt_string("localhost");
     static nxt_str_t def_port = nxt_string("80");
@@ -736,20 +738,23 @@ nxt_python_get_environ(nxt_task_t *task, nxt_app_rmsg_t *rmsg,
     RC(nxt_python_add_env(task, environ, "SERVER_NAME", &server_name));
     RC(nxt_python_add_env(task, environ, "SERVER_PORT", &server_port));
 
+    /* The cookie is passed in the "HTTP_COOKIE" field. */
+    RC(nxt_app_msg_read_str(task, rmsg, &v));
+
     NXT_READ("CONTENT_TYPE");
     NXT_READ("CONTENT_LENGTH");
 
-    while (nxt_app_msg_read_str(task, rmsg, &n) == NXT_OK) {
-        if (nxt_slow_path(n.length == 0)) {
-            break;
-        }
+    /* The parsed content length is not used. */
+    RC(nxt_app_msg_read_size(task, rmsg, &s));
 
-        rc = nxt_app_msg_read_str(task, rmsg, &v);
-        if (nxt_slow_path(rc != NXT_OK)) {
-            break;
-        }
+    RC(nxt_app_msg_read_fields(task, rmsg, &fields));
 
-        RC(nxt_python_add_env(task, environ, (char *) n.start, &v));
+    for (i = 0; i < fields.count; i++) {
+        RC(nxt_app_fields_get(&fields, i, &n, &v));
+
+        nxt_app_field_env_name(name, &n);
+
+        RC(nxt_python_add_env(task, environ, (char *) name, &v));
     }
 
     RC(nxt_app_msg_read_size(task, rmsg, &ctx->body_preread_size));
@@ -770,35 +775,34 @@ fail:
 static PyObject *
 nxt_py_start_resp(PyObject *self, PyObject *args)
 {
-    PyObject    *headers, *tuple, *string;
-    nxt_int_t   rc;
+    PyObject    *headers, *tuple, *string, *name, *value;
+    nxt_int_t   rc, status;
     nxt_uint_t  i, n;
     nxt_python_run_ctx_t  *ctx;
 
-    static const u_char status[] = "Status: ";
-
-    static const u_char cr_lf[] = "\r\n";
-    static const u_char sc_sp[] = ": ";
-
     n = PyTuple_GET_SIZE(args);
 
     if (n < 2 || n > 3) {
         return PyErr_Format(PyExc_TypeError, "invalid number of arguments");
     }
 
-    string = PyTuple_GET_ITEM(args, 0);
-
-    ctx = nxt_python_run_ctx;
-
-    nxt_python_write(ctx, status, sizeof(status) - 1, 0, 0);
-
-    rc = nxt_python_write_py_str(ctx, string, 0, 0);
-    if (nxt_slow_path(rc != NXT_OK)) {
+    string = nxt_python_str_bytes(PyTuple_GET_ITEM(args, 0));
+    if (nxt_slow_path(string == NULL)) {
         return PyErr_Format(PyExc_TypeError,
                             "failed to write first argument (not a string?)");
     }
 
-    nxt_python_write(ctx, cr_lf, sizeof(cr_lf) - 1, 0, 0);
+    status = -1;
+
+    if (PyBytes_GET_SIZE(string) >= 3) {
+        status = nxt_int_parse((u_char *) PyBytes_AS_STRING(string), 3);
+    }
+
+    Py_DECREF(string);
+
+    if (nxt_slow_path(status < 100)) {
+        return PyErr_Format(PyExc_ValueError, "invalid response status");
+    }
 
     headers = PyTuple_GET_ITEM(args, 1);
 
@@ -807,7 +811,9 @@ nxt_py_start_resp(PyObject *self, PyObject *args)
                          "the second argument is not a response headers list");
     }
 
-    for (i = 0; i < (nxt_uint_t) PyList_GET_SIZE(headers); i++) {
+    n = PyList_GET_SIZE(headers);
+
+    for (i = 0; i < n; i++) {
         tuple = PyList_GET_ITEM(headers, i);
 
         if (!PyTuple_Check(tuple)) {
@@ -819,32 +825,52 @@ nxt_py_start_resp(PyObject *self, PyObject *args)
             return PyErr_Format(PyExc_TypeError,
                                 "each header must be a tuple of two items");
         }
+    }
+
+    ctx = nxt_python_run_ctx;
 
-        string = PyTuple_GET_ITEM(tuple, 0);
+    rc = nxt_app_msg_write_status(ctx->task, ctx->wmsg, status, n);
+    if (nxt_slow_path(rc != NXT_OK)) {
+        return PyErr_Format(PyExc_RuntimeError,
+                            "failed to write response status");
+    }
 
-        rc = nxt_python_write_py_str(ctx, string, 0, 0);
-        if (nxt_slow_path(rc != NXT_OK)) {
+    for (i = 0; i < n; i++) {
+        tuple = PyList_GET_ITEM(headers, i);
+
+        name = nxt_python_str_bytes(PyTuple_GET_ITEM(tuple, 0));
+        if (nxt_slow_path(name == NULL)) {
             return PyErr_Format(PyExc_TypeError,
                                 "failed to write response header name"
                                  " (not a string?)");
         }
 
-        nxt_python_write(ctx, sc_sp, sizeof(sc_sp) - 1, 0, 0);
-
-        string = PyTuple_GET_ITEM(tuple, 1);
+        value = nxt_python_str_bytes(PyTuple_GET_ITEM(tuple, 1));
+        if (nxt_slow_path(value == NULL)) {
+            Py_DECREF(name);
 
-        rc = nxt_python_write_py_str(ctx, string, 0, 0);
-        if (nxt_slow_path(rc != NXT_OK)) {
             return PyErr_Format(PyExc_TypeError,
                                 "failed to write response header value"
                                  " (not a string?)");
         }
 
-        nxt_python_write(ctx, cr_lf, sizeof(cr_lf) - 1, 0, 0);
+        rc = nxt_app_msg_write_field(ctx->task, ctx->wmsg,
+                                     (u_char *) PyBytes_AS_STRING(name),
+                                     PyBytes_GET_SIZE(name),
+                                     (u_char *) PyBytes_AS_STRING(value),
+                                     PyBytes_GET_SIZE(value));
+
+        Py_DECREF(name);
+        Py_DECREF(value);
+
+        if (nxt_slow_path(rc != NXT_OK)) {
+            return PyErr_Format(PyExc_RuntimeError,
+                                "failed to write response header");
+        }
     }
 
     /* flush headers */
-    nxt_python_write(ctx, cr_lf, sizeof(cr_lf) - 1, 1, 0);
+    nxt_app_msg_flush(ctx->task, ctx->wmsg, 0);
 
     return args;
 }
@@ -905,7 +931,18 @@ nxt_py_input_read(nxt_py_input_t *self, PyObject *args)
     buf = (u_char *) PyBytes_AS_STRING(body);
 
     copy_size = nxt_min((size_t) size, ctx->body_preread_size);
-    copy_size = nxt_app_msg_read_raw(ctx->task, ctx->rmsg, buf, copy_size);
+    copy_size = nxt_app_msg_read_body(ctx->task, ctx->rmsg, buf, copy_size);
+
+    if (nxt_slow_path(copy_size < (size_t) size)) {
+        /* A streamed body may be truncated by client. */
+        ctx->body_preread_size = 0;
+
+        if (_PyBytes_Resize(&body, copy_size) != 0) {
+            return NULL;
+        }
+
+        return body;
+    }
 
     ctx->body_preread_size -= copy_size;
 
@@ -943,34 +980,17 @@ nxt_python_write(nxt_python_run_ctx_t *ctx, const u_char *data, size_t len,
 }
 
 
-nxt_inline nxt_int_t
-nxt_python_write_py_str(nxt_python_run_ctx_t *ctx, PyObject *str,
-    nxt_bool_t flush, nxt_bool_t last)
+static PyObject *
+nxt_python_str_bytes(PyObject *str)
 {
-    PyObject   *bytes;
-    nxt_int_t  rc;
-
-    rc = NXT_OK;
-
     if (PyBytes_Check(str)) {
-        rc = nxt_python_write(ctx, (u_char *) PyBytes_AS_STRING(str),
-                              PyBytes_GET_SIZE(str), flush, last);
-
-    } else {
-        if (!PyUnicode_Check(str)) {
-            return NXT_ERROR;
-        }
-
-        bytes = PyUnicode_AsLatin1String(str);
-        if (nxt_slow_path(bytes == NULL)) {
-            return NXT_ERROR;
-        }
-
-        rc = nxt_python_write(ctx, (u_char *) PyBytes_AS_STRING(bytes),
-                              PyBytes_GET_SIZE(bytes), flush, last);
+        Py_INCREF(str);
+        return str;
+    }
 
-        Py_DECREF(bytes);
+    if (!PyUnicode_Check(str)) {
+        return NULL;
     }
 
-    return rc;
+    return PyUnicode_AsLatin1String(str);
 }
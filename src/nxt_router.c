@@ -10,6 +10,10 @@
 #include <nxt_http.h>
 
 
+/* The minimum time in milliseconds an unused engine share keeps ports. */
+#define NXT_ROUTER_APP_SHARE_TIMEOUT  1000
+
+
 typedef struct {
     nxt_str_t         type;
     uint32_t          processes;
@@ -18,17 +22,37 @@ typedef struct {
     nxt_msec_t        timeout;
     nxt_msec_t        res_timeout;
     nxt_msec_t        idle_timeout;
+    nxt_str_t         balance;
     uint32_t          requests;
     nxt_conf_value_t  *limits_value;
     nxt_conf_value_t  *processes_value;
+    nxt_conf_value_t  *cache_value;
+    size_t            cache_size;
+    uint32_t          cache_valid;
+    uint32_t          cache_stale;
+    nxt_msec_t        cache_lock_timeout;
 } nxt_router_app_conf_t;
 
 
 typedef struct {
-    nxt_str_t  application;
+    nxt_str_t         application;
+    nxt_str_t         share;
+    nxt_conf_value_t  *tls_value;
+    uint8_t           reuseport;      /* 1 bit */
+    uint8_t           reuseport_cpu;  /* 1 bit */
 } nxt_router_listener_conf_t;
 
 
+#if (NXT_SSLTLS)
+
+typedef struct {
+    nxt_queue_link_t   link;
+    nxt_socket_conf_t  *socket_conf;
+} nxt_router_tlssock_t;
+
+#endif
+
+
 typedef struct nxt_msg_info_s {
     nxt_buf_t                 *buf;
     nxt_port_mmap_tracking_t  tracking;
@@ -46,6 +70,7 @@ typedef struct {
     nxt_app_parse_ctx_t      *ap;
     nxt_msg_info_t           msg_info;
     nxt_req_app_link_t       *ra;
+    nxt_nsec_t               start_time;
 
     nxt_queue_link_t         link;     /* for nxt_conn_t.requests */
 } nxt_req_conn_link_t;
@@ -150,6 +175,29 @@ static void nxt_router_listen_socket_ready(nxt_task_t *task,
     nxt_port_recv_msg_t *msg, void *data);
 static void nxt_router_listen_socket_error(nxt_task_t *task,
     nxt_port_recv_msg_t *msg, void *data);
+#if (NXT_HAVE_REUSEPORT)
+static nxt_int_t nxt_router_listen_sockets_handover(nxt_task_t *task,
+    nxt_listen_socket_t *ls, nxt_listen_socket_t *prev);
+static void nxt_router_listen_sockets_complete(nxt_task_t *task,
+    nxt_listen_socket_t *ls);
+#endif
+#if (NXT_HAVE_REUSEPORT_CBPF)
+static void nxt_router_listen_socket_cpu(nxt_task_t *task,
+    nxt_listen_socket_t *ls);
+#endif
+static void nxt_router_listen_sockets_close(nxt_task_t *task,
+    nxt_listen_socket_t *ls);
+#if (NXT_SSLTLS)
+static nxt_int_t nxt_router_tls_conf(nxt_task_t *task,
+    nxt_router_temp_conf_t *tmcf, nxt_socket_conf_t *skcf,
+    nxt_conf_value_t *value);
+static void nxt_router_tls_rpc_create(nxt_task_t *task,
+    nxt_router_temp_conf_t *tmcf, nxt_router_tlssock_t *tls);
+static void nxt_router_tls_rpc_ready(nxt_task_t *task,
+    nxt_port_recv_msg_t *msg, void *data);
+static void nxt_router_tls_rpc_error(nxt_task_t *task,
+    nxt_port_recv_msg_t *msg, void *data);
+#endif
 static void nxt_router_app_rpc_create(nxt_task_t *task,
     nxt_router_temp_conf_t *tmcf, nxt_app_t *app);
 static void nxt_router_app_prefork_ready(nxt_task_t *task,
@@ -157,9 +205,12 @@ static void nxt_router_app_prefork_ready(nxt_task_t *task,
 static void nxt_router_app_prefork_error(nxt_task_t *task,
     nxt_port_recv_msg_t *msg, void *data);
 static nxt_socket_conf_t *nxt_router_socket_conf(nxt_task_t *task,
-    nxt_router_temp_conf_t *tmcf, nxt_str_t *name);
-static nxt_int_t nxt_router_listen_socket_find(nxt_router_temp_conf_t *tmcf,
-    nxt_socket_conf_t *nskcf, nxt_sockaddr_t *sa);
+    nxt_router_temp_conf_t *tmcf, nxt_str_t *name,
+    nxt_router_listener_conf_t *lscf);
+static nxt_int_t nxt_router_listen_socket_find(nxt_task_t *task,
+    nxt_router_temp_conf_t *tmcf, nxt_socket_conf_t *nskcf, nxt_sockaddr_t *sa,
+    nxt_router_listener_conf_t *lscf, uint32_t nsockets,
+    nxt_listen_socket_t **prev);
 
 static nxt_int_t nxt_router_engines_create(nxt_task_t *task,
     nxt_router_t *router, nxt_router_temp_conf_t *tmcf,
@@ -177,6 +228,10 @@ static nxt_int_t nxt_router_engine_quit(nxt_router_temp_conf_t *tmcf,
     nxt_router_engine_conf_t *recf);
 static nxt_int_t nxt_router_engine_joints_delete(nxt_router_temp_conf_t *tmcf,
     nxt_router_engine_conf_t *recf, nxt_queue_t *sockets);
+#if (NXT_HAVE_CPU_AFFINITY)
+static nxt_int_t nxt_router_engine_affinity(nxt_router_temp_conf_t *tmcf,
+    nxt_router_engine_conf_t *recf, nxt_uint_t n);
+#endif
 
 static nxt_int_t nxt_router_threads_create(nxt_task_t *task, nxt_runtime_t *rt,
     nxt_router_temp_conf_t *tmcf);
@@ -191,6 +246,8 @@ static void nxt_router_engine_post(nxt_event_engine_t *engine,
     nxt_work_t *jobs);
 
 static void nxt_router_thread_start(void *data);
+static nxt_socket_t nxt_router_listen_socket_fd(nxt_router_temp_conf_t *tmcf,
+    nxt_socket_conf_joint_t *joint);
 static void nxt_router_listen_socket_create(nxt_task_t *task, void *obj,
     void *data);
 static void nxt_router_listen_socket_update(nxt_task_t *task, void *obj,
@@ -199,6 +256,10 @@ static void nxt_router_listen_socket_delete(nxt_task_t *task, void *obj,
     void *data);
 static void nxt_router_worker_thread_quit(nxt_task_t *task, void *obj,
     void *data);
+#if (NXT_HAVE_CPU_AFFINITY)
+static void nxt_router_engine_affinity_handler(nxt_task_t *task, void *obj,
+    void *data);
+#endif
 static void nxt_router_listen_socket_close(nxt_task_t *task, void *obj,
     void *data);
 static void nxt_router_thread_exit_handler(nxt_task_t *task, void *obj,
@@ -207,6 +268,8 @@ static void nxt_router_listen_socket_release(nxt_task_t *task,
     nxt_socket_conf_t *skcf);
 static void nxt_router_conf_release(nxt_task_t *task,
     nxt_socket_conf_joint_t *joint);
+static void nxt_router_joint_app_use(nxt_task_t *task,
+    nxt_socket_conf_joint_t *joint, int i);
 
 static void nxt_router_app_port_ready(nxt_task_t *task,
     nxt_port_recv_msg_t *msg, void *data);
@@ -221,13 +284,7 @@ static nxt_int_t nxt_router_app_port(nxt_task_t *task, nxt_app_t *app,
 
 static void nxt_router_app_prepare_request(nxt_task_t *task,
     nxt_req_app_link_t *ra);
-static nxt_int_t nxt_python_prepare_msg(nxt_task_t *task, nxt_app_request_t *r,
-    nxt_app_wmsg_t *wmsg);
-static nxt_int_t nxt_php_prepare_msg(nxt_task_t *task, nxt_app_request_t *r,
-    nxt_app_wmsg_t *wmsg);
-static nxt_int_t nxt_go_prepare_msg(nxt_task_t *task, nxt_app_request_t *r,
-    nxt_app_wmsg_t *wmsg);
-static nxt_int_t nxt_perl_prepare_msg(nxt_task_t *task, nxt_app_request_t *r,
+static nxt_int_t nxt_router_prepare_msg(nxt_task_t *task, nxt_app_request_t *r,
     nxt_app_wmsg_t *wmsg);
 
 static void nxt_router_conn_free(nxt_task_t *task, void *obj, void *data);
@@ -239,18 +296,71 @@ static void nxt_router_app_idle_timeout(nxt_task_t *task, void *obj,
 static void nxt_router_app_release_handler(nxt_task_t *task, void *obj,
     void *data);
 
+static nxt_queue_link_t *nxt_router_app_least_outstanding(nxt_app_t *app);
+static nxt_queue_link_t *nxt_router_app_p2c(nxt_task_t *task, nxt_app_t *app);
+
+static nxt_app_share_t *nxt_router_app_share_create(nxt_task_t *task,
+    nxt_app_t *app);
+static nxt_bool_t nxt_router_app_share_lease(nxt_task_t *task, nxt_app_t *app,
+    nxt_port_t *port);
+static void nxt_router_app_share_push(nxt_task_t *task,
+    nxt_app_share_t *share, nxt_port_t *port);
+static nxt_bool_t nxt_router_app_share_release(nxt_task_t *task,
+    nxt_port_t *port, uint32_t request_failed, uint32_t got_response);
+static void nxt_router_app_share_recall_post(nxt_task_t *task,
+    nxt_app_share_t *share);
+static nxt_uint_t nxt_router_app_shares_recall(nxt_task_t *task,
+    nxt_app_t *app, nxt_bool_t all);
+static void nxt_router_app_share_recall_handler(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_app_share_recall(nxt_task_t *task,
+    nxt_app_share_t *share);
+static void nxt_router_app_share_check(nxt_task_t *task,
+    nxt_app_share_t *share);
+static void nxt_router_app_share_idle_timeout(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_app_share_free_handler(nxt_task_t *task, void *obj,
+    void *data);
+
+static nxt_int_t nxt_router_response_header(nxt_task_t *task,
+    nxt_http_request_t *r, nxt_buf_mem_t *mem);
 static const nxt_http_request_state_t  nxt_http_request_send_state;
 static void nxt_http_request_send_body(nxt_task_t *task, void *obj, void *data);
+static void nxt_router_response_send_error(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_response_credit(nxt_task_t *task,
+    nxt_app_parse_ctx_t *ar, nxt_buf_t *b);
+static void nxt_router_response_credit_start(nxt_task_t *task,
+    nxt_app_parse_ctx_t *ar);
+static void nxt_router_response_credit_mark(nxt_task_t *task,
+    nxt_app_parse_ctx_t *ar);
+static void nxt_router_response_drained(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_response_credit_return(nxt_task_t *task,
+    nxt_app_parse_ctx_t *ar);
+static void nxt_router_response_cancel(nxt_task_t *task,
+    nxt_app_parse_ctx_t *ar);
+static void nxt_router_response_spool(nxt_task_t *task,
+    nxt_app_parse_ctx_t *ar, nxt_buf_t *b);
+static void nxt_router_response_file_write(nxt_task_t *task,
+    nxt_app_parse_ctx_t *ar);
+static void nxt_router_response_file_error(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_response_file_written(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_response_spool_free(nxt_task_t *task, nxt_buf_t *b);
 
-static nxt_router_t  *nxt_router;
-
+static void nxt_router_app_body_request(nxt_task_t *task,
+    nxt_port_recv_msg_t *msg, nxt_req_conn_link_t *rc);
+static const nxt_http_request_state_t  nxt_router_body_stream_state;
+static void nxt_router_body_stream_ready(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_body_stream_error(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_body_stream_send(nxt_task_t *task,
+    nxt_app_parse_ctx_t *ar, nxt_bool_t last);
 
-static nxt_app_prepare_msg_t  nxt_app_prepare_msg[] = {
-    nxt_python_prepare_msg,
-    nxt_php_prepare_msg,
-    nxt_go_prepare_msg,
-    nxt_perl_prepare_msg,
-};
+static nxt_router_t  *nxt_router;
 
 
 nxt_int_t
@@ -537,6 +647,12 @@ nxt_router_ra_release(nxt_task_t *task, nxt_req_app_link_t *ra)
         } else {
             rc->app_port = ra->app_port;
             rc->msg_info = ra->msg_info;
+            rc->start_time = nxt_thread_monotonic_time(task->thread);
+
+            rc->ap->credit_port = rc->app_port;
+            rc->ap->credit_stream = rc->stream;
+
+            nxt_router_response_credit_start(task, rc->ap);
 
             if (rc->app->timeout != 0) {
                 rc->ap->timer.handler = nxt_router_app_timeout;
@@ -654,6 +770,29 @@ nxt_queue_chk_remove(nxt_queue_link_t *lnk)
 }
 
 
+nxt_inline void
+nxt_router_app_port_latency(nxt_port_t *port, nxt_nsec_t latency)
+{
+    nxt_nsec_t  ewma;
+
+    /*
+     * The value is only a balancing hint, so updates from different
+     * engines are not synchronized.  Zero means that there is no sample yet.
+     */
+
+    ewma = port->app_latency;
+
+    if (ewma == 0) {
+        ewma = latency;
+
+    } else {
+        ewma = ewma - (ewma >> 3) + (latency >> 3);
+    }
+
+    port->app_latency = nxt_max(ewma, 1);
+}
+
+
 nxt_inline void
 nxt_router_rc_unlink(nxt_task_t *task, nxt_req_conn_link_t *rc)
 {
@@ -661,6 +800,10 @@ nxt_router_rc_unlink(nxt_task_t *task, nxt_req_conn_link_t *rc)
     nxt_req_app_link_t  *ra;
 
     if (rc->app_port != NULL) {
+        nxt_router_app_port_latency(rc->app_port,
+                                    nxt_thread_monotonic_time(task->thread)
+                                    - rc->start_time);
+
         nxt_router_app_port_release(task, rc->app_port, 0, 1);
 
         rc->app_port = NULL;
@@ -704,6 +847,9 @@ nxt_router_rc_unlink(nxt_task_t *task, nxt_req_conn_link_t *rc)
     }
 
     if (rc->ap != NULL) {
+        /* The port is released above, no more credits are needed. */
+        rc->ap->credit_port = NULL;
+
         nxt_app_http_req_done(task, rc->ap);
 
         rc->ap = NULL;
@@ -852,6 +998,10 @@ nxt_router_temp_conf(nxt_task_t *task)
     nxt_queue_init(&tmcf->pending);
     nxt_queue_init(&tmcf->creating);
 
+#if (NXT_SSLTLS)
+    nxt_queue_init(&tmcf->tls);
+#endif
+
     nxt_queue_init(&tmcf->apps);
     nxt_queue_init(&tmcf->previous);
 
@@ -880,8 +1030,8 @@ nxt_router_app_can_start(nxt_app_t *app)
 nxt_inline nxt_bool_t
 nxt_router_app_need_start(nxt_app_t *app)
 {
-    return app->idle_processes + app->pending_processes
-            < app->spare_processes;
+    return app->idle_processes + app->leased_processes
+           + app->pending_processes < app->spare_processes;
 }
 
 
@@ -896,6 +1046,12 @@ nxt_router_conf_apply(nxt_task_t *task, void *obj, void *data)
     nxt_socket_conf_t            *skcf;
     nxt_router_temp_conf_t       *tmcf;
     const nxt_event_interface_t  *interface;
+#if (NXT_HAVE_REUSEPORT)
+    nxt_listen_socket_t          *ls;
+#endif
+#if (NXT_SSLTLS)
+    nxt_router_tlssock_t         *tls;
+#endif
 
     tmcf = obj;
 
@@ -907,11 +1063,43 @@ nxt_router_conf_apply(nxt_task_t *task, void *obj, void *data)
 
         skcf = nxt_queue_link_data(qlk, nxt_socket_conf_t, link);
 
+#if (NXT_HAVE_REUSEPORT)
+
+        ls = skcf->listen;
+
+        if (ls->nsockets != 0 && ls->sockets[ls->nsockets - 1] != -1) {
+            /* All the sockets have been handed over by the previous set. */
+
+            nxt_router_listen_sockets_complete(task, ls);
+
+            nxt_work_queue_add(&task->thread->engine->fast_work_queue,
+                               nxt_router_conf_apply, task, tmcf, NULL);
+            return;
+        }
+
+#endif
+
         nxt_router_listen_socket_rpc_create(task, tmcf, skcf);
 
         return;
     }
 
+#if (NXT_SSLTLS)
+
+    qlk = nxt_queue_first(&tmcf->tls);
+
+    if (qlk != nxt_queue_tail(&tmcf->tls)) {
+        nxt_queue_remove(qlk);
+
+        tls = nxt_queue_link_data(qlk, nxt_router_tlssock_t, link);
+
+        nxt_router_tls_rpc_create(task, tmcf, tls);
+
+        return;
+    }
+
+#endif
+
     nxt_queue_each(app, &tmcf->apps, nxt_app_t, link) {
 
         if (nxt_router_app_need_start(app)) {
@@ -982,23 +1170,22 @@ static void
 nxt_router_conf_error(nxt_task_t *task, nxt_router_temp_conf_t *tmcf)
 {
     nxt_app_t          *app;
-    nxt_socket_t       s;
     nxt_router_t       *router;
     nxt_queue_link_t   *qlk;
     nxt_socket_conf_t  *skcf;
 
     nxt_log(task, NXT_LOG_CRIT, "failed to apply new conf");
 
+    /* The pending sockets may have been handed over by the previous set. */
+    nxt_queue_add(&tmcf->creating, &tmcf->pending);
+
     for (qlk = nxt_queue_first(&tmcf->creating);
          qlk != nxt_queue_tail(&tmcf->creating);
          qlk = nxt_queue_next(qlk))
     {
         skcf = nxt_queue_link_data(qlk, nxt_socket_conf_t, link);
-        s = skcf->listen->socket;
 
-        if (s != -1) {
-            nxt_socket_close(task, s);
-        }
+        nxt_router_listen_sockets_close(task, skcf->listen);
 
         nxt_free(skcf->listen);
     }
@@ -1038,6 +1225,14 @@ static nxt_conf_map_t  nxt_router_conf[] = {
         NXT_CONF_MAP_INT32,
         offsetof(nxt_router_conf_t, threads),
     },
+
+#if (NXT_HAVE_CPU_AFFINITY)
+    {
+        nxt_string("listeners_affinity"),
+        NXT_CONF_MAP_INT8,
+        offsetof(nxt_router_conf_t, affinity),
+    },
+#endif
 };
 
 
@@ -1065,6 +1260,12 @@ static nxt_conf_map_t  nxt_router_app_conf[] = {
         NXT_CONF_MAP_PTR,
         offsetof(nxt_router_app_conf_t, processes_value),
     },
+
+    {
+        nxt_string("cache"),
+        NXT_CONF_MAP_PTR,
+        offsetof(nxt_router_app_conf_t, cache_value),
+    },
 };
 
 
@@ -1107,6 +1308,39 @@ static nxt_conf_map_t  nxt_router_app_processes_conf[] = {
         NXT_CONF_MAP_MSEC,
         offsetof(nxt_router_app_conf_t, idle_timeout),
     },
+
+    {
+        nxt_string("balance"),
+        NXT_CONF_MAP_STR,
+        offsetof(nxt_router_app_conf_t, balance),
+    },
+};
+
+
+static nxt_conf_map_t  nxt_router_app_cache_conf[] = {
+    {
+        nxt_string("size"),
+        NXT_CONF_MAP_SIZE,
+        offsetof(nxt_router_app_conf_t, cache_size),
+    },
+
+    {
+        nxt_string("valid"),
+        NXT_CONF_MAP_INT32,
+        offsetof(nxt_router_app_conf_t, cache_valid),
+    },
+
+    {
+        nxt_string("stale"),
+        NXT_CONF_MAP_INT32,
+        offsetof(nxt_router_app_conf_t, cache_stale),
+    },
+
+    {
+        nxt_string("lock_timeout"),
+        NXT_CONF_MAP_MSEC,
+        offsetof(nxt_router_app_conf_t, cache_lock_timeout),
+    },
 };
 
 
@@ -1116,8 +1350,57 @@ static nxt_conf_map_t  nxt_router_listener_conf[] = {
         NXT_CONF_MAP_STR,
         offsetof(nxt_router_listener_conf_t, application),
     },
+
+    {
+        nxt_string("share"),
+        NXT_CONF_MAP_STR_COPY,
+        offsetof(nxt_router_listener_conf_t, share),
+    },
+
+    {
+        nxt_string("tls"),
+        NXT_CONF_MAP_PTR,
+        offsetof(nxt_router_listener_conf_t, tls_value),
+    },
+
+    {
+        nxt_string("reuseport"),
+        NXT_CONF_MAP_INT8,
+        offsetof(nxt_router_listener_conf_t, reuseport),
+    },
+
+    {
+        nxt_string("reuseport_cpu"),
+        NXT_CONF_MAP_INT8,
+        offsetof(nxt_router_listener_conf_t, reuseport_cpu),
+    },
+};
+
+
+#if (NXT_SSLTLS)
+
+static nxt_conf_map_t  nxt_router_tls_conf_map[] = {
+    {
+        nxt_string("certificate"),
+        NXT_CONF_MAP_STR_COPY,
+        offsetof(nxt_ssltls_conf_t, name),
+    },
+
+    {
+        nxt_string("session_cache"),
+        NXT_CONF_MAP_INT32,
+        offsetof(nxt_ssltls_conf_t, session_cache),
+    },
+
+    {
+        nxt_string("session_timeout"),
+        NXT_CONF_MAP_INT32,
+        offsetof(nxt_ssltls_conf_t, session_timeout),
+    },
 };
 
+#endif
+
 
 static nxt_conf_map_t  nxt_router_http_conf[] = {
     {
@@ -1150,6 +1433,30 @@ static nxt_conf_map_t  nxt_router_http_conf[] = {
         offsetof(nxt_socket_conf_t, max_body_size),
     },
 
+    {
+        nxt_string("body_temp_threshold"),
+        NXT_CONF_MAP_SIZE,
+        offsetof(nxt_socket_conf_t, body_temp_threshold),
+    },
+
+    {
+        nxt_string("body_stream_threshold"),
+        NXT_CONF_MAP_SIZE,
+        offsetof(nxt_socket_conf_t, body_stream_threshold),
+    },
+
+    {
+        nxt_string("response_temp_threshold"),
+        NXT_CONF_MAP_SIZE,
+        offsetof(nxt_socket_conf_t, response_temp_threshold),
+    },
+
+    {
+        nxt_string("temp_path"),
+        NXT_CONF_MAP_STR_COPY,
+        offsetof(nxt_socket_conf_t, temp_path),
+    },
+
     {
         nxt_string("idle_timeout"),
         NXT_CONF_MAP_MSEC,
@@ -1273,9 +1580,15 @@ nxt_router_conf_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
         apcf.timeout = 0;
         apcf.res_timeout = 1000;
         apcf.idle_timeout = 15000;
+        nxt_str_null(&apcf.balance);
         apcf.requests = 0;
         apcf.limits_value = NULL;
         apcf.processes_value = NULL;
+        apcf.cache_value = NULL;
+        apcf.cache_size = 10 * 1024 * 1024;
+        apcf.cache_valid = 0;
+        apcf.cache_stale = 0;
+        apcf.cache_lock_timeout = 5000;
 
         ret = nxt_conf_map_object(mp, application, nxt_router_app_conf,
                                   nxt_nitems(nxt_router_app_conf), &apcf);
@@ -1318,11 +1631,29 @@ nxt_router_conf_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
             apcf.spare_processes = apcf.processes;
         }
 
+        if (apcf.cache_value != NULL) {
+
+            if (nxt_conf_type(apcf.cache_value) != NXT_CONF_OBJECT) {
+                nxt_log(task, NXT_LOG_CRIT, "application cache is not object");
+                goto app_fail;
+            }
+
+            ret = nxt_conf_map_object(mp, apcf.cache_value,
+                                      nxt_router_app_cache_conf,
+                                      nxt_nitems(nxt_router_app_cache_conf),
+                                      &apcf);
+            if (ret != NXT_OK) {
+                nxt_log(task, NXT_LOG_CRIT, "application cache map error");
+                goto app_fail;
+            }
+        }
+
         nxt_debug(task, "application type: %V", &apcf.type);
         nxt_debug(task, "application processes: %D", apcf.processes);
         nxt_debug(task, "application request timeout: %M", apcf.timeout);
         nxt_debug(task, "application reschedule timeout: %M", apcf.res_timeout);
         nxt_debug(task, "application requests: %D", apcf.requests);
+        nxt_debug(task, "application balance: %V", &apcf.balance);
 
         lang = nxt_app_lang_module(task->thread->runtime, &apcf.type);
 
@@ -1339,11 +1670,23 @@ nxt_router_conf_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
             goto app_fail;
         }
 
+        if (apcf.cache_value != NULL) {
+            app->cache = nxt_http_cache_create(apcf.cache_size,
+                                               apcf.cache_valid,
+                                               apcf.cache_stale,
+                                               apcf.cache_lock_timeout);
+            if (nxt_slow_path(app->cache == NULL)) {
+                nxt_thread_mutex_destroy(&app->mutex);
+                goto app_fail;
+            }
+        }
+
         nxt_queue_init(&app->ports);
         nxt_queue_init(&app->spare_ports);
         nxt_queue_init(&app->idle_ports);
         nxt_queue_init(&app->requests);
         nxt_queue_init(&app->pending);
+        nxt_queue_init(&app->shares);
 
         app->name.length = name.length;
         nxt_memcpy(app->name.start, name.start, name.length);
@@ -1356,10 +1699,10 @@ nxt_router_conf_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
         app->timeout = apcf.timeout;
         app->res_timeout = apcf.res_timeout * 1000000;
         app->idle_timeout = apcf.idle_timeout;
+        app->balance = nxt_router_app_parse_balance(&apcf.balance);
         app->live = 1;
         app->max_pending_responses = 2;
         app->max_requests = apcf.requests;
-        app->prepare_msg = nxt_app_prepare_msg[lang->type];
 
         engine = task->thread->engine;
 
@@ -1402,10 +1745,7 @@ nxt_router_conf_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
             break;
         }
 
-        skcf = nxt_router_socket_conf(task, tmcf, &name);
-        if (skcf == NULL) {
-            goto fail;
-        }
+        nxt_memzero(&lscf, sizeof(nxt_router_listener_conf_t));
 
         ret = nxt_conf_map_object(mp, listener, nxt_router_listener_conf,
                                   nxt_nitems(nxt_router_listener_conf), &lscf);
@@ -1414,6 +1754,11 @@ nxt_router_conf_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
             goto fail;
         }
 
+        skcf = nxt_router_socket_conf(task, tmcf, &name, &lscf);
+        if (skcf == NULL) {
+            goto fail;
+        }
+
         nxt_debug(task, "application: %V", &lscf.application);
 
         // STUB, default values if http block is not defined.
@@ -1422,6 +1767,10 @@ nxt_router_conf_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
         skcf->large_header_buffers = 4;
         skcf->body_buffer_size = 16 * 1024;
         skcf->max_body_size = 2 * 1024 * 1024;
+        skcf->body_temp_threshold = 0;
+        skcf->body_stream_threshold = 0;
+        skcf->response_temp_threshold = 0;
+        nxt_str_set(&skcf->temp_path, "/tmp");
         skcf->idle_timeout = 65000;
         skcf->header_read_timeout = 5000;
         skcf->body_read_timeout = 5000;
@@ -1436,6 +1785,19 @@ nxt_router_conf_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
             }
         }
 
+        skcf->share = lscf.share;
+
+#if (NXT_SSLTLS)
+
+        if (lscf.tls_value != NULL) {
+            ret = nxt_router_tls_conf(task, tmcf, skcf, lscf.tls_value);
+            if (ret != NXT_OK) {
+                goto fail;
+            }
+        }
+
+#endif
+
         skcf->listen->handler = nxt_http_conn_init;
         skcf->router_conf = tmcf->conf;
         skcf->router_conf->count++;
@@ -1458,6 +1820,7 @@ fail:
 
         nxt_queue_remove(&app->link);
         nxt_thread_mutex_destroy(&app->mutex);
+        nxt_http_cache_free(app->cache);
         nxt_free(app);
 
     } nxt_queue_loop;
@@ -1500,14 +1863,18 @@ nxt_router_listener_application(nxt_router_temp_conf_t *tmcf, nxt_str_t *name)
 
 static nxt_socket_conf_t *
 nxt_router_socket_conf(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
-    nxt_str_t *name)
+    nxt_str_t *name, nxt_router_listener_conf_t *lscf)
 {
-    size_t               size;
+    size_t               size, offset;
+    uint32_t             nsockets;
     nxt_int_t            ret;
     nxt_bool_t           wildcard;
     nxt_sockaddr_t       *sa;
     nxt_socket_conf_t    *skcf;
-    nxt_listen_socket_t  *ls;
+    nxt_listen_socket_t  *ls, *prev;
+#if (NXT_HAVE_REUSEPORT)
+    uint32_t             i;
+#endif
 
     sa = nxt_sockaddr_parse(tmcf->mem_pool, name);
     if (nxt_slow_path(sa == NULL)) {
@@ -1527,11 +1894,35 @@ nxt_router_socket_conf(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
 
     size = nxt_sockaddr_size(sa);
 
-    ret = nxt_router_listen_socket_find(tmcf, skcf, sa);
+    nsockets = 0;
+
+#if (NXT_HAVE_REUSEPORT)
+
+    /* Each router engine accepts connections on its own socket. */
+
+    if ((lscf->reuseport || lscf->reuseport_cpu)
+        && sa->u.sockaddr.sa_family != AF_UNIX)
+    {
+        nsockets = tmcf->conf->threads;
+    }
+
+#endif
+
+    prev = NULL;
+
+    ret = nxt_router_listen_socket_find(task, tmcf, skcf, sa, lscf, nsockets,
+                                        &prev);
+
+    if (nxt_slow_path(ret == NXT_ERROR)) {
+        return NULL;
+    }
 
     if (ret != NXT_OK) {
 
-        ls = nxt_zalloc(sizeof(nxt_listen_socket_t) + size);
+        offset = nxt_align_size(sizeof(nxt_listen_socket_t) + size,
+                                sizeof(nxt_socket_t));
+
+        ls = nxt_zalloc(offset + nsockets * sizeof(nxt_socket_t));
         if (nxt_slow_path(ls == NULL)) {
             return NULL;
         }
@@ -1547,6 +1938,27 @@ nxt_router_socket_conf(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
         ls->backlog = NXT_LISTEN_BACKLOG;
         ls->flags = NXT_NONBLOCK;
         ls->read_after_accept = 1;
+
+#if (NXT_HAVE_REUSEPORT)
+
+        if (nsockets != 0) {
+            ls->sockets = nxt_pointer_to(ls, offset);
+            ls->nsockets = nsockets;
+            ls->reuseport_cpu = lscf->reuseport_cpu;
+
+            for (i = 0; i < nsockets; i++) {
+                ls->sockets[i] = -1;
+            }
+
+            if (prev != NULL
+                && nxt_router_listen_sockets_handover(task, ls, prev)
+                   != NXT_OK)
+            {
+                return NULL;
+            }
+        }
+
+#endif
     }
 
     switch (sa->u.sockaddr.sa_family) {
@@ -1580,12 +1992,17 @@ nxt_router_socket_conf(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
 
 
 static nxt_int_t
-nxt_router_listen_socket_find(nxt_router_temp_conf_t *tmcf,
-    nxt_socket_conf_t *nskcf, nxt_sockaddr_t *sa)
+nxt_router_listen_socket_find(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
+    nxt_socket_conf_t *nskcf, nxt_sockaddr_t *sa,
+    nxt_router_listener_conf_t *lscf, uint32_t nsockets,
+    nxt_listen_socket_t **prev)
 {
-    nxt_router_t       *router;
-    nxt_queue_link_t   *qlk;
-    nxt_socket_conf_t  *skcf;
+    nxt_router_t         *router;
+    nxt_queue_link_t     *qlk;
+    nxt_socket_conf_t    *skcf;
+#if (NXT_HAVE_REUSEPORT)
+    nxt_listen_socket_t  *ls;
+#endif
 
     router = tmcf->conf->router;
 
@@ -1596,6 +2013,37 @@ nxt_router_listen_socket_find(nxt_router_temp_conf_t *tmcf,
         skcf = nxt_queue_link_data(qlk, nxt_socket_conf_t, link);
 
         if (nxt_sockaddr_cmp(skcf->listen->sockaddr, sa)) {
+
+#if (NXT_HAVE_REUSEPORT)
+
+            ls = skcf->listen;
+
+            /* The SO_REUSEPORT option cannot be changed on a bound socket. */
+
+            if ((nsockets != 0) != (ls->nsockets != 0)
+                || (nsockets != 0 && lscf->reuseport_cpu != ls->reuseport_cpu))
+            {
+                nxt_log(task, NXT_LOG_CRIT,
+                        "the \"reuseport\" options of the bound listener "
+                        "\"%*s\" cannot be changed",
+                        (size_t) sa->length, nxt_sockaddr_start(sa));
+
+                return NXT_ERROR;
+            }
+
+            /*
+             * If the number of router engines changes, the sockets are
+             * handed over to a new set rather than a new set is bound
+             * beside them, so the connections queued on them are not lost.
+             */
+
+            if (nsockets != ls->nsockets) {
+                *prev = ls;
+                break;
+            }
+
+#endif
+
             nskcf->listen = skcf->listen;
 
             nxt_queue_remove(qlk);
@@ -1613,34 +2061,96 @@ nxt_router_listen_socket_find(nxt_router_temp_conf_t *tmcf,
 }
 
 
-static void
-nxt_router_listen_socket_rpc_create(nxt_task_t *task,
-    nxt_router_temp_conf_t *tmcf, nxt_socket_conf_t *skcf)
+#if (NXT_HAVE_REUSEPORT)
+
+/*
+ * The new set takes the sockets of the previous set by duplicated
+ * descriptors, so the sockets stay in the SO_REUSEPORT group when
+ * the previous set is closed.  If the set grows, the missing sockets
+ * are added to the group, otherwise the surplus sockets are closed
+ * with the previous set after its engines stop to accept on them.
+ */
+
+static nxt_int_t
+nxt_router_listen_sockets_handover(nxt_task_t *task, nxt_listen_socket_t *ls,
+    nxt_listen_socket_t *prev)
 {
-    size_t            size;
-    uint32_t          stream;
-    nxt_buf_t         *b;
-    nxt_port_t        *main_port, *router_port;
-    nxt_runtime_t     *rt;
-    nxt_socket_rpc_t  *rpc;
+    uint32_t      i, n;
+    nxt_socket_t  s;
 
-    rpc = nxt_mp_alloc(tmcf->mem_pool, sizeof(nxt_socket_rpc_t));
-    if (rpc == NULL) {
-        goto fail;
-    }
+    n = nxt_min(ls->nsockets, prev->nsockets);
 
-    rpc->socket_conf = skcf;
-    rpc->temp_conf = tmcf;
+    for (i = 0; i < n; i++) {
+        s = dup(prev->sockets[i]);
 
-    size = nxt_sockaddr_size(skcf->listen->sockaddr);
+        if (nxt_slow_path(s == -1)) {
+            nxt_log(task, NXT_LOG_CRIT, "dup(%d) failed %E",
+                    prev->sockets[i], nxt_socket_errno);
+            return NXT_ERROR;
+        }
 
-    b = nxt_buf_mem_alloc(tmcf->mem_pool, size, 0);
-    if (b == NULL) {
-        goto fail;
+        ls->sockets[i] = s;
     }
 
-    b->mem.free = nxt_cpymem(b->mem.free, skcf->listen->sockaddr, size);
-
+    return NXT_OK;
+}
+
+
+static void
+nxt_router_listen_sockets_complete(nxt_task_t *task, nxt_listen_socket_t *ls)
+{
+#if (NXT_HAVE_REUSEPORT_CBPF)
+
+    /* The program is replaced to select only the sockets of the new set. */
+
+    if (ls->reuseport_cpu) {
+        nxt_router_listen_socket_cpu(task, ls);
+    }
+
+#endif
+
+    ls->socket = ls->sockets[0];
+}
+
+#endif
+
+
+static void
+nxt_router_listen_socket_rpc_create(nxt_task_t *task,
+    nxt_router_temp_conf_t *tmcf, nxt_socket_conf_t *skcf)
+{
+    size_t            size;
+    uint32_t          stream;
+    nxt_buf_t         *b;
+    nxt_port_t        *main_port, *router_port;
+    nxt_runtime_t     *rt;
+    nxt_socket_rpc_t  *rpc;
+
+    rpc = nxt_mp_alloc(tmcf->mem_pool, sizeof(nxt_socket_rpc_t));
+    if (rpc == NULL) {
+        goto fail;
+    }
+
+    rpc->socket_conf = skcf;
+    rpc->temp_conf = tmcf;
+
+    size = nxt_sockaddr_size(skcf->listen->sockaddr);
+
+    b = nxt_buf_mem_alloc(tmcf->mem_pool, size + 1, 0);
+    if (b == NULL) {
+        goto fail;
+    }
+
+    b->mem.free = nxt_cpymem(b->mem.free, skcf->listen->sockaddr, size);
+
+#if (NXT_HAVE_REUSEPORT)
+
+    if (skcf->listen->nsockets != 0) {
+        *b->mem.free++ = 1;
+    }
+
+#endif
+
     rt = task->thread->runtime;
     main_port = rt->port_by_type[NXT_PROCESS_MAIN];
     router_port = rt->port_by_type[NXT_PROCESS_ROUTER];
@@ -1668,11 +2178,16 @@ static void
 nxt_router_listen_socket_ready(nxt_task_t *task, nxt_port_recv_msg_t *msg,
     void *data)
 {
-    nxt_int_t         ret;
-    nxt_socket_t      s;
-    nxt_socket_rpc_t  *rpc;
+    nxt_int_t            ret;
+    nxt_socket_t         s;
+    nxt_socket_rpc_t     *rpc;
+    nxt_listen_socket_t  *ls;
+#if (NXT_HAVE_REUSEPORT)
+    uint32_t             i;
+#endif
 
     rpc = data;
+    ls = rpc->socket_conf->listen;
 
     s = msg->fd;
 
@@ -1681,14 +2196,37 @@ nxt_router_listen_socket_ready(nxt_task_t *task, nxt_port_recv_msg_t *msg,
         goto fail;
     }
 
-    nxt_socket_defer_accept(task, s, rpc->socket_conf->listen->sockaddr);
+    nxt_socket_defer_accept(task, s, ls->sockaddr);
 
     ret = nxt_listen_socket(task, s, NXT_LISTEN_BACKLOG);
     if (nxt_slow_path(ret != NXT_OK)) {
         goto fail;
     }
 
-    rpc->socket_conf->listen->socket = s;
+#if (NXT_HAVE_REUSEPORT)
+
+    if (ls->nsockets != 0) {
+
+        for (i = 0; ls->sockets[i] != -1; i++) {
+            /* void */
+        }
+
+        ls->sockets[i] = s;
+
+        if (i + 1 < ls->nsockets) {
+            nxt_router_listen_socket_rpc_create(task, rpc->temp_conf,
+                                                rpc->socket_conf);
+            return;
+        }
+
+        nxt_router_listen_sockets_complete(task, ls);
+
+        s = ls->sockets[0];
+    }
+
+#endif
+
+    ls->socket = s;
 
     nxt_work_queue_add(&task->thread->engine->fast_work_queue,
                        nxt_router_conf_apply, task, rpc->temp_conf, NULL);
@@ -1758,6 +2296,223 @@ nxt_router_listen_socket_error(nxt_task_t *task, nxt_port_recv_msg_t *msg,
 }
 
 
+#if (NXT_HAVE_REUSEPORT_CBPF)
+
+static void
+nxt_router_listen_socket_cpu(nxt_task_t *task, nxt_listen_socket_t *ls)
+{
+    struct sock_fprog   prog;
+    struct sock_filter  code[] = {
+        /* A connection is passed to the socket of the receiving CPU. */
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_CPU),
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, ls->nsockets),
+        BPF_STMT(BPF_RET | BPF_A, 0),
+    };
+
+    prog.len = nxt_nitems(code);
+    prog.filter = code;
+
+    /* The program is attached to the whole SO_REUSEPORT group. */
+
+    if (setsockopt(ls->sockets[0], SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+                   &prog, sizeof(struct sock_fprog))
+        != 0)
+    {
+        nxt_log(task, NXT_LOG_WARN,
+                "setsockopt(%d, SO_ATTACH_REUSEPORT_CBPF) failed %E",
+                ls->sockets[0], nxt_socket_errno);
+    }
+}
+
+#endif
+
+
+static void
+nxt_router_listen_sockets_close(nxt_task_t *task, nxt_listen_socket_t *ls)
+{
+#if (NXT_HAVE_REUSEPORT)
+    uint32_t  i;
+
+    if (ls->nsockets != 0) {
+
+        for (i = 0; i < ls->nsockets; i++) {
+            if (ls->sockets[i] != -1) {
+                nxt_socket_close(task, ls->sockets[i]);
+            }
+        }
+
+        return;
+    }
+
+#endif
+
+    if (ls->socket != -1) {
+        nxt_socket_close(task, ls->socket);
+    }
+}
+
+
+#if (NXT_SSLTLS)
+
+static nxt_int_t
+nxt_router_tls_conf(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
+    nxt_socket_conf_t *skcf, nxt_conf_value_t *value)
+{
+    nxt_mp_t              *mp;
+    nxt_int_t             ret;
+    nxt_ssltls_conf_t     *conf;
+    nxt_router_tlssock_t  *tls;
+
+    if (nxt_ssltls_lib == NULL) {
+        nxt_log(task, NXT_LOG_CRIT, "no SSL/TLS library is available");
+        return NXT_ERROR;
+    }
+
+    if (nxt_conf_type(value) != NXT_CONF_OBJECT) {
+        nxt_log(task, NXT_LOG_CRIT, "listener tls is not object");
+        return NXT_ERROR;
+    }
+
+    mp = tmcf->conf->mem_pool;
+
+    conf = nxt_mp_zget(mp, sizeof(nxt_ssltls_conf_t));
+    if (nxt_slow_path(conf == NULL)) {
+        return NXT_ERROR;
+    }
+
+    conf->lib = nxt_ssltls_lib;
+    conf->chain_file = -1;
+
+    /* The OpenSSL defaults. */
+    conf->session_cache = 20480;
+    conf->session_timeout = 300;
+
+    ret = nxt_conf_map_object(mp, value, nxt_router_tls_conf_map,
+                              nxt_nitems(nxt_router_tls_conf_map), conf);
+    if (ret != NXT_OK) {
+        nxt_log(task, NXT_LOG_CRIT, "listener tls map error");
+        return NXT_ERROR;
+    }
+
+    tls = nxt_mp_get(tmcf->mem_pool, sizeof(nxt_router_tlssock_t));
+    if (nxt_slow_path(tls == NULL)) {
+        return NXT_ERROR;
+    }
+
+    tls->socket_conf = skcf;
+    skcf->ssltls = conf;
+
+    nxt_queue_insert_tail(&tmcf->tls, &tls->link);
+
+    return NXT_OK;
+}
+
+
+/*
+ * The certificate chain is opened by the main process since the router
+ * has no access to the state directory.
+ */
+
+static void
+nxt_router_tls_rpc_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
+    nxt_router_tlssock_t *tls)
+{
+    uint32_t           stream;
+    nxt_buf_t          *b;
+    nxt_port_t         *main_port, *router_port;
+    nxt_runtime_t      *rt;
+    nxt_socket_rpc_t   *rpc;
+    nxt_ssltls_conf_t  *conf;
+
+    rpc = nxt_mp_alloc(tmcf->mem_pool, sizeof(nxt_socket_rpc_t));
+    if (rpc == NULL) {
+        goto fail;
+    }
+
+    rpc->socket_conf = tls->socket_conf;
+    rpc->temp_conf = tmcf;
+
+    conf = tls->socket_conf->ssltls;
+
+    b = nxt_buf_mem_alloc(tmcf->mem_pool, conf->name.length + 1, 0);
+    if (b == NULL) {
+        goto fail;
+    }
+
+    b->mem.free = nxt_cpymem(b->mem.free, conf->name.start, conf->name.length);
+    *b->mem.free++ = '\0';
+
+    rt = task->thread->runtime;
+    main_port = rt->port_by_type[NXT_PROCESS_MAIN];
+    router_port = rt->port_by_type[NXT_PROCESS_ROUTER];
+
+    stream = nxt_port_rpc_register_handler(task, router_port,
+                                           nxt_router_tls_rpc_ready,
+                                           nxt_router_tls_rpc_error,
+                                           main_port->pid, rpc);
+    if (stream == 0) {
+        goto fail;
+    }
+
+    nxt_port_socket_write(task, main_port, NXT_PORT_MSG_CERT_GET, -1,
+                          stream, router_port->id, b);
+
+    return;
+
+fail:
+
+    nxt_router_conf_error(task, tmcf);
+}
+
+
+static void
+nxt_router_tls_rpc_ready(nxt_task_t *task, nxt_port_recv_msg_t *msg,
+    void *data)
+{
+    nxt_int_t          ret;
+    nxt_socket_rpc_t   *rpc;
+    nxt_ssltls_conf_t  *conf;
+
+    rpc = data;
+
+    conf = rpc->socket_conf->ssltls;
+    conf->chain_file = msg->fd;
+
+    ret = conf->lib->server_init(task, conf, rpc->temp_conf->conf->mem_pool);
+
+    nxt_fd_close(conf->chain_file);
+    conf->chain_file = -1;
+
+    if (nxt_slow_path(ret != NXT_OK)) {
+        nxt_log(task, NXT_LOG_CRIT, "failed to load certificate \"%V\"",
+                &conf->name);
+
+        nxt_router_conf_error(task, rpc->temp_conf);
+        return;
+    }
+
+    nxt_work_queue_add(&task->thread->engine->fast_work_queue,
+                       nxt_router_conf_apply, task, rpc->temp_conf, NULL);
+}
+
+
+static void
+nxt_router_tls_rpc_error(nxt_task_t *task, nxt_port_recv_msg_t *msg,
+    void *data)
+{
+    nxt_socket_rpc_t  *rpc;
+
+    rpc = data;
+
+    nxt_log(task, NXT_LOG_CRIT, "certificate \"%V\" is not found",
+            &rpc->socket_conf->ssltls->name);
+
+    nxt_router_conf_error(task, rpc->temp_conf);
+}
+
+#endif
+
+
 static void
 nxt_router_app_rpc_create(nxt_task_t *task,
     nxt_router_temp_conf_t *tmcf, nxt_app_t *app)
@@ -1829,6 +2584,7 @@ nxt_router_app_prefork_ready(nxt_task_t *task, nxt_port_recv_msg_t *msg,
 
     port = msg->u.new_port;
     port->app = app;
+    port->ring_enabled = (app->type != NXT_APP_GO);
 
     nxt_router_app_use(task, app, 1);
 
@@ -1876,10 +2632,12 @@ nxt_router_engines_create(nxt_task_t *task, nxt_router_t *router,
     nxt_router_temp_conf_t *tmcf, const nxt_event_interface_t *interface)
 {
     nxt_int_t                 ret;
-    nxt_uint_t                n, threads;
+    nxt_uint_t                n, threads, flags;
+    nxt_runtime_t             *rt;
     nxt_queue_link_t          *qlk;
     nxt_router_engine_conf_t  *recf;
 
+    rt = task->thread->runtime;
     threads = tmcf->conf->threads;
 
     tmcf->engines = nxt_array_create(tmcf->mem_pool, threads,
@@ -1919,6 +2677,8 @@ nxt_router_engines_create(nxt_task_t *task, nxt_router_t *router,
 
     tmcf->new_threads = n;
 
+    flags = rt->timer_wheel ? NXT_ENGINE_TIMER_WHEEL : 0;
+
     while (n < threads) {
         recf = nxt_array_zero_add(tmcf->engines);
         if (nxt_slow_path(recf == NULL)) {
@@ -1927,11 +2687,14 @@ nxt_router_engines_create(nxt_task_t *task, nxt_router_t *router,
 
         recf->action = NXT_ROUTER_ENGINE_ADD;
 
-        recf->engine = nxt_event_engine_create(task, interface, NULL, 0, 0);
+        recf->engine = nxt_event_engine_create(task, interface, NULL, flags, 0);
         if (nxt_slow_path(recf->engine == NULL)) {
             return NXT_ERROR;
         }
 
+        /* The id binds the engine to an auxiliary thread pool thread. */
+        recf->engine->id = rt->last_engine_id++;
+
         ret = nxt_router_engine_conf_create(tmcf, recf);
         if (nxt_slow_path(ret != NXT_OK)) {
             return ret;
@@ -1940,6 +2703,24 @@ nxt_router_engines_create(nxt_task_t *task, nxt_router_t *router,
         n++;
     }
 
+#if (NXT_HAVE_CPU_AFFINITY)
+
+    /*
+     * The kept and added engines precede the deleted ones, so the n-th
+     * engine is pinned to the n-th CPU or released if affinity is off.
+     */
+
+    recf = tmcf->engines->elts;
+
+    for (n = 0; n < threads; n++) {
+        ret = nxt_router_engine_affinity(tmcf, &recf[n], n);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+    }
+
+#endif
+
     return NXT_OK;
 }
 
@@ -2058,6 +2839,7 @@ nxt_router_engine_joints_create(nxt_router_temp_conf_t *tmcf,
         joint->socket_conf = skcf;
 
         joint->engine = recf->engine;
+        joint->static_cache = NULL;
     }
 
     return NXT_OK;
@@ -2089,6 +2871,38 @@ nxt_router_engine_quit(nxt_router_temp_conf_t *tmcf,
 }
 
 
+#if (NXT_HAVE_CPU_AFFINITY)
+
+static nxt_int_t
+nxt_router_engine_affinity(nxt_router_temp_conf_t *tmcf,
+    nxt_router_engine_conf_t *recf, nxt_uint_t n)
+{
+    nxt_joint_job_t  *job;
+
+    job = nxt_mp_get(tmcf->mem_pool, sizeof(nxt_joint_job_t));
+    if (nxt_slow_path(job == NULL)) {
+        return NXT_ERROR;
+    }
+
+    job->work.next = recf->jobs;
+    recf->jobs = &job->work;
+
+    job->task = tmcf->engine->task;
+    job->work.handler = nxt_router_engine_affinity_handler;
+    job->work.task = &job->task;
+    job->work.obj = job;
+    job->work.data = (void *) (intptr_t) (tmcf->conf->affinity ? (nxt_int_t) n
+                                                               : -1);
+    job->tmcf = tmcf;
+
+    tmcf->count++;
+
+    return NXT_OK;
+}
+
+#endif
+
+
 static nxt_int_t
 nxt_router_engine_joints_delete(nxt_router_temp_conf_t *tmcf,
     nxt_router_engine_conf_t *recf, nxt_queue_t *sockets)
@@ -2243,6 +3057,7 @@ nxt_router_engine_post(nxt_event_engine_t *engine, nxt_work_t *jobs)
 static nxt_port_handlers_t  nxt_router_app_port_handlers = {
     .mmap = nxt_port_mmap_handler,
     .data = nxt_port_rpc_handler,
+    .body = nxt_port_rpc_handler,
 };
 
 
@@ -2300,6 +3115,38 @@ nxt_router_thread_start(void *data)
 }
 
 
+static nxt_socket_t
+nxt_router_listen_socket_fd(nxt_router_temp_conf_t *tmcf,
+    nxt_socket_conf_joint_t *joint)
+{
+    nxt_listen_socket_t       *ls;
+#if (NXT_HAVE_REUSEPORT)
+    nxt_uint_t                i;
+    nxt_router_engine_conf_t  *recf;
+#endif
+
+    ls = joint->socket_conf->listen;
+
+#if (NXT_HAVE_REUSEPORT)
+
+    if (ls->nsockets != 0) {
+        recf = tmcf->engines->elts;
+
+        /* The active engines precede the deleted ones. */
+
+        for (i = 0; i < tmcf->engines->nelts; i++) {
+            if (recf[i].engine == joint->engine) {
+                return ls->sockets[i % ls->nsockets];
+            }
+        }
+    }
+
+#endif
+
+    return ls->socket;
+}
+
+
 static void
 nxt_router_listen_socket_create(nxt_task_t *task, void *obj, void *data)
 {
@@ -2318,7 +3165,8 @@ nxt_router_listen_socket_create(nxt_task_t *task, void *obj, void *data)
     skcf = joint->socket_conf;
     ls = skcf->listen;
 
-    lev = nxt_listen_event(task, ls);
+    lev = nxt_listen_event(task, ls,
+                           nxt_router_listen_socket_fd(job->tmcf, joint));
     if (nxt_slow_path(lev == NULL)) {
         nxt_router_listen_socket_release(task, skcf);
         return;
@@ -2332,6 +3180,8 @@ nxt_router_listen_socket_create(nxt_task_t *task, void *obj, void *data)
     ls->count++;
     nxt_thread_spin_unlock(lock);
 
+    nxt_router_joint_app_use(task, joint, 1);
+
     job->work.next = NULL;
     job->work.handler = nxt_router_conf_wait;
 
@@ -2343,19 +3193,16 @@ nxt_inline nxt_listen_event_t *
 nxt_router_listen_event(nxt_queue_t *listen_connections,
     nxt_socket_conf_t *skcf)
 {
-    nxt_socket_t        fd;
     nxt_queue_link_t    *qlk;
     nxt_listen_event_t  *lev;
 
-    fd = skcf->listen->socket;
-
     for (qlk = nxt_queue_first(listen_connections);
          qlk != nxt_queue_tail(listen_connections);
          qlk = nxt_queue_next(qlk))
     {
         lev = nxt_queue_link_data(qlk, nxt_listen_event_t, link);
 
-        if (fd == lev->socket.fd) {
+        if (lev->listen == skcf->listen) {
             return lev;
         }
     }
@@ -2386,6 +3233,8 @@ nxt_router_listen_socket_update(nxt_task_t *task, void *obj, void *data)
     lev->socket.data = joint;
     lev->listen = joint->socket_conf->listen;
 
+    nxt_router_joint_app_use(task, joint, 1);
+
     job->work.next = NULL;
     job->work.handler = nxt_router_conf_wait;
 
@@ -2432,9 +3281,30 @@ nxt_router_listen_socket_delete(nxt_task_t *task, void *obj, void *data)
 }
 
 
+#if (NXT_HAVE_CPU_AFFINITY)
+
+static void
+nxt_router_engine_affinity_handler(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_joint_job_t  *job;
+
+    job = obj;
+
+    (void) nxt_cpu_affinity_thread(task, (intptr_t) data);
+
+    job->work.next = NULL;
+    job->work.handler = nxt_router_conf_wait;
+
+    nxt_event_engine_post(job->tmcf->engine, &job->work);
+}
+
+#endif
+
+
 static void
 nxt_router_worker_thread_quit(nxt_task_t *task, void *obj, void *data)
 {
+    nxt_app_share_t     *share;
     nxt_event_engine_t  *engine;
 
     nxt_debug(task, "router worker thread quit");
@@ -2443,6 +3313,12 @@ nxt_router_worker_thread_quit(nxt_task_t *task, void *obj, void *data)
 
     engine->shutdown = 1;
 
+    nxt_queue_each(share, &engine->shares, nxt_app_share_t, engine_link) {
+
+        nxt_router_app_share_recall(task, share);
+
+    } nxt_queue_loop;
+
     if (nxt_queue_is_empty(&engine->joints)) {
         nxt_thread_exit(task->thread);
     }
@@ -2497,7 +3373,7 @@ nxt_router_listen_socket_release(nxt_task_t *task, nxt_socket_conf_t *skcf)
     nxt_thread_spin_unlock(lock);
 
     if (ls != NULL) {
-        nxt_socket_close(task, ls->socket);
+        nxt_router_listen_sockets_close(task, ls);
         nxt_free(ls);
     }
 }
@@ -2519,6 +3395,10 @@ nxt_router_conf_release(nxt_task_t *task, nxt_socket_conf_joint_t *joint)
 
     nxt_queue_remove(&joint->link);
 
+    nxt_router_joint_app_use(task, joint, -1);
+
+    nxt_http_static_cache_free(joint->static_cache);
+
     /*
      * The joint content can not be safely used after the critical
      * section protected by the spinlock because its memory pool may
@@ -2565,6 +3445,26 @@ nxt_router_conf_release(nxt_task_t *task, nxt_socket_conf_joint_t *joint)
 }
 
 
+/*
+ * A joint keeps its application until the last request on the joint
+ * is finished, while the application may be already removed from
+ * the router configuration.
+ */
+
+static void
+nxt_router_joint_app_use(nxt_task_t *task, nxt_socket_conf_joint_t *joint,
+    int i)
+{
+    nxt_app_t  *app;
+
+    app = joint->socket_conf->application;
+
+    if (app != NULL) {
+        nxt_router_app_use(task, app, i);
+    }
+}
+
+
 static void
 nxt_router_thread_exit_handler(nxt_task_t *task, void *obj, void *data)
 {
@@ -2613,6 +3513,11 @@ nxt_router_response_ready_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg,
     b = msg->buf;
     rc = data;
 
+    if (msg->port_msg.type == _NXT_PORT_MSG_BODY) {
+        nxt_router_app_body_request(task, msg, rc);
+        return;
+    }
+
     dump_size = nxt_buf_used_size(b);
 
     if (dump_size > 300) {
@@ -2628,6 +3533,21 @@ nxt_router_response_ready_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg,
     }
 
     ar = rc->ap;
+    r = ar->request;
+
+    if (nxt_slow_path(r->proto.any == NULL)) {
+        /*
+         * The client connection has been closed, the response
+         * buffers are released by port on return.
+         */
+        nxt_router_response_cancel(task, ar);
+
+        if (msg->port_msg.last != 0) {
+            nxt_router_rc_unlink(task, rc);
+        }
+
+        return;
+    }
 
     if (msg->port_msg.last != 0) {
         nxt_debug(task, "router data create last buf");
@@ -2659,22 +3579,15 @@ nxt_router_response_ready_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg,
         msg->buf = NULL;
     }
 
-    r = ar->request;
-
     if (r->header_sent) {
-        nxt_buf_chain_add(&r->out, b);
-        nxt_http_request_send_body(task, r, NULL);
+        nxt_http_cache_body(task, r, b, msg->port_msg.last);
 
-    } else {
-        ret = nxt_http_parse_fields(&ar->resp_parser, &b->mem);
-        if (nxt_slow_path(ret != NXT_DONE)) {
-            goto fail;
-        }
+        nxt_router_response_spool(task, ar, b);
 
-        r->resp.fields = ar->resp_parser.fields;
+        nxt_http_request_send_body(task, r, NULL);
 
-        ret = nxt_http_fields_process(r->resp.fields,
-                                      &nxt_response_fields_hash, r);
+    } else {
+        ret = nxt_router_response_header(task, r, &b->mem);
         if (nxt_slow_path(ret != NXT_OK)) {
             goto fail;
         }
@@ -2686,8 +3599,11 @@ nxt_router_response_ready_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg,
             b = b->next;
         }
 
+        nxt_http_cache_response(task, r);
+        nxt_http_cache_body(task, r, b, msg->port_msg.last);
+
         if (b != NULL) {
-            nxt_buf_chain_add(&r->out, b);
+            nxt_router_response_spool(task, ar, b);
         }
 
         r->state = &nxt_http_request_send_state;
@@ -2706,11 +3622,98 @@ fail:
 }
 
 
+static nxt_int_t
+nxt_router_response_header(nxt_task_t *task, nxt_http_request_t *r,
+    nxt_buf_mem_t *mem)
+{
+    u_char                 *p;
+    size_t                 size;
+    nxt_int_t              ret;
+    nxt_uint_t             i;
+    nxt_list_t             *fields;
+    nxt_http_field_t       *field;
+    nxt_app_resp_field_t   f;
+    nxt_app_resp_header_t  h;
+
+    p = mem->pos;
+    size = mem->free - p;
+
+    if (nxt_slow_path(size < sizeof(nxt_app_resp_header_t))) {
+        goto invalid;
+    }
+
+    nxt_memcpy(&h, p, sizeof(nxt_app_resp_header_t));
+    p += sizeof(nxt_app_resp_header_t);
+    size -= sizeof(nxt_app_resp_header_t);
+
+    if (nxt_slow_path(h.status < 100 || h.status > 999)) {
+        goto invalid;
+    }
+
+    r->status = h.status;
+
+    fields = nxt_list_create(r->mem_pool, nxt_max(h.fields, 1),
+                             sizeof(nxt_http_field_t));
+    if (nxt_slow_path(fields == NULL)) {
+        return NXT_ERROR;
+    }
+
+    r->resp.fields = fields;
+
+    for (i = 0; i < h.fields; i++) {
+
+        if (nxt_slow_path(size < sizeof(nxt_app_resp_field_t))) {
+            goto invalid;
+        }
+
+        nxt_memcpy(&f, p, sizeof(nxt_app_resp_field_t));
+        p += sizeof(nxt_app_resp_field_t);
+        size -= sizeof(nxt_app_resp_field_t);
+
+        if (nxt_slow_path(f.name_length == 0
+                          || size < f.name_length + (size_t) f.value_length))
+        {
+            goto invalid;
+        }
+
+        field = nxt_list_add(fields);
+        if (nxt_slow_path(field == NULL)) {
+            return NXT_ERROR;
+        }
+
+        field->hash = 0;
+        field->skip = 0;
+        field->name_length = f.name_length;
+        field->value_length = f.value_length;
+        field->name = p;
+        field->value = p + f.name_length;
+
+        p += f.name_length + f.value_length;
+        size -= f.name_length + f.value_length;
+
+        ret = nxt_http_response_field_process(r, field, f.id);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+    }
+
+    mem->pos = p;
+
+    return NXT_OK;
+
+invalid:
+
+    nxt_log(task, NXT_LOG_ERR, "invalid response header from application");
+
+    return NXT_ERROR;
+}
+
+
 static const nxt_http_request_state_t  nxt_http_request_send_state
     nxt_aligned(64) =
 {
     .ready_handler = nxt_http_request_send_body,
-    .error_handler = nxt_http_request_close_handler,
+    .error_handler = nxt_router_response_send_error,
 };
 
 
@@ -2732,173 +3735,912 @@ nxt_http_request_send_body(nxt_task_t *task, void *obj, void *data)
 
 
 static void
-nxt_router_response_error_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg,
-    void *data)
+nxt_router_response_send_error(nxt_task_t *task, void *obj, void *data)
 {
-    nxt_int_t            res;
-    nxt_port_t           *port;
-    nxt_bool_t           cancelled;
-    nxt_req_app_link_t   *ra;
-    nxt_req_conn_link_t  *rc;
-
-    rc = data;
-
-    ra = rc->ra;
-
-    if (ra != NULL) {
-        cancelled = nxt_router_msg_cancel(task, &ra->msg_info, ra->stream);
+    nxt_http_request_t  *r;
 
-        if (cancelled) {
-            nxt_router_ra_inc_use(ra);
+    r = obj;
 
-            res = nxt_router_app_port(task, rc->app, ra);
+    /* An application may wait for credits which will never be returned. */
+    nxt_router_response_cancel(task, r->app_data);
 
-            if (res == NXT_OK) {
-                port = ra->app_port;
+    nxt_http_request_close_handler(task, r, data);
+}
 
-                nxt_assert(port != NULL);
 
-                nxt_port_rpc_ex_set_peer(task, task->thread->engine->port, rc,
-                                         port->pid);
+/*
+ * Response flow control.  An application may pass NXT_APP_RESPONSE_WINDOW
+ * bytes of a response body, then it waits for credits.  The body size is
+ * returned to the application as credits once the body is sent to client.
+ * A sync buffer queued after the body parts marks the sent size.  Credits
+ * are not returned while the application uses less than half of window,
+ * so short responses do not cost additional messages.
+ */
 
-                nxt_router_app_prepare_request(task, ra);
-            }
+static void
+nxt_router_response_credit(nxt_task_t *task, nxt_app_parse_ctx_t *ar,
+    nxt_buf_t *b)
+{
+    size_t  size;
 
-            msg->port_msg.last = 0;
+    size = 0;
 
-            return;
+    while (b != NULL) {
+        if (nxt_buf_is_mem(b)) {
+            size += nxt_buf_mem_used_size(&b->mem);
         }
+
+        b = b->next;
     }
 
-    nxt_http_request_error(task, rc->ap->request, NXT_HTTP_SERVICE_UNAVAILABLE);
+    ar->credit_queued += size;
+    ar->credit_used += size;
 
-    nxt_router_rc_unlink(task, rc);
+    if (ar->credit_port != NULL
+        && ar->credit_marked == 0
+        && ar->credit_queued != 0)
+    {
+        nxt_router_response_credit_mark(task, ar);
+    }
 }
 
 
+/*
+ * An application may respond before the request link is released and
+ * the credit port is set.  The credits counted meanwhile are marked and
+ * returned then, otherwise the application may wait for them forever.
+ */
+
 static void
-nxt_router_app_port_ready(nxt_task_t *task, nxt_port_recv_msg_t *msg,
-    void *data)
+nxt_router_response_credit_start(nxt_task_t *task, nxt_app_parse_ctx_t *ar)
 {
-    nxt_app_t   *app;
-    nxt_port_t  *port;
+    nxt_http_request_t  *r;
 
-    app = data;
-    port = msg->u.new_port;
+    r = ar->request;
 
-    nxt_assert(app != NULL);
-    nxt_assert(port != NULL);
+    if (ar->credit_drained != 0) {
+        nxt_router_response_credit_return(task, ar);
+    }
 
-    port->app = app;
+    if (ar->credit_port != NULL
+        && ar->credit_marked == 0
+        && ar->credit_queued != 0
+        && r->proto.any != NULL)
+    {
+        nxt_router_response_credit_mark(task, ar);
 
-    nxt_thread_mutex_lock(&app->mutex);
+        if (r->header_sent) {
+            nxt_http_request_send_body(task, r, NULL);
+        }
+    }
+}
 
-    nxt_assert(app->pending_processes != 0);
 
-    app->pending_processes--;
-    app->processes++;
+static void
+nxt_router_response_credit_mark(nxt_task_t *task, nxt_app_parse_ctx_t *ar)
+{
+    nxt_buf_t  *b;
 
-    nxt_thread_mutex_unlock(&app->mutex);
+    b = nxt_buf_mem_alloc(ar->mem_pool, 0, 0);
+    if (nxt_slow_path(b == NULL)) {
+        nxt_router_response_cancel(task, ar);
+        return;
+    }
 
-    nxt_debug(task, "app '%V' new port ready, pid %PI, %d/%d",
-              &app->name, port->pid, app->processes, app->pending_processes);
+    nxt_buf_set_sync(b);
+    b->completion_handler = nxt_router_response_drained;
+    b->parent = ar;
 
-    nxt_router_app_port_release(task, port, 0, 0);
+    ar->credit_marked = ar->credit_queued;
+    ar->credit_queued = 0;
+
+    nxt_buf_chain_add(&ar->request->out, b);
 }
 
 
 static void
-nxt_router_app_port_error(nxt_task_t *task, nxt_port_recv_msg_t *msg,
-    void *data)
+nxt_router_response_drained(nxt_task_t *task, void *obj, void *data)
 {
-    nxt_app_t           *app;
-    nxt_queue_link_t    *lnk;
-    nxt_req_app_link_t  *ra;
+    nxt_buf_t            *b;
+    nxt_app_parse_ctx_t  *ar;
 
-    app = data;
+    b = obj;
+    ar = data;
 
-    nxt_assert(app != NULL);
+    nxt_mp_free(ar->mem_pool, b);
 
-    nxt_debug(task, "app '%V' %p start error", &app->name, app);
+    ar->credit_drained += ar->credit_marked;
+    ar->credit_marked = 0;
 
-    nxt_thread_mutex_lock(&app->mutex);
+    if (ar->credit_port == NULL) {
+        return;
+    }
 
-    nxt_assert(app->pending_processes != 0);
+    nxt_router_response_credit_return(task, ar);
 
-    app->pending_processes--;
+    if (ar->credit_port != NULL && ar->credit_queued != 0) {
+        nxt_router_response_credit_mark(task, ar);
+        nxt_http_request_send_body(task, ar->request, NULL);
+    }
+}
 
-    if (!nxt_queue_is_empty(&app->requests)) {
-        lnk = nxt_queue_last(&app->requests);
-        nxt_queue_remove(lnk);
-        lnk->next = NULL;
 
-        ra = nxt_queue_link_data(lnk, nxt_req_app_link_t, link_app_requests);
+static void
+nxt_router_response_credit_return(nxt_task_t *task, nxt_app_parse_ctx_t *ar)
+{
+    uint32_t   credit;
+    nxt_buf_t  *b;
+    nxt_int_t  ret;
 
-    } else {
-        ra = NULL;
+    if (ar->credit_used < NXT_APP_RESPONSE_WINDOW / 2) {
+        return;
     }
 
-    nxt_thread_mutex_unlock(&app->mutex);
+    credit = ar->credit_drained;
 
-    if (ra != NULL) {
-        nxt_debug(task, "app '%V' %p abort next stream #%uD",
-                  &app->name, app, ra->stream);
+    nxt_debug(task, "stream #%uD: return credit %uD",
+              ar->credit_stream, credit);
 
-        nxt_router_ra_error(ra, 500, "Failed to start application process");
-        nxt_router_ra_use(task, ra, -1);
+    b = nxt_buf_mem_ts_alloc(task, task->thread->engine->mem_pool,
+                             sizeof(uint32_t));
+    if (nxt_slow_path(b == NULL)) {
+        nxt_router_response_cancel(task, ar);
+        return;
     }
 
-    nxt_router_app_use(task, app, -1);
-}
+    b->mem.free = nxt_cpymem(b->mem.free, &credit, sizeof(uint32_t));
 
+    ret = nxt_port_socket_write(task, ar->credit_port, NXT_PORT_MSG_CREDIT,
+                                -1, ar->credit_stream, 0, b);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return;
+    }
 
-void
-nxt_router_app_use(nxt_task_t *task, nxt_app_t *app, int i)
-{
-    int  c;
+    ar->credit_used -= credit;
+    ar->credit_drained = 0;
+}
 
-    c = nxt_atomic_fetch_add(&app->use_count, i);
 
-    if (i < 0 && c == -i) {
+static void
+nxt_router_response_cancel(nxt_task_t *task, nxt_app_parse_ctx_t *ar)
+{
+    nxt_port_t  *port;
 
-        nxt_assert(app->live == 0);
-        nxt_assert(app->processes == 0);
-        nxt_assert(app->idle_processes == 0);
-        nxt_assert(app->pending_processes == 0);
-        nxt_assert(nxt_queue_is_empty(&app->requests) != 0);
-        nxt_assert(nxt_queue_is_empty(&app->ports) != 0);
-        nxt_assert(nxt_queue_is_empty(&app->spare_ports) != 0);
-        nxt_assert(nxt_queue_is_empty(&app->idle_ports) != 0);
+    port = ar->credit_port;
 
-        nxt_thread_mutex_destroy(&app->mutex);
-        nxt_free(app);
+    if (port == NULL) {
+        return;
     }
-}
-
 
-nxt_inline nxt_bool_t
-nxt_router_app_first_port_busy(nxt_app_t *app)
-{
-    nxt_port_t        *port;
-    nxt_queue_link_t  *lnk;
+    ar->credit_port = NULL;
 
-    lnk = nxt_queue_first(&app->ports);
-    port = nxt_queue_link_data(lnk, nxt_port_t, app_link);
+    nxt_debug(task, "stream #%uD: cancel response", ar->credit_stream);
 
-    return port->app_pending_responses > 0;
+    (void) nxt_port_socket_write(task, port, NXT_PORT_MSG_CREDIT_LAST, -1,
+                                 ar->credit_stream, 0, NULL);
 }
 
 
-nxt_inline nxt_port_t *
-nxt_router_pop_first_port(nxt_app_t *app)
+/*
+ * A response body exceeding "response_temp_threshold" is saved to an
+ * anonymous temporary file and is sent to client with sendfile().  The
+ * body parts are written by the thread pool: while a write job runs, the
+ * following parts are queued in the spool chain to keep the body order.
+ * The shared memory is released and credits are returned just after
+ * a body part is written, so a slow client does not hold an application
+ * process until the whole response is sent.  If the file cannot be
+ * written, the rest of the body is kept in memory as usual.
+ */
+
+static void
+nxt_router_response_spool(nxt_task_t *task, nxt_app_parse_ctx_t *ar,
+    nxt_buf_t *b)
 {
-    nxt_port_t        *port;
-    nxt_queue_link_t  *lnk;
+    size_t              size;
+    nxt_buf_t           *out, **prev;
+    nxt_off_t           threshold;
+    nxt_file_t          *file;
+    nxt_http_request_t  *r;
 
-    lnk = nxt_queue_first(&app->ports);
-    nxt_queue_remove(lnk);
+    r = ar->request;
 
-    port = nxt_queue_link_data(lnk, nxt_port_t, app_link);
+    threshold = r->socket_conf->response_temp_threshold;
+
+    if (threshold == 0 || ar->response_file_error) {
+        nxt_buf_chain_add(&r->out, b);
+        nxt_router_response_credit(task, ar, b);
+        return;
+    }
+
+    if (ar->response_file == NULL) {
+        out = NULL;
+        prev = &out;
+
+        while (b != NULL) {
+            size = nxt_buf_is_mem(b) ? nxt_buf_mem_used_size(&b->mem) : 0;
+
+            if (ar->response_size + (nxt_off_t) size > threshold) {
+                break;
+            }
+
+            ar->response_size += size;
+
+            *prev = b;
+            prev = &b->next;
+            b = b->next;
+        }
+
+        *prev = NULL;
+
+        if (out != NULL) {
+            nxt_buf_chain_add(&r->out, out);
+            nxt_router_response_credit(task, ar, out);
+        }
+
+        if (b == NULL) {
+            return;
+        }
+
+        file = nxt_http_request_temp_file(task, r, "unit.response");
+
+        if (nxt_slow_path(file == NULL)) {
+            ar->response_file_error = 1;
+
+            nxt_buf_chain_add(&r->out, b);
+            nxt_router_response_credit(task, ar, b);
+            return;
+        }
+
+        ar->response_file = file;
+    }
+
+    nxt_buf_chain_add(&ar->response_spool, b);
+
+    if (!ar->response_spooling) {
+        nxt_router_response_file_write(task, ar);
+    }
+}
+
+
+static void
+nxt_router_response_file_write(nxt_task_t *task, nxt_app_parse_ctx_t *ar)
+{
+    nxt_buf_t             *b, *fb;
+    nxt_http_request_t    *r;
+    nxt_job_file_write_t  *jbw;
+
+    r = ar->request;
+
+    b = ar->response_spool;
+    ar->response_spool = NULL;
+
+    /*
+     * The file buffer is allocated in advance and heads the job chain,
+     * it is skipped by the job since it is not a memory buffer.
+     */
+    fb = nxt_buf_file_alloc(ar->mem_pool, 0, 0);
+    jbw = nxt_job_create(ar->mem_pool, sizeof(nxt_job_file_write_t));
+
+    if (nxt_slow_path(fb == NULL || jbw == NULL)) {
+        ar->response_file_error = 1;
+
+        nxt_buf_chain_add(&r->out, b);
+        nxt_router_response_credit(task, ar, b);
+
+        return;
+    }
+
+    fb->file = ar->response_file;
+    fb->next = b;
+
+    jbw->job.data = ar;
+    jbw->job.thread_pool = nxt_runtime_thread_pool(task->thread->runtime);
+    jbw->job.abort_handler = nxt_router_response_file_error;
+
+    jbw->file = ar->response_file;
+    jbw->offset = ar->response_file_size;
+    jbw->buffer = fb;
+
+    jbw->ready_handler = nxt_router_response_file_written;
+    jbw->error_handler = nxt_router_response_file_error;
+
+    ar->response_spooling = 1;
+
+    /* The request may be closed while the job runs. */
+    nxt_mp_retain(ar->mem_pool);
+
+    nxt_job_file_write(task, jbw);
+}
+
+
+static void
+nxt_router_response_file_error(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_app_parse_ctx_t  *ar;
+
+    ar = data;
+
+    ar->response_file_error = 1;
+
+    nxt_router_response_file_written(task, obj, data);
+}
+
+
+static void
+nxt_router_response_file_written(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_mp_t              *mp;
+    nxt_buf_t             *b, *fb, *next, *out, **prev;
+    nxt_off_t             written;
+    nxt_work_queue_t      *wq;
+    nxt_http_request_t    *r;
+    nxt_app_parse_ctx_t   *ar;
+    nxt_job_file_write_t  *jbw;
+
+    jbw = obj;
+    ar = data;
+    r = ar->request;
+    mp = ar->mem_pool;
+
+    fb = jbw->buffer;
+
+    written = jbw->offset - ar->response_file_size;
+    ar->response_file_size = jbw->offset;
+
+    task = &task->thread->engine->task;
+
+    nxt_job_destroy(task, jbw);
+
+    nxt_debug(task, "response file written: %O", written);
+
+    ar->response_spooling = 0;
+
+    if (r->proto.any == NULL) {
+        nxt_router_response_spool_free(task, fb->next);
+        nxt_router_response_spool_free(task, ar->response_spool);
+
+        ar->response_spool = NULL;
+
+        nxt_mp_free(mp, fb);
+        nxt_mp_release(mp);
+
+        return;
+    }
+
+    wq = &task->thread->engine->fast_work_queue;
+
+    out = NULL;
+    prev = &out;
+
+    /* On error the buffers following the written data are kept in memory. */
+
+    for (b = fb->next; b != NULL; b = next) {
+        next = b->next;
+
+        if (nxt_buf_is_mem(b) && !nxt_buf_is_sync(b)
+            && b->mem.pos == b->mem.free)
+        {
+            nxt_work_queue_add(wq, b->completion_handler, task, b, b->parent);
+            continue;
+        }
+
+        *prev = b;
+        prev = &b->next;
+    }
+
+    *prev = NULL;
+
+    fb->next = NULL;
+
+    if (written != 0) {
+        fb->file_pos = ar->response_file_size - written;
+        fb->file_end = ar->response_file_size;
+
+        nxt_buf_chain_add(&r->out, fb);
+
+        ar->credit_used += written;
+        ar->credit_drained += written;
+
+        if (ar->credit_port != NULL) {
+            nxt_router_response_credit_return(task, ar);
+        }
+
+    } else {
+        nxt_mp_free(mp, fb);
+    }
+
+    if (ar->response_file_error) {
+        nxt_buf_chain_add(&out, ar->response_spool);
+        ar->response_spool = NULL;
+    }
+
+    if (out != NULL) {
+        nxt_buf_chain_add(&r->out, out);
+        nxt_router_response_credit(task, ar, out);
+    }
+
+    if (ar->response_spool != NULL) {
+        nxt_router_response_file_write(task, ar);
+    }
+
+    if (r->header_sent) {
+        nxt_http_request_send_body(task, r, NULL);
+    }
+
+    nxt_mp_release(mp);
+}
+
+
+static void
+nxt_router_response_spool_free(nxt_task_t *task, nxt_buf_t *b)
+{
+    nxt_buf_t         *next;
+    nxt_work_queue_t  *wq;
+
+    wq = &task->thread->engine->fast_work_queue;
+
+    for ( /* void */ ; b != NULL; b = next) {
+        next = b->next;
+
+        if (nxt_buf_is_mem(b) && !nxt_buf_is_sync(b)) {
+            b->mem.pos = b->mem.free;
+            nxt_work_queue_add(wq, b->completion_handler, task, b, b->parent);
+        }
+    }
+}
+
+
+static void
+nxt_router_app_body_request(nxt_task_t *task, nxt_port_recv_msg_t *msg,
+    nxt_req_conn_link_t *rc)
+{
+    size_t               size;
+    nxt_buf_t            *b;
+    nxt_port_t           *port;
+    nxt_http_request_t   *r;
+    nxt_app_parse_ctx_t  *ar;
+
+    ar = rc->ap;
+    r = ar->request;
+
+    port = rc->app_port;
+
+    if (port == NULL && rc->ra != NULL) {
+        port = rc->ra->app_port;
+    }
+
+    if (nxt_slow_path(port == NULL
+                      || port->pid != msg->port_msg.pid
+                      || ar->body_port != NULL))
+    {
+        nxt_debug(task, "stream #%uD: unexpected body request", rc->stream);
+        return;
+    }
+
+    nxt_debug(task, "stream #%uD: body request, rest: %O",
+              rc->stream, r->body_rest);
+
+    if (r->body_rest == 0 || r->proto.any == NULL) {
+        goto eof;
+    }
+
+    size = r->socket_conf->body_buffer_size;
+
+    if ((nxt_off_t) size > r->body_rest) {
+        size = (size_t) r->body_rest;
+    }
+
+    b = nxt_port_mmap_get_buf(task, port, size);
+    if (nxt_slow_path(b == NULL)) {
+        goto eof;
+    }
+
+    (void) nxt_port_mmap_increase_buf(task, b, size, 1);
+
+    if ((size_t) nxt_buf_mem_free_size(&b->mem) > size) {
+        /* The buffer end remains in the last chunk. */
+        b->mem.end = b->mem.free + size;
+    }
+
+    nxt_port_use(task, port, 1);
+
+    ar->body_port = port;
+    ar->body_buf = b;
+    ar->body_stream = rc->stream;
+
+    r->body_state = &nxt_router_body_stream_state;
+    r->body_data = ar;
+
+    /* The request may be closed while the body part is read. */
+    nxt_mp_retain(ar->mem_pool);
+
+    if (rc->app->timeout != 0) {
+        nxt_timer_add(task->thread->engine, &ar->timer,
+                      rc->app->timeout + r->socket_conf->body_read_timeout);
+    }
+
+    nxt_http_request_body_stream(task, r, b);
+
+    return;
+
+eof:
+
+    (void) nxt_port_socket_write(task, port, NXT_PORT_MSG_BODY_LAST, -1,
+                                 rc->stream, 0, NULL);
+}
+
+
+static const nxt_http_request_state_t  nxt_router_body_stream_state
+    nxt_aligned(64) =
+{
+    .ready_handler = nxt_router_body_stream_ready,
+    .error_handler = nxt_router_body_stream_error,
+};
+
+
+static void
+nxt_router_body_stream_ready(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_http_request_t  *r;
+
+    r = obj;
+
+    nxt_router_body_stream_send(task, data, r->body_rest == 0);
+}
+
+
+static void
+nxt_router_body_stream_error(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_router_body_stream_send(task, data, 1);
+}
+
+
+static void
+nxt_router_body_stream_send(nxt_task_t *task, nxt_app_parse_ctx_t *ar,
+    nxt_bool_t last)
+{
+    nxt_int_t   ret;
+    nxt_buf_t   *b;
+    nxt_uint_t  type;
+    nxt_port_t  *port;
+
+    b = ar->body_buf;
+    port = ar->body_port;
+
+    ar->body_buf = NULL;
+    ar->body_port = NULL;
+
+    if (nxt_buf_mem_used_size(&b->mem) == 0) {
+        b->completion_handler(task, b, b->parent);
+        b = NULL;
+    }
+
+    nxt_debug(task, "stream #%uD: send %sbody part",
+              ar->body_stream, last ? "last " : "");
+
+    type = last ? NXT_PORT_MSG_BODY_LAST : NXT_PORT_MSG_BODY;
+
+    ret = nxt_port_socket_write(task, port, type, -1, ar->body_stream, 0, b);
+
+    if (nxt_slow_path(ret != NXT_OK && b != NULL)) {
+        b->completion_handler(task, b, b->parent);
+    }
+
+    nxt_port_use(task, port, -1);
+
+    nxt_mp_release(ar->mem_pool);
+}
+
+
+static void
+nxt_router_response_error_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg,
+    void *data)
+{
+    nxt_int_t            res;
+    nxt_port_t           *port;
+    nxt_bool_t           cancelled;
+    nxt_req_app_link_t   *ra;
+    nxt_req_conn_link_t  *rc;
+
+    rc = data;
+
+    ra = rc->ra;
+
+    if (ra != NULL) {
+        cancelled = nxt_router_msg_cancel(task, &ra->msg_info, ra->stream);
+
+        if (cancelled) {
+            nxt_router_ra_inc_use(ra);
+
+            res = nxt_router_app_port(task, rc->app, ra);
+
+            if (res == NXT_OK) {
+                port = ra->app_port;
+
+                nxt_assert(port != NULL);
+
+                nxt_port_rpc_ex_set_peer(task, task->thread->engine->port, rc,
+                                         port->pid);
+
+                nxt_router_app_prepare_request(task, ra);
+            }
+
+            msg->port_msg.last = 0;
+
+            return;
+        }
+    }
+
+    nxt_http_request_error(task, rc->ap->request, NXT_HTTP_SERVICE_UNAVAILABLE);
+
+    nxt_router_rc_unlink(task, rc);
+}
+
+
+static void
+nxt_router_app_port_ready(nxt_task_t *task, nxt_port_recv_msg_t *msg,
+    void *data)
+{
+    nxt_app_t   *app;
+    nxt_port_t  *port;
+
+    app = data;
+    port = msg->u.new_port;
+
+    nxt_assert(app != NULL);
+    nxt_assert(port != NULL);
+
+    port->app = app;
+    port->ring_enabled = (app->type != NXT_APP_GO);
+
+    nxt_thread_mutex_lock(&app->mutex);
+
+    nxt_assert(app->pending_processes != 0);
+
+    app->pending_processes--;
+    app->processes++;
+
+    nxt_thread_mutex_unlock(&app->mutex);
+
+    nxt_debug(task, "app '%V' new port ready, pid %PI, %d/%d",
+              &app->name, port->pid, app->processes, app->pending_processes);
+
+    nxt_router_app_port_release(task, port, 0, 0);
+}
+
+
+static void
+nxt_router_app_port_error(nxt_task_t *task, nxt_port_recv_msg_t *msg,
+    void *data)
+{
+    nxt_app_t           *app;
+    nxt_queue_link_t    *lnk;
+    nxt_req_app_link_t  *ra;
+
+    app = data;
+
+    nxt_assert(app != NULL);
+
+    nxt_debug(task, "app '%V' %p start error", &app->name, app);
+
+    nxt_thread_mutex_lock(&app->mutex);
+
+    nxt_assert(app->pending_processes != 0);
+
+    app->pending_processes--;
+
+    if (!nxt_queue_is_empty(&app->requests)) {
+        lnk = nxt_queue_last(&app->requests);
+        nxt_queue_remove(lnk);
+        lnk->next = NULL;
+
+        ra = nxt_queue_link_data(lnk, nxt_req_app_link_t, link_app_requests);
+
+    } else {
+        ra = NULL;
+    }
+
+    nxt_thread_mutex_unlock(&app->mutex);
+
+    if (ra != NULL) {
+        nxt_debug(task, "app '%V' %p abort next stream #%uD",
+                  &app->name, app, ra->stream);
+
+        nxt_router_ra_error(ra, 500, "Failed to start application process");
+        nxt_router_ra_use(task, ra, -1);
+    }
+
+    nxt_router_app_use(task, app, -1);
+}
+
+
+void
+nxt_router_app_use(nxt_task_t *task, nxt_app_t *app, int i)
+{
+    int  c;
+
+    c = nxt_atomic_fetch_add(&app->use_count, i);
+
+    if (i < 0 && c == -i) {
+
+        nxt_assert(app->live == 0);
+        nxt_assert(app->processes == 0);
+        nxt_assert(app->idle_processes == 0);
+        nxt_assert(app->pending_processes == 0);
+        nxt_assert(nxt_queue_is_empty(&app->requests) != 0);
+        nxt_assert(nxt_queue_is_empty(&app->ports) != 0);
+        nxt_assert(nxt_queue_is_empty(&app->spare_ports) != 0);
+        nxt_assert(nxt_queue_is_empty(&app->idle_ports) != 0);
+        nxt_assert(nxt_queue_is_empty(&app->shares) != 0);
+
+        nxt_thread_mutex_destroy(&app->mutex);
+        nxt_http_cache_free(app->cache);
+        nxt_free(app);
+    }
+}
+
+
+nxt_inline nxt_bool_t
+nxt_router_app_first_port_busy(nxt_app_t *app)
+{
+    nxt_port_t        *port;
+    nxt_queue_link_t  *lnk;
+
+    lnk = nxt_queue_first(&app->ports);
+    port = nxt_queue_link_data(lnk, nxt_port_t, app_link);
+
+    return port->app_pending_responses > 0;
+}
+
+
+nxt_app_balance_t
+nxt_router_app_parse_balance(nxt_str_t *str)
+{
+    if (str->length == 0 || nxt_str_eq(str, "round_robin", 11)) {
+        return NXT_APP_BALANCE_ROUND_ROBIN;
+
+    } else if (nxt_str_eq(str, "least_outstanding", 17)) {
+        return NXT_APP_BALANCE_LEAST_OUTSTANDING;
+
+    } else if (nxt_str_eq(str, "p2c", 3)) {
+        return NXT_APP_BALANCE_P2C;
+    }
+
+    return NXT_APP_BALANCE_UNKNOWN;
+}
+
+
+nxt_inline nxt_nsec_t
+nxt_router_app_port_cost(nxt_port_t *port, nxt_nsec_t latency)
+{
+    return (nxt_nsec_t) (port->app_pending_responses + 1) * (latency + 1);
+}
+
+
+static nxt_queue_link_t *
+nxt_router_app_least_outstanding(nxt_app_t *app)
+{
+    nxt_port_t        *port, *best;
+    nxt_queue_link_t  *lnk;
+
+    best = NULL;
+
+    for (lnk = nxt_queue_first(&app->ports);
+         lnk != nxt_queue_tail(&app->ports);
+         lnk = nxt_queue_next(lnk))
+    {
+        port = nxt_queue_link_data(lnk, nxt_port_t, app_link);
+
+        if (best == NULL
+            || port->app_pending_responses < best->app_pending_responses)
+        {
+            best = port;
+
+            /* Idle ports are kept at the head of the queue. */
+            if (port->app_pending_responses == 0) {
+                break;
+            }
+        }
+    }
+
+    return &best->app_link;
+}
+
+
+static nxt_queue_link_t *
+nxt_router_app_p2c(nxt_task_t *task, nxt_app_t *app)
+{
+    uint32_t          i, n, first, second;
+    nxt_nsec_t        latency1, latency2;
+    nxt_port_t        *port1, *port2;
+    nxt_queue_link_t  *lnk, *lnk1, *lnk2;
+
+    n = 0;
+
+    for (lnk = nxt_queue_first(&app->ports);
+         lnk != nxt_queue_tail(&app->ports);
+         lnk = nxt_queue_next(lnk))
+    {
+        n++;
+    }
+
+    if (n == 1) {
+        return nxt_queue_first(&app->ports);
+    }
+
+    first = nxt_random(&task->thread->random) % n;
+    second = nxt_random(&task->thread->random) % (n - 1);
+
+    if (second >= first) {
+        second++;
+    }
+
+    lnk1 = NULL;
+    lnk2 = NULL;
+
+    for (i = 0, lnk = nxt_queue_first(&app->ports);
+         lnk1 == NULL || lnk2 == NULL;
+         i++, lnk = nxt_queue_next(lnk))
+    {
+        if (i == first) {
+            lnk1 = lnk;
+
+        } else if (i == second) {
+            lnk2 = lnk;
+        }
+    }
+
+    port1 = nxt_queue_link_data(lnk1, nxt_port_t, app_link);
+    port2 = nxt_queue_link_data(lnk2, nxt_port_t, app_link);
+
+    latency1 = port1->app_latency;
+    latency2 = port2->app_latency;
+
+    /*
+     * A process without a response time sample, e.g. the one busy with
+     * its first slow request, is assumed to be as fast as the other one.
+     */
+
+    if (latency1 == 0) {
+        latency1 = latency2;
+
+    } else if (latency2 == 0) {
+        latency2 = latency1;
+    }
+
+    return (nxt_router_app_port_cost(port1, latency1)
+            <= nxt_router_app_port_cost(port2, latency2))
+           ? lnk1 : lnk2;
+}
+
+
+/* The function must be called with the app->mutex locked. */
+
+nxt_inline nxt_port_t *
+nxt_router_pop_port(nxt_task_t *task, nxt_app_t *app)
+{
+    nxt_port_t        *port;
+    nxt_queue_link_t  *lnk;
+
+    switch (app->balance) {
+
+    case NXT_APP_BALANCE_LEAST_OUTSTANDING:
+        lnk = nxt_router_app_least_outstanding(app);
+        break;
+
+    case NXT_APP_BALANCE_P2C:
+        lnk = nxt_router_app_p2c(task, app);
+        break;
+
+    default: /* NXT_APP_BALANCE_ROUND_ROBIN */
+        lnk = nxt_queue_first(&app->ports);
+        break;
+    }
+
+    nxt_queue_remove(lnk);
+
+    port = nxt_queue_link_data(lnk, nxt_port_t, app_link);
 
     port->app_pending_responses++;
 
@@ -2980,6 +4722,12 @@ nxt_router_app_quit(nxt_task_t *task, nxt_app_t *app)
 
     app->live = 0;
 
+    nxt_thread_mutex_lock(&app->mutex);
+
+    nxt_router_app_shares_recall(task, app, 1);
+
+    nxt_thread_mutex_unlock(&app->mutex);
+
     for ( ;; ) {
         port = nxt_router_app_get_port_for_quit(app);
         if (port == NULL) {
@@ -3037,8 +4785,9 @@ nxt_router_app_port_release(nxt_task_t *task, nxt_port_t *port,
     uint32_t request_failed, uint32_t got_response)
 {
     nxt_app_t                *app;
-    nxt_bool_t               port_unchained;
+    nxt_bool_t               port_unchained, leased;
     nxt_bool_t               send_quit, cancelled, adjust_idle_timer;
+    nxt_app_share_t          *share;
     nxt_queue_link_t         *lnk;
     nxt_req_app_link_t       *ra, *pending_ra, *re_ra;
     nxt_port_select_state_t  state;
@@ -3046,12 +4795,47 @@ nxt_router_app_port_release(nxt_task_t *task, nxt_port_t *port,
     nxt_assert(port != NULL);
     nxt_assert(port->app != NULL);
 
+    share = port->share;
+
+    if (share != NULL
+        && nxt_router_app_share_release(task, port, request_failed,
+                                        got_response))
+    {
+        return;
+    }
+
     ra = NULL;
 
     app = port->app;
 
     nxt_thread_mutex_lock(&app->mutex);
 
+    if (share != NULL) {
+        nxt_assert(share->engine == task->thread->engine);
+
+        port->share = NULL;
+        share->leased--;
+
+        if (nxt_slow_path(port->app_closed)) {
+            /* The process has been already unaccounted on port close. */
+
+            port->app_pending_responses -= request_failed + got_response;
+
+            nxt_thread_mutex_unlock(&app->mutex);
+
+            nxt_debug(task, "app '%V' %p leased port %p closed",
+                      &app->name, app, port);
+
+            if (request_failed > 0 || got_response > 0) {
+                nxt_router_app_share_check(task, share);
+            }
+
+            goto adjust_use;
+        }
+
+        app->leased_processes--;
+    }
+
     port->app_pending_responses -= request_failed + got_response;
     port->app_responses += got_response;
 
@@ -3059,7 +4843,7 @@ nxt_router_app_port_release(nxt_task_t *task, nxt_port_t *port,
         goto app_dead;
     }
 
-    if (port->pair[1] != -1
+    if (!port->app_closed
         && (app->max_pending_responses == 0
             || port->app_pending_responses < app->max_pending_responses)
         && (app->max_requests == 0
@@ -3095,7 +4879,7 @@ nxt_router_app_port_release(nxt_task_t *task, nxt_port_t *port,
 
         ra = nxt_queue_link_data(lnk, nxt_req_app_link_t, link_app_requests);
 
-        ra->app_port = nxt_router_pop_first_port(app);
+        ra->app_port = nxt_router_pop_port(task, app);
 
         if (ra->app_port->app_pending_responses > 1) {
             nxt_router_ra_pending(task, app, ra);
@@ -3171,7 +4955,12 @@ re_ra_cancelled:
 
     adjust_idle_timer = 0;
 
-    if (!send_quit && port->app_pending_responses == 0) {
+    leased = !send_quit
+             && got_response > 0
+             && port->app_pending_responses == 0
+             && nxt_router_app_share_lease(task, app, port);
+
+    if (!send_quit && !leased && port->app_pending_responses == 0) {
         nxt_assert(port->idle_link.next == NULL);
 
         if (app->idle_processes == app->spare_processes
@@ -3196,6 +4985,10 @@ re_ra_cancelled:
 
     nxt_thread_mutex_unlock(&app->mutex);
 
+    if (share != NULL && (request_failed > 0 || got_response > 0)) {
+        nxt_router_app_share_check(task, share);
+    }
+
     if (adjust_idle_timer) {
         nxt_router_app_use(task, app, 1);
         nxt_event_engine_post(app->engine, &app->adjust_idle_work);
@@ -3272,6 +5065,15 @@ nxt_router_app_port_close(nxt_task_t *task, nxt_port_t *port)
 
     nxt_thread_mutex_lock(&app->mutex);
 
+    port->app_closed = 1;
+
+    if (port->share != NULL) {
+        /* The share returns the leased port to the application. */
+        app->leased_processes--;
+
+        nxt_router_app_share_recall_post(task, port->share);
+    }
+
     unchain = nxt_queue_chk_remove(&port->app_link);
 
     if (nxt_queue_chk_remove(&port->idle_link)) {
@@ -3400,26 +5202,424 @@ nxt_router_adjust_idle_timer(nxt_task_t *task, void *obj, void *data)
 static void
 nxt_router_app_idle_timeout(nxt_task_t *task, void *obj, void *data)
 {
-    nxt_app_t    *app;
-    nxt_timer_t  *timer;
+    nxt_app_t    *app;
+    nxt_timer_t  *timer;
+
+    timer = obj;
+    app = nxt_container_of(timer, nxt_app_t, idle_timer);
+
+    nxt_router_adjust_idle_timer(task, app, NULL);
+}
+
+
+static void
+nxt_router_app_release_handler(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_app_t    *app;
+    nxt_timer_t  *timer;
+
+    timer = obj;
+    app = nxt_container_of(timer, nxt_app_t, idle_timer);
+
+    nxt_router_app_use(task, app, -1);
+}
+
+
+nxt_inline nxt_app_share_t *
+nxt_router_app_share_find(nxt_event_engine_t *engine, nxt_app_t *app)
+{
+    nxt_app_share_t  *share;
+
+    nxt_queue_each(share, &engine->shares, nxt_app_share_t, engine_link) {
+
+        if (share->app == app) {
+            return share;
+        }
+
+    } nxt_queue_loop;
+
+    return NULL;
+}
+
+
+nxt_inline nxt_msec_t
+nxt_router_app_share_timeout(nxt_app_t *app)
+{
+    return nxt_max(app->idle_timeout, NXT_ROUTER_APP_SHARE_TIMEOUT);
+}
+
+
+static nxt_app_share_t *
+nxt_router_app_share_create(nxt_task_t *task, nxt_app_t *app)
+{
+    nxt_app_share_t     *share;
+    nxt_event_engine_t  *engine;
+
+    share = nxt_zalloc(sizeof(nxt_app_share_t));
+    if (nxt_slow_path(share == NULL)) {
+        return NULL;
+    }
+
+    engine = task->thread->engine;
+
+    nxt_queue_init(&share->ports);
+
+    share->app = app;
+    share->engine = engine;
+
+    share->idle_timer.precision = NXT_TIMER_DEFAULT_PRECISION;
+    share->idle_timer.work_queue = &engine->fast_work_queue;
+    share->idle_timer.handler = nxt_router_app_share_idle_timeout;
+    share->idle_timer.task = &engine->task;
+    share->idle_timer.log = share->idle_timer.task->log;
+
+    share->recall_work.handler = nxt_router_app_share_recall_handler;
+    share->recall_work.task = &engine->task;
+    share->recall_work.obj = share;
+
+    nxt_queue_insert_tail(&app->shares, &share->link);
+    nxt_queue_insert_tail(&engine->shares, &share->engine_link);
+
+    nxt_router_app_use(task, app, 1);
+
+    nxt_debug(task, "app '%V' %p share %p created for engine %p",
+              &app->name, app, share, engine);
+
+    return share;
+}
+
+
+/*
+ * The function must be called with the app->mutex locked.  Ports are leased
+ * only with the round robin balancing, see nxt_app_share_t.
+ */
+
+static nxt_bool_t
+nxt_router_app_share_lease(nxt_task_t *task, nxt_app_t *app, nxt_port_t *port)
+{
+    nxt_app_share_t     *share;
+    nxt_event_engine_t  *engine;
+
+    engine = task->thread->engine;
+
+    if (app->balance != NXT_APP_BALANCE_ROUND_ROBIN
+        || engine->shutdown
+        || port->app_closed
+        || port->app_link.next == NULL
+        || !nxt_queue_is_empty(&app->requests))
+    {
+        return 0;
+    }
+
+    share = nxt_router_app_share_find(engine, app);
+
+    if (share == NULL) {
+        share = nxt_router_app_share_create(task, app);
+
+        if (nxt_slow_path(share == NULL)) {
+            return 0;
+        }
+    }
+
+    if (share->recall) {
+        return 0;
+    }
+
+    /* The app->ports reference is passed to the share. */
+    nxt_queue_remove(&port->app_link);
+    port->app_link.next = NULL;
+
+    port->share = share;
+    share->leased++;
+    app->leased_processes++;
+
+    nxt_debug(task, "app '%V' %p port %PI leased to engine %p",
+              &app->name, app, port->pid, engine);
+
+    nxt_router_app_share_push(task, share, port);
+
+    return 1;
+}
+
+
+static void
+nxt_router_app_share_push(nxt_task_t *task, nxt_app_share_t *share,
+    nxt_port_t *port)
+{
+    nxt_event_engine_t  *engine;
+
+    engine = task->thread->engine;
+
+    port->idle_start = engine->timers.now;
+
+    nxt_queue_insert_head(&share->ports, &port->share_link);
+    share->idle++;
+
+    if (share->idle_timer.state == NXT_TIMER_DISABLED) {
+        share->timer_requests = share->requests;
+
+        nxt_timer_add(engine, &share->idle_timer,
+                      nxt_router_app_share_timeout(share->app));
+    }
+}
+
+
+nxt_inline nxt_port_t *
+nxt_router_app_share_port(nxt_task_t *task, nxt_app_t *app)
+{
+    nxt_port_t        *port;
+    nxt_app_share_t   *share;
+    nxt_queue_link_t  *lnk;
+
+    share = nxt_router_app_share_find(task->thread->engine, app);
+
+    if (share == NULL || share->recall) {
+        return NULL;
+    }
+
+    if (nxt_queue_is_empty(&share->ports)) {
+        return NULL;
+    }
+
+    lnk = nxt_queue_first(&share->ports);
+    nxt_queue_remove(lnk);
+    lnk->next = NULL;
+
+    share->idle--;
+    share->requests++;
+
+    port = nxt_queue_link_data(lnk, nxt_port_t, share_link);
+
+    /* The share reference is passed to the request. */
+    port->app_pending_responses++;
+
+    nxt_debug(task, "app '%V' %p use leased port %PI",
+              &app->name, app, port->pid);
+
+    return port;
+}
+
+
+/*
+ * A leased port is kept by the engine share if the request has been
+ * completed and the share has not been recalled.  Otherwise the lease
+ * is returned to the application.  Requests queued in the application
+ * recall the shares, so the application mutex is not locked here.
+ */
+
+static nxt_bool_t
+nxt_router_app_share_release(nxt_task_t *task, nxt_port_t *port,
+    uint32_t request_failed, uint32_t got_response)
+{
+    nxt_app_t        *app;
+    nxt_app_share_t  *share;
+
+    share = port->share;
+    app = port->app;
+
+    if (share->recall) {
+        return 0;
+    }
+
+    if (request_failed == 0 && got_response == 0) {
+        /* The port is still used by the engine. */
+        return 1;
+    }
+
+    if (port->app_pending_responses != request_failed + got_response
+        || (app->max_requests != 0
+            && port->app_responses + got_response >= app->max_requests))
+    {
+        return 0;
+    }
+
+    port->app_pending_responses = 0;
+    port->app_responses += got_response;
+
+    /* The request reference is passed to the share. */
+    nxt_router_app_share_push(task, share, port);
+
+    return 1;
+}
+
+
+/* The function must be called with the app->mutex locked. */
+
+static nxt_uint_t
+nxt_router_app_shares_recall(nxt_task_t *task, nxt_app_t *app, nxt_bool_t all)
+{
+    nxt_uint_t       idle;
+    nxt_app_share_t  *share;
+
+    idle = 0;
+
+    nxt_queue_each(share, &app->shares, nxt_app_share_t, link) {
+
+        if (share->leased == 0 && !all) {
+            continue;
+        }
+
+        /* The counter is updated by another engine, it is only a hint. */
+        idle += share->idle;
+
+        nxt_router_app_share_recall_post(task, share);
+
+    } nxt_queue_loop;
+
+    return idle;
+}
+
+
+/* The function must be called with the app->mutex locked. */
+
+static void
+nxt_router_app_share_recall_post(nxt_task_t *task, nxt_app_share_t *share)
+{
+    if (share->recall_work.data != NULL) {
+        return;
+    }
+
+    nxt_debug(task, "app '%V' %p recall share %p of engine %p",
+              &share->app->name, share->app, share, share->engine);
+
+    share->recall_work.data = share;
+    share->recall_work.next = NULL;
+
+    nxt_event_engine_post(share->engine, &share->recall_work);
+}
+
+
+static void
+nxt_router_app_share_recall_handler(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_app_t        *app;
+    nxt_app_share_t  *share;
+
+    share = obj;
+    app = share->app;
+
+    nxt_assert(share->engine == task->thread->engine);
+
+    nxt_thread_mutex_lock(&app->mutex);
+
+    share->recall_work.data = NULL;
+
+    nxt_thread_mutex_unlock(&app->mutex);
+
+    nxt_router_app_share_recall(task, share);
+}
+
+
+static void
+nxt_router_app_share_recall(nxt_task_t *task, nxt_app_share_t *share)
+{
+    nxt_port_t        *port;
+    nxt_queue_link_t  *lnk;
+
+    nxt_debug(task, "app '%V' share %p recall: %uD/%uD",
+              &share->app->name, share, share->idle, share->leased);
+
+    /* Busy ports will be returned on release. */
+    share->recall = 1;
+
+    while (!nxt_queue_is_empty(&share->ports)) {
+        lnk = nxt_queue_first(&share->ports);
+        nxt_queue_remove(lnk);
+        lnk->next = NULL;
+
+        share->idle--;
+
+        port = nxt_queue_link_data(lnk, nxt_port_t, share_link);
+
+        nxt_router_app_port_release(task, port, 0, 0);
+        nxt_port_use(task, port, -1);
+    }
+
+    nxt_router_app_share_check(task, share);
+}
+
+
+static void
+nxt_router_app_share_check(nxt_task_t *task, nxt_app_share_t *share)
+{
+    nxt_app_t  *app;
+
+    if (!share->recall || share->leased != 0) {
+        return;
+    }
+
+    app = share->app;
+
+    if (app->live != 0 && !share->engine->shutdown) {
+        share->recall = 0;
+        return;
+    }
+
+    nxt_thread_mutex_lock(&app->mutex);
+
+    if (share->recall_work.data != NULL) {
+        /* The share will be checked again by the recall handler. */
+        nxt_thread_mutex_unlock(&app->mutex);
+        return;
+    }
+
+    nxt_queue_remove(&share->link);
+
+    nxt_thread_mutex_unlock(&app->mutex);
+
+    nxt_queue_remove(&share->engine_link);
+
+    nxt_debug(task, "app '%V' %p share %p destroy", &app->name, app, share);
+
+    if (share->idle_timer.state != NXT_TIMER_DISABLED
+        || nxt_timer_is_in_tree(&share->idle_timer))
+    {
+        share->idle_timer.handler = nxt_router_app_share_free_handler;
+        nxt_timer_add(share->engine, &share->idle_timer, 0);
+
+    } else {
+        nxt_free(share);
+    }
+
+    nxt_router_app_use(task, app, -1);
+}
+
+
+static void
+nxt_router_app_share_idle_timeout(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_timer_t      *timer;
+    nxt_app_share_t  *share;
 
     timer = obj;
-    app = nxt_container_of(timer, nxt_app_t, idle_timer);
+    share = nxt_timer_data(timer, nxt_app_share_t, idle_timer);
 
-    nxt_router_adjust_idle_timer(task, app, NULL);
+    if (share->idle == 0) {
+        return;
+    }
+
+    if (share->requests != share->timer_requests) {
+        share->timer_requests = share->requests;
+
+        nxt_timer_add(task->thread->engine, timer,
+                      nxt_router_app_share_timeout(share->app));
+        return;
+    }
+
+    nxt_router_app_share_recall(task, share);
 }
 
 
 static void
-nxt_router_app_release_handler(nxt_task_t *task, void *obj, void *data)
+nxt_router_app_share_free_handler(nxt_task_t *task, void *obj, void *data)
 {
-    nxt_app_t    *app;
-    nxt_timer_t  *timer;
+    nxt_timer_t      *timer;
+    nxt_app_share_t  *share;
 
     timer = obj;
-    app = nxt_container_of(timer, nxt_app_t, idle_timer);
+    share = nxt_timer_data(timer, nxt_app_share_t, idle_timer);
 
-    nxt_router_app_use(task, app, -1);
+    nxt_free(share);
 }
 
 
@@ -3457,6 +5657,15 @@ nxt_router_port_select(nxt_task_t *task, nxt_port_select_state_t *state)
 
         state->failed_port->app_pending_responses--;
 
+        if (state->failed_port->share != NULL) {
+            state->failed_port->share->leased--;
+            state->failed_port->share = NULL;
+
+            if (!state->failed_port->app_closed) {
+                app->leased_processes--;
+            }
+        }
+
         if (nxt_queue_chk_remove(&state->failed_port->app_link)) {
             state->failed_port_use_delta--;
         }
@@ -3489,13 +5698,19 @@ nxt_router_port_select(nxt_task_t *task, nxt_port_select_state_t *state)
 
         nxt_debug(task, "ra stream #%uD enqueue to app->requests", ra->stream);
 
-        if (can_start_process) {
+        /*
+         * Idle ports leased to other engines are recalled instead
+         * of starting a new process.
+         */
+        if (nxt_router_app_shares_recall(task, app, 0) == 0
+            && can_start_process)
+        {
             app->pending_processes++;
             state->start_process = 1;
         }
 
     } else {
-        state->port = nxt_router_pop_first_port(app);
+        state->port = nxt_router_pop_port(task, app);
 
         if (state->port->app_pending_responses > 1) {
             ra = nxt_router_ra_create(task, ra);
@@ -3582,8 +5797,19 @@ nxt_router_port_post_select(nxt_task_t *task, nxt_port_select_state_t *state)
 static nxt_int_t
 nxt_router_app_port(nxt_task_t *task, nxt_app_t *app, nxt_req_app_link_t *ra)
 {
+    nxt_port_t               *port;
     nxt_port_select_state_t  state;
 
+    if (ra->app_port == NULL) {
+        port = nxt_router_app_share_port(task, app);
+
+        if (port != NULL) {
+            ra->app_port = port;
+
+            return NXT_OK;
+        }
+    }
+
     state.ra = ra;
     state.app = app;
 
@@ -3664,9 +5890,11 @@ nxt_router_dummy_buf_completion(nxt_task_t *task, void *obj, void *data)
 static void
 nxt_router_app_prepare_request(nxt_task_t *task, nxt_req_app_link_t *ra)
 {
+    nxt_fd_t             fd;
     uint32_t             request_failed;
     nxt_buf_t            *b;
     nxt_int_t            res;
+    nxt_uint_t           type;
     nxt_port_t           *port, *c_port, *reply_port;
     nxt_app_wmsg_t       wmsg;
     nxt_app_parse_ctx_t  *ap;
@@ -3697,8 +5925,9 @@ nxt_router_app_prepare_request(nxt_task_t *task, nxt_req_app_link_t *ra)
     wmsg.write = NULL;
     wmsg.buf = &wmsg.write;
     wmsg.stream = ra->stream;
+    wmsg.read_port = NULL;
 
-    res = port->app->prepare_msg(task, &ap->r, &wmsg);
+    res = nxt_router_prepare_msg(task, &ap->r, &wmsg);
 
     if (nxt_slow_path(res != NXT_OK)) {
         nxt_router_ra_error(ra, 500,
@@ -3727,116 +5956,60 @@ nxt_router_app_prepare_request(nxt_task_t *task, nxt_req_app_link_t *ra)
         goto release_port;
     }
 
-    res = nxt_port_socket_twrite(task, wmsg.port, NXT_PORT_MSG_DATA,
-                                 -1, ra->stream, reply_port->id, wmsg.write,
-                                 &ra->msg_info.tracking);
-
-    if (nxt_slow_path(res != NXT_OK)) {
-        nxt_router_ra_error(ra, 500,
-                            "Failed to send message to application");
-        goto release_port;
-    }
-
-release_port:
-
-    nxt_router_app_port_release(task, port, request_failed, 0);
-
-    nxt_router_ra_update_peer(task, ra);
-}
-
-
-static nxt_int_t
-nxt_python_prepare_msg(nxt_task_t *task, nxt_app_request_t *r,
-    nxt_app_wmsg_t *wmsg)
-{
-    nxt_int_t                 rc;
-    nxt_buf_t                 *b;
-    nxt_http_field_t          *field;
-    nxt_app_request_header_t  *h;
-
-    static const nxt_str_t prefix = nxt_string("HTTP_");
-    static const nxt_str_t eof = nxt_null_string;
-
-    h = &r->header;
-
-#define RC(S)                                                                 \
-    do {                                                                      \
-        rc = (S);                                                             \
-        if (nxt_slow_path(rc != NXT_OK)) {                                    \
-            goto fail;                                                        \
-        }                                                                     \
-    } while(0)
-
-#define NXT_WRITE(N)                                                          \
-    RC(nxt_app_msg_write_str(task, wmsg, N))
-
-    /* TODO error handle, async mmap buffer assignment */
+    /*
+     * A message without the "last" flag means that
+     * the rest of the request body has to be requested.
+     */
+    type = ap->r.body.done ? NXT_PORT_MSG_DATA_LAST : NXT_PORT_MSG_DATA;
 
-    NXT_WRITE(&h->method);
-    NXT_WRITE(&h->target);
+    fd = -1;
 
-    if (h->path.start == h->target.start) {
-        NXT_WRITE(&eof);
+    if (ap->r.body.fd != -1) {
+        /*
+         * The body file descriptor is duplicated since the request
+         * may be resent, the duplicate is closed by port once sent.
+         */
+        fd = dup(ap->r.body.fd);
 
-    } else {
-        NXT_WRITE(&h->path);
-    }
+        if (nxt_slow_path(fd == -1)) {
+            nxt_router_ra_error(ra, 500, "Failed to pass request body file");
+            goto release_port;
+        }
 
-    if (h->query.start != NULL) {
-        RC(nxt_app_msg_write_size(task, wmsg,
-                                  h->query.start - h->target.start + 1));
-    } else {
-        RC(nxt_app_msg_write_size(task, wmsg, 0));
+        type |= NXT_PORT_MSG_CLOSE_FD;
     }
 
-    NXT_WRITE(&h->version);
-
-    NXT_WRITE(&r->remote);
-    NXT_WRITE(&r->local);
-
-    NXT_WRITE(&h->host);
-    NXT_WRITE(&h->content_type);
-    NXT_WRITE(&h->content_length);
-
-    nxt_list_each(field, h->fields) {
-        RC(nxt_app_msg_write_prefixed_upcase(task, wmsg, &prefix, field->name,
-                                             field->name_length));
-        RC(nxt_app_msg_write(task, wmsg, field->value, field->value_length));
-
-    } nxt_list_loop;
+    res = nxt_port_socket_twrite(task, wmsg.port, type,
+                                 fd, ra->stream, reply_port->id, wmsg.write,
+                                 &ra->msg_info.tracking);
 
-    /* end-of-headers mark */
-    NXT_WRITE(&eof);
+    if (nxt_slow_path(res != NXT_OK)) {
 
-    RC(nxt_app_msg_write_size(task, wmsg, r->body.preread_size));
+        if (fd != -1) {
+            nxt_fd_close(fd);
+        }
 
-    for (b = r->body.buf; b != NULL; b = b->next) {
-        RC(nxt_app_msg_write_raw(task, wmsg, b->mem.pos,
-                                 nxt_buf_mem_used_size(&b->mem)));
+        nxt_router_ra_error(ra, 500,
+                            "Failed to send message to application");
+        goto release_port;
     }
 
-#undef NXT_WRITE
-#undef RC
-
-    return NXT_OK;
+release_port:
 
-fail:
+    nxt_router_app_port_release(task, port, request_failed, 0);
 
-    return NXT_ERROR;
+    nxt_router_ra_update_peer(task, ra);
 }
 
 
 static nxt_int_t
-nxt_php_prepare_msg(nxt_task_t *task, nxt_app_request_t *r,
+nxt_router_prepare_msg(nxt_task_t *task, nxt_app_request_t *r,
     nxt_app_wmsg_t *wmsg)
 {
     nxt_int_t                 rc;
     nxt_buf_t                 *b;
-    nxt_bool_t                method_is_post;
-    nxt_http_field_t          *field;
     nxt_app_request_header_t  *h;
 
-    static const nxt_str_t prefix = nxt_string("HTTP_");
     static const nxt_str_t eof = nxt_null_string;
 
     h = &r->header;
@@ -3873,11 +6046,6 @@ nxt_php_prepare_msg(nxt_task_t *task, nxt_app_request_t *r,
 
     NXT_WRITE(&h->version);
 
-    // PHP_SELF
-    // SCRIPT_NAME
-    // SCRIPT_FILENAME
-    // DOCUMENT_ROOT
-
     NXT_WRITE(&r->remote);
     NXT_WRITE(&r->local);
 
@@ -3887,198 +6055,12 @@ nxt_php_prepare_msg(nxt_task_t *task, nxt_app_request_t *r,
     NXT_WRITE(&h->content_length);
 
     RC(nxt_app_msg_write_size(task, wmsg, h->parsed_content_length));
-    RC(nxt_app_msg_write_size(task, wmsg, r->body.preread_size));
-
-    method_is_post = h->method.length == 4
-                     && h->method.start[0] == 'P'
-                     && h->method.start[1] == 'O'
-                     && h->method.start[2] == 'S'
-                     && h->method.start[3] == 'T';
-
-    if (method_is_post) {
-        for (b = r->body.buf; b != NULL; b = b->next) {
-            RC(nxt_app_msg_write_raw(task, wmsg, b->mem.pos,
-                                     nxt_buf_mem_used_size(&b->mem)));
-        }
-    }
-
-    nxt_list_each(field, h->fields) {
-        RC(nxt_app_msg_write_prefixed_upcase(task, wmsg, &prefix, field->name,
-                                             field->name_length));
-        RC(nxt_app_msg_write(task, wmsg, field->value, field->value_length));
-
-    } nxt_list_loop;
-
-    /* end-of-headers mark */
-    NXT_WRITE(&eof);
-
-    if (!method_is_post) {
-        for (b = r->body.buf; b != NULL; b = b->next) {
-            RC(nxt_app_msg_write_raw(task, wmsg, b->mem.pos,
-                                     nxt_buf_mem_used_size(&b->mem)));
-        }
-    }
-
-#undef NXT_WRITE
-#undef RC
-
-    return NXT_OK;
-
-fail:
-
-    return NXT_ERROR;
-}
-
-
-static nxt_int_t
-nxt_go_prepare_msg(nxt_task_t *task, nxt_app_request_t *r, nxt_app_wmsg_t *wmsg)
-{
-    nxt_int_t                 rc;
-    nxt_buf_t                 *b;
-    nxt_http_field_t          *field;
-    nxt_app_request_header_t  *h;
-
-    static const nxt_str_t eof = nxt_null_string;
-
-    h = &r->header;
-
-#define RC(S)                                                                 \
-    do {                                                                      \
-        rc = (S);                                                             \
-        if (nxt_slow_path(rc != NXT_OK)) {                                    \
-            goto fail;                                                        \
-        }                                                                     \
-    } while(0)
-
-#define NXT_WRITE(N)                                                          \
-    RC(nxt_app_msg_write_str(task, wmsg, N))
-
-    /* TODO error handle, async mmap buffer assignment */
-
-    NXT_WRITE(&h->method);
-    NXT_WRITE(&h->target);
-
-    if (h->path.start == h->target.start) {
-        NXT_WRITE(&eof);
-
-    } else {
-        NXT_WRITE(&h->path);
-    }
-
-    if (h->query.start != NULL) {
-        RC(nxt_app_msg_write_size(task, wmsg,
-                                  h->query.start - h->target.start + 1));
-    } else {
-        RC(nxt_app_msg_write_size(task, wmsg, 0));
-    }
-
-    NXT_WRITE(&h->version);
-    NXT_WRITE(&r->remote);
-
-    NXT_WRITE(&h->host);
-    NXT_WRITE(&h->cookie);
-    NXT_WRITE(&h->content_type);
-    NXT_WRITE(&h->content_length);
-
-    RC(nxt_app_msg_write_size(task, wmsg, h->parsed_content_length));
-
-    nxt_list_each(field, h->fields) {
-        RC(nxt_app_msg_write(task, wmsg, field->name, field->name_length));
-        RC(nxt_app_msg_write(task, wmsg, field->value, field->value_length));
-
-    } nxt_list_loop;
-
-    /* end-of-headers mark */
-    NXT_WRITE(&eof);
-
-    RC(nxt_app_msg_write_size(task, wmsg, r->body.preread_size));
-
-    for (b = r->body.buf; b != NULL; b = b->next) {
-        RC(nxt_app_msg_write_raw(task, wmsg, b->mem.pos,
-                                 nxt_buf_mem_used_size(&b->mem)));
-    }
-
-#undef NXT_WRITE
-#undef RC
-
-    return NXT_OK;
-
-fail:
-
-    return NXT_ERROR;
-}
-
-
-static nxt_int_t
-nxt_perl_prepare_msg(nxt_task_t *task, nxt_app_request_t *r,
-    nxt_app_wmsg_t *wmsg)
-{
-    nxt_int_t                 rc;
-    nxt_str_t                 str;
-    nxt_buf_t                 *b;
-    nxt_http_field_t          *field;
-    nxt_app_request_header_t  *h;
-
-    static const nxt_str_t prefix = nxt_string("HTTP_");
-    static const nxt_str_t eof = nxt_null_string;
-
-    h = &r->header;
-
-#define RC(S)                                                                 \
-    do {                                                                      \
-        rc = (S);                                                             \
-        if (nxt_slow_path(rc != NXT_OK)) {                                    \
-            goto fail;                                                        \
-        }                                                                     \
-    } while(0)
 
-#define NXT_WRITE(N)                                                          \
-    RC(nxt_app_msg_write_str(task, wmsg, N))
-
-    /* TODO error handle, async mmap buffer assignment */
-
-    NXT_WRITE(&h->method);
-    NXT_WRITE(&h->target);
-
-    if (h->query.length) {
-        str.start = h->target.start;
-        str.length = (h->target.length - h->query.length) - 1;
-
-        RC(nxt_app_msg_write_str(task, wmsg, &str));
-
-    } else {
-        NXT_WRITE(&eof);
-    }
-
-    if (h->query.start != NULL) {
-        RC(nxt_app_msg_write_size(task, wmsg,
-                                  h->query.start - h->target.start + 1));
-    } else {
-        RC(nxt_app_msg_write_size(task, wmsg, 0));
-    }
-
-    NXT_WRITE(&h->version);
-
-    NXT_WRITE(&r->remote);
-    NXT_WRITE(&r->local);
-
-    NXT_WRITE(&h->host);
-    NXT_WRITE(&h->content_type);
-    NXT_WRITE(&h->content_length);
-
-    nxt_list_each(field, h->fields) {
-        RC(nxt_app_msg_write_prefixed_upcase(task, wmsg, &prefix,
-                                             field->name, field->name_length));
-        RC(nxt_app_msg_write(task, wmsg, field->value, field->value_length));
-    } nxt_list_loop;
-
-    /* end-of-headers mark */
-    NXT_WRITE(&eof);
+    RC(nxt_app_msg_write_fields(task, wmsg, h->fields));
 
     RC(nxt_app_msg_write_size(task, wmsg, r->body.preread_size));
 
     for (b = r->body.buf; b != NULL; b = b->next) {
-
         RC(nxt_app_msg_write_raw(task, wmsg, b->mem.pos,
                                  nxt_buf_mem_used_size(&b->mem)));
     }
@@ -13,6 +13,8 @@
 #include <nxt_main_process.h>
 
 typedef struct nxt_http_request_s   nxt_http_request_t;
+typedef struct nxt_http_static_cache_s  nxt_http_static_cache_t;
+typedef struct nxt_http_cache_s     nxt_http_cache_t;
 #include <nxt_application.h>
 
 
@@ -28,6 +30,9 @@ typedef struct {
 typedef struct {
     uint32_t               count;
     uint32_t               threads;
+#if (NXT_HAVE_CPU_AFFINITY)
+    uint8_t                affinity;   /* 1 bit */
+#endif
     nxt_router_t           *router;
     nxt_mp_t               *mem_pool;
 } nxt_router_conf_t;
@@ -52,6 +57,10 @@ typedef struct {
     nxt_queue_t            keeping;    /* of nxt_socket_conf_t */
     nxt_queue_t            deleting;   /* of nxt_socket_conf_t */
 
+#if (NXT_SSLTLS)
+    nxt_queue_t            tls;        /* of nxt_router_tlssock_t */
+#endif
+
     nxt_queue_t            apps;       /* of nxt_app_t */
     nxt_queue_t            previous;   /* of nxt_app_t */
 
@@ -75,8 +84,13 @@ typedef struct {
 
 
 
-typedef nxt_int_t (*nxt_app_prepare_msg_t)(nxt_task_t *task,
-    nxt_app_request_t *r, nxt_app_wmsg_t *wmsg);
+typedef enum {
+    NXT_APP_BALANCE_ROUND_ROBIN = 0,
+    NXT_APP_BALANCE_LEAST_OUTSTANDING,
+    NXT_APP_BALANCE_P2C,
+
+    NXT_APP_BALANCE_UNKNOWN,
+} nxt_app_balance_t;
 
 
 struct nxt_app_s {
@@ -91,11 +105,13 @@ struct nxt_app_s {
 
     nxt_queue_t            requests; /* of nxt_req_app_link_t */
     nxt_queue_t            pending;  /* of nxt_req_app_link_t */
+    nxt_queue_t            shares;   /* of nxt_app_share_t */
     nxt_str_t              name;
 
     uint32_t               pending_processes;
     uint32_t               processes;
     uint32_t               idle_processes;
+    uint32_t               leased_processes;
 
     uint32_t               max_processes;
     uint32_t               spare_processes;
@@ -107,18 +123,56 @@ struct nxt_app_s {
     nxt_nsec_t             res_timeout;
     nxt_msec_t             idle_timeout;
 
+    /* A cache of application responses shared by engines. */
+    nxt_http_cache_t       *cache;
+
     nxt_app_type_t         type:8;
+    nxt_app_balance_t      balance:8;
     uint8_t                live;   /* 1 bit */
 
     nxt_queue_link_t       link;
 
     nxt_str_t              conf;
-    nxt_app_prepare_msg_t  prepare_msg;
 
     nxt_atomic_t           use_count;
 };
 
 
+/*
+ * An engine share of application ports.  Ports leased to an engine are
+ * used by this engine exclusively without locking the application mutex.
+ * The leases are recalled when other engines run out of ports, when the
+ * share stays unused for the application idle timeout, when a leased port
+ * is closed, when the application quits, or when the engine shuts down.
+ * The engine learns about all these events only from the recall posted
+ * to it, so the share does not test application or port state itself.
+ *
+ * Ports are leased only to round robin applications: requests sent to
+ * leased ports bypass the port selection, so the "least_outstanding"
+ * and "p2c" methods would not account for them.
+ */
+
+struct nxt_app_share_s {
+    nxt_queue_t            ports;    /* of nxt_port_t.share_link */
+    uint32_t               idle;
+    uint32_t               leased;   /* Protected by app->mutex. */
+
+    uint32_t               requests;
+    uint32_t               timer_requests;
+
+    uint8_t                recall;   /* 1 bit */
+
+    nxt_app_t              *app;
+    nxt_event_engine_t     *engine;
+
+    nxt_timer_t            idle_timer;
+    nxt_work_t             recall_work;
+
+    nxt_queue_link_t       link;         /* for nxt_app_t.shares */
+    nxt_queue_link_t       engine_link;  /* for nxt_event_engine_t.shares */
+};
+
+
 typedef struct {
     uint32_t               count;
     nxt_queue_link_t       link;
@@ -135,11 +189,24 @@ typedef struct {
 
     nxt_listen_socket_t    *listen;
 
+    /* A directory of files sent by router. */
+    nxt_str_t              share;
+
+    /* A directory of request body and response temporary files. */
+    nxt_str_t              temp_path;
+
+#if (NXT_SSLTLS)
+    nxt_ssltls_conf_t      *ssltls;
+#endif
+
     size_t                 header_buffer_size;
     size_t                 large_header_buffer_size;
     size_t                 large_header_buffers;
     size_t                 body_buffer_size;
     size_t                 max_body_size;
+    size_t                 body_temp_threshold;
+    size_t                 body_stream_threshold;
+    size_t                 response_temp_threshold;
     nxt_msec_t             idle_timeout;
     nxt_msec_t             header_read_timeout;
     nxt_msec_t             body_read_timeout;
@@ -154,6 +221,7 @@ typedef struct {
     nxt_socket_conf_t      *socket_conf;
 
     /* Modules configuraitons. */
+    nxt_http_static_cache_t  *static_cache;
 } nxt_socket_conf_joint_t;
 
 
@@ -164,6 +232,7 @@ void nxt_router_remove_pid_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg);
 void nxt_router_process_http_request(nxt_task_t *task, nxt_app_parse_ctx_t *ar);
 void nxt_router_app_port_close(nxt_task_t *task, nxt_port_t *port);
 void nxt_router_app_use(nxt_task_t *task, nxt_app_t *app, int i);
+nxt_app_balance_t nxt_router_app_parse_balance(nxt_str_t *str);
 
 
 #endif  /* _NXT_ROUTER_H_INCLUDED_ */
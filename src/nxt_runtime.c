@@ -630,6 +630,26 @@ nxt_runtime_thread_pool_create(nxt_thread_t *thr, nxt_runtime_t *rt,
 }
 
 
+/*
+ * The first thread pool is used by engine threads for blocking operations.
+ * NULL is returned if the process has no thread pool.
+ */
+
+nxt_thread_pool_t *
+nxt_runtime_thread_pool(nxt_runtime_t *rt)
+{
+    nxt_thread_pool_t  **tp;
+
+    if (nxt_array_is_empty(rt->thread_pools)) {
+        return NULL;
+    }
+
+    tp = rt->thread_pools->elts;
+
+    return tp[0];
+}
+
+
 static void
 nxt_runtime_thread_pool_destroy(nxt_task_t *task, nxt_runtime_t *rt,
     nxt_runtime_cont_t cont)
@@ -719,7 +739,7 @@ nxt_runtime_conf_init(nxt_task_t *task, nxt_runtime_t *rt)
     rt->daemon = 1;
     rt->main_process = 1;
     rt->engine_connections = 256;
-    rt->auxiliary_threads = 2;
+    rt->auxiliary_threads = nxt_max(nxt_ncpu, 2);
     rt->user_cred.user = NXT_USER;
     rt->group = NXT_GROUP;
     rt->pid = NXT_PID;
@@ -797,6 +817,14 @@ nxt_runtime_conf_init(nxt_task_t *task, nxt_runtime_t *rt)
 
     rt->conf_tmp = (char *) file_name.start;
 
+    ret = nxt_file_name_create(rt->mem_pool, &file_name, "%s%scerts/%Z",
+                               rt->state, slash);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return NXT_ERROR;
+    }
+
+    rt->certs = (char *) file_name.start;
+
     control.length = nxt_strlen(rt->control);
     control.start = (u_char *) rt->control;
 
@@ -818,9 +846,10 @@ nxt_runtime_conf_init(nxt_task_t *task, nxt_runtime_t *rt)
 static nxt_int_t
 nxt_runtime_conf_read_cmd(nxt_task_t *task, nxt_runtime_t *rt)
 {
-    char    *p, **argv;
-    u_char  *end;
-    u_char  buf[1024];
+    char       *p, **argv;
+    u_char     *end;
+    nxt_int_t  n;
+    u_char     buf[1024];
 
     static const char  version[] =
         "unit version: " NXT_VERSION "\n"
@@ -832,6 +861,8 @@ nxt_runtime_conf_read_cmd(nxt_task_t *task, nxt_runtime_t *rt)
     static const char  no_group[] = "option \"--group\" requires group name\n";
     static const char  no_pid[] = "option \"--pid\" requires filename\n";
     static const char  no_log[] = "option \"--log\" requires filename\n";
+    static const char  no_aux_threads[] =
+                       "option \"--aux-threads\" requires number\n";
     static const char  no_modules[] =
                        "option \"--modules\" requires directory\n";
     static const char  no_state[] = "option \"--state\" requires directory\n";
@@ -859,6 +890,12 @@ nxt_runtime_conf_read_cmd(nxt_task_t *task, nxt_runtime_t *rt)
         "  --state DIRECTORY    set state directory name\n"
         "                       default: \"" NXT_STATE "\"\n"
         "\n"
+        "  --timer-wheel        use timer wheel in router threads\n"
+        "\n"
+        "  --aux-threads NUMBER set maximum number of auxiliary threads"
+                                " per process\n"
+        "                       default: the number of CPUs, at least 2\n"
+        "\n"
         "  --user USER          set non-privileged processes to run"
                                 " as specified user\n"
         "                       default: \"" NXT_USER "\"\n"
@@ -981,6 +1018,33 @@ nxt_runtime_conf_read_cmd(nxt_task_t *task, nxt_runtime_t *rt)
             continue;
         }
 
+        if (nxt_strcmp(p, "--aux-threads") == 0) {
+            if (*argv == NULL) {
+                write(STDERR_FILENO, no_aux_threads,
+                      sizeof(no_aux_threads) - 1);
+                return NXT_ERROR;
+            }
+
+            p = *argv++;
+
+            n = nxt_int_parse((u_char *) p, nxt_strlen(p));
+
+            if (n < 1) {
+                write(STDERR_FILENO, no_aux_threads,
+                      sizeof(no_aux_threads) - 1);
+                return NXT_ERROR;
+            }
+
+            rt->auxiliary_threads = n;
+
+            continue;
+        }
+
+        if (nxt_strcmp(p, "--timer-wheel") == 0) {
+            rt->timer_wheel = 1;
+            continue;
+        }
+
         if (nxt_strcmp(p, "--no-daemon") == 0) {
             rt->daemon = 0;
             continue;
@@ -1496,7 +1560,7 @@ nxt_runtime_listen_sockets_enable(nxt_task_t *task, nxt_runtime_t *rt)
 
     for (i = 0; i < n; i++) {
         if (ls[i].flags == NXT_NONBLOCK) {
-            if (nxt_listen_event(task, &ls[i]) == NULL) {
+            if (nxt_listen_event(task, &ls[i], ls[i].socket) == NULL) {
                 return NXT_ERROR;
             }
         }
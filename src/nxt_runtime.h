@@ -50,6 +50,7 @@ struct nxt_runtime_s {
     uint8_t                daemon;
     uint8_t                batch;
     uint8_t                main_process;
+    uint8_t                timer_wheel;
     const char             *engine;
     uint32_t               engine_connections;
     uint32_t               auxiliary_threads;
@@ -61,6 +62,7 @@ struct nxt_runtime_s {
     const char             *state;
     const char             *conf;
     const char             *conf_tmp;
+    const char             *certs;
     const char             *control;
 
     nxt_queue_t            engines;            /* of nxt_event_engine_t */
@@ -82,6 +84,7 @@ void nxt_runtime_event_engine_free(nxt_runtime_t *rt);
 
 nxt_int_t nxt_runtime_thread_pool_create(nxt_thread_t *thr, nxt_runtime_t *rt,
     nxt_uint_t max_threads, nxt_nsec_t timeout);
+nxt_thread_pool_t *nxt_runtime_thread_pool(nxt_runtime_t *rt);
 
 
 nxt_inline nxt_bool_t
@@ -150,6 +153,8 @@ void nxt_stream_connection_init(nxt_task_t *task, void *obj, void *data);
 
 void nxt_app_quit_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg);
 void nxt_app_data_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg);
+void nxt_app_body_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg);
+void nxt_app_credit_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg);
 
 
 #define nxt_runtime_process_each(rt, process)                                 \
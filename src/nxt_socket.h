@@ -116,6 +116,12 @@ NXT_EXPORT ssize_t nxt_socketpair_send(nxt_fd_event_t *ev, nxt_fd_t fd,
 NXT_EXPORT ssize_t nxt_socketpair_recv(nxt_fd_event_t *ev, nxt_fd_t *fd,
    nxt_iobuf_t *iob, nxt_uint_t niob);
 
+#if (NXT_HAVE_SENDMMSG)
+struct mmsghdr;
+NXT_EXPORT ssize_t nxt_socketpair_send_batch(nxt_fd_event_t *ev,
+    struct mmsghdr *msgs, nxt_uint_t n);
+#endif
+
 
 #define                                                                       \
 nxt_socket_nonblocking(task, fd)                                              \
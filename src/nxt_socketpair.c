@@ -112,6 +112,57 @@ nxt_socketpair_send(nxt_fd_event_t *ev, nxt_fd_t fd, nxt_iobuf_t *iob,
 }
 
 
+#if (NXT_HAVE_SENDMMSG)
+
+/*
+ * Sends several datagrams without file descriptors in one system call
+ * and returns the number of sent datagrams.
+ */
+
+ssize_t
+nxt_socketpair_send_batch(nxt_fd_event_t *ev, struct mmsghdr *msgs,
+    nxt_uint_t n)
+{
+    int        ret;
+    nxt_err_t  err;
+
+    for ( ;; ) {
+        ret = sendmmsg(ev->fd, msgs, n, 0);
+
+        err = (ret == -1) ? nxt_socket_errno : 0;
+
+        nxt_debug(ev->task, "sendmmsg(%d, %ui): %d", ev->fd, n, ret);
+
+        if (ret > 0) {
+            return ret;
+        }
+
+        /* ret == -1 */
+
+        switch (err) {
+
+        case NXT_EAGAIN:
+            nxt_debug(ev->task, "sendmmsg(%d) not ready", ev->fd);
+            ev->write_ready = 0;
+
+            return NXT_AGAIN;
+
+        case NXT_EINTR:
+            nxt_debug(ev->task, "sendmmsg(%d) interrupted", ev->fd);
+            continue;
+
+        default:
+            nxt_log(ev->task, NXT_LOG_CRIT, "sendmmsg(%d, %ui) failed %E",
+                    ev->fd, n, err);
+
+            return NXT_ERROR;
+        }
+    }
+}
+
+#endif
+
+
 ssize_t
 nxt_socketpair_recv(nxt_fd_event_t *ev, nxt_fd_t *fd, nxt_iobuf_t *iob,
     nxt_uint_t niob)
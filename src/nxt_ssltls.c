@@ -5,3 +5,11 @@
  */
 
 #include <nxt_main.h>
+
+
+const nxt_ssltls_lib_t  *nxt_ssltls_lib =
+#if (NXT_HAVE_OPENSSL)
+    &nxt_openssl_lib;
+#else
+    NULL;
+#endif
@@ -13,22 +13,36 @@
  * overhead to each SSL/TLS record so buffering allows to decrease the
  * overhead.  The typical overhead size is about 30 bytes, however, TLS
  * supports also random padding up to 255 bytes.  The maximum SSLv3/TLS
- * record size is 16K.  However, large records increase decryption latency.
- * 4K is good compromise between 1-6% of SSL/TLS overhead and the latency.
- * 4K buffer allows to send one SSL/TLS record (4096-bytes data and up to
- * 224-bytes overhead) in three 1440-bytes TCP/IPv4 packets with timestamps
- * and compatible with tunnels.
+ * record size is 16K.  However, large records increase decryption latency
+ * since a client can not decrypt a record until it has received it whole.
+ *
+ * So a connection starts with records fitting in one 1440-bytes TCP/IPv4
+ * packet with timestamps and compatible with tunnels: the first bytes of
+ * a response can be processed as soon as the first packet arrives.  After
+ * NXT_SSLTLS_BOOST_SIZE bytes have been sent the TCP congestion window is
+ * large enough and the connection switches to the maximum records to
+ * minimize the overhead of bulk transfers.  The connection returns to
+ * small records after NXT_SSLTLS_IDLE_TIMEOUT of idleness since the
+ * congestion window is likely to have been reduced by then.
  */
 
-#define NXT_SSLTLS_BUFFER_SIZE    4096
+#define NXT_SSLTLS_RECORD_SIZE    1400
+#define NXT_SSLTLS_BUFFER_SIZE    16384
+#define NXT_SSLTLS_BOOST_SIZE     (1024 * 1024)
+#define NXT_SSLTLS_IDLE_TIMEOUT   1000
 
 
 typedef struct nxt_ssltls_conf_s  nxt_ssltls_conf_t;
 
 
 typedef struct {
-    nxt_int_t                     (*server_init)(nxt_ssltls_conf_t *conf);
+    nxt_int_t                     (*server_init)(nxt_task_t *task,
+                                      nxt_ssltls_conf_t *conf, nxt_mp_t *mp);
     nxt_int_t                     (*set_versions)(nxt_ssltls_conf_t *conf);
+
+    /* Tests that a PEM bundle has a certificate chain and its key. */
+    nxt_int_t                     (*chain_check)(nxt_task_t *task,
+                                      u_char *start, size_t length);
 } nxt_ssltls_lib_t;
 
 
@@ -39,13 +53,16 @@ struct nxt_ssltls_conf_s {
 
     const nxt_ssltls_lib_t        *lib;
 
-    char                          *certificate;
-    char                          *certificate_key;
+    /* A certificate chain with a private key in PEM format. */
+    nxt_str_t                     name;
+    nxt_fd_t                      chain_file;
+
     char                          *ciphers;
 
     char                          *ca_certificate;
 
-    size_t                        buffer_size;
+    uint32_t                      session_cache;
+    uint32_t                      session_timeout;
 };
 
 
@@ -66,4 +83,8 @@ extern const nxt_ssltls_lib_t     nxt_polar_lib;
 #endif
 
 
+/* The library used for listening sockets, NULL if none is available. */
+extern const nxt_ssltls_lib_t     *nxt_ssltls_lib;
+
+
 #endif /* _NXT_SSLTLS_H_INCLUDED_ */
@@ -237,3 +237,18 @@ nxt_thread_wait(nxt_thread_handle_t handle)
         nxt_main_log_alert("pthread_join(%PH) failed %E", handle, err);
     }
 }
+
+
+void
+nxt_thread_detach(nxt_thread_handle_t handle)
+{
+    nxt_err_t  err;
+
+    nxt_thread_log_debug("thread detach: %PH", handle);
+
+    err = pthread_detach(handle);
+
+    if (err != 0) {
+        nxt_main_log_alert("pthread_detach(%PH) failed %E", handle, err);
+    }
+}
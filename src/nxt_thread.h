@@ -99,6 +99,7 @@ NXT_EXPORT nxt_thread_t *nxt_thread_init(void);
 NXT_EXPORT void nxt_thread_exit(nxt_thread_t *thr);
 NXT_EXPORT void nxt_thread_cancel(nxt_thread_handle_t handle);
 NXT_EXPORT void nxt_thread_wait(nxt_thread_handle_t handle);
+NXT_EXPORT void nxt_thread_detach(nxt_thread_handle_t handle);
 
 
 #define                                                                       \
@@ -7,11 +7,35 @@
 #include <nxt_main.h>
 
 
+/*
+ * Each thread of a pool has its own work queue and semaphore.  A work is
+ * posted to the queue of the thread bound to the posting event engine,
+ * so engines do not contend for a single queue lock.  If the thread is
+ * busy, an idle thread is woken up to steal the work, or a new thread is
+ * started if there are no idle threads.  A thread which has processed its
+ * own queue steals works from queues of other threads before going to
+ * sleep, so a long blocking work such as a file open or a DNS lookup does
+ * not delay works queued behind it.
+ *
+ * Threads are started on demand up to the maximum number and exit after
+ * the idle timeout, except the last one.
+ */
+
+
 static nxt_int_t nxt_thread_pool_init(nxt_thread_pool_t *tp);
+static nxt_int_t nxt_thread_pool_start(nxt_thread_pool_t *tp,
+    nxt_thread_pool_worker_t *worker);
 static void nxt_thread_pool_exit(nxt_task_t *task, void *obj, void *data);
-static void nxt_thread_pool_start(void *ctx);
 static void nxt_thread_pool_loop(void *ctx);
-static void nxt_thread_pool_wait(nxt_thread_pool_t *tp);
+static nxt_work_handler_t nxt_thread_pool_steal(nxt_thread_pool_t *tp,
+    nxt_thread_pool_worker_t *worker, nxt_task_t **task, void **obj,
+    void **data);
+static void nxt_thread_pool_wakeup(nxt_thread_pool_t *tp,
+    nxt_thread_pool_worker_t *worker);
+static nxt_int_t nxt_thread_pool_wait(nxt_thread_pool_t *tp,
+    nxt_thread_pool_worker_t *worker);
+static nxt_bool_t nxt_thread_pool_idle_exit(nxt_thread_pool_t *tp,
+    nxt_thread_pool_worker_t *worker);
 
 
 nxt_thread_pool_t *
@@ -21,12 +45,16 @@ nxt_thread_pool_create(nxt_uint_t max_threads, nxt_nsec_t timeout,
 {
     nxt_thread_pool_t  *tp;
 
-    tp = nxt_zalloc(sizeof(nxt_thread_pool_t));
+    tp = nxt_zalloc(sizeof(nxt_thread_pool_t)
+                    + max_threads * sizeof(nxt_thread_pool_worker_t));
     if (tp == NULL) {
         return NULL;
     }
 
     tp->max_threads = max_threads;
+    tp->nworkers = max_threads;
+    tp->workers = (nxt_thread_pool_worker_t *) ((u_char *) tp
+                                                + sizeof(nxt_thread_pool_t));
     tp->timeout = timeout;
     tp->engine = engine;
     tp->task.thread = engine->task.thread;
@@ -41,26 +69,75 @@ nxt_thread_pool_create(nxt_uint_t max_threads, nxt_nsec_t timeout,
 nxt_int_t
 nxt_thread_pool_post(nxt_thread_pool_t *tp, nxt_work_t *work)
 {
+    nxt_int_t                 ret;
+    nxt_uint_t                i, n;
+    nxt_bool_t                busy;
+    nxt_thread_t              *thr;
+    nxt_thread_pool_worker_t  *worker;
+
     nxt_thread_log_debug("thread pool post");
 
     if (nxt_slow_path(nxt_thread_pool_init(tp) != NXT_OK)) {
         return NXT_ERROR;
     }
 
-    nxt_locked_work_queue_add(&tp->work_queue, work);
+    thr = nxt_thread();
+
+    if (thr->engine != NULL) {
+        i = thr->engine->id;
+
+    } else {
+        i = nxt_atomic_fetch_add(&tp->next, 1);
+    }
+
+    n = tp->nworkers;
+    worker = &tp->workers[i % n];
+
+    if (tp->max_threads == 0) {
+        /* Only the running threads process works of a destroyed pool. */
+
+        for (i = 0; i < n && !worker->running; i++) {
+            worker = &tp->workers[(worker - tp->workers + 1) % n];
+        }
+    }
+
+    busy = !worker->idle;
+
+    nxt_locked_work_queue_add(&worker->work_queue, work);
+
+    (void) nxt_atomic_fetch_add(&tp->pending, 1);
+
+    ret = nxt_thread_pool_start(tp, worker);
+
+    if (ret == NXT_OK) {
+        return NXT_OK;
+    }
+
+    if (ret == NXT_DECLINED) {
+        (void) nxt_sem_post(&worker->sem);
+    }
 
-    (void) nxt_sem_post(&tp->sem);
+    if (busy) {
+        nxt_thread_pool_wakeup(tp, worker);
+    }
 
     return NXT_OK;
 }
 
 
+nxt_bool_t
+nxt_thread_pool_pending(nxt_thread_pool_t *tp)
+{
+    return (tp->pending != 0);
+}
+
+
 static nxt_int_t
 nxt_thread_pool_init(nxt_thread_pool_t *tp)
 {
-    nxt_int_t            ret;
-    nxt_thread_link_t    *link;
-    nxt_thread_handle_t  handle;
+    nxt_int_t                 ret;
+    nxt_uint_t                i;
+    nxt_thread_pool_worker_t  *worker;
 
     if (nxt_fast_path(tp->ready)) {
         return NXT_OK;
@@ -71,170 +148,320 @@ nxt_thread_pool_init(nxt_thread_pool_t *tp)
         return NXT_ERROR;
     }
 
-    nxt_thread_spin_lock(&tp->work_queue.lock);
+    nxt_thread_spin_lock(&tp->lock);
 
     ret = NXT_OK;
 
     if (!tp->ready) {
 
-        nxt_thread_log_debug("thread pool init");
-
-        (void) nxt_atomic_fetch_add(&tp->threads, 1);
-
-        if (nxt_fast_path(nxt_sem_init(&tp->sem, 0) == NXT_OK)) {
-
-            link = nxt_zalloc(sizeof(nxt_thread_link_t));
+        nxt_thread_log_debug("thread pool init: %ui", tp->nworkers);
 
-            if (nxt_fast_path(link != NULL)) {
-                link->start = nxt_thread_pool_start;
-                link->work.data = tp;
+        for (i = 0; i < tp->nworkers; i++) {
+            worker = &tp->workers[i];
+            worker->thread_pool = tp;
 
-                if (nxt_thread_create(&handle, link) == NXT_OK) {
-                    tp->ready = 1;
-                    goto done;
-                }
+            if (nxt_slow_path(nxt_sem_init(&worker->sem, 0) != NXT_OK)) {
+                break;
             }
-
-            nxt_sem_destroy(&tp->sem);
         }
 
-        (void) nxt_atomic_fetch_add(&tp->threads, -1);
+        if (i != 0) {
+            /* The pool works with fewer threads if some have failed. */
+            tp->nworkers = i;
+            tp->ready = 1;
 
-        ret = NXT_ERROR;
+        } else {
+            ret = NXT_ERROR;
+        }
     }
 
-done:
-
-    nxt_thread_spin_unlock(&tp->work_queue.lock);
+    nxt_thread_spin_unlock(&tp->lock);
 
     return ret;
 }
 
 
-static void
-nxt_thread_pool_start(void *ctx)
+/*
+ * Returns NXT_OK if a thread has been started, NXT_DECLINED if the thread
+ * is already running, and NXT_ERROR if the thread cannot be started.
+ */
+
+static nxt_int_t
+nxt_thread_pool_start(nxt_thread_pool_t *tp, nxt_thread_pool_worker_t *worker)
 {
-    nxt_thread_t       *thr;
-    nxt_thread_pool_t  *tp;
+    nxt_int_t            ret;
+    nxt_thread_link_t    *link;
+    nxt_thread_handle_t  handle;
 
-    tp = ctx;
-    thr = nxt_thread();
+    /*
+     * The lock is acquired even if the thread is running, otherwise
+     * the work just queued may be missed by the thread exiting on the
+     * idle timeout.
+     */
+
+    nxt_thread_spin_lock(&worker->lock);
+
+    ret = NXT_DECLINED;
+
+    if (!worker->running) {
+        ret = NXT_ERROR;
+
+        if (tp->max_threads == 0) {
+            goto done;
+        }
 
-    tp->main = thr->handle;
-    tp->task.thread = thr;
+        link = nxt_zalloc(sizeof(nxt_thread_link_t));
+        if (nxt_slow_path(link == NULL)) {
+            goto done;
+        }
+
+        link->start = nxt_thread_pool_loop;
+        link->work.data = worker;
+
+        worker->running = 1;
+        worker->idle = 0;
+
+        (void) nxt_atomic_fetch_add(&tp->threads, 1);
+
+        if (nxt_thread_create(&handle, link) != NXT_OK) {
+            (void) nxt_atomic_fetch_add(&tp->threads, -1);
+            worker->running = 0;
+            goto done;
+        }
 
-    nxt_thread_pool_loop(ctx);
+        nxt_thread_log_debug("thread pool start %ui", worker - tp->workers);
+
+        ret = NXT_OK;
+    }
+
+done:
+
+    nxt_thread_spin_unlock(&worker->lock);
+
+    return ret;
 }
 
 
 static void
 nxt_thread_pool_loop(void *ctx)
 {
-    void                *obj, *data;
-    nxt_task_t          *task;
-    nxt_thread_t        *thr;
-    nxt_thread_pool_t   *tp;
-    nxt_work_handler_t  handler;
-
-    tp = ctx;
+    void                      *obj, *data;
+    nxt_task_t                *task;
+    nxt_thread_t              *thr;
+    nxt_thread_pool_t         *tp;
+    nxt_work_handler_t        handler;
+    nxt_thread_pool_worker_t  *worker;
+
+    worker = ctx;
+    tp = worker->thread_pool;
     thr = nxt_thread();
 
+    worker->handle = thr->handle;
+    thr->thread_pool = tp;
+
     if (tp->init != NULL) {
         tp->init();
     }
 
     for ( ;; ) {
-        nxt_thread_pool_wait(tp);
-
-        handler = nxt_locked_work_queue_pop(&tp->work_queue, &task, &obj,
+        handler = nxt_locked_work_queue_pop(&worker->work_queue, &task, &obj,
                                             &data);
 
-        if (nxt_fast_path(handler != NULL)) {
-            task->thread = thr;
+        if (handler == NULL) {
+            handler = nxt_thread_pool_steal(tp, worker, &task, &obj, &data);
 
-            nxt_log_debug(thr->log, "locked work queue");
+            if (handler == NULL) {
 
-            handler(task, obj, data);
+                if (nxt_thread_pool_wait(tp, worker) != NXT_OK) {
+                    nxt_thread_log_debug("thread pool idle exit");
+
+                    /* No one waits for the thread exit. */
+                    nxt_thread_detach(thr->handle);
+
+                    nxt_thread_exit(thr);
+                    nxt_unreachable();
+                }
+
+                continue;
+            }
         }
 
+        (void) nxt_atomic_fetch_add(&tp->pending, -1);
+
+        task->thread = thr;
+
+        nxt_log_debug(thr->log, "locked work queue");
+
+        handler(task, obj, data);
+
         thr->log = &nxt_main_log;
     }
 }
 
 
-static void
-nxt_thread_pool_wait(nxt_thread_pool_t *tp)
+static nxt_work_handler_t
+nxt_thread_pool_steal(nxt_thread_pool_t *tp, nxt_thread_pool_worker_t *worker,
+    nxt_task_t **task, void **obj, void **data)
 {
-    nxt_err_t            err;
-    nxt_thread_t         *thr;
-    nxt_atomic_uint_t    waiting, threads;
-    nxt_thread_link_t    *link;
-    nxt_thread_handle_t  handle;
-
-    thr = nxt_thread();
+    nxt_uint_t                i, n;
+    nxt_work_handler_t        handler;
+    nxt_thread_pool_worker_t  *victim;
 
-    nxt_log_debug(thr->log, "thread pool wait");
+    if (tp->pending == 0) {
+        return NULL;
+    }
 
-    (void) nxt_atomic_fetch_add(&tp->waiting, 1);
+    n = tp->nworkers;
+    victim = worker;
 
-    for ( ;; ) {
-        err = nxt_sem_wait(&tp->sem, tp->timeout);
+    for (i = 1; i < n; i++) {
+        victim = &tp->workers[(victim - tp->workers + 1) % n];
 
-        if (err == 0) {
-            waiting = nxt_atomic_fetch_add(&tp->waiting, -1);
-            break;
+        if (victim->work_queue.head == NULL) {
+            continue;
         }
 
-        if (err == NXT_ETIMEDOUT) {
-            if (nxt_thread_handle_equal(thr->handle, tp->main)) {
-                continue;
-            }
+        handler = nxt_locked_work_queue_pop(&victim->work_queue, task, obj,
+                                            data);
+
+        if (handler != NULL) {
+            nxt_thread_log_debug("thread pool steal from %ui",
+                                 victim - tp->workers);
+            return handler;
         }
+    }
 
-        (void) nxt_atomic_fetch_add(&tp->waiting, -1);
-        (void) nxt_atomic_fetch_add(&tp->threads, -1);
+    return NULL;
+}
 
-        nxt_thread_exit(thr);
-        nxt_unreachable();
-    }
 
-    nxt_log_debug(thr->log, "thread pool awake, waiting: %A", waiting);
+static void
+nxt_thread_pool_wakeup(nxt_thread_pool_t *tp, nxt_thread_pool_worker_t *worker)
+{
+    nxt_uint_t                i, n;
+    nxt_thread_pool_worker_t  *other;
 
-    if (waiting > 1) {
-        return;
+    n = tp->nworkers;
+    other = worker;
+
+    for (i = 1; i < n; i++) {
+        other = &tp->workers[(other - tp->workers + 1) % n];
+
+        if (other->idle && nxt_atomic_cmp_set(&other->idle, 1, 0)) {
+            (void) nxt_sem_post(&other->sem);
+            return;
+        }
     }
 
-    do {
-        threads = tp->threads;
+    /* There are no idle threads, a new one will steal the work. */
+
+    for (i = 1; i < n; i++) {
+        other = &tp->workers[(other - tp->workers + 1) % n];
 
-        if (threads >= tp->max_threads) {
+        if (!other->running) {
+            (void) nxt_thread_pool_start(tp, other);
             return;
         }
+    }
+}
 
-    } while (!nxt_atomic_cmp_set(&tp->threads, threads, threads + 1));
 
-    link = nxt_zalloc(sizeof(nxt_thread_link_t));
+/*
+ * Returns NXT_OK if the thread has been woken up, or NXT_DECLINED
+ * if the thread should exit after the idle timeout.
+ */
 
-    if (nxt_fast_path(link != NULL)) {
-        link->start = nxt_thread_pool_loop;
-        link->work.data = tp;
+static nxt_int_t
+nxt_thread_pool_wait(nxt_thread_pool_t *tp, nxt_thread_pool_worker_t *worker)
+{
+    nxt_err_t  err;
 
-        if (nxt_thread_create(&handle, link) != NXT_OK) {
+    nxt_thread_log_debug("thread pool wait");
+
+    (void) nxt_atomic_cmp_set(&worker->idle, 0, 1);
+
+    /*
+     * A work may have been posted to a busy thread after the last steal
+     * attempt but before the thread has been marked as idle.
+     */
+
+    if (tp->pending != 0 && nxt_atomic_cmp_set(&worker->idle, 1, 0)) {
+        return NXT_OK;
+    }
+
+    err = nxt_sem_wait(&worker->sem, tp->timeout);
+
+    if (err == NXT_ETIMEDOUT
+        && nxt_atomic_cmp_set(&worker->idle, 1, 0)
+        && nxt_thread_pool_idle_exit(tp, worker))
+    {
+        return NXT_DECLINED;
+    }
+
+    worker->idle = 0;
+
+    if (err != 0 && err != NXT_ETIMEDOUT) {
+        nxt_thread_log_alert("thread pool wait failed %E", err);
+    }
+
+    return NXT_OK;
+}
+
+
+/*
+ * The last thread and the threads of a pool being destroyed do not exit
+ * on the idle timeout.  A thread with a work queued after the timeout
+ * continues, otherwise the work poster starts a new thread.
+ */
+
+static nxt_bool_t
+nxt_thread_pool_idle_exit(nxt_thread_pool_t *tp,
+    nxt_thread_pool_worker_t *worker)
+{
+    nxt_bool_t  exit;
+
+    exit = 0;
+
+    nxt_thread_spin_lock(&tp->lock);
+
+    if (tp->max_threads != 0 && tp->threads > 1) {
+        nxt_thread_spin_lock(&worker->lock);
+
+        if (worker->work_queue.head == NULL) {
+            worker->running = 0;
             (void) nxt_atomic_fetch_add(&tp->threads, -1);
+            exit = 1;
         }
+
+        nxt_thread_spin_unlock(&worker->lock);
     }
+
+    nxt_thread_spin_unlock(&tp->lock);
+
+    return exit;
 }
 
 
 void
 nxt_thread_pool_destroy(nxt_thread_pool_t *tp)
 {
+    nxt_uint_t    i;
     nxt_thread_t  *thr;
 
     thr = nxt_thread();
 
     nxt_log_debug(thr->log, "thread pool destroy: %A", tp->ready);
 
+    if (tp->ready && tp->threads == 0) {
+        /* No thread has been started. */
+
+        for (i = 0; i < tp->nworkers; i++) {
+            nxt_sem_destroy(&tp->workers[i].sem);
+        }
+
+        tp->ready = 0;
+    }
+
     if (!tp->ready) {
         nxt_work_queue_add(&thr->engine->fast_work_queue, tp->exit,
                            &tp->engine->task, tp, NULL);
@@ -242,8 +469,11 @@ nxt_thread_pool_destroy(nxt_thread_pool_t *tp)
     }
 
     if (tp->max_threads != 0) {
-        /* Disable new threads creation and mark a pool as being destroyed. */
+        /* Mark a pool as being destroyed, so idle threads do not exit. */
+
+        nxt_thread_spin_lock(&tp->lock);
         tp->max_threads = 0;
+        nxt_thread_spin_unlock(&tp->lock);
 
         nxt_work_set(&tp->work, nxt_thread_pool_exit, &tp->task, tp, NULL);
 
@@ -266,6 +496,7 @@ nxt_thread_pool_destroy(nxt_thread_pool_t *tp)
 static void
 nxt_thread_pool_exit(nxt_task_t *task, void *obj, void *data)
 {
+    nxt_uint_t           i;
     nxt_thread_t         *thread;
     nxt_thread_pool_t    *tp;
     nxt_atomic_uint_t    threads;
@@ -281,6 +512,20 @@ nxt_thread_pool_exit(nxt_task_t *task, void *obj, void *data)
         nxt_thread_wait(handle);
     }
 
+    /*
+     * The exit work is posted to the next running thread, works left
+     * in the exited thread queue are stolen by the running threads.
+     */
+
+    for (i = 0; i < tp->nworkers; i++) {
+        if (tp->workers[i].running
+            && nxt_thread_handle_equal(tp->workers[i].handle, thread->handle))
+        {
+            tp->workers[i].running = 0;
+            break;
+        }
+    }
+
     threads = nxt_atomic_fetch_add(&tp->threads, -1);
 
     nxt_debug(task, "thread pool threads: %A", threads);
@@ -294,7 +539,9 @@ nxt_thread_pool_exit(nxt_task_t *task, void *obj, void *data)
     } else {
         nxt_debug(task, "thread pool destroy");
 
-        nxt_sem_destroy(&tp->sem);
+        for (i = 0; i < tp->nworkers; i++) {
+            nxt_sem_destroy(&tp->workers[i].sem);
+        }
 
         nxt_work_set(&tp->work, tp->exit, &tp->engine->task, tp,
                      (void *) (uintptr_t) thread->handle);
@@ -11,25 +11,39 @@
 typedef void (*nxt_thread_pool_init_t)(void);
 
 
-struct nxt_thread_pool_s {
-    nxt_atomic_t             ready;
-    nxt_atomic_t             waiting;
-    nxt_atomic_t             threads;
-    nxt_uint_t               max_threads;
-
+typedef struct {
+    nxt_locked_work_queue_t  work_queue;
     nxt_sem_t                sem;
-    nxt_nsec_t               timeout;
 
-    nxt_work_t               work;
-    nxt_task_t               task;
+    /* The lock serializes the thread start and the idle thread exit. */
+    nxt_thread_spinlock_t    lock;
+    nxt_atomic_t             running;
+    nxt_atomic_t             idle;
 
-    nxt_locked_work_queue_t  work_queue;
+    nxt_thread_handle_t      handle;
+    nxt_thread_pool_t        *thread_pool;
+} nxt_thread_pool_worker_t;
+
+
+struct nxt_thread_pool_s {
+    nxt_atomic_t              ready;
+    nxt_atomic_t              threads;
+    nxt_atomic_t              next;
+    nxt_atomic_t              pending;
+    nxt_uint_t                max_threads;
+
+    nxt_thread_spinlock_t     lock;
+    nxt_nsec_t                timeout;
+
+    nxt_work_t                work;
+    nxt_task_t                task;
 
-    nxt_thread_handle_t      main;
+    nxt_uint_t                nworkers;
+    nxt_thread_pool_worker_t  *workers;
 
-    nxt_event_engine_t       *engine;
-    nxt_thread_pool_init_t   init;
-    nxt_work_handler_t       exit;
+    nxt_event_engine_t        *engine;
+    nxt_thread_pool_init_t    init;
+    nxt_work_handler_t        exit;
 };
 
 
@@ -39,6 +53,7 @@ NXT_EXPORT nxt_thread_pool_t *nxt_thread_pool_create(nxt_uint_t max_threads,
 NXT_EXPORT void nxt_thread_pool_destroy(nxt_thread_pool_t *tp);
 NXT_EXPORT nxt_int_t nxt_thread_pool_post(nxt_thread_pool_t *tp,
     nxt_work_t *work);
+NXT_EXPORT nxt_bool_t nxt_thread_pool_pending(nxt_thread_pool_t *tp);
 
 
 #endif /* _NXT_UNIX_THREAD_POOL_H_INCLUDED_ */
@@ -11,6 +11,16 @@
  * Timer operations are batched in the changes array to improve instruction
  * and data cache locality of rbtree operations.
  *
+ * Timers are stored either in rbtree or in hierarchical timer wheel.
+ * The wheel has four levels of 256 slots, a level 0 slot spans one
+ * millisecond, a level 1 slot spans 256 milliseconds, and so on.  A timer
+ * is linked to a slot of the lowest level covering its time and is moved
+ * to lower levels as the wheel reaches the slot, so insertion and deletion
+ * do not depend on number of timers.  Nonempty slots are marked in bitmaps
+ * to skip empty slots and to find the nearest timer quickly.  The nearest
+ * time is approximate for upper levels, so event poll may return earlier
+ * than any timer expires.
+ *
  * nxt_timer_add() adds or modify a timer.
  *
  * nxt_timer_disable() disables a timer.
@@ -19,8 +29,66 @@
  * changes in the changes array or 0 otherwise.
  */
 
+#define NXT_TIMER_WHEEL_BITS    8
+#define NXT_TIMER_WHEEL_SIZE    (1 << NXT_TIMER_WHEEL_BITS)
+#define NXT_TIMER_WHEEL_MASK    (NXT_TIMER_WHEEL_SIZE - 1)
+#define NXT_TIMER_WHEEL_LEVELS  4
+#define NXT_TIMER_WHEEL_SLOTS   (NXT_TIMER_WHEEL_LEVELS * NXT_TIMER_WHEEL_SIZE)
+#define NXT_TIMER_WHEEL_WORDS   (NXT_TIMER_WHEEL_SIZE / 32)
+
+
+struct nxt_timer_wheel_s {
+    /* The next millisecond to process. */
+    nxt_msec_t                next;
+
+    uint32_t                  map[NXT_TIMER_WHEEL_SLOTS / 32];
+
+    /* Already expired timers, they are expired without poll waiting. */
+    nxt_rbtree_node_t         expired;
+
+    /*
+     * Slots are sentinels of circular lists linked by left and right
+     * links of timer nodes.
+     */
+    nxt_rbtree_node_t         slots[NXT_TIMER_WHEEL_SLOTS];
+};
+
+
+#if (NXT_HAVE_BUILTIN_CTZ)
+
+#define nxt_timer_wheel_ctz(bits)                                             \
+    __builtin_ctz(bits)
+
+#else
+
+static nxt_uint_t
+nxt_timer_wheel_ctz(uint32_t bits)
+{
+    nxt_uint_t  n;
+
+    for (n = 0; (bits & 1) == 0; n++) {
+        bits >>= 1;
+    }
+
+    return n;
+}
+
+#endif
+
+
 static intptr_t nxt_timer_rbtree_compare(nxt_rbtree_node_t *node1,
     nxt_rbtree_node_t *node2);
+static nxt_timer_wheel_t *nxt_timer_wheel_create(nxt_msec_t now);
+static void nxt_timer_wheel_insert(nxt_timer_wheel_t *wheel,
+    nxt_timer_t *timer);
+static void nxt_timer_wheel_delete(nxt_timer_wheel_t *wheel,
+    nxt_timer_t *timer);
+static nxt_int_t nxt_timer_wheel_search(nxt_timer_wheel_t *wheel,
+    nxt_uint_t level, nxt_uint_t index);
+static void nxt_timer_wheel_cascade(nxt_timer_wheel_t *wheel);
+static nxt_msec_t nxt_timer_wheel_find(nxt_timers_t *timers);
+static void nxt_timer_wheel_expire(nxt_timers_t *timers, nxt_msec_t now);
+static void nxt_timer_expired(nxt_timer_t *timer);
 static void nxt_timer_change(nxt_event_engine_t *engine, nxt_timer_t *timer,
     nxt_timer_operation_t change, nxt_msec_t time);
 static void nxt_timer_changes_commit(nxt_event_engine_t *engine);
@@ -28,7 +96,7 @@ static void nxt_timer_handler(nxt_task_t *task, void *obj, void *data);
 
 
 nxt_int_t
-nxt_timers_init(nxt_timers_t *timers, nxt_uint_t mchanges)
+nxt_timers_init(nxt_timers_t *timers, nxt_uint_t mchanges, nxt_bool_t wheel)
 {
     nxt_rbtree_init(&timers->tree, nxt_timer_rbtree_compare);
 
@@ -36,11 +104,22 @@ nxt_timers_init(nxt_timers_t *timers, nxt_uint_t mchanges)
 
     timers->changes = nxt_malloc(sizeof(nxt_timer_change_t) * mchanges);
 
-    if (nxt_fast_path(timers->changes != NULL)) {
-        return NXT_OK;
+    if (nxt_slow_path(timers->changes == NULL)) {
+        return NXT_ERROR;
+    }
+
+    timers->wheel = NULL;
+
+    if (wheel) {
+        timers->wheel = nxt_timer_wheel_create(timers->now);
+
+        if (nxt_slow_path(timers->wheel == NULL)) {
+            nxt_free(timers->changes);
+            return NXT_ERROR;
+        }
     }
 
-    return NXT_ERROR;
+    return NXT_OK;
 }
 
 
@@ -62,6 +141,311 @@ nxt_timer_rbtree_compare(nxt_rbtree_node_t *node1, nxt_rbtree_node_t *node2)
 }
 
 
+static nxt_timer_wheel_t *
+nxt_timer_wheel_create(nxt_msec_t now)
+{
+    nxt_uint_t         i;
+    nxt_rbtree_node_t  *slot;
+    nxt_timer_wheel_t  *wheel;
+
+    wheel = nxt_zalloc(sizeof(nxt_timer_wheel_t));
+    if (nxt_slow_path(wheel == NULL)) {
+        return NULL;
+    }
+
+    wheel->next = now;
+
+    wheel->expired.left = &wheel->expired;
+    wheel->expired.right = &wheel->expired;
+
+    for (i = 0; i < NXT_TIMER_WHEEL_SLOTS; i++) {
+        slot = &wheel->slots[i];
+
+        slot->left = slot;
+        slot->right = slot;
+    }
+
+    return wheel;
+}
+
+
+static void
+nxt_timer_wheel_insert(nxt_timer_wheel_t *wheel, nxt_timer_t *timer)
+{
+    int32_t            diff;
+    nxt_uint_t         n, level;
+    nxt_rbtree_node_t  *node, *slot;
+
+    diff = nxt_msec_diff(timer->time, wheel->next);
+
+    if (diff < 0) {
+        slot = &wheel->expired;
+        n = NXT_TIMER_WHEEL_SLOTS;
+
+    } else {
+        for (level = 0; level < NXT_TIMER_WHEEL_LEVELS - 1; level++) {
+            if ((uint32_t) diff < (1U << ((level + 1) * NXT_TIMER_WHEEL_BITS)))
+            {
+                break;
+            }
+        }
+
+        n = (timer->time >> (level * NXT_TIMER_WHEEL_BITS))
+            & NXT_TIMER_WHEEL_MASK;
+
+        n += level * NXT_TIMER_WHEEL_SIZE;
+        slot = &wheel->slots[n];
+    }
+
+    node = (nxt_rbtree_node_t *) &timer->node;
+
+    node->left = slot;
+    node->right = slot->right;
+    node->parent = slot;
+
+    slot->right->left = node;
+    slot->right = node;
+
+    if (n != NXT_TIMER_WHEEL_SLOTS) {
+        wheel->map[n / 32] |= 1U << (n % 32);
+    }
+}
+
+
+static void
+nxt_timer_wheel_delete(nxt_timer_wheel_t *wheel, nxt_timer_t *timer)
+{
+    nxt_uint_t         n;
+    nxt_rbtree_node_t  *node, *slot;
+
+    node = (nxt_rbtree_node_t *) &timer->node;
+    slot = node->parent;
+
+    node->right->left = node->left;
+    node->left->right = node->right;
+
+    if (slot->left == slot && slot != &wheel->expired) {
+        n = slot - wheel->slots;
+
+        wheel->map[n / 32] &= ~(1U << (n % 32));
+    }
+}
+
+
+/*
+ * nxt_timer_wheel_search() returns a distance from the index to the nearest
+ * nonempty slot of the level wrapping around the level end, or -1 if all
+ * slots of the level are empty.
+ */
+
+static nxt_int_t
+nxt_timer_wheel_search(nxt_timer_wheel_t *wheel, nxt_uint_t level,
+    nxt_uint_t index)
+{
+    uint32_t    bits, *map;
+    nxt_uint_t  i, n;
+
+    map = &wheel->map[level * NXT_TIMER_WHEEL_WORDS];
+
+    n = index / 32;
+    bits = map[n] & (0xFFFFFFFF << (index % 32));
+
+    for (i = 0; i < NXT_TIMER_WHEEL_WORDS; i++) {
+
+        if (bits != 0) {
+            return (n * 32 + nxt_timer_wheel_ctz(bits) - index)
+                   & NXT_TIMER_WHEEL_MASK;
+        }
+
+        n = (n + 1) % NXT_TIMER_WHEEL_WORDS;
+        bits = map[n];
+    }
+
+    bits &= ~(0xFFFFFFFF << (index % 32));
+
+    if (bits != 0) {
+        return (n * 32 + nxt_timer_wheel_ctz(bits) - index)
+               & NXT_TIMER_WHEEL_MASK;
+    }
+
+    return -1;
+}
+
+
+/*
+ * The cascade moves timers of the upper levels slots which have been
+ * reached by the wheel to lower levels.  It is called when the wheel
+ * reaches the start of a level 0 revolution.
+ */
+
+static void
+nxt_timer_wheel_cascade(nxt_timer_wheel_t *wheel)
+{
+    nxt_uint_t         n, level, shift;
+    nxt_timer_t        *timer;
+    nxt_rbtree_node_t  *slot, list;
+
+    for (level = 1; level < NXT_TIMER_WHEEL_LEVELS; level++) {
+        shift = level * NXT_TIMER_WHEEL_BITS;
+        n = (wheel->next >> shift) & NXT_TIMER_WHEEL_MASK;
+
+        slot = &wheel->slots[level * NXT_TIMER_WHEEL_SIZE + n];
+
+        if (slot->left != slot) {
+            /* Move the slot list to the temporary list. */
+
+            list.left = slot->left;
+            list.right = slot->right;
+            list.left->right = &list;
+            list.right->left = &list;
+
+            slot->left = slot;
+            slot->right = slot;
+
+            n += level * NXT_TIMER_WHEEL_SIZE;
+            wheel->map[n / 32] &= ~(1U << (n % 32));
+
+            while (list.left != &list) {
+                timer = (nxt_timer_t *) list.left;
+
+                list.left = list.left->left;
+
+                nxt_timer_wheel_insert(wheel, timer);
+            }
+        }
+
+        if (((wheel->next >> shift) & NXT_TIMER_WHEEL_MASK) != 0) {
+            break;
+        }
+    }
+}
+
+
+static nxt_msec_t
+nxt_timer_wheel_find(nxt_timers_t *timers)
+{
+    int32_t            time;
+    uint32_t           min, diff;
+    nxt_int_t          n;
+    nxt_msec_t         start;
+    nxt_uint_t         level, shift;
+    nxt_timer_wheel_t  *wheel;
+
+    wheel = timers->wheel;
+
+    if (wheel->expired.left != &wheel->expired) {
+        timers->minimum = timers->now;
+        return 0;
+    }
+
+    min = 0xFFFFFFFF;
+
+    n = nxt_timer_wheel_search(wheel, 0, wheel->next & NXT_TIMER_WHEEL_MASK);
+
+    if (n >= 0) {
+        min = n;
+    }
+
+    /*
+     * Timers of an upper level slot cannot expire before the wheel
+     * reaches the slot start and cascades them to lower levels.
+     */
+
+    for (level = 1; level < NXT_TIMER_WHEEL_LEVELS; level++) {
+        shift = level * NXT_TIMER_WHEEL_BITS;
+        start = (wheel->next >> shift) + 1;
+
+        n = nxt_timer_wheel_search(wheel, level,
+                                   start & NXT_TIMER_WHEEL_MASK);
+
+        if (n >= 0) {
+            diff = (nxt_msec_t) ((start + n) << shift) - wheel->next;
+            min = nxt_min(min, diff);
+        }
+    }
+
+    if (min != 0xFFFFFFFF) {
+        time = wheel->next + min;
+        timers->minimum = time;
+
+        nxt_thread_log_debug("timer wheel found minimum: %D:%M",
+                             time, timers->now);
+
+        time = nxt_msec_diff(time, timers->now);
+
+        return (nxt_msec_t) nxt_max(time, 0);
+    }
+
+    /* Set minimum time one day ahead. */
+    timers->minimum = timers->now + 24 * 60 * 60 * 1000;
+
+    return NXT_INFINITE_MSEC;
+}
+
+
+static void
+nxt_timer_wheel_expire(nxt_timers_t *timers, nxt_msec_t now)
+{
+    uint32_t           left;
+    nxt_int_t          n;
+    nxt_uint_t         index;
+    nxt_timer_t        *timer;
+    nxt_rbtree_node_t  *slot;
+    nxt_timer_wheel_t  *wheel;
+
+    wheel = timers->wheel;
+
+    slot = &wheel->expired;
+
+    while (slot->left != slot) {
+        timer = (nxt_timer_t *) slot->left;
+
+        nxt_timer_wheel_delete(wheel, timer);
+        nxt_timer_in_tree_clear(timer);
+
+        nxt_timer_expired(timer);
+    }
+
+                   /* wheel->next <= now */
+    while (nxt_msec_diff(wheel->next , now) <= 0) {
+        index = wheel->next & NXT_TIMER_WHEEL_MASK;
+
+        if (index == 0) {
+            nxt_timer_wheel_cascade(wheel);
+        }
+
+        /* Skip empty slots up to the current time or the level end. */
+
+        n = nxt_timer_wheel_search(wheel, 0, index);
+
+        if (n != 0) {
+            if (n < 0 || index + n >= NXT_TIMER_WHEEL_SIZE) {
+                n = NXT_TIMER_WHEEL_SIZE - index;
+            }
+
+            left = now - wheel->next + 1;
+
+            wheel->next += nxt_min((uint32_t) n, left);
+
+            continue;
+        }
+
+        wheel->next++;
+
+        slot = &wheel->slots[index];
+
+        while (slot->left != slot) {
+            timer = (nxt_timer_t *) slot->left;
+
+            nxt_timer_wheel_delete(wheel, timer);
+            nxt_timer_in_tree_clear(timer);
+
+            nxt_timer_expired(timer);
+        }
+    }
+}
+
+
 void
 nxt_timer_add(nxt_event_engine_t *engine, nxt_timer_t *timer,
     nxt_msec_t timeout)
@@ -161,6 +545,30 @@ nxt_timer_change(nxt_event_engine_t *engine, nxt_timer_t *timer,
 }
 
 
+nxt_inline void
+nxt_timers_insert(nxt_timers_t *timers, nxt_timer_t *timer)
+{
+    if (timers->wheel != NULL) {
+        nxt_timer_wheel_insert(timers->wheel, timer);
+
+    } else {
+        nxt_rbtree_insert(&timers->tree, &timer->node);
+    }
+}
+
+
+nxt_inline void
+nxt_timers_delete(nxt_timers_t *timers, nxt_timer_t *timer)
+{
+    if (timers->wheel != NULL) {
+        nxt_timer_wheel_delete(timers->wheel, timer);
+
+    } else {
+        nxt_rbtree_delete(&timers->tree, &timer->node);
+    }
+}
+
+
 static void
 nxt_timer_changes_commit(nxt_event_engine_t *engine)
 {
@@ -201,14 +609,14 @@ nxt_timer_changes_commit(nxt_event_engine_t *engine)
                 nxt_debug(timer->task, "timer rbtree delete: %M:%d",
                           timer->time, timer->state);
 
-                nxt_rbtree_delete(&timers->tree, &timer->node);
+                nxt_timers_delete(timers, timer);
             }
 
             timer->time = ch->time;
 
             nxt_debug(timer->task, "timer rbtree insert: %M", timer->time);
 
-            nxt_rbtree_insert(&timers->tree, &timer->node);
+            nxt_timers_insert(timers, timer);
             nxt_timer_in_tree_set(timer);
             state = NXT_TIMER_WAITING;
 
@@ -219,7 +627,7 @@ nxt_timer_changes_commit(nxt_event_engine_t *engine)
                 nxt_debug(timer->task, "timer rbtree delete: %M:%d",
                           timer->time, timer->state);
 
-                nxt_rbtree_delete(&timers->tree, &timer->node);
+                nxt_timers_delete(timers, timer);
                 nxt_timer_in_tree_clear(timer);
             }
 
@@ -253,6 +661,10 @@ nxt_timer_find(nxt_event_engine_t *engine)
         nxt_timer_changes_commit(engine);
     }
 
+    if (timers->wheel != NULL) {
+        return nxt_timer_wheel_find(timers);
+    }
+
     tree = &timers->tree;
 
     for (node = nxt_rbtree_min(tree);
@@ -303,6 +715,15 @@ nxt_timer_expire(nxt_event_engine_t *engine, nxt_msec_t now)
     nxt_debug(&engine->task, "timer expire minimum: %M:%M",
               timers->minimum, now);
 
+    if (timers->wheel != NULL) {
+        /*
+         * The wheel is advanced on each call to keep it close to the
+         * current time, empty slots are skipped using the bitmaps.
+         */
+        nxt_timer_wheel_expire(timers, now);
+        return;
+    }
+
                    /* timers->minimum > now */
     if (nxt_msec_diff(timers->minimum , now) > 0) {
         return;
@@ -329,12 +750,19 @@ nxt_timer_expire(nxt_event_engine_t *engine, nxt_msec_t now)
         nxt_rbtree_delete(tree, &timer->node);
         nxt_timer_in_tree_clear(timer);
 
-        if (timer->state != NXT_TIMER_DISABLED) {
-            timer->state = NXT_TIMER_ENQUEUED;
+        nxt_timer_expired(timer);
+    }
+}
 
-            nxt_work_queue_add(timer->work_queue, nxt_timer_handler,
-                               timer->task, timer, NULL);
-        }
+
+static void
+nxt_timer_expired(nxt_timer_t *timer)
+{
+    if (timer->state != NXT_TIMER_DISABLED) {
+        timer->state = NXT_TIMER_ENQUEUED;
+
+        nxt_work_queue_add(timer->work_queue, nxt_timer_handler,
+                           timer->task, timer, NULL);
     }
 }
 
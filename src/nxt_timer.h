@@ -55,8 +55,13 @@ typedef struct {
 } nxt_timer_change_t;
 
 
+typedef struct nxt_timer_wheel_s  nxt_timer_wheel_t;
+
+
 typedef struct {
     nxt_rbtree_t              tree;
+    /* The timer wheel is used instead of the rbtree if it is not NULL. */
+    nxt_timer_wheel_t         *wheel;
 
     /* An overflown milliseconds counter. */
     nxt_msec_t                now;
@@ -75,7 +80,8 @@ typedef struct {
 
 /*
  * When timer resides in rbtree all links of its node are not NULL.
- * A parent link is the nearst to other timer flags.
+ * A parent link is the nearst to other timer flags.  A timer in the
+ * timer wheel has the parent link pointed to its wheel slot.
  */
 
 #define nxt_timer_is_in_tree(timer)                                           \
@@ -88,7 +94,8 @@ typedef struct {
     (timer)->node.parent = NULL
 
 
-nxt_int_t nxt_timers_init(nxt_timers_t *timers, nxt_uint_t mchanges);
+nxt_int_t nxt_timers_init(nxt_timers_t *timers, nxt_uint_t mchanges,
+    nxt_bool_t wheel);
 nxt_msec_t nxt_timer_find(nxt_event_engine_t *engine);
 void nxt_timer_expire(nxt_event_engine_t *engine, nxt_msec_t now);
 
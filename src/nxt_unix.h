@@ -234,6 +234,14 @@
 #include <sys/sendfile.h>
 #endif
 
+#if (NXT_HAVE_X86_SIMD)
+#include <immintrin.h>
+#endif
+
+#if (NXT_HAVE_REUSEPORT_CBPF)
+#include <linux/filter.h>
+#endif
+
 
 #if (NXT_TEST_BUILD)
 #include <nxt_test_build.h>
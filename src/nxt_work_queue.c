@@ -229,6 +229,8 @@ nxt_work_queue_pop(nxt_work_queue_t *wq, nxt_task_t **task, void **obj,
 void
 nxt_locked_work_queue_add(nxt_locked_work_queue_t *lwq, nxt_work_t *work)
 {
+    work->next = NULL;
+
     nxt_thread_spin_lock(&lwq->lock);
 
     if (lwq->tail != NULL) {
@@ -309,3 +311,59 @@ nxt_locked_work_queue_move(nxt_thread_t *thr, nxt_locked_work_queue_t *lwq,
         work = work->next;
     }
 }
+
+
+/*
+ * Push a work to an atomic work queue head.  It returns 1 if the queue has
+ * been empty, so the consumer should be notified, or 0 if a notification
+ * has been already sent by a producer of a previous work and the consumer
+ * has not moved the works yet.
+ */
+
+nxt_bool_t
+nxt_atomic_work_queue_add(nxt_atomic_work_queue_t *awq, nxt_work_t *work)
+{
+    nxt_atomic_uint_t  head;
+
+    do {
+        head = awq->head;
+        work->next = (nxt_work_t *) head;
+
+    } while (!nxt_atomic_cmp_set(&awq->head, head, (nxt_atomic_uint_t) work));
+
+    return (head == 0);
+}
+
+
+/*
+ * Move all works from an atomic work queue to a usual work queue.
+ * The works are pushed in reverse order, so the list is reversed
+ * to process them in order of addition.
+ */
+
+void
+nxt_atomic_work_queue_move(nxt_thread_t *thr, nxt_atomic_work_queue_t *awq,
+    nxt_work_queue_t *wq)
+{
+    nxt_work_t  *work, *next, *prev;
+
+    work = (nxt_work_t *) nxt_atomic_xchg(&awq->head, 0);
+
+    prev = NULL;
+
+    while (work != NULL) {
+        next = work->next;
+        work->next = prev;
+        prev = work;
+        work = next;
+    }
+
+    for (work = prev; work != NULL; work = next) {
+        next = work->next;
+
+        work->task->thread = thr;
+
+        nxt_work_queue_add(wq, work->handler, work->task,
+                           work->obj, work->data);
+    }
+}
@@ -82,6 +82,17 @@ typedef struct {
 } nxt_locked_work_queue_t;
 
 
+/*
+ * A lock-free multiple producers single consumer queue.  The works are
+ * linked by their own next links, so a work may not be reused until it
+ * has been moved to a usual work queue.
+ */
+
+typedef struct {
+    nxt_atomic_t                head;        /* of nxt_work_t */
+} nxt_atomic_work_queue_t;
+
+
 NXT_EXPORT void nxt_work_queue_cache_create(nxt_work_queue_cache_t *cache,
     size_t chunk_size);
 NXT_EXPORT void nxt_work_queue_cache_destroy(nxt_work_queue_cache_t *cache);
@@ -124,5 +135,10 @@ NXT_EXPORT nxt_work_handler_t nxt_locked_work_queue_pop(
 NXT_EXPORT void nxt_locked_work_queue_move(nxt_thread_t *thr,
     nxt_locked_work_queue_t *lwq, nxt_work_queue_t *wq);
 
+NXT_EXPORT nxt_bool_t nxt_atomic_work_queue_add(nxt_atomic_work_queue_t *awq,
+    nxt_work_t *work);
+NXT_EXPORT void nxt_atomic_work_queue_move(nxt_thread_t *thr,
+    nxt_atomic_work_queue_t *awq, nxt_work_queue_t *wq);
+
 
 #endif /* _NXT_WORK_QUEUE_H_INCLUDED_ */
@@ -27,6 +27,9 @@ nxt_port_handlers_t  nxt_app_process_port_handlers = {
     .mmap         = nxt_port_mmap_handler,
     .data         = nxt_app_data_handler,
     .remove_pid   = nxt_port_remove_pid_handler,
+    .body         = nxt_app_body_handler,
+    .ring         = nxt_port_ring_handler,
+    .credit       = nxt_app_credit_handler,
 };
 
 
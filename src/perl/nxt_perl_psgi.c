@@ -24,13 +24,6 @@ typedef struct {
 } nxt_perl_psgi_input_t;
 
 
-nxt_inline nxt_int_t nxt_perl_psgi_write(nxt_task_t *task, nxt_app_wmsg_t *wmsg,
-    const u_char *data, size_t len,
-    nxt_bool_t flush, nxt_bool_t last);
-
-nxt_inline nxt_int_t nxt_perl_psgi_http_write_status_str(nxt_task_t *task,
-    nxt_app_wmsg_t *wmsg, nxt_str_t *http_status);
-
 static long nxt_perl_psgi_io_input_read(PerlInterpreter *my_perl,
     nxt_perl_psgi_io_arg_t *arg, void *vbuf, size_t length);
 static long nxt_perl_psgi_io_input_write(PerlInterpreter *my_perl,
@@ -84,7 +77,7 @@ static u_char *nxt_perl_psgi_module_create(nxt_task_t *task,
 static nxt_str_t nxt_perl_psgi_result_status(PerlInterpreter *my_perl,
     SV *result);
 static nxt_int_t nxt_perl_psgi_result_head(PerlInterpreter *my_perl,
-    SV *sv_head, nxt_task_t *task, nxt_app_wmsg_t *wmsg);
+    SV *sv_head, nxt_task_t *task, nxt_app_wmsg_t *wmsg, nxt_uint_t status);
 static nxt_int_t nxt_perl_psgi_result_body(PerlInterpreter *my_perl,
     SV *result, nxt_task_t *task, nxt_app_wmsg_t *wmsg);
 static nxt_int_t nxt_perl_psgi_result_body_ref(PerlInterpreter *my_perl,
@@ -120,54 +113,6 @@ NXT_EXPORT nxt_application_module_t  nxt_app_module = {
 };
 
 
-nxt_inline nxt_int_t
-nxt_perl_psgi_write(nxt_task_t *task, nxt_app_wmsg_t *wmsg,
-    const u_char *data, size_t len,
-    nxt_bool_t flush, nxt_bool_t last)
-{
-    nxt_int_t  rc;
-
-    rc = nxt_app_msg_write_raw(task, wmsg, data, len);
-
-    if (nxt_slow_path(rc != NXT_OK)) {
-        return rc;
-    }
-
-    if (flush || last) {
-        rc = nxt_app_msg_flush(task, wmsg, last);
-    }
-
-    return rc;
-}
-
-
-nxt_inline nxt_int_t
-nxt_perl_psgi_http_write_status_str(nxt_task_t *task, nxt_app_wmsg_t *wmsg,
-    nxt_str_t *http_status)
-{
-    nxt_int_t  rc;
-
-    rc = NXT_OK;
-
-#define RC_WRT(DATA, DATALEN, FLUSH)                       \
-    do {                                                   \
-        rc = nxt_perl_psgi_write(task, wmsg, DATA,         \
-                    DATALEN, FLUSH, 0);                    \
-        if (nxt_slow_path(rc != NXT_OK))                   \
-            return rc;                                     \
-                                                           \
-    } while (0)
-
-    RC_WRT((const u_char *) "Status: ", (sizeof("Status: ") - 1), 0);
-    RC_WRT(http_status->start, http_status->length, 0);
-    RC_WRT((u_char *) "\r\n", (sizeof("\r\n") - 1), 0);
-
-#undef RC_WRT
-
-    return rc;
-}
-
-
 static long
 nxt_perl_psgi_io_input_read(PerlInterpreter *my_perl,
     nxt_perl_psgi_io_arg_t *arg, void *vbuf, size_t length)
@@ -182,7 +127,7 @@ nxt_perl_psgi_io_input_read(PerlInterpreter *my_perl,
     }
 
     copy_size = nxt_min(length, input->body_preread_size);
-    copy_size = nxt_app_msg_read_raw(input->task, input->rmsg,
+    copy_size = nxt_app_msg_read_body(input->task, input->rmsg,
                                      vbuf, copy_size);
 
     input->body_preread_size -= copy_size;
@@ -574,13 +519,15 @@ static SV *
 nxt_perl_psgi_env_create(PerlInterpreter *my_perl, nxt_task_t *task,
     nxt_app_rmsg_t *rmsg, size_t *body_preread_size)
 {
-    HV         *hash_env;
-    AV         *array_version;
-    u_char     *colon;
-    size_t     query_size;
-    nxt_int_t  rc;
-    nxt_str_t  str, value, path, target;
-    nxt_str_t  host, server_name, server_port;
+    HV                *hash_env;
+    AV                *array_version;
+    u_char            *colon;
+    size_t            query_size, size;
+    nxt_str_t         str, value, path, target;
+    nxt_str_t         host, server_name, server_port;
+    nxt_uint_t        i;
+    nxt_app_fields_t  fields;
+    u_char            name[NXT_APP_FIELD_ENV_NAME_SIZE];
 
     static nxt_str_t  def_host = nxt_string("localhost");
     static nxt_str_t  def_port = nxt_string("80");
@@ -606,11 +553,18 @@ nxt_perl_psgi_env_create(PerlInterpreter *my_perl, nxt_task_t *task,
 
     target = str;
 
-    RC(nxt_app_msg_read_str(task, rmsg, &path));
+    /* PATH_INFO is the undecoded target path. */
+    RC(nxt_app_msg_read_str(task, rmsg, &str));
     RC(nxt_app_msg_read_size(task, rmsg, &query_size));
 
-    if (path.start == NULL || path.length == 0) {
-        path = target;
+    path = target;
+
+    if (query_size > 0) {
+        if (nxt_slow_path(target.length < query_size - 1)) {
+            goto fail;
+        }
+
+        path.length = query_size - 2;
     }
 
     array_version = newAV();
@@ -687,28 +641,24 @@ nxt_perl_psgi_env_create(PerlInterpreter *my_perl, nxt_task_t *task,
     RC(nxt_perl_psgi_env_append_str(my_perl, hash_env,
                                     "SERVER_PORT", &server_port));
 
+    /* The cookie is passed in the "HTTP_COOKIE" field. */
+    RC(nxt_app_msg_read_str(task, rmsg, &str));
+
     GET_STR("CONTENT_TYPE");
     GET_STR("CONTENT_LENGTH");
 
-    for ( ;; ) {
-        rc = nxt_app_msg_read_str(task, rmsg, &str);
+    /* The parsed content length is not used. */
+    RC(nxt_app_msg_read_size(task, rmsg, &size));
 
-        if (nxt_slow_path(rc != NXT_OK)) {
-            goto fail;
-        }
+    RC(nxt_app_msg_read_fields(task, rmsg, &fields));
 
-        if (nxt_slow_path(str.length == 0)) {
-            break;
-        }
+    for (i = 0; i < fields.count; i++) {
+        RC(nxt_app_fields_get(&fields, i, &str, &value));
 
-        rc = nxt_app_msg_read_str(task, rmsg, &value);
-
-        if (nxt_slow_path(rc != NXT_OK)) {
-            break;
-        }
+        nxt_app_field_env_name(name, &str);
 
         RC(nxt_perl_psgi_env_append_str(my_perl, hash_env,
-                                        (char *) str.start, &value));
+                                        (char *) name, &value));
     }
 
     RC(nxt_app_msg_read_size(task, rmsg, body_preread_size));
@@ -744,13 +694,13 @@ nxt_perl_psgi_result_status(PerlInterpreter *my_perl, SV *result)
 
 static nxt_int_t
 nxt_perl_psgi_result_head(PerlInterpreter *my_perl, SV *sv_head,
-    nxt_task_t *task, nxt_app_wmsg_t *wmsg)
+    nxt_task_t *task, nxt_app_wmsg_t *wmsg, nxt_uint_t status)
 {
     AV         *array_head;
     SV         **entry;
     long       i, array_len;
     nxt_int_t  rc;
-    nxt_str_t  body;
+    nxt_str_t  name, value;
 
     if (nxt_slow_path(SvROK(sv_head) == 0
                       || SvTYPE(SvRV(sv_head)) != SVt_PVAV))
@@ -766,7 +716,7 @@ nxt_perl_psgi_result_head(PerlInterpreter *my_perl, SV *sv_head,
     array_len = av_len(array_head);
 
     if (array_len < 1) {
-        return NXT_OK;
+        return nxt_app_msg_write_status(task, wmsg, status, 0);
     }
 
     if (nxt_slow_path((array_len % 2) == 0)) {
@@ -777,7 +727,15 @@ nxt_perl_psgi_result_head(PerlInterpreter *my_perl, SV *sv_head,
         return NXT_ERROR;
     }
 
-    for (i = 0; i <= array_len; i++) {
+    rc = nxt_app_msg_write_status(task, wmsg, status, (array_len + 1) / 2);
+
+    if (nxt_slow_path(rc != NXT_OK)) {
+        nxt_log_error(NXT_LOG_ERR, task->log,
+                      "PSGI: Failed to write HTTP Status");
+        return rc;
+    }
+
+    for (i = 0; i <= array_len; i += 2) {
         entry = av_fetch(array_head, i, 0);
 
         if (nxt_fast_path(entry == NULL)) {
@@ -788,32 +746,27 @@ nxt_perl_psgi_result_head(PerlInterpreter *my_perl, SV *sv_head,
             return NXT_ERROR;
         }
 
-        body.start = (u_char *) SvPV(*entry, body.length);
+        name.start = (u_char *) SvPV(*entry, name.length);
 
-        rc = nxt_app_msg_write_raw(task, wmsg,
-                                   (u_char *) body.start, body.length);
+        entry = av_fetch(array_head, i + 1, 0);
 
-        if (nxt_slow_path(rc != NXT_OK)) {
+        if (nxt_fast_path(entry == NULL)) {
             nxt_log_error(NXT_LOG_ERR, task->log,
-                          "PSGI: Failed to write head "
-                          "from Perl Application");
-            return rc;
-        }
+                          "PSGI: Failed to get head entry from "
+                          "Perl Application");
 
-        if ((i % 2) == 0) {
-            rc = nxt_app_msg_write_raw(task, wmsg,
-                                       (u_char *) ": ",
-                                       (sizeof(": ") - 1));
-        } else {
-            rc = nxt_app_msg_write_raw(task, wmsg,
-                                       (u_char *) "\r\n",
-                                       (sizeof("\r\n") - 1));
+            return NXT_ERROR;
         }
 
+        value.start = (u_char *) SvPV(*entry, value.length);
+
+        rc = nxt_app_msg_write_field(task, wmsg, name.start, name.length,
+                                     value.start, value.length);
+
         if (nxt_slow_path(rc != NXT_OK)) {
             nxt_log_error(NXT_LOG_ERR, task->log,
-                          "PSGI: Failed to write head from "
-                          "Perl Application");
+                          "PSGI: Failed to write head "
+                          "from Perl Application");
             return rc;
         }
     }
@@ -943,7 +896,7 @@ nxt_perl_psgi_result_array(PerlInterpreter *my_perl, SV *result,
     AV         *array;
     SV         **sv_temp;
     long       array_len;
-    nxt_int_t  rc;
+    nxt_int_t  rc, status;
     nxt_str_t  http_status;
 
     array = (AV *) SvRV(result);
@@ -958,30 +911,26 @@ nxt_perl_psgi_result_array(PerlInterpreter *my_perl, SV *result,
 
     http_status = nxt_perl_psgi_result_status(nxt_perl_psgi, result);
 
-    if (nxt_slow_path(http_status.start == NULL || http_status.length == 0)) {
-        nxt_log_error(NXT_LOG_ERR, task->log,
-                      "PSGI: An unexpected status was received "
-                      "from Perl Application");
+    status = -1;
 
-        return NXT_ERROR;
+    if (nxt_fast_path(http_status.start != NULL && http_status.length >= 3)) {
+        status = nxt_int_parse(http_status.start, 3);
     }
 
-    rc = nxt_perl_psgi_http_write_status_str(task, wmsg, &http_status);
-
-    if (nxt_slow_path(rc != NXT_OK)) {
+    if (nxt_slow_path(status < 100)) {
         nxt_log_error(NXT_LOG_ERR, task->log,
-                      "PSGI: Failed to write HTTP Status");
+                      "PSGI: An unexpected status was received "
+                      "from Perl Application");
 
-        return rc;
+        return NXT_ERROR;
     }
 
     if (array_len < 1) {
-        rc = nxt_app_msg_write_raw(task, wmsg, (u_char *) "\r\n",
-                                   (sizeof("\r\n") - 1));
+        rc = nxt_app_msg_write_status(task, wmsg, status, 0);
 
         if (nxt_slow_path(rc != NXT_OK)) {
             nxt_log_error(NXT_LOG_ERR, task->log,
-                          "PSGI: Failed to write HTTP Headers");
+                          "PSGI: Failed to write HTTP Status");
 
             return rc;
         }
@@ -998,22 +947,13 @@ nxt_perl_psgi_result_array(PerlInterpreter *my_perl, SV *result,
         return NXT_ERROR;
     }
 
-    rc = nxt_perl_psgi_result_head(nxt_perl_psgi, *sv_temp, task, wmsg);
+    rc = nxt_perl_psgi_result_head(nxt_perl_psgi, *sv_temp, task, wmsg,
+                                   status);
 
     if (nxt_slow_path(rc != NXT_OK)) {
         return rc;
     }
 
-    rc = nxt_app_msg_write_raw(task, wmsg, (u_char *) "\r\n",
-                               (sizeof("\r\n") - 1));
-
-    if (nxt_slow_path(rc != NXT_OK)) {
-        nxt_log_error(NXT_LOG_ERR, task->log,
-                      "PSGI: Failed to write HTTP Headers");
-
-        return rc;
-    }
-
     if (nxt_fast_path(array_len < 2)) {
         return NXT_OK;
     }
@@ -47,7 +47,8 @@ typedef struct {
 static nxt_int_t nxt_http_parse_test_run(nxt_http_request_parse_t *rp,
     nxt_str_t *request);
 static nxt_int_t nxt_http_parse_test_bench(nxt_thread_t *thr,
-    nxt_str_t *request, nxt_lvlhsh_t *hash, const char *name, nxt_uint_t n);
+    nxt_str_t *request, nxt_http_fields_hash_t *hash, const char *name,
+    nxt_uint_t n);
 static nxt_int_t nxt_http_parse_test_request_line(nxt_http_request_parse_t *rp,
     nxt_http_parse_test_data_t *data,
     nxt_str_t *request, nxt_log_t *log);
@@ -305,7 +306,7 @@ static nxt_http_field_proc_t  nxt_http_test_fields[] = {
 };
 
 
-static nxt_lvlhsh_t  nxt_http_test_fields_hash;
+static nxt_http_fields_hash_t  nxt_http_test_fields_hash;
 
 
 static nxt_http_field_proc_t  nxt_http_test_bench_fields[] = {
@@ -382,6 +383,11 @@ static nxt_http_field_proc_t  nxt_http_test_bench_fields[] = {
 };
 
 
+static const char  *nxt_http_parse_test_simd[] = {
+    "scalar", "sse4.2", "avx2",
+};
+
+
 static nxt_str_t nxt_http_test_simple_request = nxt_string(
     "GET /page HTTP/1.1\r\n"
     "Host: example.com\r\n\r\n"
@@ -465,8 +471,10 @@ nxt_http_parse_test(nxt_thread_t *thr)
 {
     nxt_mp_t                    *mp, *mp_temp;
     nxt_int_t                   rc;
-    nxt_uint_t                  i, colls, lvl_colls;
+    nxt_uint_t                  i, n, colls, lvl_colls;
     nxt_lvlhsh_t                hash;
+    nxt_http_parse_simd_t       simd;
+    nxt_http_fields_hash_t      fields_hash;
     nxt_http_request_parse_t    rp;
     nxt_http_parse_test_case_t  *test;
 
@@ -484,8 +492,16 @@ nxt_http_parse_test(nxt_thread_t *thr)
         return NXT_ERROR;
     }
 
-    for (i = 0; i < nxt_nitems(nxt_http_test_cases); i++) {
-        test = &nxt_http_test_cases[i];
+    simd = nxt_http_parse_simd_detect();
+
+    n = nxt_nitems(nxt_http_test_cases);
+
+    /* Each test case is run with all available lookup paths. */
+
+    for (i = 0; i < n * (simd + 1); i++) {
+        test = &nxt_http_test_cases[i % n];
+
+        (void) nxt_http_parse_simd_set(i / n);
 
         nxt_memzero(&rp, sizeof(nxt_http_request_parse_t));
 
@@ -503,8 +519,10 @@ nxt_http_parse_test(nxt_thread_t *thr)
         if (rc != test->result) {
             nxt_log_alert(thr->log, "http parse test case failed:\n"
                                     " - request:\n\"%V\"\n"
-                                    " - result: %i (expected: %i)",
-                                    &test->request, rc, test->result);
+                                    " - result: %i (expected: %i)\n"
+                                    " - path: %s",
+                                    &test->request, rc, test->result,
+                                    nxt_http_parse_test_simd[i / n]);
             return NXT_ERROR;
         }
 
@@ -538,28 +556,40 @@ nxt_http_parse_test(nxt_thread_t *thr)
                   "http parse test hash collisions %ui out of %uz, level: %ui",
                   colls, nxt_nitems(nxt_http_test_bench_fields), lvl_colls);
 
-    nxt_memzero(&hash, sizeof(nxt_lvlhsh_t));
-
-    rc = nxt_http_fields_hash(&hash, mp, nxt_http_test_bench_fields,
+    rc = nxt_http_fields_hash(&fields_hash, mp, nxt_http_test_bench_fields,
                               nxt_nitems(nxt_http_test_bench_fields));
     if (rc != NXT_OK) {
         return NXT_ERROR;
     }
 
-    if (nxt_http_parse_test_bench(thr, &nxt_http_test_simple_request,
-                                  &hash, "simple", 1000000)
-        != NXT_OK)
-    {
-        return NXT_ERROR;
-    }
+    nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                  "http parse test fields hash size: %ui, shift: %ui",
+                  (nxt_uint_t) fields_hash.mask + 1,
+                  (nxt_uint_t) fields_hash.shift);
 
-    if (nxt_http_parse_test_bench(thr, &nxt_http_test_big_request,
-                                  &hash, "big", 100000)
-        != NXT_OK)
-    {
-        return NXT_ERROR;
+    for (i = 0; i <= simd; i++) {
+        (void) nxt_http_parse_simd_set(i);
+
+        nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                      "http parse bench path: %s", nxt_http_parse_test_simd[i]);
+
+        if (nxt_http_parse_test_bench(thr, &nxt_http_test_simple_request,
+                                      &fields_hash, "simple", 1000000)
+            != NXT_OK)
+        {
+            return NXT_ERROR;
+        }
+
+        if (nxt_http_parse_test_bench(thr, &nxt_http_test_big_request,
+                                      &fields_hash, "big", 100000)
+            != NXT_OK)
+        {
+            return NXT_ERROR;
+        }
     }
 
+    (void) nxt_http_parse_simd_set(simd);
+
     nxt_mp_destroy(mp);
 
     return NXT_OK;
@@ -589,7 +619,7 @@ nxt_http_parse_test_run(nxt_http_request_parse_t *rp, nxt_str_t *request)
 
 static nxt_int_t
 nxt_http_parse_test_bench(nxt_thread_t *thr, nxt_str_t *request,
-    nxt_lvlhsh_t *hash, const char *name, nxt_uint_t n)
+    nxt_http_fields_hash_t *hash, const char *name, nxt_uint_t n)
 {
     nxt_mp_t                  *mp;
     nxt_nsec_t                start, end;
@@ -643,8 +673,9 @@ nxt_http_parse_test_bench(nxt_thread_t *thr, nxt_str_t *request,
     end = nxt_thread_monotonic_time(thr);
 
     nxt_log_error(NXT_LOG_NOTICE, thr->log,
-                  "http parse %s request bench: %0.3fs",
-                  name, (end - start) / 1000000000.0);
+                  "http parse %s request bench: %0.3fs, %0.1f MB/s",
+                  name, (end - start) / 1000000000.0,
+                  (request->length * n * 1000.0) / (end - start));
 
     return NXT_OK;
 }
@@ -162,5 +162,17 @@ main(int argc, char **argv)
         return 1;
     }
 
+    if (nxt_timer_test(thr, 100 * 1000) != NXT_OK) {
+        return 1;
+    }
+
+    if (nxt_work_queue_test(thr, 1000 * 1000) != NXT_OK) {
+        return 1;
+    }
+
+    if (nxt_thread_pool_test(thr, 1000) != NXT_OK) {
+        return 1;
+    }
+
     return 0;
 }
@@ -64,6 +64,9 @@ nxt_int_t nxt_malloc_test(nxt_thread_t *thr);
 nxt_int_t nxt_utf8_test(nxt_thread_t *thr);
 nxt_int_t nxt_http_parse_test(nxt_thread_t *thr);
 nxt_int_t nxt_strverscmp_test(nxt_thread_t *thr);
+nxt_int_t nxt_timer_test(nxt_thread_t *thr, nxt_uint_t n);
+nxt_int_t nxt_work_queue_test(nxt_thread_t *thr, nxt_uint_t n);
+nxt_int_t nxt_thread_pool_test(nxt_thread_t *thr, nxt_uint_t n);
 
 
 #endif /* _NXT_TESTS_H_INCLUDED_ */
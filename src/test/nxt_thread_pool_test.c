@@ -0,0 +1,152 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_main.h>
+#include "nxt_tests.h"
+
+
+#define NXT_THREAD_POOL_TEST_THREADS  4
+
+
+typedef struct {
+    nxt_thread_pool_t  *thread_pool;
+    nxt_atomic_t       done;
+    nxt_atomic_t       stolen;
+} nxt_thread_pool_test_t;
+
+
+static void nxt_thread_pool_test_handler(nxt_task_t *task, void *obj,
+    void *data);
+
+
+/*
+ * All blocking works are posted by one engine, so they are queued to
+ * the same pool thread and the other threads should steal them.
+ */
+
+nxt_int_t
+nxt_thread_pool_test(nxt_thread_t *thr, nxt_uint_t n)
+{
+    nxt_uint_t              i;
+    nxt_nsec_t              start, end;
+    nxt_task_t              task;
+    nxt_work_t              *works;
+    nxt_thread_pool_t       *tp;
+    nxt_event_engine_t      *engine, *saved;
+    nxt_thread_pool_test_t  test;
+
+    nxt_log_error(NXT_LOG_NOTICE, thr->log, "thread pool test started: %ui",
+                  n);
+
+    engine = nxt_zalloc(sizeof(nxt_event_engine_t));
+    if (engine == NULL) {
+        return NXT_ERROR;
+    }
+
+    works = nxt_malloc(n * sizeof(nxt_work_t));
+    if (works == NULL) {
+        nxt_free(engine);
+        return NXT_ERROR;
+    }
+
+    engine->task.thread = thr;
+    engine->task.log = thr->log;
+
+    /*
+     * The pool and the engine are not freed because the pool exit
+     * procedure posts to the engine, its threads stay waiting until
+     * the process exit.
+     */
+
+    tp = nxt_thread_pool_create(NXT_THREAD_POOL_TEST_THREADS,
+                                100 * 1000000LL, NULL, engine, NULL);
+    if (tp == NULL) {
+        return NXT_ERROR;
+    }
+
+    nxt_memzero(&task, sizeof(nxt_task_t));
+    task.log = thr->log;
+
+    test.thread_pool = tp;
+    test.done = 0;
+    test.stolen = 0;
+
+    saved = thr->engine;
+    thr->engine = engine;
+
+    nxt_thread_time_update(thr);
+    start = nxt_thread_monotonic_time(thr);
+
+    for (i = 0; i < n; i++) {
+        nxt_work_set(&works[i], nxt_thread_pool_test_handler, &task, &test,
+                     NULL);
+
+        if (nxt_thread_pool_post(tp, &works[i]) != NXT_OK) {
+            thr->engine = saved;
+            return NXT_ERROR;
+        }
+    }
+
+    thr->engine = saved;
+
+    /* Wait up to 10 seconds. */
+
+    for (i = 0; i < 10000 && test.done != n; i++) {
+        nxt_nanosleep(1000000);
+    }
+
+    nxt_thread_time_update(thr);
+    end = nxt_thread_monotonic_time(thr);
+
+    if (test.done != n || test.stolen == 0
+        || nxt_thread_pool_pending(tp))
+    {
+        nxt_log_alert(thr->log, "thread pool test failed: done:%A stolen:%A",
+                      test.done, test.stolen);
+        return NXT_ERROR;
+    }
+
+    /* The idle threads exit except the last one. */
+
+    for (i = 0; i < 1000 && tp->threads != 1; i++) {
+        nxt_nanosleep(1000000);
+    }
+
+    if (tp->threads != 1) {
+        nxt_log_alert(thr->log, "thread pool test failed: threads:%A",
+                      tp->threads);
+        return NXT_ERROR;
+    }
+
+    nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                  "thread pool test passed %0.3fs, stolen: %A of %ui",
+                  (end - start) / 1000000000.0, test.stolen, n);
+
+    nxt_free(works);
+
+    return NXT_OK;
+}
+
+
+static void
+nxt_thread_pool_test_handler(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_thread_t            *thr;
+    nxt_thread_pool_test_t  *test;
+
+    test = obj;
+    thr = task->thread;
+
+    /* A blocking operation such as a file open. */
+    nxt_nanosleep(1000000);
+
+    if (!nxt_thread_handle_equal(thr->handle,
+                                 test->thread_pool->workers[0].handle))
+    {
+        (void) nxt_atomic_fetch_add(&test->stolen, 1);
+    }
+
+    (void) nxt_atomic_fetch_add(&test->done, 1);
+}
@@ -0,0 +1,237 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_main.h>
+#include "nxt_tests.h"
+
+
+typedef struct {
+    nxt_timer_t         timer;
+    uint32_t            key;
+    nxt_msec_t          *last;
+    nxt_uint_t          *expired;
+    nxt_event_engine_t  *engine;
+} nxt_timer_test_t;
+
+
+static nxt_int_t nxt_timer_test_run(nxt_thread_t *thr, nxt_uint_t n,
+    nxt_bool_t wheel, nxt_uint_t *expired);
+static nxt_msec_t nxt_timer_test_timeout(uint32_t *key);
+static void nxt_timer_test_handler(nxt_task_t *task, void *obj, void *data);
+
+
+/*
+ * The test churns timers of the rbtree and the timer wheel backends with
+ * the same sequence of additions, deletions, and expirations crossing
+ * the milliseconds counter overflow.  Each timer should expire exactly
+ * in the expiration call following its time and both backends should
+ * expire the same number of timers.  Each timer has its own random key,
+ * so timeouts do not depend on an order of expiration.
+ */
+
+nxt_int_t
+nxt_timer_test(nxt_thread_t *thr, nxt_uint_t n)
+{
+    nxt_uint_t  expired, wheel_expired;
+
+    nxt_log_error(NXT_LOG_NOTICE, thr->log, "timer test started: %ui", n);
+
+    if (nxt_timer_test_run(thr, n, 0, &expired) != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    if (nxt_timer_test_run(thr, n, 1, &wheel_expired) != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    if (expired != wheel_expired) {
+        nxt_log_alert(thr->log, "timer test failed: expired rbtree:%ui "
+                      "wheel:%ui", expired, wheel_expired);
+        return NXT_ERROR;
+    }
+
+    nxt_log_error(NXT_LOG_NOTICE, thr->log, "timer test passed");
+
+    return NXT_OK;
+}
+
+
+#define NXT_TIMER_TEST_TICKS  20000
+#define NXT_TIMER_TEST_CHURN  64
+
+
+static nxt_int_t
+nxt_timer_test_run(nxt_thread_t *thr, nxt_uint_t n, nxt_bool_t wheel,
+    nxt_uint_t *expired)
+{
+    void                    *obj, *data;
+    uint32_t                key;
+    nxt_int_t               ret;
+    nxt_msec_t              now, last;
+    nxt_nsec_t              start, end;
+    nxt_task_t              *task;
+    nxt_uint_t              i, k, tick;
+    nxt_timer_test_t        *items, *item;
+    nxt_work_queue_t        wq;
+    nxt_event_engine_t      *engine;
+    nxt_work_handler_t      handler;
+    nxt_work_queue_cache_t  cache;
+
+    ret = NXT_ERROR;
+
+    engine = nxt_zalloc(sizeof(nxt_event_engine_t));
+    if (engine == NULL) {
+        return NXT_ERROR;
+    }
+
+    items = nxt_zalloc(n * sizeof(nxt_timer_test_t));
+    if (items == NULL) {
+        goto fail;
+    }
+
+    engine->task.thread = thr;
+    engine->task.log = thr->log;
+
+    /* Start before the milliseconds counter overflow. */
+    now = 0xFFFFFFFF - 5000;
+    last = now;
+
+    engine->timers.now = now;
+
+    if (nxt_timers_init(&engine->timers, 128, wheel) != NXT_OK) {
+        goto fail;
+    }
+
+    nxt_work_queue_cache_create(&cache, 0);
+
+    nxt_memzero(&wq, sizeof(nxt_work_queue_t));
+    wq.cache = &cache;
+
+    *expired = 0;
+    key = 0;
+
+    for (i = 0; i < n; i++) {
+        item = &items[i];
+
+        item->timer.work_queue = &wq;
+        item->timer.handler = nxt_timer_test_handler;
+        item->timer.task = &engine->task;
+        item->timer.log = thr->log;
+
+        item->key = i;
+        item->last = &last;
+        item->expired = expired;
+        item->engine = engine;
+
+        nxt_timer_add(engine, &item->timer,
+                      nxt_timer_test_timeout(&item->key));
+    }
+
+    nxt_thread_time_update(thr);
+    start = nxt_thread_monotonic_time(thr);
+
+    for (tick = 0; tick < NXT_TIMER_TEST_TICKS; tick++) {
+
+        for (k = 0; k < NXT_TIMER_TEST_CHURN; k++) {
+            key = nxt_murmur_hash2(&key, sizeof(uint32_t));
+            item = &items[key % n];
+
+            if (key & 0x100) {
+                nxt_timer_add(engine, &item->timer,
+                              nxt_timer_test_timeout(&item->key));
+
+            } else {
+                (void) nxt_timer_delete(engine, &item->timer);
+            }
+        }
+
+        (void) nxt_timer_find(engine);
+
+        /* Time jumps forward sometimes as if a process has been stopped. */
+        now += ((tick % 1000) == 999) ? 70000 : 1;
+
+        nxt_timer_expire(engine, now);
+
+        while (wq.head != NULL) {
+            handler = nxt_work_queue_pop(&wq, &task, &obj, &data);
+            handler(task, obj, data);
+        }
+
+        last = now;
+    }
+
+    nxt_thread_time_update(thr);
+    end = nxt_thread_monotonic_time(thr);
+
+    for (i = 0; i < n; i++) {
+        (void) nxt_timer_delete(engine, &items[i].timer);
+    }
+
+    if (nxt_timer_find(engine) != NXT_INFINITE_MSEC) {
+        nxt_log_alert(thr->log, "timer test failed: timers are not empty");
+        goto done;
+    }
+
+    nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                  "timer %s test: %ui expired %0.3fs",
+                  wheel ? "wheel" : "rbtree", *expired,
+                  (end - start) / 1000000000.0);
+
+    ret = NXT_OK;
+
+done:
+
+    nxt_work_queue_cache_destroy(&cache);
+
+fail:
+
+    nxt_free(items);
+    nxt_free(engine);
+
+    return ret;
+}
+
+
+static nxt_msec_t
+nxt_timer_test_timeout(uint32_t *key)
+{
+    uint32_t  k;
+
+    k = nxt_murmur_hash2(key, sizeof(uint32_t));
+    *key = k;
+
+    /* Mostly connection timeouts and sometimes much longer ones. */
+
+    if ((k & 0xF) == 0) {
+        return k % (1 << 26) + 1;
+    }
+
+    return (k >> 4) % 60000 + 1;
+}
+
+
+static void
+nxt_timer_test_handler(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_timer_t       *timer;
+    nxt_timer_test_t  *item;
+
+    timer = obj;
+    item = nxt_timer_data(timer, nxt_timer_test_t, timer);
+
+    /* The timer should expire after the last and before the current time. */
+
+    if (nxt_msec_diff(timer->time, *item->last) <= 0
+        || nxt_msec_diff(timer->time, item->engine->timers.now) > 0)
+    {
+        nxt_log_alert(task->log, "timer test failed: %M expired at %M:%M",
+                      timer->time, *item->last, item->engine->timers.now);
+        nxt_abort();
+    }
+
+    (*item->expired)++;
+
+    nxt_timer_add(item->engine, timer, nxt_timer_test_timeout(&item->key));
+}
@@ -0,0 +1,199 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_main.h>
+#include "nxt_tests.h"
+
+
+#define NXT_WORK_QUEUE_TEST_PRODUCERS  4
+
+
+typedef struct {
+    nxt_atomic_work_queue_t  *queue;
+    nxt_work_t               *works;
+    nxt_uint_t               n;
+    nxt_uint_t               next;
+    nxt_uint_t               signals;
+    nxt_bool_t               failed;
+} nxt_work_queue_test_t;
+
+
+static void nxt_work_queue_test_producer(void *data);
+static void nxt_work_queue_test_handler(nxt_task_t *task, void *obj,
+    void *data);
+
+
+/*
+ * Several threads post works to an atomic work queue concurrently with
+ * the consumer moving them.  Each producer's works should be moved once
+ * and in order of posting.
+ */
+
+nxt_int_t
+nxt_work_queue_test(nxt_thread_t *thr, nxt_uint_t n)
+{
+    void                     *obj, *data;
+    nxt_int_t                ret;
+    nxt_uint_t               i, j, total, moved, signals;
+    nxt_nsec_t               start, end;
+    nxt_task_t               task, *tp;
+    nxt_work_t               *works;
+    nxt_work_queue_t         wq;
+    nxt_thread_link_t        *link;
+    nxt_work_handler_t       handler;
+    nxt_thread_handle_t      handles[NXT_WORK_QUEUE_TEST_PRODUCERS];
+    nxt_work_queue_test_t    producers[NXT_WORK_QUEUE_TEST_PRODUCERS];
+    nxt_work_queue_cache_t   cache;
+    nxt_atomic_work_queue_t  queue;
+
+    nxt_log_error(NXT_LOG_NOTICE, thr->log, "work queue test started: %ui",
+                  n);
+
+    total = n * NXT_WORK_QUEUE_TEST_PRODUCERS;
+
+    works = nxt_malloc(total * sizeof(nxt_work_t));
+    if (works == NULL) {
+        return NXT_ERROR;
+    }
+
+    ret = NXT_ERROR;
+
+    nxt_memzero(&task, sizeof(nxt_task_t));
+    task.log = thr->log;
+
+    queue.head = 0;
+
+    nxt_work_queue_cache_create(&cache, 0);
+
+    nxt_memzero(&wq, sizeof(nxt_work_queue_t));
+    wq.cache = &cache;
+
+    for (i = 0; i < NXT_WORK_QUEUE_TEST_PRODUCERS; i++) {
+        producers[i].queue = &queue;
+        producers[i].works = &works[i * n];
+        producers[i].n = n;
+        producers[i].next = 0;
+        producers[i].signals = 0;
+        producers[i].failed = 0;
+
+        for (j = 0; j < n; j++) {
+            nxt_work_set(&producers[i].works[j], nxt_work_queue_test_handler,
+                         &task, &producers[i], (void *) (uintptr_t) j);
+        }
+    }
+
+    nxt_thread_time_update(thr);
+    start = nxt_thread_monotonic_time(thr);
+
+    for (i = 0; i < NXT_WORK_QUEUE_TEST_PRODUCERS; i++) {
+        link = nxt_zalloc(sizeof(nxt_thread_link_t));
+        if (link == NULL) {
+            break;
+        }
+
+        link->start = nxt_work_queue_test_producer;
+        link->work.data = &producers[i];
+
+        if (nxt_thread_create(&handles[i], link) != NXT_OK) {
+            break;
+        }
+    }
+
+    if (i != NXT_WORK_QUEUE_TEST_PRODUCERS) {
+        while (i != 0) {
+            nxt_thread_wait(handles[--i]);
+        }
+
+        goto fail;
+    }
+
+    moved = 0;
+
+    while (moved < total) {
+        nxt_atomic_work_queue_move(thr, &queue, &wq);
+
+        if (wq.head == NULL) {
+            nxt_thread_yield();
+            continue;
+        }
+
+        while (wq.head != NULL) {
+            handler = nxt_work_queue_pop(&wq, &tp, &obj, &data);
+            handler(tp, obj, data);
+
+            moved++;
+        }
+    }
+
+    for (i = 0; i < NXT_WORK_QUEUE_TEST_PRODUCERS; i++) {
+        nxt_thread_wait(handles[i]);
+    }
+
+    nxt_thread_time_update(thr);
+    end = nxt_thread_monotonic_time(thr);
+
+    signals = 0;
+
+    for (i = 0; i < NXT_WORK_QUEUE_TEST_PRODUCERS; i++) {
+
+        if (producers[i].failed || producers[i].next != n) {
+            nxt_log_alert(thr->log, "work queue test failed: producer %ui "
+                          "moved %ui works", i, producers[i].next);
+            goto fail;
+        }
+
+        signals += producers[i].signals;
+    }
+
+    if (queue.head != 0) {
+        nxt_log_alert(thr->log, "work queue test failed: queue is not empty");
+        goto fail;
+    }
+
+    nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                  "work queue test passed %0.3fs, signals: %ui of %ui",
+                  (end - start) / 1000000000.0, signals, total);
+
+    ret = NXT_OK;
+
+fail:
+
+    nxt_work_queue_cache_destroy(&cache);
+    nxt_free(works);
+
+    return ret;
+}
+
+
+static void
+nxt_work_queue_test_producer(void *data)
+{
+    nxt_uint_t             i;
+    nxt_work_queue_test_t  *producer;
+
+    producer = data;
+
+    for (i = 0; i < producer->n; i++) {
+
+        if (nxt_atomic_work_queue_add(producer->queue, &producer->works[i])) {
+            producer->signals++;
+        }
+    }
+}
+
+
+static void
+nxt_work_queue_test_handler(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_work_queue_test_t  *producer;
+
+    producer = obj;
+
+    if ((uintptr_t) data != producer->next) {
+        producer->failed = 1;
+    }
+
+    producer->next++;
+}
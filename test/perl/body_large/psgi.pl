@@ -0,0 +1,7 @@
+my $app = sub {
+    my ($environ) = @_;
+
+    my $chunk = '0123456789abcdef' x 4096;
+
+    return ['200', ['Content-Length' => 64 * length $chunk], [($chunk) x 64]];
+};
@@ -0,0 +1,20 @@
+my $counter = 0;
+
+my $app = sub {
+    my ($environ) = @_;
+
+    $counter++;
+
+    sleep(2) if $environ->{'PATH_INFO'} eq '/slow' && $counter == 2;
+    sleep(1) if $environ->{'PATH_INFO'} eq '/wait';
+    sleep(3) if $environ->{'PATH_INFO'} eq '/lock' && $counter == 1;
+
+    my $cache_control = $environ->{'QUERY_STRING'};
+    $cache_control =~ s/%20/ /g;
+
+    return ['200', [
+        'Content-Type' => 'text/plain',
+        'Content-Length' => length($counter),
+        'Cache-Control' => $cache_control
+    ], [$counter]];
+};
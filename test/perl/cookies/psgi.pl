@@ -0,0 +1,8 @@
+my $app = sub {
+    my ($environ) = @_;
+
+    return ['200', [
+        'Content-Length' => 0,
+        'Http-Cookie' => $environ->{'HTTP_COOKIE'}
+    ], []];
+};
@@ -0,0 +1,10 @@
+my $app = sub {
+    my ($environ) = @_;
+
+    sleep($environ->{'HTTP_X_DELAY'}) if $environ->{'HTTP_X_DELAY'};
+
+    return ['200', [
+        'Content-Length' => 0,
+        'Pid' => $$
+    ], []];
+};
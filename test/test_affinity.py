@@ -0,0 +1,93 @@
+import os
+import re
+import unittest
+import unit
+
+class TestUnitAffinity(unit.TestUnitApplicationPerl):
+
+    def setUpClass():
+        unit.TestUnit().check_modules('perl')
+
+        if not hasattr(os, 'sched_getaffinity'):
+            raise unittest.SkipTest('CPU affinity is not supported')
+
+    def setUp(self):
+        super().setUp()
+
+        self.load('variables')
+
+        self.allowed = os.sched_getaffinity(0)
+
+    def test_affinity_app_cpu(self):
+        self.assertIn('success', self.conf('"cpu"',
+            '/applications/variables/affinity'), 'cpu')
+
+        self.assertEqual(self.get()['status'], 200, 'request')
+
+        cpus = self.cpus(self.pid('"variables" application'))
+
+        self.assertEqual(len(cpus), 1, 'single cpu')
+        self.assertTrue(cpus <= self.allowed, 'allowed cpu')
+
+    def test_affinity_app_node(self):
+        self.assertIn('success', self.conf('"node"',
+            '/applications/variables/affinity'), 'node')
+
+        self.assertEqual(self.get()['status'], 200, 'request')
+
+        cpus = self.cpus(self.pid('"variables" application'))
+
+        self.assertTrue(cpus, 'node cpus')
+        self.assertTrue(cpus <= self.allowed, 'allowed node cpus')
+
+    def test_affinity_listeners(self):
+        self.assertIn('success', self.conf('true', '/listeners_affinity'),
+            'listeners affinity')
+
+        self.assertEqual(self.get()['status'], 200, 'request')
+
+        router = self.pid('router')
+
+        pinned = [cpus for cpus in self.threads(router) if len(cpus) == 1]
+
+        self.assertGreaterEqual(len(pinned), os.cpu_count(), 'pinned')
+
+        self.assertIn('success', self.conf_delete('/listeners_affinity'),
+            'delete')
+
+        self.assertEqual(self.get()['status'], 200, 'request 2')
+
+        for cpus in self.threads(router):
+            self.assertEqual(cpus, self.allowed, 'released')
+
+    def test_affinity_invalid(self):
+        self.assertIn('error', self.conf('"core"',
+            '/applications/variables/affinity'), 'invalid value')
+        self.assertIn('error', self.conf('1',
+            '/applications/variables/affinity'), 'not string')
+        self.assertIn('error', self.conf('"blah"', '/listeners_affinity'),
+            'not boolean')
+
+    def cpus(self, pid, task=None):
+        path = '/proc/' + pid
+
+        if task is not None:
+            path += '/task/' + task
+
+        with open(path + '/status') as f:
+            m = re.search('^Cpus_allowed_list:\s*(\S+)', f.read(), re.M)
+
+        cpus = set()
+
+        for part in m.group(1).split(','):
+            first, _, last = part.partition('-')
+            cpus.update(range(int(first), int(last or first) + 1))
+
+        return cpus
+
+    def threads(self, pid):
+        return [self.cpus(pid, task) for task in
+            os.listdir('/proc/' + pid + '/task')]
+
+if __name__ == '__main__':
+    unittest.main()
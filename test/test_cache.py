@@ -0,0 +1,203 @@
+import time
+import socket
+import unittest
+import unit
+
+class TestUnitCache(unit.TestUnitApplicationPerl):
+
+    def setUpClass():
+        unit.TestUnit().check_modules('perl')
+
+    def setUp(self):
+        super().setUp()
+
+        self.load('cache')
+
+        self.conf({ "size": 1048576 }, '/applications/cache/cache')
+
+    def test_cache_max_age(self):
+        resp = self.get(url='/?max-age=2')
+
+        self.assertEqual(resp['body'], '1', 'first')
+        self.assertNotIn('Age', resp['headers'], 'first age')
+
+        resp = self.get(url='/?max-age=2')
+
+        self.assertEqual(resp['status'], 200, 'cached status')
+        self.assertEqual(resp['body'], '1', 'cached')
+        self.assertEqual(resp['headers']['Content-Length'], '1',
+            'cached content length')
+        self.assertEqual(resp['headers']['Content-Type'], 'text/plain',
+            'cached content type')
+        self.assertIn('Age', resp['headers'], 'cached age')
+
+        self.assertEqual(self.get(url='/?max-age=2', headers={
+            'Host': 'example.com',
+            'Connection': 'close'
+        })['body'], '2', 'host')
+
+        time.sleep(3)
+
+        self.assertEqual(self.get(url='/?max-age=2')['body'], '3', 'expired')
+
+    def test_cache_key_host(self):
+        self.assertEqual(self.get(url='/x?max-age=10', headers={
+            'Host': 'localhost/admin',
+            'Connection': 'close'
+        })['body'], '1', 'host with slash')
+
+        self.assertEqual(self.get(url='/admin/x?max-age=10', headers={
+            'Host': 'localhost',
+            'Connection': 'close'
+        })['body'], '2', 'host and target separated')
+
+    def test_cache_not_cacheable(self):
+        self.assertEqual(self.get(url='/?no-store')['body'], '1', 'no-store')
+        self.assertEqual(self.get(url='/?no-store')['body'], '2',
+            'no-store 2')
+        self.assertEqual(self.get(url='/?private,%20max-age=10')['body'], '3',
+            'private')
+        self.assertEqual(self.get(url='/?private,%20max-age=10')['body'], '4',
+            'private 2')
+        self.assertEqual(self.get(url='/')['body'], '5', 'no freshness')
+        self.assertEqual(self.get(url='/')['body'], '6', 'no freshness 2')
+        self.assertEqual(self.post(url='/?max-age=10')['body'], '7', 'post')
+        self.assertEqual(self.post(url='/?max-age=10')['body'], '8', 'post 2')
+
+    def test_cache_valid(self):
+        self.conf({ "size": 1048576, "valid": 10 },
+            '/applications/cache/cache')
+
+        self.assertEqual(self.get(url='/')['body'], '1', 'valid')
+        self.assertEqual(self.get(url='/')['body'], '1', 'valid cached')
+        self.assertEqual(self.get(url='/?max-age=0')['body'], '2',
+            'max-age=0')
+        self.assertEqual(self.get(url='/?max-age=0')['body'], '3',
+            'max-age=0 2')
+
+    def test_cache_head(self):
+        self.assertEqual(self.http('HEAD', url='/?max-age=10')['status'], 200,
+            'head')
+        self.assertEqual(self.get(url='/?max-age=10')['body'], '2',
+            'head not cached')
+
+        resp = self.http('HEAD', url='/?max-age=10')
+
+        self.assertEqual(resp['body'], '', 'head cached')
+        self.assertEqual(resp['headers']['Content-Length'], '1',
+            'head content length')
+        self.assertEqual(self.get(url='/?max-age=10')['body'], '2',
+            'get cached')
+
+    def test_cache_authorization(self):
+        auth = {
+            'Host': 'localhost',
+            'Authorization': 'Basic dXNlcjpwYXNz',
+            'Connection': 'close'
+        }
+
+        self.assertEqual(self.get(url='/?max-age=10', headers=auth)['body'],
+            '1', 'authorization')
+        self.assertEqual(self.get(url='/?max-age=10')['body'], '2',
+            'authorization not stored')
+        self.assertEqual(self.get(url='/?max-age=10')['body'], '2',
+            'cached')
+        self.assertEqual(self.get(url='/?max-age=10', headers=auth)['body'],
+            '3', 'authorization not served')
+
+        url = '/?public,%20max-age=10'
+
+        self.assertEqual(self.get(url=url, headers=auth)['body'], '4',
+            'public')
+        self.assertEqual(self.get(url=url)['body'], '4', 'public cached')
+        self.assertEqual(self.get(url=url, headers=auth)['body'], '4',
+            'public authorization cached')
+
+        url = '/?s-maxage=10'
+
+        self.assertEqual(self.get(url=url, headers=auth)['body'], '5',
+            's-maxage')
+        self.assertEqual(self.get(url=url, headers=auth)['body'], '5',
+            's-maxage cached')
+
+    def test_cache_stale_while_revalidate(self):
+        url = '/slow?max-age=1,%20stale-while-revalidate=10'
+
+        self.assertEqual(self.get(url=url)['body'], '1', 'first')
+
+        time.sleep(2)
+
+        # The request updates the expired response slowly.
+
+        sock = socket.create_connection(('127.0.0.1', 7080))
+        sock.sendall(('GET ' + url + ' HTTP/1.1\r\nHost: localhost\r\n'
+            'Connection: close\r\n\r\n').encode())
+
+        time.sleep(0.5)
+
+        start = time.time()
+
+        self.assertEqual(self.get(url=url)['body'], '1', 'stale')
+        self.assertLess(time.time() - start, 1.5, 'stale time')
+
+        resp = b''
+        while True:
+            part = sock.recv(4096)
+            if not part:
+                break
+            resp += part
+
+        sock.close()
+
+        self.assertTrue(resp.endswith(b'\r\n\r\n2'), 'updated')
+        self.assertEqual(self.get(url=url)['body'], '2', 'fresh')
+
+    def test_cache_collapse(self):
+        self.assertListEqual(self.get_concurrent('/wait', 5),
+            ['1'] * 5, 'collapsed')
+        self.assertListEqual(self.get_concurrent('/wait', 1), ['2'],
+            'not cached')
+
+        self.assertListEqual(sorted(self.get_concurrent('/wait?no-store', 3)),
+            ['3', '4', '5'], 'not collapsed')
+
+    def test_cache_lock_timeout(self):
+        self.conf({ "size": 1048576, "lock_timeout": 1 },
+            '/applications/cache/cache')
+
+        self.assertListEqual(sorted(self.get_concurrent('/lock?max-age=10', 2)),
+            ['1', '2'], 'lock timeout')
+
+    def test_cache_configuration(self):
+        self.assertIn('error', self.conf('1', '/applications/cache/cache'),
+            'cache invalid')
+        self.assertIn('error', self.conf({ "size": "1" },
+            '/applications/cache/cache'), 'cache size invalid')
+
+    def get_concurrent(self, url, n):
+        socks = []
+
+        for i in range(n):
+            sock = socket.create_connection(('127.0.0.1', 7080))
+            sock.sendall(('GET ' + url + ' HTTP/1.1\r\nHost: localhost\r\n'
+                'Connection: close\r\n\r\n').encode())
+            socks.append(sock)
+
+        bodies = []
+
+        for sock in socks:
+            resp = b''
+            while True:
+                part = sock.recv(4096)
+                if not part:
+                    break
+                resp += part
+
+            sock.close()
+
+            bodies.append(resp.split(b'\r\n\r\n', 1)[1].decode())
+
+        return bodies
+
+if __name__ == '__main__':
+    unittest.main()
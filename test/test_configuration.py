@@ -62,6 +62,27 @@ class TestUnitConfiguration(unit.TestUnitControl):
             }
         }, '/applications'), 'negative spare')
 
+    def test_processes_balance(self):
+        for balance in ['round_robin', 'least_outstanding', 'p2c']:
+            self.assertIn('success', self.conf({
+                "app": {
+                    "type": "python",
+                    "processes": { "spare": 0, "balance": balance },
+                    "path": "/app",
+                    "module": "wsgi"
+                }
+            }, '/applications'), 'balance ' + balance)
+
+    def test_processes_balance_invalid(self):
+        self.assertIn('error', self.conf({
+            "app": {
+                "type": "python",
+                "processes": { "spare": 0, "balance": "random" },
+                "path": "/app",
+                "module": "wsgi"
+            }
+        }, '/applications'), 'invalid balance')
+
     def test_applications_type_only(self):
         self.assertIn('error', self.conf({
             "app": {
@@ -196,5 +217,30 @@ class TestUnitConfiguration(unit.TestUnitControl):
             }
         }), 'no port')
 
+    def test_http_body_temp_threshold(self):
+        self.assertIn('success', self.conf({
+            "body_temp_threshold": 65536
+        }, '/http'), 'body temp threshold')
+
+    def test_http_body_temp_threshold_invalid(self):
+        self.assertIn('error', self.conf({
+            "body_temp_threshold": "64k"
+        }, '/http'), 'body temp threshold invalid')
+
+    def test_http_body_stream_threshold(self):
+        self.assertIn('success', self.conf({
+            "body_stream_threshold": 65536
+        }, '/http'), 'body stream threshold')
+
+    def test_http_response_temp_threshold(self):
+        self.assertIn('success', self.conf({
+            "response_temp_threshold": 1048576
+        }, '/http'), 'response temp threshold')
+
+    def test_http_temp_path_invalid(self):
+        self.assertIn('error', self.conf({
+            "temp_path": 1
+        }, '/http'), 'temp path invalid')
+
 if __name__ == '__main__':
     unittest.main()
@@ -0,0 +1,426 @@
+import time
+import socket
+import struct
+import unittest
+import unit
+
+class TestUnitHTTP2(unit.TestUnitApplicationPerl):
+
+    preface = b'PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n'
+
+    static_table = [
+        (':authority', ''), (':method', 'GET'), (':method', 'POST'),
+        (':path', '/'), (':path', '/index.html'), (':scheme', 'http'),
+        (':scheme', 'https'), (':status', '200'), (':status', '204'),
+        (':status', '206'), (':status', '304'), (':status', '400'),
+        (':status', '404'), (':status', '500'), ('accept-charset', ''),
+        ('accept-encoding', 'gzip, deflate'), ('accept-language', ''),
+        ('accept-ranges', ''), ('accept', ''),
+        ('access-control-allow-origin', ''), ('age', ''), ('allow', ''),
+        ('authorization', ''), ('cache-control', ''),
+        ('content-disposition', ''), ('content-encoding', ''),
+        ('content-language', ''), ('content-length', ''),
+        ('content-location', ''), ('content-range', ''),
+        ('content-type', ''), ('cookie', ''), ('date', ''), ('etag', ''),
+        ('expect', ''), ('expires', ''), ('from', ''), ('host', ''),
+        ('if-match', ''), ('if-modified-since', ''), ('if-none-match', ''),
+        ('if-range', ''), ('if-unmodified-since', ''), ('last-modified', ''),
+        ('link', ''), ('location', ''), ('max-forwards', ''),
+        ('proxy-authenticate', ''), ('proxy-authorization', ''),
+        ('range', ''), ('referer', ''), ('refresh', ''), ('retry-after', ''),
+        ('server', ''), ('set-cookie', ''),
+        ('strict-transport-security', ''), ('transfer-encoding', ''),
+        ('user-agent', ''), ('vary', ''), ('via', ''),
+        ('www-authenticate', '')
+    ]
+
+    def setUpClass():
+        unit.TestUnit().check_modules('perl')
+
+    def setUp(self):
+        super().setUp()
+
+        self.load('variables')
+
+    def test_http2_get(self):
+        sock = self.h2_connect()
+
+        self.h2_request(sock, 1, url='/path?arg=1',
+            headers=[('custom-header', 'blah')])
+
+        resp = self.h2_responses(sock, 1)[1]
+
+        self.assertEqual(resp['status'], 200, 'status')
+        self.assertEqual(resp['headers']['request-uri'], '/path?arg=1',
+            'request uri')
+        self.assertEqual(resp['headers']['server-protocol'], 'HTTP/2.0',
+            'protocol')
+        self.assertEqual(resp['headers']['http-host'], 'localhost', 'host')
+        self.assertEqual(resp['headers']['custom-header'], 'blah', 'custom')
+
+        sock.close()
+
+    def test_http2_post(self):
+        sock = self.h2_connect()
+
+        body = b'0123456789' * 5000
+
+        self.h2_request(sock, 1, method='POST', body=body,
+            headers=[('content-type', 'text/plain')])
+
+        resp = self.h2_responses(sock, 1)[1]
+
+        self.assertEqual(resp['status'], 200, 'status')
+        self.assertEqual(resp['headers']['content-length'], str(len(body)),
+            'content length')
+        self.assertEqual(resp['headers']['content-type'], 'text/plain',
+            'content type')
+        self.assertEqual(resp['body'], body, 'body')
+
+        sock.close()
+
+    def test_http2_concurrent_streams(self):
+        sock = self.h2_connect()
+
+        for stream in (1, 3, 5):
+            self.h2_request(sock, stream, method='POST', url='/' + str(stream),
+                body=str(stream).encode() * 20000,
+                headers=[('content-type', 'text/plain')])
+
+        resps = self.h2_responses(sock, 1, 3, 5)
+
+        for stream in (1, 3, 5):
+            self.assertEqual(resps[stream]['headers']['request-uri'],
+                '/' + str(stream), 'request uri ' + str(stream))
+            self.assertEqual(resps[stream]['body'],
+                str(stream).encode() * 20000, 'body ' + str(stream))
+
+        # Response fields are indexed in the dynamic table.
+
+        self.h2_request(sock, 7)
+
+        self.assertEqual(self.h2_responses(sock, 7)[7]['headers']['server'],
+            resps[1]['headers']['server'], 'indexed')
+
+        sock.close()
+
+    def test_http2_cookie(self):
+        self.load('cookies')
+
+        sock = self.h2_connect()
+
+        self.h2_request(sock, 1, headers=[('cookie', 'a=1'),
+            ('custom-header', 'blah'), ('cookie', 'b=2'), ('cookie', 'c=3')])
+
+        resp = self.h2_responses(sock, 1)[1]
+
+        self.assertEqual(resp['status'], 200, 'status')
+        self.assertEqual(resp['headers']['http-cookie'], 'a=1; b=2; c=3',
+            'cookie crumbs')
+
+        sock.close()
+
+    def test_http2_body_buffered(self):
+        self.assertIn('success', self.conf({"max_body_size": 100000},
+            '/http'), 'max body size configure')
+
+        sock = self.h2_connect()
+
+        for stream in (1, 3):
+            self.h2_send_headers(sock, stream, [(':method', 'POST'),
+                (':scheme', 'http'), (':authority', 'localhost'),
+                (':path', '/'), ('content-type', 'text/plain')],
+                end_stream=False)
+
+        # The bodies buffered by both streams exceed the limit.
+
+        for stream in (1, 3):
+            for i in range(4):
+                self.h2_send(sock, 0, 0, stream, b'0123456789' * 1500)
+
+        frame = self.h2_frame(sock)
+
+        while frame['type'] == 8:
+            frame = self.h2_frame(sock)
+
+        self.assertEqual(frame['type'], 3, 'reset')
+        self.assertEqual(frame['stream'], 3, 'reset stream')
+        self.assertEqual(struct.unpack('!I', frame['payload'])[0], 7,
+            'refused stream')
+
+        self.h2_send(sock, 0, 0x1, 1, b'')
+
+        resp = self.h2_responses(sock, 1)[1]
+
+        self.assertEqual(resp['status'], 200, 'status')
+        self.assertEqual(resp['body'], b'0123456789' * 6000, 'body')
+
+        sock.close()
+
+    def test_http2_bad_request(self):
+        sock = self.h2_connect()
+
+        self.h2_send_headers(sock, 1, [(':method', 'GET'),
+            (':scheme', 'http'), (':authority', 'localhost')])
+
+        self.assertEqual(self.h2_responses(sock, 1)[1]['status'], 400,
+            'no path')
+
+        self.h2_request(sock, 3, headers=[('Upper', 'case')])
+
+        self.assertEqual(self.h2_responses(sock, 3)[3]['status'], 400,
+            'uppercase')
+
+        self.h2_request(sock, 5, headers=[('connection', 'close')])
+
+        self.assertEqual(self.h2_responses(sock, 5)[5]['status'], 400,
+            'connection')
+
+        sock.close()
+
+    def test_http2_ping(self):
+        sock = self.h2_connect()
+
+        self.h2_send(sock, 6, 0, 0, b'12345678')
+
+        frame = self.h2_frame(sock)
+
+        self.assertEqual(frame['type'], 6, 'ping type')
+        self.assertEqual(frame['flags'], 1, 'ping ack')
+        self.assertEqual(frame['payload'], b'12345678', 'ping payload')
+
+        sock.close()
+
+    def test_http2_protocol_error(self):
+        sock = self.h2_connect()
+
+        # A stream identifier must be odd.
+
+        self.h2_send_headers(sock, 2, [(':method', 'GET')])
+
+        frame = self.h2_frame(sock)
+
+        self.assertEqual(frame['type'], 7, 'goaway')
+        self.assertEqual(struct.unpack('!I', frame['payload'][4:8])[0], 1,
+            'protocol error')
+
+        sock.close()
+
+    def test_http2_cache_wait_reset(self):
+        self.load('cache')
+
+        self.conf({ "size": 1048576 }, '/applications/cache/cache')
+
+        sock = self.h2_connect()
+        sock_closed = self.h2_connect()
+
+        self.h2_request(sock, 1, url='/wait?max-age=10')
+
+        time.sleep(0.2)
+
+        self.h2_request(sock, 3, url='/wait?max-age=10')
+        self.h2_request(sock_closed, 1, url='/wait?max-age=10')
+
+        # The waiting requests are closed before the response is received.
+
+        self.h2_send(sock, 3, 0, 3, struct.pack('!I', 8))
+        sock_closed.close()
+
+        self.assertEqual(self.h2_responses(sock, 1)[1]['body'], b'1',
+            'updated')
+
+        self.h2_request(sock, 5, url='/wait?max-age=10')
+
+        self.assertEqual(self.h2_responses(sock, 5)[5]['body'], b'1',
+            'cached')
+
+        sock.close()
+
+    def h2_connect(self):
+        sock = socket.create_connection(('127.0.0.1', 7080))
+        sock.settimeout(5)
+
+        sock.sendall(self.preface)
+
+        self.h2_send(sock, 4, 0, 0, b'')
+
+        frame = self.h2_frame(sock)
+
+        self.assertEqual(frame['type'], 4, 'settings')
+        self.assertEqual(frame['flags'], 0, 'settings no ack')
+
+        self.h2_send(sock, 4, 1, 0, b'')
+
+        frame = self.h2_frame(sock)
+
+        self.assertEqual(frame['type'], 4, 'settings ack')
+        self.assertEqual(frame['flags'], 1, 'settings ack flag')
+
+        self.table = []
+
+        return sock
+
+    def h2_send(self, sock, type, flags, stream, payload):
+        sock.sendall(struct.pack('!I', len(payload))[1:]
+            + struct.pack('!BBI', type, flags, stream) + payload)
+
+    def h2_send_headers(self, sock, stream, headers, end_stream=True):
+        block = b''
+
+        for name, value in headers:
+            block += b'\x00' + self.hpack_string(name.encode()) \
+                + self.hpack_string(value.encode())
+
+        self.h2_send(sock, 1, 0x4 | (0x1 if end_stream else 0), stream,
+            block)
+
+    def h2_request(self, sock, stream, method='GET', url='/', headers=[],
+        body=b''):
+
+        self.h2_send_headers(sock, stream, [(':method', method),
+            (':scheme', 'http'), (':authority', 'localhost'),
+            (':path', url)] + headers, end_stream=(body == b''))
+
+        while body != b'':
+            self.h2_send(sock, 0, 0x1 if len(body) <= 16384 else 0, stream,
+                body[:16384])
+            body = body[16384:]
+
+    def h2_frame(self, sock):
+        header = self.h2_recv(sock, 9)
+        length = struct.unpack('!I', b'\x00' + header[:3])[0]
+        type, flags, stream = struct.unpack('!BBI', header[3:])
+
+        return {
+            'type': type,
+            'flags': flags,
+            'stream': stream & 0x7fffffff,
+            'payload': self.h2_recv(sock, length)
+        }
+
+    def h2_recv(self, sock, size):
+        data = b''
+
+        while len(data) < size:
+            part = sock.recv(size - len(data))
+            if not part:
+                break
+            data += part
+
+        return data
+
+    def h2_responses(self, sock, *streams):
+        resps = {}
+        closed = 0
+
+        while closed < len(streams):
+            frame = self.h2_frame(sock)
+            stream = frame['stream']
+
+            if frame['type'] == 1:
+                resps[stream] = self.hpack_decode(frame['payload'])
+                resps[stream]['body'] = b''
+
+            elif frame['type'] == 0:
+                resps[stream]['body'] += frame['payload']
+
+                if frame['payload'] != b'':
+                    increment = struct.pack('!I', len(frame['payload']))
+
+                    self.h2_send(sock, 8, 0, 0, increment)
+                    self.h2_send(sock, 8, 0, stream, increment)
+
+            elif frame['type'] == 3:
+                self.fail('stream ' + str(stream) + ' reset')
+
+            elif frame['type'] == 7:
+                self.fail('goaway')
+
+            if frame['type'] in (0, 1) and frame['flags'] & 0x1:
+                closed += 1
+
+        return resps
+
+    def hpack_string(self, s):
+        return self.hpack_integer(0, 7, len(s)) + s
+
+    def hpack_integer(self, flags, prefix, value):
+        mask = (1 << prefix) - 1
+
+        if value < mask:
+            return bytes([flags | value])
+
+        data = bytes([flags | mask])
+        value -= mask
+
+        while value >= 0x80:
+            data += bytes([0x80 | (value & 0x7f)])
+            value >>= 7
+
+        return data + bytes([value])
+
+    def hpack_decode(self, block):
+        resp = { 'headers': {} }
+        pos = 0
+
+        def integer(prefix):
+            nonlocal pos
+
+            mask = (1 << prefix) - 1
+            value = block[pos] & mask
+            pos += 1
+
+            if value == mask:
+                shift = 0
+
+                while True:
+                    value += (block[pos] & 0x7f) << shift
+                    shift += 7
+                    pos += 1
+
+                    if not block[pos - 1] & 0x80:
+                        break
+
+            return value
+
+        def string():
+            nonlocal pos
+
+            self.assertFalse(block[pos] & 0x80, 'no huffman')
+            length = integer(7)
+            pos += length
+
+            return block[pos - length:pos].decode()
+
+        def entry(index):
+            if index <= len(self.static_table):
+                return self.static_table[index - 1]
+
+            return self.table[index - len(self.static_table) - 1]
+
+        while pos < len(block):
+            if block[pos] & 0x80:
+                name, value = entry(integer(7))
+
+            elif block[pos] & 0xe0 == 0x20:
+                integer(5)
+                continue
+
+            else:
+                indexing = block[pos] & 0x40
+                index = integer(6 if indexing else 4)
+                name = entry(index)[0] if index else string()
+                value = string()
+
+                if indexing:
+                    self.table.insert(0, (name, value))
+
+            if name == ':status':
+                resp['status'] = int(value)
+            else:
+                resp['headers'][name] = value
+
+        return resp
+
+if __name__ == '__main__':
+    unittest.main()
@@ -1,5 +1,7 @@
+import os
 import re
 import time
+import signal
 import unittest
 import unit
 
@@ -37,6 +39,24 @@ class TestUnitPerlApplication(unit.TestUnitApplicationPerl):
         }, 'headers')
         self.assertEqual(resp['body'], body, 'body')
 
+    def test_perl_application_large_header(self):
+        self.load('variables')
+
+        value = 'x' * 7000
+
+        resp = self.get(headers={
+            'Host': 'localhost',
+            'X-Pad-1': 'a' * 6000,
+            'X-Pad-2': 'b' * 6000,
+            'Custom-Header': value
+        })
+
+        self.assertEqual(resp['status'], 200, 'status')
+        self.assertEqual(resp['headers']['Custom-Header'], value,
+            'large header')
+        self.assertEqual(resp['headers']['Http-Host'], 'localhost',
+            'host header')
+
     def test_perl_application_query_string(self):
         self.load('query_string')
 
@@ -104,6 +124,93 @@ class TestUnitPerlApplication(unit.TestUnitApplicationPerl):
 
         self.assertEqual(resp, body, 'body large')
 
+    def test_perl_application_body_large_response(self):
+        self.load('body_large')
+
+        self.assertEqual(self.get()['body'], '0123456789abcdef' * 262144,
+            'body large response')
+
+    def test_perl_application_body_large_response_temp_file(self):
+        self.load('body_large')
+
+        self.conf({"response_temp_threshold": 100000}, '/http')
+
+        self.assertEqual(self.get()['body'], '0123456789abcdef' * 262144,
+            'body large response temp file')
+
+    def test_perl_application_body_large_response_temp_file_error(self):
+        self.load('body_large')
+
+        self.conf({
+            "response_temp_threshold": 100000,
+            "temp_path": self.testdir + '/nonexistent'
+        }, '/http')
+
+        self.assertEqual(self.get()['body'], '0123456789abcdef' * 262144,
+            'body large response temp file error')
+
+    def test_perl_application_body_stream(self):
+        self.load('variables')
+
+        self.conf({"body_stream_threshold": 100000}, '/http')
+
+        body = '0123456789' * 50000
+
+        resp = self.post(headers={
+            'Host': 'localhost',
+            'Content-Type': 'text/html'
+        }, body=body)
+
+        self.assertEqual(resp['status'], 200, 'body stream status')
+        self.assertEqual(resp['body'], body, 'body stream')
+
+    def test_perl_application_body_temp_file(self):
+        self.load('variables')
+
+        self.conf({"body_temp_threshold": 1000}, '/http')
+
+        body = '0123456789' * 10000
+
+        resp = self.post(headers={
+            'Host': 'localhost',
+            'Content-Type': 'text/html'
+        }, body=body)
+
+        self.assertEqual(resp['status'], 200, 'body temp file status')
+        self.assertEqual(resp['body'], body, 'body temp file')
+
+    def test_perl_application_body_temp_path(self):
+        self.load('variables')
+
+        temp_path = self.testdir + '/temp'
+
+        os.mkdir(temp_path)
+        os.chmod(temp_path, 0o777)
+        os.chmod(self.testdir, 0o711)
+
+        self.conf({
+            "body_temp_threshold": 1000,
+            "temp_path": temp_path
+        }, '/http')
+
+        body = '0123456789' * 10000
+
+        resp = self.post(headers={
+            'Host': 'localhost',
+            'Content-Type': 'text/html'
+        }, body=body)
+
+        self.assertEqual(resp['status'], 200, 'body temp path status')
+        self.assertEqual(resp['body'], body, 'body temp path')
+
+        self.conf('"' + temp_path + '/nonexistent"', '/http/temp_path')
+
+        self.assertEqual(self.post(headers={
+            'Host': 'localhost',
+            'Content-Type': 'text/html',
+            'Connection': 'close'
+        }, body=body)['status'], 500, 'body temp path nonexistent')
+
     def test_perl_application_body_io_empty(self):
         self.load('body_io_empty')
 
@@ -114,5 +221,73 @@ class TestUnitPerlApplication(unit.TestUnitApplicationPerl):
 
         self.assertEqual(self.get()['body'], 'body\n', 'body io file')
 
+    def test_perl_application_leased_process_killed(self):
+        self.load('variables')
+
+        self.conf({ "spare": 1, "max": 2 },
+            '/applications/variables/processes')
+
+        # The process is leased to the router engine after the request,
+        # and another spare process is started.
+
+        self.assertEqual(self.get()['status'], 200, 'status')
+
+        time.sleep(0.5)
+
+        for i in range(2):
+            pid = self.pid('"variables" application')
+
+            os.kill(int(pid), signal.SIGKILL)
+
+            time.sleep(0.5)
+
+        time.sleep(0.5)
+
+        self.pid('"variables" application')
+
+    def test_perl_application_balance_least_outstanding(self):
+        self.balance('least_outstanding')
+
+    def test_perl_application_balance_p2c(self):
+        self.balance('p2c')
+
+    def balance(self, balance):
+        self.load('delayed')
+
+        self.assertIn('success', self.conf({
+            "spare": 2,
+            "max": 2,
+            "balance": balance
+        }, '/applications/delayed/processes'), 'balance ' + balance)
+
+        # A slow request occupies one process.
+
+        (resp, sock) = self.get(headers={
+            'Host': 'localhost',
+            'X-Delay': '3',
+            'Connection': 'close'
+        }, start=True, raw_resp=True)
+
+        pids = set()
+
+        for i in range(4):
+            pids.add(self.get()['headers']['Pid'])
+
+        sock.setblocking(True)
+
+        while True:
+            part = sock.recv(4096).decode()
+            if part == '':
+                break
+
+            resp += part
+
+        sock.close()
+
+        slow_pid = self._resp_to_dict(resp)['headers']['Pid']
+
+        self.assertEqual(len(pids), 1, 'one process ' + balance)
+        self.assertNotIn(slow_pid, pids, 'less loaded process ' + balance)
+
 if __name__ == '__main__':
     unittest.main()
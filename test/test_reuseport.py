@@ -0,0 +1,127 @@
+import os
+import unittest
+import unit
+
+class TestUnitReuseport(unit.TestUnitApplicationPerl):
+
+    def setUpClass():
+        unit.TestUnit().check_modules('perl')
+
+    def setUp(self):
+        super().setUp()
+
+        self.load('variables')
+
+    def test_reuseport(self):
+        self.assertIn('success', self.listener(reuseport=True), 'reuseport')
+
+        self.assertEqual(self.listen_sockets(), os.cpu_count(), 'sockets')
+
+        for i in range(20):
+            self.assertEqual(self.get(url='/' + str(i))['status'], 200,
+                'request ' + str(i))
+
+        # The option cannot be changed on the bound sockets.
+
+        self.assertIn('error', self.conf('false',
+            '/listeners/*:7080/reuseport'), 'toggle off')
+
+        self.assertEqual(self.listen_sockets(), os.cpu_count(),
+            'sockets kept')
+        self.assertEqual(self.get()['status'], 200, 'toggle off request')
+
+    def test_reuseport_distribution(self):
+        if os.cpu_count() < 2:
+            self.skipTest('one router engine')
+
+        self.listener(reuseport=True)
+
+        router = self.pid('router')
+        before = self.engine_switches(router)
+
+        for i in range(100):
+            self.get(headers={'Host': 'localhost', 'Connection': 'close'})
+
+        after = self.engine_switches(router)
+
+        # The kernel distributes connections between the engine sockets,
+        # so not only one engine thread wakes up to process them.
+
+        n = sorted(after[tid] - before.get(tid, 0) for tid in after)
+
+        self.assertGreater(n[-2], n[-1] / 4, 'distribution')
+
+    def test_reuseport_cpu(self):
+        self.assertIn('success', self.listener(reuseport_cpu=True),
+            'reuseport cpu')
+
+        for i in range(20):
+            self.assertEqual(self.get()['status'], 200, 'request ' + str(i))
+
+    def test_reuseport_recreate(self):
+        self.listener(reuseport=True)
+
+        self.assertIn('success', self.conf_delete('/listeners/*:7080'),
+            'delete')
+        self.assertEqual(self.listen_sockets(), 0, 'deleted')
+
+        self.assertIn('success', self.listener(reuseport=True), 'recreate')
+        self.assertEqual(self.get()['status'], 200, 'recreated')
+
+        self.assertIn('success', self.conf_delete('/listeners/*:7080'),
+            'delete 2')
+        self.assertIn('success', self.listener(), 'shared')
+        self.assertEqual(self.listen_sockets(), 1, 'shared socket')
+        self.assertEqual(self.get()['status'], 200, 'shared request')
+
+    def test_reuseport_shared(self):
+        self.assertEqual(self.listen_sockets(), 1, 'shared socket')
+
+        self.assertIn('error', self.conf('true',
+            '/listeners/*:7080/reuseport'), 'toggle on')
+
+        self.assertEqual(self.listen_sockets(), 1, 'shared socket kept')
+        self.assertEqual(self.get()['status'], 200, 'toggle on request')
+
+    def test_reuseport_invalid(self):
+        self.assertIn('error', self.conf('"blah"',
+            '/listeners/*:7080/reuseport'), 'not boolean')
+        self.assertIn('error', self.conf('1',
+            '/listeners/*:7080/reuseport_cpu'), 'cpu not boolean')
+
+    def listener(self, **options):
+        options['application'] = 'variables'
+
+        # The sockets of an existing listener are not recreated.
+
+        self.conf({}, '/listeners')
+
+        return self.conf({ "*:7080": options }, '/listeners')
+
+    def engine_switches(self, pid):
+        switches = {}
+
+        for tid in os.listdir('/proc/' + pid + '/task'):
+            with open('/proc/' + pid + '/task/' + tid + '/status') as f:
+                for line in f:
+                    if line.startswith('voluntary_ctxt_switches'):
+                        switches[tid] = int(line.split()[1])
+
+        return switches
+
+    def listen_sockets(self):
+        n = 0
+
+        with open('/proc/net/tcp') as f:
+            for line in f.readlines()[1:]:
+                fields = line.split()
+
+                # The local address is 0.0.0.0:7080 in the LISTEN state.
+
+                if fields[1] == '00000000:1BA8' and fields[3] == '0A':
+                    n += 1
+
+        return n
+
+if __name__ == '__main__':
+    unittest.main()
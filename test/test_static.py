@@ -0,0 +1,118 @@
+import os
+import time
+import unittest
+import unit
+
+class TestUnitStatic(unit.TestUnitApplicationPerl):
+
+    def setUpClass():
+        unit.TestUnit().check_modules('perl')
+
+    def setUp(self):
+        super().setUp()
+
+        os.makedirs(self.testdir + '/share/dir')
+        os.chmod(self.testdir, 0o755)
+
+        with open(self.testdir + '/share/index.html', 'w') as f:
+            f.write('0123456789')
+
+        with open(self.testdir + '/share/dir/file.css', 'w') as f:
+            f.write('css' * 10000)
+
+        self.load('variables')
+
+        self.conf('"' + self.testdir + '/share"', '/listeners/*:7080/share')
+
+    def test_static_file(self):
+        resp = self.get(url='/index.html')
+
+        self.assertEqual(resp['status'], 200, 'status')
+        self.assertEqual(resp['body'], '0123456789', 'body')
+        self.assertEqual(resp['headers']['Content-Type'], 'text/html',
+            'content type')
+        self.assertEqual(resp['headers']['Content-Length'], '10',
+            'content length')
+        self.assertIn('ETag', resp['headers'], 'etag')
+        self.assertIn('Last-Modified', resp['headers'], 'last modified')
+
+    def test_static_file_large(self):
+        resp = self.get(url='/dir/file.css')
+
+        self.assertEqual(resp['headers']['Content-Type'], 'text/css',
+            'content type')
+        self.assertEqual(resp['body'], 'css' * 10000, 'body')
+
+    def test_static_head(self):
+        resp = self.http('HEAD', url='/index.html')
+
+        self.assertEqual(resp['status'], 200, 'status')
+        self.assertEqual(resp['headers']['Content-Length'], '10',
+            'content length')
+        self.assertEqual(resp['body'], '', 'body')
+
+    def test_static_not_modified(self):
+        headers = self.get(url='/index.html')['headers']
+
+        resp = self.get(url='/index.html', headers={
+            'Host': 'localhost',
+            'If-None-Match': headers['ETag'],
+            'Connection': 'close'
+        })
+
+        self.assertEqual(resp['status'], 304, 'etag status')
+        self.assertEqual(resp['body'], '', 'etag body')
+
+        resp = self.get(url='/index.html', headers={
+            'Host': 'localhost',
+            'If-Modified-Since': headers['Last-Modified'],
+            'Connection': 'close'
+        })
+
+        self.assertEqual(resp['status'], 304, 'last modified status')
+
+        resp = self.get(url='/index.html', headers={
+            'Host': 'localhost',
+            'If-None-Match': '"blah"',
+            'Connection': 'close'
+        })
+
+        self.assertEqual(resp['status'], 200, 'etag mismatch')
+
+    def test_static_application(self):
+        resp = self.post(url='/nofile', headers={
+            'Host': 'localhost',
+            'Content-Type': 'text/html',
+            'Connection': 'close'
+        }, body='body')
+
+        self.assertEqual(resp['status'], 200, 'no file status')
+        self.assertEqual(resp['body'], 'body', 'no file body')
+
+        self.assertEqual(self.get(url='/dir')['headers']['Request-Uri'],
+            '/dir', 'directory')
+        self.assertEqual(self.post(url='/index.html')['body'], '',
+            'post method')
+        self.assertEqual(self.get(url='/../share/index.html')['status'], 400,
+            'outside of share')
+
+    def test_static_update(self):
+        self.assertEqual(self.get(url='/index.html')['body'], '0123456789',
+            'before update')
+
+        with open(self.testdir + '/share/index.html', 'w') as f:
+            f.write('updated')
+
+        os.utime(self.testdir + '/share/index.html', (1, 1))
+
+        time.sleep(2)
+
+        self.assertEqual(self.get(url='/index.html')['body'], 'updated',
+            'after update')
+
+    def test_static_configuration(self):
+        self.assertIn('error', self.conf('1', '/listeners/*:7080/share'),
+            'share invalid')
+
+if __name__ == '__main__':
+    unittest.main()
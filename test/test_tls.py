@@ -0,0 +1,222 @@
+import os
+import ssl
+import socket
+import unittest
+import subprocess
+import unit
+
+class TestUnitTLS(unit.TestUnitApplicationPerl):
+
+    def setUpClass():
+        unit.TestUnit().check_modules('perl')
+
+        version = subprocess.check_output([unit.TestUnit.pardir +
+            '/build/unitd', '--version'], stderr=subprocess.STDOUT)
+
+        if b'--openssl' not in version:
+            raise unittest.SkipTest('Unit has no OpenSSL support')
+
+    def setUp(self):
+        super().setUp()
+
+        subprocess.check_call(['openssl', 'req', '-x509', '-newkey',
+            'rsa:2048', '-nodes', '-subj', '/CN=localhost', '-days', '1',
+            '-keyout', self.testdir + '/key.pem',
+            '-out', self.testdir + '/cert.pem'], stderr=subprocess.DEVNULL)
+
+        with open(self.testdir + '/cert.pem') as f:
+            self.bundle = f.read()
+
+        with open(self.testdir + '/key.pem') as f:
+            self.bundle += f.read()
+
+        self.assertIn('success', self.conf(self.bundle,
+            '/certificates/default'), 'certificate upload')
+
+        self.load('variables')
+
+        self.assertIn('success', self.conf({ "certificate": "default" },
+            '/listeners/*:7080/tls'), 'tls listener')
+
+    def test_tls_get(self):
+        resp = self.tls_get(url='/path?arg=1')
+
+        self.assertEqual(resp['status'], 200, 'status')
+        self.assertEqual(resp['headers']['Request-Uri'], '/path?arg=1',
+            'request uri')
+
+    def test_tls_keepalive(self):
+        sock = self.tls_connect()
+
+        for i in range(3):
+            sock.sendall(b'GET / HTTP/1.1\r\nHost: localhost\r\n\r\n')
+
+            self.assertTrue(self.tls_recv(sock).startswith(b'HTTP/1.1 200 '),
+                'keepalive ' + str(i))
+
+        sock.close()
+
+    def test_tls_large_response(self):
+        os.makedirs(self.testdir + '/share')
+        os.chmod(self.testdir, 0o755)
+
+        body = os.urandom(3 * 1024 * 1024)
+
+        with open(self.testdir + '/share/large', 'wb') as f:
+            f.write(body)
+
+        self.conf('"' + self.testdir + '/share"', '/listeners/*:7080/share')
+
+        sock = self.tls_connect()
+        sock.sendall(b'GET /large HTTP/1.1\r\nHost: localhost\r\n'
+            b'Connection: close\r\n\r\n')
+
+        resp = b''
+        while True:
+            part = sock.recv(65536)
+            if not part:
+                break
+            resp += part
+
+        sock.close()
+
+        self.assertEqual(resp.split(b'\r\n\r\n', 1)[1], body, 'body')
+
+    def test_tls_session_cache(self):
+        ctx = self.tls_context(tickets=False)
+
+        session = self.tls_get(ctx=ctx)['session']
+
+        self.assertTrue(self.tls_get(ctx=ctx, session=session)['reused'],
+            'reused')
+
+    def test_tls_session_ticket(self):
+        ctx = self.tls_context()
+
+        session = self.tls_get(ctx=ctx)['session']
+
+        self.assertTrue(session.has_ticket, 'ticket')
+        self.assertTrue(self.tls_get(ctx=ctx, session=session)['reused'],
+            'reused')
+
+    def test_tls_session_cache_disabled(self):
+        self.assertIn('success', self.conf({ "certificate": "default",
+            "session_cache": 0 }, '/listeners/*:7080/tls'), 'no cache')
+
+        ctx = self.tls_context(tickets=False)
+
+        session = self.tls_get(ctx=ctx)['session']
+
+        self.assertFalse(self.tls_get(ctx=ctx, session=session)['reused'],
+            'not reused')
+
+    def test_tls_alpn_h2(self):
+        ctx = self.tls_context()
+        ctx.set_alpn_protocols(['h2', 'http/1.1'])
+
+        sock = self.tls_connect(ctx=ctx)
+
+        self.assertEqual(sock.selected_alpn_protocol(), 'h2', 'alpn h2')
+
+        sock.sendall(b'PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n'
+            + b'\x00\x00\x00\x04\x00\x00\x00\x00\x00')
+
+        header = sock.recv(9)
+
+        self.assertEqual(header[3], 4, 'settings')
+
+        sock.close()
+
+        ctx = self.tls_context()
+        ctx.set_alpn_protocols(['http/1.1'])
+
+        self.assertEqual(self.tls_get(ctx=ctx)['alpn'], 'http/1.1',
+            'alpn http/1.1')
+
+    def test_tls_certificate_invalid(self):
+        self.assertIn('error', self.conf('blah', '/certificates/invalid'),
+            'not pem')
+
+        with open(self.testdir + '/cert.pem') as f:
+            self.assertIn('error', self.conf(f.read(),
+                '/certificates/invalid'), 'no key')
+
+        self.assertIn('error', self.conf(self.bundle, '/certificates/..'),
+            'name')
+
+    def test_tls_certificate_unknown(self):
+        self.assertIn('error', self.conf({ "certificate": "unknown" },
+            '/listeners/*:7080/tls'), 'unknown')
+
+        self.assertIn('success', self.conf_delete('/certificates/default'),
+            'delete')
+
+        self.assertIn('error', self.conf({ "certificate": "default",
+            "session_cache": 0 }, '/listeners/*:7080/tls'), 'deleted')
+
+        self.assertEqual(self.tls_get()['status'], 200, 'previous conf')
+
+    def tls_context(self, tickets=True):
+        ctx = ssl.SSLContext(ssl.PROTOCOL_TLS_CLIENT)
+        ctx.check_hostname = False
+        ctx.verify_mode = ssl.CERT_NONE
+
+        # Sessions are resumed without post-handshake messages in TLS 1.2.
+        ctx.maximum_version = ssl.TLSVersion.TLSv1_2
+
+        if not tickets:
+            ctx.options |= ssl.OP_NO_TICKET
+
+        return ctx
+
+    def tls_connect(self, ctx=None, session=None):
+        if ctx is None:
+            ctx = self.tls_context()
+
+        sock = socket.create_connection(('127.0.0.1', 7080))
+        sock.settimeout(5)
+
+        return ctx.wrap_socket(sock, session=session)
+
+    def tls_recv(self, sock):
+        data = b''
+
+        while b'\r\n\r\n' not in data:
+            data += sock.recv(4096)
+
+        head, body = data.split(b'\r\n\r\n', 1)
+
+        for line in head.split(b'\r\n'):
+            if line.lower().startswith(b'content-length:'):
+                length = int(line.split(b':')[1])
+
+                while len(body) < length:
+                    body += sock.recv(4096)
+
+        return head + b'\r\n\r\n' + body
+
+    def tls_get(self, url='/', ctx=None, session=None):
+        sock = self.tls_connect(ctx, session)
+
+        sock.sendall(('GET ' + url + ' HTTP/1.1\r\nHost: localhost\r\n'
+            'Connection: close\r\n\r\n').encode())
+
+        resp = b''
+        while True:
+            part = sock.recv(4096)
+            if not part:
+                break
+            resp += part
+
+        resp = self._resp_to_dict(resp.decode())
+
+        resp['session'] = sock.session
+        resp['reused'] = sock.session_reused
+        resp['alpn'] = sock.selected_alpn_protocol()
+
+        sock.close()
+
+        return resp
+
+if __name__ == '__main__':
+    unittest.main()
@@ -8,7 +8,7 @@ import socket
 import select
 import tempfile
 import unittest
-from subprocess import call
+from subprocess import call, check_output
 from multiprocessing import Process
 
 class TestUnit(unittest.TestCase):
@@ -97,6 +97,18 @@ class TestUnit(unittest.TestCase):
         with open(self.testdir + '/' + name + '/wsgi.py', 'w') as f:
             f.write(code)
 
+    def pid(self, title):
+        with open(self.testdir + '/unit.pid') as f:
+            main = f.read().rstrip()
+
+        output = check_output(['ps', '-o', 'pid=,args=', '--ppid', main])
+
+        for line in output.decode().splitlines():
+            if line.endswith('unit: ' + title):
+                return line.split()[0]
+
+        self.fail('no "' + title + '" process')
+
     def _stop(self):
         with open(self.testdir + '/unit.pid', 'r') as f:
             pid = f.read().rstrip()